@@ -0,0 +1,150 @@
+/*
+ *arena.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../inc/protocol.h"
+#include "../inc/arena.h"
+
+/*
+ *Offset of the usable bytes in a block, keeping them aligned.
+ */
+#define ARENA_HEADER_SIZE ((sizeof(ArenaBlock) + ARENA_ALIGNMENT - 1u) \
+        & ~(size_t)(ARENA_ALIGNMENT - 1u))
+
+/*
+ *Set up an empty arena requesting blocks of the given size.
+ */
+void arena_init(Arena* arena, size_t blockSize) {
+    memset(arena, 0, sizeof(Arena));
+    arena->blockSize = blockSize;
+}
+
+/*
+ *Start a new block holding at least the given number of bytes, the spare
+ *one if it is large enough.
+ */
+void push_block(Arena* arena, size_t size) {
+    ArenaBlock* block = NULL;
+
+    if (arena->spare && size <= arena->spare->size) {
+        block = arena->spare;
+        arena->spare = NULL;
+    } else {
+        size = MAX(size, arena->blockSize);
+        block = (ArenaBlock*)malloc(ARENA_HEADER_SIZE + size);
+        block->size = size;
+        arena->systemAllocations += 1;
+    }
+    block->previous = arena->block;
+    arena->block = block;
+    arena->used = 0u;
+}
+
+/*
+ *Allocate from the arena.
+ */
+void* arena_alloc(Arena* arena, size_t size) {
+    void* memory = NULL;
+
+    size = (size + ARENA_ALIGNMENT - 1u) & ~(size_t)(ARENA_ALIGNMENT - 1u);
+    if (!arena->block || arena->block->size - arena->used < size) {
+        push_block(arena, size);
+    }
+    memory = (unsigned char*)arena->block + ARENA_HEADER_SIZE + arena->used;
+    arena->used += size;
+    arena->allocations += 1;
+    arena->bytes += size;
+    arena->peakBytes = MAX(arena->peakBytes, arena->bytes);
+    return memory;
+}
+
+/*
+ *Allocate zeroed memory from the arena.
+ */
+void* arena_calloc(Arena* arena, size_t count, size_t size) {
+    void* memory = arena_alloc(arena, count * size);
+
+    memset(memory, 0, count * size);
+    return memory;
+}
+
+/*
+ *Remember the current position of the arena.
+ */
+ArenaMark arena_mark(const Arena* arena) {
+    ArenaMark mark;
+
+    mark.block = arena->block;
+    mark.used = arena->used;
+    mark.bytes = arena->bytes;
+    return mark;
+}
+
+/*
+ *Give back everything allocated since the mark was taken.
+ *Blocks started since are kept as spare, only the largest one.
+ */
+void arena_release(Arena* arena, ArenaMark mark) {
+    ArenaBlock* block = NULL;
+
+    while (arena->block != mark.block) {
+        block = arena->block;
+        arena->block = block->previous;
+        if (arena->spare && arena->spare->size < block->size) {
+            free(arena->spare);
+            arena->spare = NULL;
+        }
+        if (arena->spare) {
+            free(block);
+        } else {
+            arena->spare = block;
+        }
+    }
+    arena->used = mark.used;
+    arena->bytes = mark.bytes;
+}
+
+/*
+ *Give back everything allocated. If the arena had to grow, its blocks are
+ *merged into one, so the next game fits without requesting more.
+ */
+void arena_reset(Arena* arena) {
+    const ArenaBlock* block = NULL;
+    size_t size = 0u;
+
+    arena->resets += 1;
+    arena->used = 0u;
+    arena->bytes = 0u;
+    if (!arena->block || (!arena->block->previous && !arena->spare)) {
+        return;
+    }
+
+    size = arena->spare ? arena->spare->size : 0u;
+    for (block = arena->block; block; block = block->previous) {
+        size += block->size;
+    }
+    arena_free(arena);
+    push_block(arena, size);
+}
+
+/*
+ *Return all blocks to the system.
+ */
+void arena_free(Arena* arena) {
+    ArenaBlock* block = arena->block;
+    ArenaBlock* previous = NULL;
+
+    while (block) {
+        previous = block->previous;
+        free(block);
+        block = previous;
+    }
+    free(arena->spare);
+    arena->block = NULL;
+    arena->spare = NULL;
+    arena->used = 0u;
+    arena->bytes = 0u;
+}
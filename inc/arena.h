@@ -0,0 +1,101 @@
+/*
+ *arena.h
+ */
+
+#pragma once
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+/*
+ *Size of the blocks an arena requests from the system, unless a single
+ *allocation needs more.
+ */
+#define ARENA_BLOCK_SIZE (64u * 1024u)
+
+/*
+ *Alignment of every allocation of an arena.
+ */
+#define ARENA_ALIGNMENT 16u
+
+/*
+ *Header of a block of arena memory, the usable bytes follow it.
+ */
+typedef struct ArenaBlock {
+    struct ArenaBlock* previous;
+    size_t size;
+} ArenaBlock;
+
+/*
+ *Bump allocator for the state of a game: everything is freed at once by
+ *resetting it.
+ *block, used .. Newest block and the bytes used of it. Older blocks are
+ *full.
+ *spare .. Block given back by arena_release(), kept for the next one
+ *needed.
+ *allocations .. Allocations served.
+ *bytes, peakBytes .. Bytes in use now and at most.
+ *systemAllocations .. Blocks requested from the system.
+ *resets .. Times the arena has been reset.
+ */
+typedef struct {
+    ArenaBlock* block;
+    size_t used;
+    ArenaBlock* spare;
+    size_t blockSize;
+    size_t allocations;
+    size_t bytes;
+    size_t peakBytes;
+    size_t systemAllocations;
+    size_t resets;
+} Arena;
+
+/*
+ *Position in an arena to release later allocations back to.
+ */
+typedef struct {
+    ArenaBlock* block;
+    size_t used;
+    size_t bytes;
+} ArenaMark;
+
+/*
+ *Set up an empty arena requesting blocks of the given size.
+ */
+void arena_init(Arena* arena, size_t blockSize);
+
+/*
+ *Allocate from the arena.
+ */
+void* arena_alloc(Arena* arena, size_t size);
+
+/*
+ *Allocate zeroed memory from the arena.
+ */
+void* arena_calloc(Arena* arena, size_t count, size_t size);
+
+/*
+ *Remember the current position of the arena.
+ */
+ArenaMark arena_mark(const Arena* arena);
+
+/*
+ *Give back everything allocated since the mark was taken.
+ */
+void arena_release(Arena* arena, ArenaMark mark);
+
+/*
+ *Give back everything allocated. If the arena had to grow, its blocks are
+ *merged into one, so the next game fits without requesting more.
+ */
+void arena_reset(Arena* arena);
+
+/*
+ *Return all blocks to the system.
+ */
+void arena_free(Arena* arena);
+
+#endif
+
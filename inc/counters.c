@@ -0,0 +1,167 @@
+/*
+ *counters.c
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "../inc/counters.h"
+
+/*
+ *Type of each event for perf_event_open().
+ */
+static const uint32_t counterTypes[COUNTER_EVENTS_COUNT] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+    PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE
+};
+/*
+ *Configuration of each event, within its type.
+ */
+static const uint64_t counterConfigs[COUNTER_EVENTS_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_SW_CONTEXT_SWITCHES
+};
+/*
+ *Names the events are printed with.
+ */
+static const char* const counterNames[COUNTER_EVENTS_COUNT] = {
+    "Cycles", "Instructions", "CacheMisses", "BranchMisses",
+    "ContextSwitches"
+};
+
+/*
+ *Set up counters which count nothing.
+ */
+void counters_init(Counters* counters) {
+    int i = 0;
+
+    memset(counters, 0, sizeof(Counters));
+    for (i = 0; i < COUNTER_EVENTS_COUNT; i++) {
+        counters->fds[i] = -1;
+    }
+}
+
+/*
+ *Open the counter of a single event.
+ *Returns the file descriptor, or -1 if it can't be counted.
+ */
+int open_counter(enum CounterEvents event, pid_t pid, int inherit) {
+    struct perf_event_attr attributes;
+    int fd = -1;
+
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = counterTypes[event];
+    attributes.config = counterConfigs[event];
+    attributes.inherit = inherit ? 1 : 0;
+    attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+            | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    fd = (int)syscall(SYS_perf_event_open, &attributes, pid, -1, -1,
+            PERF_FLAG_FD_CLOEXEC);
+    if (-1 == fd && EACCES == errno) {
+        /*perf_event_paranoid may allow counting user space only*/
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        fd = (int)syscall(SYS_perf_event_open, &attributes, pid, -1, -1,
+                PERF_FLAG_FD_CLOEXEC);
+    }
+    return fd;
+}
+
+/*
+ *Start counting the events of the given process, 0 for this one. With
+ *inherit set, the threads and processes it starts afterwards are counted
+ *as well.
+ *Returns the number of events counted, 0 if none can be.
+ */
+int counters_open(Counters* counters, pid_t pid, int inherit) {
+    int opened = 0;
+    int i = 0;
+
+    for (i = 0; i < COUNTER_EVENTS_COUNT; i++) {
+        counters->fds[i] = open_counter((enum CounterEvents)i, pid,
+                inherit);
+        opened += -1 != counters->fds[i];
+    }
+    return opened;
+}
+
+/*
+ *Stop counting and add the counts to the values. The process may have
+ *ended already.
+ */
+void counters_read(Counters* counters) {
+    uint64_t data[3];
+    double value = 0.0;
+    int i = 0;
+
+    for (i = 0; i < COUNTER_EVENTS_COUNT; i++) {
+        if (-1 == counters->fds[i]) {
+            continue;
+        }
+        ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        /*value, time enabled, time running*/
+        if ((ssize_t)sizeof(data) == read(counters->fds[i], data,
+                sizeof(data))) {
+            value = (double)data[0];
+            if (data[2] && data[2] < data[1]) {
+                value *= (double)data[1] / (double)data[2];
+            }
+            counters->values[i] += (uint64_t)value;
+            counters->counted[i] = 1;
+        }
+        close(counters->fds[i]);
+        counters->fds[i] = -1;
+    }
+}
+
+/*
+ *Add the values of other counters, e.g. of another process running the
+ *same program.
+ */
+void counters_add(Counters* counters, const Counters* other) {
+    int i = 0;
+
+    for (i = 0; i < COUNTER_EVENTS_COUNT; i++) {
+        if (other->counted[i]) {
+            counters->values[i] += other->values[i];
+            counters->counted[i] = 1;
+        }
+    }
+}
+
+/*
+ *Print the values as a line of Name=value pairs after the prefix, with
+ *n/a for the events not counted.
+ */
+void counters_print(FILE* output, const char* prefix,
+        const Counters* counters) {
+    int i = 0;
+
+    fputs(prefix, output);
+    for (i = 0; i < COUNTER_EVENTS_COUNT; i++) {
+        if (counters->counted[i]) {
+            fprintf(output, i ? " %s=%llu" : "%s=%llu", counterNames[i],
+                    (unsigned long long)counters->values[i]);
+        } else {
+            fprintf(output, i ? " %s=n/a" : "%s=n/a", counterNames[i]);
+        }
+    }
+    if (counters->counted[COUNTER_CYCLES]
+            && counters->counted[COUNTER_INSTRUCTIONS]
+            && counters->values[COUNTER_CYCLES]) {
+        fprintf(output, " IPC=%.2f",
+                (double)counters->values[COUNTER_INSTRUCTIONS]
+                        / counters->values[COUNTER_CYCLES]);
+    }
+    fputc('\n', output);
+}
+
@@ -0,0 +1,74 @@
+/*
+ *counters.h
+ */
+
+#pragma once
+
+#ifndef __COUNTERS_H__
+#define __COUNTERS_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ *Events counted around a measured section.
+ */
+enum CounterEvents {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_CACHE_MISSES,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_CONTEXT_SWITCHES,
+    COUNTER_EVENTS_COUNT
+};
+
+/*
+ *perf_event_open() counters of a process, from when they are opened until
+ *they are read.
+ *fds .. One per event, -1 if the event can't be counted, e.g. in a
+ *virtual machine without a PMU or if perf_event_paranoid forbids it.
+ *values .. Counts read so far, scaled up if the kernel had to share the
+ *hardware counters with others.
+ *counted .. Set for the events values holds counts of.
+ */
+typedef struct {
+    int fds[COUNTER_EVENTS_COUNT];
+    uint64_t values[COUNTER_EVENTS_COUNT];
+    int counted[COUNTER_EVENTS_COUNT];
+} Counters;
+
+/*
+ *Set up counters which count nothing.
+ */
+void counters_init(Counters* counters);
+
+/*
+ *Start counting the events of the given process, 0 for this one. With
+ *inherit set, the threads and processes it starts afterwards are counted
+ *as well.
+ *Returns the number of events counted, 0 if none can be.
+ */
+int counters_open(Counters* counters, pid_t pid, int inherit);
+
+/*
+ *Stop counting and add the counts to the values. The process may have
+ *ended already.
+ */
+void counters_read(Counters* counters);
+
+/*
+ *Add the values of other counters, e.g. of another process running the
+ *same program.
+ */
+void counters_add(Counters* counters, const Counters* other);
+
+/*
+ *Print the values as a line of Name=value pairs after the prefix, with
+ *n/a for the events not counted.
+ */
+void counters_print(FILE* output, const char* prefix,
+        const Counters* counters);
+
+#endif
+
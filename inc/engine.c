@@ -0,0 +1,165 @@
+/*
+ *engine.c
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../inc/protocol.h"
+#include "../inc/strategy.h"
+#include "../inc/engine.h"
+
+/*
+ *Convert a player type letter (A, B) to the strategy it plays.
+ */
+enum StrategyTypes engine_convert_strategy(char name) {
+    switch (name) {
+        case 'A':
+        case 'a':
+            return STRATEGY_A;
+        case 'B':
+        case 'b':
+            return STRATEGY_B;
+        default:
+            return UNKNOWN_STRATEGY;
+    }
+}
+
+/*
+ *Produce the next pseudo random number of the given sequence.
+ *Xorshift generator; a zero state would stick at zero, so it is replaced.
+ */
+unsigned int engine_random(unsigned int* seed) {
+    unsigned int x = *seed ? *seed : 2463534242u;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    return x;
+}
+
+/*
+ *Put all players at the start of the path with fresh earnings.
+ */
+void engine_reset_game(Game* game) {
+    int i = 0;
+
+    for (i = 0; i < game->playersCount; i++) {
+        dealer_reset_player(game->players + i);
+    }
+    memset(game->positions, 0, game->playersCount * sizeof(int));
+    dealer_init_rankings(game->positions, game->rankings,
+            game->playersCount);
+    if (game->deck) {
+        game->deck->nextCard = game->deck->buffer;
+    }
+}
+
+/*
+ *Copy the state of one game into another of the same size.
+ */
+void engine_copy_game(Game* target, const Game* source) {
+    target->path = source->path;
+    target->playersCount = source->playersCount;
+    target->deck = source->deck;
+    target->seed = source->seed;
+    memcpy(target->positions, source->positions,
+            source->playersCount * sizeof(int));
+    memcpy(target->rankings, source->rankings,
+            source->playersCount * sizeof(int));
+    memcpy(target->players, source->players,
+            source->playersCount * sizeof(Player));
+}
+
+/*
+ *Choose the site the given seat moves to when playing the given strategy.
+ *Returns -1 if there is no move to make.
+ */
+int engine_choose_site(const Game* game, int id, enum StrategyTypes strategy) {
+    StrategyView view;
+
+    view.path = game->path;
+    view.playersCount = game->playersCount;
+    view.ownId = id;
+    view.positions = game->positions;
+    view.rankings = game->rankings;
+    view.players = game->players;
+    view.index = NULL;
+
+    switch (strategy) {
+        case STRATEGY_A:
+            return strategy_a_choose_site(&view);
+        case STRATEGY_B:
+            return strategy_b_choose_site(&view);
+        default:
+            return -1;
+    }
+}
+
+/*
+ *Move the given player to the target site and update its earnings.
+ *Returns non-zero if the game has ended.
+ */
+int engine_play_move(Game* game, int id, int targetSite) {
+    int pointDiff = 0;
+    int moneyDiff = 0;
+    int newCard = 0;
+    char card = '\0';
+    Deck randomDeck;
+
+    dealer_move_player(id, targetSite, game->playersCount, game->positions,
+            game->rankings);
+
+    if (game->deck) {
+        dealer_calculate_player_earnings(id, targetSite, &pointDiff,
+                &moneyDiff, &newCard, (Path*)game->path, game->players + id,
+                game->deck);
+    } else {
+        /*Unknown deck: any card type is equally likely*/
+        card = (char)('A' + engine_random(&game->seed) % CARD_TYPES_COUNT);
+        randomDeck.size = 1u;
+        randomDeck.buffer = &card;
+        randomDeck.nextCard = &card;
+        dealer_calculate_player_earnings(id, targetSite, &pointDiff,
+                &moneyDiff, &newCard, (Path*)game->path, game->players + id,
+                &randomDeck);
+    }
+
+    return dealer_is_finished(game->playersCount, game->path->siteCount,
+            game->positions, game->rankings);
+}
+
+/*
+ *Play the game until it ends, every seat driven by its strategy.
+ *Returns non-zero if the game has ended regularly.
+ */
+int engine_play_out(Game* game, const enum StrategyTypes* strategies) {
+    int nextPlayer = 0;
+    int targetSite = 0;
+
+    while (!dealer_is_finished(game->playersCount, game->path->siteCount,
+            game->positions, game->rankings)) {
+        nextPlayer = dealer_calculate_next_player(game->playersCount,
+                game->positions, game->rankings);
+        targetSite = engine_choose_site(game, nextPlayer,
+                strategies[nextPlayer]);
+        if (-1 == targetSite) {
+            /*A stuck seat would never let the game end*/
+            return 0;
+        }
+        engine_play_move(game, nextPlayer, targetSite);
+    }
+    return 1;
+}
+
+/*
+ *Calculate the final score of the given player without altering it.
+ */
+int engine_final_score(const Player* player) {
+    Player copy = *player;
+
+    return copy.points + copy.v1 + copy.v2
+            + dealer_calculate_card_points(&copy);
+}
+
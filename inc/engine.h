@@ -0,0 +1,80 @@
+/*
+ *engine.h
+ */
+
+#pragma once
+
+#ifndef __ENGINE_H__
+#define __ENGINE_H__
+
+#include "../inc/protocol.h"
+#include "../inc/strategy.h"
+
+/*
+ *Strategies a simulated seat can be driven by.
+ */
+enum StrategyTypes {
+    STRATEGY_A, STRATEGY_B, UNKNOWN_STRATEGY
+};
+
+/*
+ *State of a game played in-process.
+ *The path is shared, all the arrays are owned by the caller and hold
+ *playersCount elements.
+ *If no deck is given, cards are drawn at random using the seed.
+ */
+typedef struct {
+    const Path* path;
+    int playersCount;
+    int* positions;
+    int* rankings;
+    Player* players;
+    Deck* deck;
+    unsigned int seed;
+} Game;
+
+/*
+ *Convert a player type letter (A, B) to the strategy it plays.
+ */
+enum StrategyTypes engine_convert_strategy(char name);
+
+/*
+ *Produce the next pseudo random number of the given sequence.
+ */
+unsigned int engine_random(unsigned int* seed);
+
+/*
+ *Put all players at the start of the path with fresh earnings.
+ */
+void engine_reset_game(Game* game);
+
+/*
+ *Copy the state of one game into another of the same size.
+ */
+void engine_copy_game(Game* target, const Game* source);
+
+/*
+ *Choose the site the given seat moves to when playing the given strategy.
+ *Returns -1 if there is no move to make.
+ */
+int engine_choose_site(const Game* game, int id, enum StrategyTypes strategy);
+
+/*
+ *Move the given player to the target site and update its earnings.
+ *Returns non-zero if the game has ended.
+ */
+int engine_play_move(Game* game, int id, int targetSite);
+
+/*
+ *Play the game until it ends, every seat driven by its strategy.
+ *Returns non-zero if the game has ended regularly.
+ */
+int engine_play_out(Game* game, const enum StrategyTypes* strategies);
+
+/*
+ *Calculate the final score of the given player without altering it.
+ */
+int engine_final_score(const Player* player);
+
+#endif
+
@@ -29,7 +29,8 @@ const char* dealerErrorTexts[] = {
     "Error reading deck",
     "Error reading path",
     "Error starting process",
-    "Communications error"
+    "Communications error",
+    "Error accessing file"
 };
 
 /*
@@ -38,7 +38,8 @@ enum DealerErrorCodes {
     E_DEALER_INVALID_DECK = 2,
     E_DEALER_INVALID_PATH = 3,
     E_DEALER_INVALID_START_PLAYER = 4,
-    E_DEALER_COMMS_ERROR = 5
+    E_DEALER_COMMS_ERROR = 5,
+    E_DEALER_FILE_ERROR = 6
 };
 
 /*
@@ -0,0 +1,436 @@
+/*
+ *handoff.c
+ */
+
+/*
+ *memfd_create() and fopencookie() are GNU extensions.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "../inc/errorReturn.h"
+#include "../inc/protocol.h"
+#include "../inc/handoff.h"
+
+/*
+ *Sleep on the futex word as long as it holds the given value, at most the
+ *given milliseconds (-1 for no limit). The word is shared between
+ *processes, so the futex is not private.
+ */
+void futex_sleep(uint32_t* word, uint32_t value, int timeout) {
+    struct timespec limit;
+
+    limit.tv_sec = timeout / 1000;
+    limit.tv_nsec = (timeout % 1000) * 1000000L;
+    syscall(SYS_futex, word, FUTEX_WAIT, value,
+            -1 == timeout ? NULL : &limit, NULL, 0);
+}
+
+/*
+ *Wake whoever sleeps on the futex word.
+ */
+void futex_wake_all(uint32_t* word) {
+    syscall(SYS_futex, word, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+}
+
+/*
+ *Let the other side of a spin loop run on.
+ */
+void spin_pause(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+/*
+ *Map the slots of the memory file, which has room for the given number of
+ *seats.
+ *Returns the start of the mapping, or NULL if it fails.
+ */
+HandoffHeader* map_slots(int fd, size_t length) {
+    void* mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+            fd, 0);
+
+    return MAP_FAILED == mapping ? NULL : (HandoffHeader*)mapping;
+}
+
+/*
+ *Create the turn slots of the given number of seats in an inheritable
+ *memory file.
+ *Returns -1 if shared memory is not available, 0 else.
+ */
+int handoff_create(Handoff* handoff, int seatsCount, int spin) {
+    memset(handoff, 0, sizeof(Handoff));
+    handoff->spin = spin;
+    handoff->length = sizeof(HandoffHeader)
+            + seatsCount * sizeof(HandoffSlot);
+    handoff->fd = memfd_create("2310handoff", 0);
+    if (-1 == handoff->fd) {
+        return -1;
+    }
+    /*A new memory file is all zeros, no turns and no moves*/
+    if (0 != ftruncate(handoff->fd, handoff->length)
+            || !(handoff->header = map_slots(handoff->fd,
+                    handoff->length))) {
+        close(handoff->fd);
+        return -1;
+    }
+    handoff->header->seatsCount = (uint32_t)seatsCount;
+    handoff->slots = (HandoffSlot*)(handoff->header + 1);
+    return 0;
+}
+
+/*
+ *Unmap the slots and close the memory file, if still open.
+ */
+void handoff_destroy(Handoff* handoff) {
+    if (-1 != handoff->fd) {
+        close(handoff->fd);
+    }
+    munmap(handoff->header, handoff->length);
+    handoff->header = NULL;
+    handoff->slots = NULL;
+}
+
+/*
+ *Count up the seat's futex word and wake the player if it sleeps.
+ */
+void notify_player(HandoffSlot* slot) {
+    __atomic_fetch_add(&slot->notices, 1u, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&slot->playerSleeping, __ATOMIC_SEQ_CST)) {
+        futex_wake_all(&slot->notices);
+    }
+}
+
+/*
+ *Give the seat its turn, once it has read the given number of bytes.
+ */
+void handoff_post_turn(Handoff* handoff, int seat, uint64_t announced) {
+    HandoffSlot* slot = handoff->slots + seat;
+
+    __atomic_store_n(&slot->announced, announced, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->turn, slot->turn + 1u, __ATOMIC_RELEASE);
+    notify_player(slot);
+}
+
+/*
+ *Let the seat read up to the given number of bytes, e.g. DONE.
+ */
+void handoff_notify(Handoff* handoff, int seat, uint64_t announced) {
+    HandoffSlot* slot = handoff->slots + seat;
+
+    __atomic_store_n(&slot->announced, announced, __ATOMIC_RELEASE);
+    notify_player(slot);
+}
+
+/*
+ *Let the seat read up to the end of its connection, which is closed.
+ *Safe to call from a signal handler.
+ */
+void handoff_close_seat(Handoff* handoff, int seat) {
+    HandoffSlot* slot = handoff->slots + seat;
+
+    __atomic_store_n(&slot->closed, 1u, __ATOMIC_RELEASE);
+    notify_player(slot);
+}
+
+/*
+ *Check if the seat has answered its current turn, which is not taken yet.
+ */
+int has_move(const HandoffSlot* slot) {
+    uint32_t turn = slot->turn;
+
+    return turn && turn != slot->taken
+            && turn == __atomic_load_n(&slot->answered, __ATOMIC_ACQUIRE);
+}
+
+/*
+ *Take the seat's answer to its current turn.
+ *Returns the site, or -1 if it has not answered yet.
+ */
+int handoff_take_move(Handoff* handoff, int seat) {
+    HandoffSlot* slot = handoff->slots + seat;
+
+    if (!has_move(slot)) {
+        return -1;
+    }
+    slot->taken = slot->turn;
+    return slot->site;
+}
+
+/*
+ *Check if the seat has not answered its last turn yet.
+ */
+int handoff_busy(const Handoff* handoff, int seat) {
+    const HandoffSlot* slot = handoff->slots + seat;
+
+    return slot->turn != __atomic_load_n(&slot->answered, __ATOMIC_ACQUIRE);
+}
+
+/*
+ *Find an awaited seat which has answered its turn.
+ *Returns the seat, or -1 if there is none yet.
+ */
+int handoff_find_move(const Handoff* handoff, const int* awaited,
+        int count) {
+    int seat = 0;
+
+    for (seat = 0; seat < count; seat++) {
+        if (awaited[seat] && has_move(handoff->slots + seat)) {
+            return seat;
+        }
+    }
+    return -1;
+}
+
+/*
+ *Wait until an awaited seat has answered its turn, looking for it spin
+ *times before sleeping.
+ *Returns the seat, or -1 if the timeout (milliseconds, -1 for none)
+ *expired.
+ */
+int handoff_wait_move(Handoff* handoff, const int* awaited, int count,
+        int timeout) {
+    HandoffHeader* header = handoff->header;
+    uint32_t doorbell = 0u;
+    int seat = -1;
+    int i = 0;
+
+    for (i = 0; i <= handoff->spin; i++) {
+        doorbell = __atomic_load_n(&header->doorbell, __ATOMIC_SEQ_CST);
+        seat = handoff_find_move(handoff, awaited, count);
+        if (-1 != seat || !timeout) {
+            return seat;
+        }
+        spin_pause();
+    }
+
+    /*A move after the last look rings the doorbell or sees the flag*/
+    __atomic_store_n(&header->dealerSleeping, 1u, __ATOMIC_SEQ_CST);
+    seat = handoff_find_move(handoff, awaited, count);
+    if (-1 == seat) {
+        futex_sleep(&header->doorbell, doorbell, timeout);
+        seat = handoff_find_move(handoff, awaited, count);
+    }
+    __atomic_store_n(&header->dealerSleeping, 0u, __ATOMIC_SEQ_CST);
+    return seat;
+}
+
+/*
+ *Attach to the given slot of the memory file at fd. Everything but the
+ *turns is read from inputFd.
+ *Returns E_OK if successful, E_COMMS_ERROR else.
+ */
+int handoff_attach(HandoffPlayer* player, int fd, int seat, int spin,
+        int inputFd) {
+    off_t length = lseek(fd, 0, SEEK_END);
+    struct stat status;
+
+    memset(player, 0, sizeof(HandoffPlayer));
+    if (0 > seat || (off_t)(sizeof(HandoffHeader)
+            + (seat + 1) * sizeof(HandoffSlot)) > length) {
+        return E_COMMS_ERROR;
+    }
+    player->length = (size_t)length;
+    player->header = map_slots(fd, player->length);
+    if (!player->header) {
+        return E_COMMS_ERROR;
+    }
+    player->slot = (HandoffSlot*)(player->header + 1) + seat;
+    player->inputFd = inputFd;
+    player->spin = spin;
+    player->packets = 0 == fstat(inputFd, &status) && S_ISSOCK(status.st_mode);
+    return E_OK;
+}
+
+/*
+ *Attach to the slot the dealer handed down in the environment, if any,
+ *reading everything but the turns from stdin.
+ *The file descriptor is closed afterwards, the mapping stays.
+ *Returns E_OK if successful, E_COMMS_ERROR else.
+ */
+int handoff_attach_inherited(HandoffPlayer* player) {
+    const char* value = getenv(HANDOFF_VARIABLE);
+    int fd = -1;
+    int seat = -1;
+    int spin = 0;
+    int success = E_COMMS_ERROR;
+
+    if (!value) {
+        return E_COMMS_ERROR;
+    }
+    if (3 != sscanf(value, "%d,%d,%d", &fd, &seat, &spin) || 0 > fd
+            || 0 > spin) {
+        unsetenv(HANDOFF_VARIABLE);
+        return E_COMMS_ERROR;
+    }
+    unsetenv(HANDOFF_VARIABLE);
+    success = handoff_attach(player, fd, seat, spin, STDIN_FILENO);
+    close(fd);
+    return success;
+}
+
+/*
+ *Check if the dealer has gone without closing the slot, i.e. the
+ *connection has hung up.
+ */
+int dealer_gone(const HandoffPlayer* player) {
+    struct pollfd input;
+
+    input.fd = player->inputFd;
+    input.events = POLLIN;
+    input.revents = 0;
+    return 1 == poll(&input, 1, 0) && (input.revents & (POLLHUP | POLLERR));
+}
+
+/*
+ *Wait until the dealer changes the slot after the given value of its
+ *futex word, looking spin times before sleeping.
+ */
+void wait_for_notice(HandoffPlayer* player, uint32_t notices) {
+    HandoffSlot* slot = player->slot;
+    int i = 0;
+
+    for (i = 0; i < player->spin; i++) {
+        if (notices != __atomic_load_n(&slot->notices, __ATOMIC_ACQUIRE)) {
+            return;
+        }
+        spin_pause();
+    }
+
+    __atomic_store_n(&slot->playerSleeping, 1u, __ATOMIC_SEQ_CST);
+    if (notices == __atomic_load_n(&slot->notices, __ATOMIC_SEQ_CST)) {
+        futex_sleep(&slot->notices, notices, HANDOFF_CHECK_MS);
+    }
+    __atomic_store_n(&slot->playerSleeping, 0u, __ATOMIC_SEQ_CST);
+    if (notices == __atomic_load_n(&slot->notices, __ATOMIC_ACQUIRE)
+            && dealer_gone(player)) {
+        player->closed = 1;
+    }
+}
+
+/*
+ *Read the dealer's messages for stdio: the bytes announced so far, then a
+ *YT line for the new turn, if any. Sleeps until there is either.
+ */
+ssize_t read_input(void* cookie, char* buffer, size_t size) {
+    HandoffPlayer* player = (HandoffPlayer*)cookie;
+    HandoffSlot* slot = player->slot;
+    uint32_t notices = 0u;
+    uint32_t turn = 0u;
+    uint64_t announced = 0u;
+    ssize_t result = 0;
+
+    while (1) {
+        notices = __atomic_load_n(&slot->notices, __ATOMIC_ACQUIRE);
+        turn = __atomic_load_n(&slot->turn, __ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->closed, __ATOMIC_ACQUIRE)) {
+            player->closed = 1;
+        }
+
+        /*Later messages, e.g. of a forfeited turn, are read after YT*/
+        announced = __atomic_load_n(&slot->announced, __ATOMIC_ACQUIRE);
+        if (player->closed || player->consumed < announced) {
+            if (!player->closed && !player->packets) {
+                size = MIN(size, announced - player->consumed);
+            }
+            do {
+                result = read(player->inputFd, buffer, size);
+            } while (0 > result && EINTR == errno);
+            if (0 < result) {
+                player->consumed += (uint64_t)result;
+            }
+            return result;
+        }
+
+        if (turn != player->taken && 3u <= size) {
+            player->taken = turn;
+            memcpy(buffer, "YT\n", 3u);
+            return 3;
+        }
+        wait_for_notice(player, notices);
+    }
+}
+
+/*
+ *Take a DO line the player writes and answer its last turn with it.
+ *Anything else goes to stdout as it is.
+ */
+ssize_t write_moves(void* cookie, const char* buffer, size_t size) {
+    HandoffPlayer* player = (HandoffPlayer*)cookie;
+    HandoffSlot* slot = player->slot;
+    HandoffHeader* header = player->header;
+    char line[MESSAGE_LENGTH];
+    int site = 0;
+
+    memcpy(line, buffer, MIN(size, sizeof(line) - 1));
+    line[MIN(size, sizeof(line) - 1)] = '\0';
+    if (1 != sscanf(line, "DO%d", &site)) {
+        return write(STDOUT_FILENO, buffer, size);
+    }
+
+    slot->site = site;
+    __atomic_store_n(&slot->answered, player->taken, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&header->doorbell, 1u, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&header->dealerSleeping, __ATOMIC_SEQ_CST)) {
+        futex_wake_all(&header->doorbell);
+    }
+    return (ssize_t)size;
+}
+
+/*
+ *Open the stream of the dealer's messages: what is read from the
+ *connection, with a YT line for every turn once everything before it has
+ *been read.
+ */
+FILE* handoff_open_input(HandoffPlayer* player) {
+    cookie_io_functions_t functions;
+
+    memset(&functions, 0, sizeof(functions));
+    functions.read = read_input;
+    return fopencookie(player, "r", functions);
+}
+
+/*
+ *Open the stream of the player's moves. A DO line written to it answers
+ *the turn in the slot.
+ */
+FILE* handoff_open_moves(HandoffPlayer* player) {
+    cookie_io_functions_t functions;
+    FILE* stream = NULL;
+
+    memset(&functions, 0, sizeof(functions));
+    functions.write = write_moves;
+    stream = fopencookie(player, "w", functions);
+    if (stream) {
+        /*Every move is flushed on its own*/
+        setvbuf(stream, NULL, _IOLBF, MESSAGE_LENGTH);
+    }
+    return stream;
+}
+
+/*
+ *Unmap the slot.
+ */
+void handoff_detach(HandoffPlayer* player) {
+    if (player->header) {
+        munmap(player->header, player->length);
+    }
+    player->header = NULL;
+    player->slot = NULL;
+}
+
@@ -0,0 +1,193 @@
+/*
+ *handoff.h
+ */
+
+#pragma once
+
+#ifndef __HANDOFF_H__
+#define __HANDOFF_H__
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ *Environment variable holding "fd,seat,spin": the file descriptor of the
+ *shared turn slots, the player's slot and how often to look at it before
+ *sleeping.
+ */
+#define HANDOFF_VARIABLE "PIPE_HANDOFF"
+
+/*
+ *Size of a cache line, every slot takes one of its own.
+ */
+#define HANDOFF_CACHE_LINE 64
+
+/*
+ *Milliseconds a player sleeps at most before it checks if the dealer is
+ *still there.
+ */
+#define HANDOFF_CHECK_MS 100
+
+/*
+ *Start of the shared memory, followed by one slot per seat.
+ *doorbell .. Futex word of the dealer, counted up with every move.
+ *dealerSleeping .. Set while the dealer sleeps on the doorbell.
+ */
+typedef struct {
+    uint32_t doorbell;
+    uint32_t dealerSleeping;
+    uint32_t seatsCount;
+    char padding[HANDOFF_CACHE_LINE - 3 * sizeof(uint32_t)];
+} HandoffHeader;
+
+/*
+ *Turn slot of a seat. Everything else is still sent through the seat's
+ *connection, the slot only tells how far the player has to read it.
+ *notices .. Futex word of the player, counted up with every turn and
+ *notice of the dealer.
+ *playerSleeping .. Set while the player sleeps on notices.
+ *turn .. Number of the last turn given to the player, 0 for none yet.
+ *announced .. Bytes the dealer had queued for the player at the last turn
+ *or notice. They are read before the turn is taken.
+ *closed .. Set once the dealer has closed the connection.
+ *answered, site .. Number of the turn the player has answered last and
+ *the site it moves to.
+ *taken .. Number of the last turn the dealer has taken the answer of.
+ */
+typedef struct {
+    uint32_t notices;
+    uint32_t playerSleeping;
+    uint32_t turn;
+    uint32_t closed;
+    uint64_t announced;
+    uint32_t answered;
+    int32_t site;
+    uint32_t taken;
+    char padding[HANDOFF_CACHE_LINE - 7 * sizeof(uint32_t)
+            - sizeof(uint64_t)];
+} HandoffSlot;
+
+/*
+ *The dealer's side: the turn slots of all seats in a memory file the
+ *players inherit.
+ *spin .. Times to look for a move before sleeping.
+ */
+typedef struct {
+    HandoffHeader* header;
+    HandoffSlot* slots;
+    size_t length;
+    int fd;
+    int spin;
+} Handoff;
+
+/*
+ *A player's side: its slot, and the connection it reads everything but
+ *the turns from.
+ *consumed .. Bytes read from the connection so far.
+ *taken .. Number of the last turn handed out as YT.
+ *packets .. Set if the connection is a socket, whose packets are read
+ *whole, even beyond the announced bytes.
+ */
+typedef struct {
+    HandoffHeader* header;
+    HandoffSlot* slot;
+    size_t length;
+    int inputFd;
+    int spin;
+    uint64_t consumed;
+    uint32_t taken;
+    int closed;
+    int packets;
+} HandoffPlayer;
+
+/*
+ *Create the turn slots of the given number of seats in an inheritable
+ *memory file.
+ *Returns -1 if shared memory is not available, 0 else.
+ */
+int handoff_create(Handoff* handoff, int seatsCount, int spin);
+
+/*
+ *Unmap the slots and close the memory file, if still open.
+ */
+void handoff_destroy(Handoff* handoff);
+
+/*
+ *Give the seat its turn, once it has read the given number of bytes.
+ */
+void handoff_post_turn(Handoff* handoff, int seat, uint64_t announced);
+
+/*
+ *Let the seat read up to the given number of bytes, e.g. DONE.
+ */
+void handoff_notify(Handoff* handoff, int seat, uint64_t announced);
+
+/*
+ *Let the seat read up to the end of its connection, which is closed.
+ *Safe to call from a signal handler.
+ */
+void handoff_close_seat(Handoff* handoff, int seat);
+
+/*
+ *Take the seat's answer to its current turn.
+ *Returns the site, or -1 if it has not answered yet.
+ */
+int handoff_take_move(Handoff* handoff, int seat);
+
+/*
+ *Check if the seat has not answered its last turn yet.
+ */
+int handoff_busy(const Handoff* handoff, int seat);
+
+/*
+ *Find an awaited seat which has answered its turn.
+ *Returns the seat, or -1 if there is none yet.
+ */
+int handoff_find_move(const Handoff* handoff, const int* awaited,
+        int count);
+
+/*
+ *Wait until an awaited seat has answered its turn, looking for it spin
+ *times before sleeping.
+ *Returns the seat, or -1 if the timeout (milliseconds, -1 for none)
+ *expired.
+ */
+int handoff_wait_move(Handoff* handoff, const int* awaited, int count,
+        int timeout);
+
+/*
+ *Attach to the given slot of the memory file at fd. Everything but the
+ *turns is read from inputFd.
+ *Returns E_OK if successful, E_COMMS_ERROR else.
+ */
+int handoff_attach(HandoffPlayer* player, int fd, int seat, int spin,
+        int inputFd);
+
+/*
+ *Attach to the slot the dealer handed down in the environment, if any,
+ *reading everything but the turns from stdin.
+ *Returns E_OK if successful, E_COMMS_ERROR else.
+ */
+int handoff_attach_inherited(HandoffPlayer* player);
+
+/*
+ *Open the stream of the dealer's messages: what is read from the
+ *connection, with a YT line for every turn once everything before it has
+ *been read.
+ */
+FILE* handoff_open_input(HandoffPlayer* player);
+
+/*
+ *Open the stream of the player's moves. A DO line written to it answers
+ *the turn in the slot.
+ */
+FILE* handoff_open_moves(HandoffPlayer* player);
+
+/*
+ *Unmap the slot.
+ */
+void handoff_detach(HandoffPlayer* player);
+
+#endif
+
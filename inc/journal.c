@@ -0,0 +1,110 @@
+/*
+ *journal.c
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../inc/protocol.h"
+#include "../inc/journal.h"
+
+/*
+ *Bytes the header and the texts following it take, padding included.
+ */
+size_t journal_header_length(const JournalHeader* header) {
+    size_t length = sizeof(JournalHeader) + header->playersCount
+            + header->pathLength + header->deckLength;
+
+    return (length + JOURNAL_ALIGNMENT - 1u)
+            & ~(size_t)(JOURNAL_ALIGNMENT - 1u);
+}
+
+/*
+ *Write the header of a journal of the given tables, with the players'
+ *strategy letters, the path and the deck all games are played with.
+ *Returns non-zero if successful.
+ */
+int journal_write_header(FILE* stream, int playersCount, int tablesCount,
+        const char* strategies, const Path* path, const Deck* deck) {
+    const char padding[JOURNAL_ALIGNMENT] = { 0 };
+    char prefix[32];
+    JournalHeader header;
+    int prefixLength = 0;
+    size_t written = 0u;
+
+    memset(&header, 0, sizeof(JournalHeader));
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    header.version = JOURNAL_VERSION;
+    header.playersCount = (uint32_t)playersCount;
+    header.tablesCount = (uint32_t)tablesCount;
+
+    /*The path as it is sent to the players, its site count first*/
+    prefixLength = sprintf(prefix, "%zu;", path->siteCount);
+    header.pathLength = prefixLength + strlen(path->buffer);
+    header.deckLength = snprintf(NULL, 0u, "%zu", deck->size) + deck->size;
+
+    written += fwrite(&header, sizeof(JournalHeader), 1u, stream)
+            * sizeof(JournalHeader);
+    written += fwrite(strategies, 1u, playersCount, stream);
+    written += fwrite(prefix, 1u, prefixLength, stream);
+    written += fwrite(path->buffer, 1u, strlen(path->buffer), stream);
+    written += fprintf(stream, "%zu", deck->size);
+    written += fwrite(deck->buffer, 1u, deck->size, stream);
+    written += fwrite(padding, 1u, journal_header_length(&header)
+            - sizeof(JournalHeader) - playersCount - header.pathLength
+            - header.deckLength, stream);
+    return journal_header_length(&header) == written;
+}
+
+/*
+ *Append a record to the journal, unless an earlier write has failed.
+ *Returns non-zero if the record has been written.
+ */
+int journal_write_record(FILE* stream, int table,
+        enum JournalRecordTypes type, int id, int site, int regular) {
+    JournalRecord record;
+
+    /*Records after a lost one would be replayed at the wrong place*/
+    if (ferror(stream)) {
+        return 0;
+    }
+
+    record.table = (uint32_t)table;
+    record.site = (uint32_t)site;
+    record.id = (uint16_t)id;
+    record.type = (uint8_t)type;
+    record.regular = (uint8_t)regular;
+    return 1u == fwrite(&record, sizeof(JournalRecord), 1u, stream);
+}
+
+/*
+ *Find the parts of the journal in the given memory.
+ *Returns non-zero if it is a journal this version can read.
+ */
+int journal_parse(const void* data, size_t length, JournalView* view) {
+    const char* bytes = (const char*)data;
+    const JournalHeader* header = (const JournalHeader*)data;
+
+    memset(view, 0, sizeof(JournalView));
+    if (length < sizeof(JournalHeader)
+            || 0 != memcmp(header->magic, JOURNAL_MAGIC,
+                    sizeof(JOURNAL_MAGIC))
+            || JOURNAL_VERSION != header->version
+            || !header->playersCount || MAX_PLAYERS < header->playersCount
+            || !header->tablesCount
+            || length < header->pathLength || length < header->deckLength
+            || length < journal_header_length(header)) {
+        return 0;
+    }
+
+    view->header = header;
+    view->strategies = bytes + sizeof(JournalHeader);
+    view->pathText = view->strategies + header->playersCount;
+    view->deckText = view->pathText + header->pathLength;
+    view->records = (const JournalRecord*)(bytes
+            + journal_header_length(header));
+    view->recordsCount = (length - journal_header_length(header))
+            / sizeof(JournalRecord);
+    return 1;
+}
+
@@ -0,0 +1,107 @@
+/*
+ *journal.h
+ */
+
+#pragma once
+
+#ifndef __JOURNAL_H__
+#define __JOURNAL_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "../inc/protocol.h"
+
+/*
+ *First bytes of every journal.
+ */
+#define JOURNAL_MAGIC "2310JNL"
+
+/*
+ *Version of the journal layout described below.
+ */
+#define JOURNAL_VERSION 1u
+
+/*
+ *Alignment of the records following the header.
+ */
+#define JOURNAL_ALIGNMENT 8u
+
+/*
+ *Kinds of records.
+ *START .. A game starts at the table, all players at the start of the path.
+ *MOVE .. The player moved to the site.
+ *END .. The game at the table has ended, regularly or not.
+ */
+enum JournalRecordTypes {
+    JOURNAL_START, JOURNAL_MOVE, JOURNAL_END
+};
+
+/*
+ *Start of a journal, in the byte order of the dealer writing it.
+ *It is followed by one strategy letter per seat, the path and the deck as
+ *read from their files, and padding up to JOURNAL_ALIGNMENT. The records
+ *take the rest of the file.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t playersCount;
+    uint32_t tablesCount;
+    uint32_t reserved;
+    uint64_t pathLength;
+    uint64_t deckLength;
+} JournalHeader;
+
+/*
+ *Something that happened at a table, in the order the dealer did it.
+ *id, site .. Player and target site of MOVE.
+ *regular .. Whether the game of END has been played to its end.
+ */
+typedef struct {
+    uint32_t table;
+    uint32_t site;
+    uint16_t id;
+    uint8_t type;
+    uint8_t regular;
+} JournalRecord;
+
+/*
+ *The parts of a journal in memory.
+ *The texts are not terminated, their lengths are given by the header.
+ *recordsCount .. Complete records, a record cut short by a dealer which
+ *did not finish is left out.
+ */
+typedef struct {
+    const JournalHeader* header;
+    const char* strategies;
+    const char* pathText;
+    const char* deckText;
+    const JournalRecord* records;
+    size_t recordsCount;
+} JournalView;
+
+/*
+ *Write the header of a journal of the given tables, with the players'
+ *strategy letters, the path and the deck all games are played with.
+ *Returns non-zero if successful.
+ */
+int journal_write_header(FILE* stream, int playersCount, int tablesCount,
+        const char* strategies, const Path* path, const Deck* deck);
+
+/*
+ *Append a record to the journal, unless an earlier write has failed. The
+ *stream's error indicator tells if one has.
+ *Returns non-zero if the record has been written.
+ */
+int journal_write_record(FILE* stream, int table,
+        enum JournalRecordTypes type, int id, int site, int regular);
+
+/*
+ *Find the parts of the journal in the given memory.
+ *Returns non-zero if it is a journal this version can read.
+ */
+int journal_parse(const void* data, size_t length, JournalView* view);
+
+#endif
+
@@ -0,0 +1,439 @@
+/*
+ *pathWindow.c
+ */
+
+/*
+ *MAP_NORESERVE and getc_unlocked() are extensions to C99.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "../inc/errorReturn.h"
+#include "../inc/protocol.h"
+#include "../inc/pathWindow.h"
+#include "../inc/siteEffects.h"
+
+/*
+ *Number of sites per chunk requested in the environment.
+ *Returns 0 if the whole path is to be kept.
+ */
+size_t path_window_sites(void) {
+    const char* value = getenv(PATH_WINDOW_VARIABLE);
+    char* end = NULL;
+    unsigned long sites = 0ul;
+
+    if (!value || '-' == *value) {
+        return 0u;
+    }
+    sites = strtoul(value, &end, 10);
+    return end != value && '\0' == *end ? (size_t)sites : 0u;
+}
+
+/*
+ *Read or write the whole block at the given position of the file.
+ *Returns 0 if successful, -1 else.
+ */
+int transfer_block(int fd, void* block, size_t length, off_t offset,
+        int writing) {
+    char* pos = (char*)block;
+    ssize_t done = 0;
+
+    while (length) {
+        done = writing ? pwrite(fd, pos, length, offset)
+                : pread(fd, pos, length, offset);
+        if (0 > done && EINTR == errno) {
+            continue;
+        }
+        if (0 >= done) {
+            return -1;
+        }
+        pos += done;
+        length -= (size_t)done;
+        offset += done;
+    }
+    return 0;
+}
+
+/*
+ *Read the columns of a chunk from the file, or write them to it.
+ *The file holds the columns of the whole path back to back, the reserved
+ *columns are padded to whole chunks.
+ *Returns 0 if successful, -1 else.
+ */
+int transfer_chunk(const Path* path, size_t chunk, int writing) {
+    const struct PathWindow* window = path->window;
+    size_t first = chunk * window->chunkSites;
+    size_t last = MIN(first + window->chunkSites, path->siteCount);
+    size_t sourceWords = (path->siteCount + 63u) / 64u;
+    off_t bitmapsOffset = window->offset
+            + (off_t)((2u * path->siteCount + 7u) & ~(size_t)7u);
+    size_t words = (last - first + 63u) / 64u;
+    int type = 0;
+
+    if (transfer_block(window->fd, path->types + first, last - first,
+                    window->offset + (off_t)first, writing)
+            || transfer_block(window->fd, path->capacities + first,
+                    last - first,
+                    window->offset + (off_t)(path->siteCount + first),
+                    writing)) {
+        return -1;
+    }
+    for (type = 0; type < SITE_TYPES_COUNT; type++) {
+        if (transfer_block(window->fd, path->bitmaps
+                        + type * path->bitmapWords + first / 64u,
+                words * sizeof(uint64_t), bitmapsOffset
+                        + (off_t)((type * sourceWords + first / 64u)
+                        * sizeof(uint64_t)), writing)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ *Give the memory of a chunk's columns back, they read as zero afterwards.
+ *Chunks are whole pages in every column.
+ */
+void release_chunk(const Path* path, size_t chunk) {
+    struct PathWindow* window = path->window;
+    size_t first = chunk * window->chunkSites;
+    int type = 0;
+
+    madvise(path->types + first, window->chunkSites, MADV_DONTNEED);
+    madvise(path->capacities + first, window->chunkSites, MADV_DONTNEED);
+    for (type = 0; type < SITE_TYPES_COUNT; type++) {
+        madvise(path->bitmaps + type * path->bitmapWords + first / 64u,
+                window->chunkSites / 8u, MADV_DONTNEED);
+    }
+    window->loaded[chunk] = 0u;
+}
+
+/*
+ *Read a chunk from the file.
+ *Returns 0 if successful, -1 else.
+ */
+int load_chunk(const Path* path, size_t chunk) {
+    struct PathWindow* window = path->window;
+
+    if (transfer_chunk(path, chunk, 0)) {
+        return -1;
+    }
+    window->loaded[chunk] = 1u;
+    window->firstLoaded = MIN(window->firstLoaded, chunk);
+    return 0;
+}
+
+/*
+ *Note the site types occurring in a materialized chunk.
+ *Returns -1 if a type is not in the site table, 0 else.
+ */
+int summarize_chunk(const Path* path, size_t chunk) {
+    struct PathWindow* window = path->window;
+    size_t first = chunk * window->chunkSites;
+    size_t last = MIN(first + window->chunkSites, path->siteCount);
+    unsigned int mask = 0u;
+    int type = 0;
+    size_t i = 0;
+
+    for (i = first; i < last; i++) {
+        type = path->types[i];
+        if (site_table()->count <= type) {
+            return -1;
+        }
+        /*Blocking sites are found like barriers*/
+        mask |= 1u << type
+                | (unsigned int)site_effect((enum SiteTypes)type)->blocking
+                << BARRIER;
+    }
+    window->typeMasks[chunk] = (unsigned char)mask;
+    return 0;
+}
+
+/*
+ *Reserve the columns of the whole path without materializing them.
+ *Chunks are rounded up so each of them starts on a page in every column.
+ *Returns E_OK if successful, E_INVALID_PATH else.
+ */
+int reserve_window(Path* path, int fd, off_t offset, size_t siteCount,
+        size_t chunkSites) {
+    struct PathWindow* window = NULL;
+    size_t alignment = 8u * (size_t)sysconf(_SC_PAGESIZE);
+    size_t paddedSites = 0u;
+    unsigned char* columns = NULL;
+
+    window = (struct PathWindow*)calloc(1u, sizeof(struct PathWindow));
+    window->fd = fd;
+    window->offset = offset;
+    window->chunkSites = (MAX(chunkSites, 1u) + alignment - 1u)
+            / alignment * alignment;
+    window->chunkCount = (siteCount + window->chunkSites - 1u)
+            / window->chunkSites;
+    window->loaded = (unsigned char*)calloc(window->chunkCount, 1u);
+    window->typeMasks = (unsigned char*)calloc(window->chunkCount, 1u);
+    window->firstLoaded = window->chunkCount;
+    paddedSites = window->chunkCount * window->chunkSites;
+    window->reservationLength = 2u * paddedSites
+            + SITE_TYPES_COUNT * paddedSites / 8u;
+    path->window = window;
+
+    columns = (unsigned char*)mmap(NULL, window->reservationLength,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (MAP_FAILED == (void*)columns) {
+        path->storage = NULL;
+        return E_INVALID_PATH;
+    }
+    path->storage = columns;
+    path->siteCount = siteCount;
+    path->types = columns;
+    path->capacities = columns + paddedSites;
+    path->bitmaps = (uint64_t*)(columns + 2u * paddedSites);
+    path->bitmapWords = paddedSites / 64u;
+    return E_OK;
+}
+
+/*
+ *Attach to the site columns at the given position of the file, whose
+ *descriptor the path takes over.
+ *Each chunk is read once to learn its site types and released again.
+ *Returns E_OK if the sites are valid, E_INVALID_PATH else.
+ */
+int path_window_open(Path* path, int fd, off_t offset, size_t siteCount,
+        size_t chunkSites) {
+    size_t chunk = 0u;
+
+    if (E_OK != reserve_window(path, fd, offset, siteCount, chunkSites)) {
+        player_free_path(path);
+        return E_INVALID_PATH;
+    }
+    for (chunk = 0u; chunk < path->window->chunkCount; chunk++) {
+        if (load_chunk(path, chunk) || summarize_chunk(path, chunk)
+                || (0u == chunk && BARRIER != path->types[0])
+                || (path->window->chunkCount == chunk + 1u
+                        && BARRIER != path->types[siteCount - 1u])) {
+            player_free_path(path);
+            return E_INVALID_PATH;
+        }
+        release_chunk(path, chunk);
+    }
+    path->window->firstLoaded = path->window->chunkCount;
+    return E_OK;
+}
+
+/*
+ *Read the next site of a path, which has a single digit capacity unless it
+ *is a barrier.
+ *Returns E_OK if it is valid, E_INVALID_PATH else.
+ */
+int read_site(FILE* stream, int playersCount, size_t site, Path* path) {
+    char siteName[3];
+    int chars[3];
+    int i = 0;
+
+    for (i = 0; i < 3; i++) {
+        chars[i] = getc_unlocked(stream);
+        if (EOF == chars[i] || '\n' == chars[i]) {
+            return E_INVALID_PATH;
+        }
+    }
+    siteName[0] = (char)chars[0];
+    siteName[1] = (char)chars[1];
+    siteName[2] = '\0';
+
+    if (0 == strcmp("::", siteName) && '-' == chars[2]) {
+        path_store_site(path, site, BARRIER, playersCount, playersCount);
+    } else if (0 < site && isdigit(chars[2])) {
+        path_store_site(path, site, convert_site_type(siteName),
+                chars[2] - '0', playersCount);
+    } else {
+        return E_INVALID_PATH;
+    }
+    return E_OK;
+}
+
+/*
+ *Write a parsed chunk to the file and release it.
+ *Returns 0 if successful, -1 else.
+ */
+int spool_chunk(const Path* path, size_t chunk) {
+    if (summarize_chunk(path, chunk) || transfer_chunk(path, chunk, 1)) {
+        return -1;
+    }
+    release_chunk(path, chunk);
+    return 0;
+}
+
+/*
+ *Read the path from stream like player_read_path(), but spool the sites to
+ *a temporary file chunk by chunk instead of keeping them.
+ *Returns E_OK if the path is valid, E_INVALID_PATH else.
+ */
+int path_window_read(FILE* stream, int playersCount, size_t chunkSites,
+        Path* path) {
+    FILE* spool = NULL;
+    int fd = -1;
+    int siteCount = 0;
+    int readChars = 0;
+    char separator = '\0';
+    size_t site = 0u;
+    int success = E_OK;
+    int c = 0;
+
+    player_reset_path(path);
+    readChars = fscanf(stream, "%d%c", &siteCount, &separator);
+    if (EOF == readChars || ';' != separator || 1 > siteCount) {
+        return E_INVALID_PATH;
+    }
+
+    /*The spool is unlinked already, the descriptor keeps it*/
+    spool = tmpfile();
+    if (spool) {
+        fd = fcntl(fileno(spool), F_DUPFD_CLOEXEC, 0);
+        fclose(spool);
+    }
+    if (0 > fd || ftruncate(fd, path_storage_length(siteCount))) {
+        if (0 <= fd) {
+            close(fd);
+        }
+        return E_INVALID_PATH;
+    }
+    success = reserve_window(path, fd, 0, (size_t)siteCount, chunkSites);
+
+    for (site = 0u; site < (size_t)siteCount && E_OK == success; site++) {
+        success = read_site(stream, playersCount, site, path);
+        if (E_OK == success && (size_t)siteCount == site + 1u
+                && BARRIER != path->types[site]) {
+            /*The last site needs to be a barrier too*/
+            success = E_INVALID_PATH;
+        }
+        if (E_OK == success && ((size_t)siteCount == site + 1u
+                || 0u == (site + 1u) % path->window->chunkSites)
+                && spool_chunk(path, site / path->window->chunkSites)) {
+            success = E_INVALID_PATH;
+        }
+    }
+
+    /*Surplus sites are ignored*/
+    while (EOF != (c = getc_unlocked(stream)) && '\n' != c) {
+    }
+    if (E_OK != success) {
+        player_free_path(path);
+    }
+    return success;
+}
+
+/*
+ *Materialize the chunk holding the given site, if it is not yet.
+ */
+void path_window_load(const Path* path, size_t site) {
+    size_t chunk = site / path->window->chunkSites;
+
+    if (!path->window->loaded[chunk] && load_chunk(path, chunk)) {
+        /*The spooled sites are gone*/
+        error_return(stderr, E_INVALID_PATH);
+    }
+}
+
+/*
+ *Find the first site of the given type after the given one, reading only
+ *chunks which contain the type.
+ *Returns -1 if there is none.
+ */
+int path_window_find_site(const Path* path, enum SiteTypes type, int after) {
+    const struct PathWindow* window = path->window;
+    const uint64_t* bitmap = path->bitmaps + type * path->bitmapWords;
+    size_t site = (size_t)(after + 1);
+    size_t chunk = 0u;
+    size_t word = 0u;
+    size_t lastWord = 0u;
+    uint64_t bits = 0u;
+
+    while (site < path->siteCount) {
+        chunk = site / window->chunkSites;
+        if (window->typeMasks[chunk] & (1u << type)) {
+            path_window_load(path, site);
+            word = site / 64u;
+            lastWord = (chunk + 1u) * window->chunkSites / 64u;
+            bits = bitmap[word] & (~(uint64_t)0u << (site % 64u));
+            while (!bits && ++word < lastWord) {
+                bits = bitmap[word];
+            }
+            if (bits) {
+                return (int)(word * 64u + __builtin_ctzll(bits));
+            }
+        }
+        site = (chunk + 1u) * window->chunkSites;
+    }
+    return -1;
+}
+
+/*
+ *Release the chunks behind every player.
+ */
+void path_window_follow(const Path* path, const int* positions,
+        int playersCount) {
+    struct PathWindow* window = path->window;
+    size_t rearChunk = 0u;
+    size_t chunk = 0u;
+    int rear = positions[0];
+    int i = 0;
+
+    for (i = 1; i < playersCount; i++) {
+        rear = MIN(rear, positions[i]);
+    }
+    rearChunk = (size_t)rear / window->chunkSites;
+    for (chunk = window->firstLoaded; chunk < rearChunk; chunk++) {
+        if (window->loaded[chunk]) {
+            release_chunk(path, chunk);
+        }
+    }
+    window->firstLoaded = MAX(window->firstLoaded, rearChunk);
+}
+
+/*
+ *Sites from the start of the rearmost player's chunk to the end of the
+ *frontmost player's chunk, [first, last).
+ */
+void path_window_range(const Path* path, const int* positions,
+        int playersCount, size_t* first, size_t* last) {
+    size_t chunkSites = path->window->chunkSites;
+    int rear = positions[0];
+    int front = positions[0];
+    int i = 0;
+
+    for (i = 1; i < playersCount; i++) {
+        rear = MIN(rear, positions[i]);
+        front = MAX(front, positions[i]);
+    }
+    *first = (size_t)rear / chunkSites * chunkSites;
+    *last = MIN(((size_t)front / chunkSites + 1u) * chunkSites,
+            path->siteCount);
+}
+
+/*
+ *Free the window, its reserved columns and the file.
+ */
+void path_window_free(Path* path) {
+    struct PathWindow* window = path->window;
+
+    if (path->storage) {
+        munmap(path->storage, window->reservationLength);
+    }
+    close(window->fd);
+    free(window->loaded);
+    free(window->typeMasks);
+    free(window);
+    free(path->escapes);
+    free(path->buffer);
+    path->window = NULL;
+}
@@ -0,0 +1,96 @@
+/*
+ *pathWindow.h
+ */
+
+#pragma once
+
+#ifndef __PATH_WINDOW_H__
+#define __PATH_WINDOW_H__
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "../inc/protocol.h"
+
+/*
+ *Environment variable holding the number of sites per chunk, if the player
+ *should keep only a window of the path in memory.
+ */
+#define PATH_WINDOW_VARIABLE "PIPE_PATH_WINDOW"
+
+/*
+ *Windowed storage of a path: the site columns are reserved for the whole
+ *path but only filled in chunks around the players, which are read from a
+ *file holding all the columns.
+ *fd, offset .. File and position of the columns in the layout of
+ *path_use_storage().
+ *loaded .. Whether each chunk is materialized.
+ *typeMasks .. Bit mask of the site types occurring in each chunk.
+ *firstLoaded .. No chunk before this one is materialized.
+ */
+struct PathWindow {
+    int fd;
+    off_t offset;
+    size_t chunkSites;
+    size_t chunkCount;
+    unsigned char* loaded;
+    unsigned char* typeMasks;
+    size_t firstLoaded;
+    size_t reservationLength;
+};
+
+/*
+ *Number of sites per chunk requested in the environment.
+ *Returns 0 if the whole path is to be kept.
+ */
+size_t path_window_sites(void);
+
+/*
+ *Attach to the site columns at the given position of the file, whose
+ *descriptor the path takes over.
+ *Each chunk is read once to learn its site types and released again.
+ *Returns E_OK if the sites are valid, E_INVALID_PATH else.
+ */
+int path_window_open(Path* path, int fd, off_t offset, size_t siteCount,
+        size_t chunkSites);
+
+/*
+ *Read the path from stream like player_read_path(), but spool the sites to
+ *a temporary file chunk by chunk instead of keeping them.
+ *Returns E_OK if the path is valid, E_INVALID_PATH else.
+ */
+int path_window_read(FILE* stream, int playersCount, size_t chunkSites,
+        Path* path);
+
+/*
+ *Materialize the chunk holding the given site, if it is not yet.
+ */
+void path_window_load(const Path* path, size_t site);
+
+/*
+ *Find the first site of the given type after the given one, reading only
+ *chunks which contain the type.
+ *Returns -1 if there is none.
+ */
+int path_window_find_site(const Path* path, enum SiteTypes type, int after);
+
+/*
+ *Release the chunks behind every player.
+ */
+void path_window_follow(const Path* path, const int* positions,
+        int playersCount);
+
+/*
+ *Sites from the start of the rearmost player's chunk to the end of the
+ *frontmost player's chunk, [first, last).
+ */
+void path_window_range(const Path* path, const int* positions,
+        int playersCount, size_t* first, size_t* last);
+
+/*
+ *Free the window, its reserved columns and the file.
+ */
+void path_window_free(Path* path);
+
+#endif
+
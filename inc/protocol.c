@@ -6,9 +6,13 @@
 #include <math.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
+#include <sys/mman.h>
 
 #include "../inc/errorReturn.h"
 #include "../inc/protocol.h"
+#include "../inc/pathWindow.h"
+#include "../inc/siteEffects.h"
 
 /*
  *Calculate the maximum byte count of a given path.
@@ -40,10 +44,7 @@ void reset_player(Player* player) {
  *Initialize all the path structure's fields.
  */
 void reset_path(Path* path) {
-    path->buffer = NULL;
-    path->sites = NULL;
-    path->siteCount = 0u;
-    path->bufferLength = 0u;
+    memset(path, 0, sizeof(Path));
 }
 
 /*
@@ -57,6 +58,7 @@ void reset_deck(Deck* deck) {
  *Allocates memory for buffer and sites.
  */
 int build_path(FILE* stream, int playersCount, Path* path) {
+    Arena* arena = path->arena;
     int siteCount = 0;
     int readChars = 0;
     char separator = '\0';
@@ -65,40 +67,184 @@ int build_path(FILE* stream, int playersCount, Path* path) {
         fprintf(stderr, "  !!! Path was not freed !!!\n");
     }
     reset_path(path);
+    path->arena = arena;
 
     readChars = fscanf(stream, "%d%c", &siteCount, &separator);
     if (EOF == readChars || ';' != separator) {
         return E_INVALID_PATH;
     }
 
+    if (1 > siteCount) {
+        return E_INVALID_PATH;
+    }
+
     path->bufferLength = calculate_path_length(playersCount, siteCount);
+    /*Not from the arena, so dropping the text frees its memory*/
     path->buffer = (char*)malloc(path->bufferLength);
-    path->sites = (Site*)malloc(siteCount * sizeof(Site));
-    path->siteCount = siteCount;
+    if (arena) {
+        path_use_storage(path, arena_calloc(arena,
+                path_storage_length(siteCount), 1u), siteCount);
+        return E_OK;
+    }
+    path_use_storage(path, calloc(path_storage_length(siteCount), 1u),
+            siteCount);
 
     return E_OK;
 }
 
 /*
- *Deallocate the sites and the path buffer.
+ *Deallocate the sites and the path buffer, or unmap a shared path.
  */
 void free_path(Path* path) {
+    if (path && path->window) {
+        path_window_free(path);
+    } else if (path && path->mapping) {
+        /*The sites belong to the shared mapping*/
+        munmap(path->mapping, path->mappingLength);
+    } else if (path && !path->arena) {
+        free(path->storage);
+        free(path->escapes);
+        free(path->buffer);
+    } else if (path) {
+        free(path->buffer);
+    }
     if (path) {
-        if (path->siteCount) {
-            if (path->sites) {
-                free((void*)path->sites);
-                path->sites = NULL;
-                path->siteCount = 0u;
-            }
+        reset_path(path);
+    }
+}
+
+/*
+ *Number of bytes of storage the site columns of a path take.
+ *The bitmaps follow the type and capacity bytes at the next 8-byte boundary.
+ */
+size_t path_storage_length(size_t siteCount) {
+    size_t bitmapsOffset = (2u * siteCount + 7u) & ~(size_t)7u;
+    size_t bitmapWords = (siteCount + 63u) / 64u;
+
+    return bitmapsOffset + SITE_TYPES_COUNT * bitmapWords * sizeof(uint64_t);
+}
+
+/*
+ *Point the site columns of the path into the given storage.
+ */
+void path_use_storage(Path* path, void* storage, size_t siteCount) {
+    unsigned char* bytes = (unsigned char*)storage;
+
+    path->storage = storage;
+    path->siteCount = siteCount;
+    path->types = bytes;
+    path->capacities = bytes + siteCount;
+    path->bitmaps = (uint64_t*)(bytes
+            + ((2u * siteCount + 7u) & ~(size_t)7u));
+    path->bitmapWords = (siteCount + 63u) / 64u;
+}
+
+/*
+ *Store a parsed site, escaping its capacity if it does not fit a byte.
+ *Blocking sites hold all players, whatever capacity the path gives them.
+ *Escapes are appended in site order, their list grows in powers of two.
+ */
+void path_store_site(Path* path, size_t site, enum SiteTypes type,
+        int capacity, int playersCount) {
+    SiteEscape* escape = NULL;
+
+    path->types[site] = (unsigned char)type;
+    if (SITE_TYPES_COUNT > type) {
+        path->bitmaps[type * path->bitmapWords + site / 64u]
+                |= (uint64_t)1u << (site % 64u);
+    }
+    /*Players have to stop at blocking sites like at barriers, all of them*/
+    if (site_effect(type)->blocking) {
+        path->bitmaps[BARRIER * path->bitmapWords + site / 64u]
+                |= (uint64_t)1u << (site % 64u);
+        capacity = MAX(capacity, playersCount);
+    }
+
+    if (0 <= capacity && SITE_CAPACITY_ESCAPE > (unsigned int)capacity) {
+        path->capacities[site] = (unsigned char)capacity;
+        return;
+    }
+    path->capacities[site] = SITE_CAPACITY_ESCAPE;
+    if (!(path->escapeCount & (path->escapeCount - 1u)) && path->arena) {
+        escape = (SiteEscape*)arena_alloc(path->arena,
+                MAX(2u * path->escapeCount, 1u) * sizeof(SiteEscape));
+        memcpy(escape, path->escapes,
+                path->escapeCount * sizeof(SiteEscape));
+        path->escapes = escape;
+    } else if (!(path->escapeCount & (path->escapeCount - 1u))) {
+        path->escapes = (SiteEscape*)realloc(path->escapes,
+                MAX(2u * path->escapeCount, 1u) * sizeof(SiteEscape));
+    }
+    escape = path->escapes + path->escapeCount++;
+    escape->site = site;
+    escape->capacity = capacity;
+}
+
+/*
+ *Type of the given site.
+ */
+enum SiteTypes path_site_type(const Path* path, size_t site) {
+    if (path->window) {
+        path_window_load(path, site);
+    }
+    return (enum SiteTypes)path->types[site];
+}
+
+/*
+ *Number of players the given site can hold.
+ */
+int path_site_capacity(const Path* path, size_t site) {
+    size_t low = 0u;
+    size_t high = path->escapeCount;
+    size_t middle = 0u;
+
+    if (path->window) {
+        path_window_load(path, site);
+    }
+    if (SITE_CAPACITY_ESCAPE != path->capacities[site]) {
+        return path->capacities[site];
+    }
+
+    /*Binary search among the escapes ordered by site*/
+    while (low < high) {
+        middle = low + (high - low) / 2u;
+        if (path->escapes[middle].site < site) {
+            low = middle + 1u;
+        } else {
+            high = middle;
         }
-        if (path->bufferLength) {
-            if (path->buffer) {
-                free((void*)path->buffer);
-                path->buffer = NULL;
-                path->bufferLength = 0u;
-            }
+    }
+    return low < path->escapeCount && site == path->escapes[low].site
+            ? path->escapes[low].capacity : 0;
+}
+
+/*
+ *Find the first site of the given type after the given one.
+ *Scans the type's bitmap a word of 64 sites at a time.
+ *Returns -1 if there is none.
+ */
+int path_find_site(const Path* path, enum SiteTypes type, int after) {
+    const uint64_t* bitmap = path->bitmaps + type * path->bitmapWords;
+    size_t site = (size_t)(after + 1);
+    size_t word = site / 64u;
+    uint64_t bits = 0u;
+
+    if (path->window) {
+        return path_window_find_site(path, type, after);
+    }
+    if (path->siteCount <= site) {
+        return -1;
+    }
+
+    bits = bitmap[word] & (~(uint64_t)0u << (site % 64u));
+    while (!bits) {
+        word += 1u;
+        if (path->bitmapWords <= word) {
+            return -1;
         }
+        bits = bitmap[word];
     }
+    return (int)(word * 64u + __builtin_ctzll(bits));
 }
 
 /*
@@ -111,45 +257,25 @@ int is_barrier(const char* site) {
 }
 
 /*
- *Convert site names to enumeration types.
+ *Convert site names to enumeration types, as named by the site table.
  */
 enum SiteTypes convert_site_type(const char* siteName) {
-    if (0 == strcmp("Mo", siteName)) {
-        return MO;
-    } else if (0 == strcmp("V1", siteName)) {
-        return V1;
-    } else if (0 == strcmp("V2", siteName)) {
-        return V2;
-    } else if (0 == strcmp("Do", siteName)) {
-        return DO;
-    } else if (0 == strcmp("Ri", siteName)) {
-        return RI;
-    } else if (0 == strcmp("::", siteName)) {
-        return BARRIER;
+    const SiteTable* table = site_table();
+    int type = 0;
+
+    for (type = 0; type < table->count; type++) {
+        if (0 == strcmp(table->effects[type].name, siteName)) {
+            return (enum SiteTypes)type;
+        }
     }
     return UNKNOWN_SITE_TYPE;
 }
 
 /*
- *Convert site type enumeration to names.
+ *Convert site type enumeration to names, as named by the site table.
  */
 const char* convert_site_name(enum SiteTypes type) {
-    switch (type) {
-        case MO:
-            return "Mo";
-        case V1:
-            return "V1";
-        case V2:
-            return "V2";
-        case DO:
-            return "Do";
-        case RI:
-            return "Ri";
-        case BARRIER:
-            return "::";
-        default:
-            return "__";
-    }
+    return site_effect(type)->name;
 }
 
 /*
@@ -161,7 +287,6 @@ int deserialize_path(FILE* stream, Path* path, int playersCount) {
     int success = E_OK;
     char* pos = NULL;
     size_t siteIdx = 0;
-    int i = 0;
     int readChars = 0;
     char siteName[3];
     int siteCapacity = 0;
@@ -179,17 +304,16 @@ int deserialize_path(FILE* stream, Path* path, int playersCount) {
         free_path(path);
         return E_INVALID_PATH;
     }
-    path->sites[siteIdx].capacity = playersCount;
-    path->sites[siteIdx].type = BARRIER;
+    path_store_site(path, siteIdx, BARRIER, playersCount,
+            playersCount);
     pos += 3;
     siteIdx += 1;
 
-    /*Deserialize all the sites*/
-    for (i = 0; i < (int)path->siteCount && '\n' != *pos
-            && '\0' != *pos; i++) {
+    /*Deserialize all the sites, surplus ones are ignored*/
+    while (siteIdx < path->siteCount && '\n' != *pos && '\0' != *pos) {
         if (is_barrier(pos)) {
-            path->sites[siteIdx].capacity = playersCount;
-            path->sites[siteIdx].type = BARRIER;
+            path_store_site(path, siteIdx, BARRIER, playersCount,
+                    playersCount);
             pos += 3;
             siteIdx += 1;
         } else {
@@ -199,8 +323,8 @@ int deserialize_path(FILE* stream, Path* path, int playersCount) {
                 free_path(path);
                 return E_INVALID_PATH;
             }
-            path->sites[siteIdx].capacity = siteCapacity;
-            path->sites[siteIdx].type = convert_site_type(siteName);
+            path_store_site(path, siteIdx, convert_site_type(siteName),
+                    siteCapacity, playersCount);
             pos += readChars;
             siteIdx += 1;
         }
@@ -219,10 +343,10 @@ int deserialize_path(FILE* stream, Path* path, int playersCount) {
  *Verify the path's integrity.
  */
 int verify_path(Path* path) {
-    if (BARRIER != path->sites[0].type) {
+    if (BARRIER != path_site_type(path, 0)) {
         return E_INVALID_PATH;
     }
-    if (BARRIER != path->sites[path->siteCount - 1].type) {
+    if (BARRIER != path_site_type(path, path->siteCount - 1)) {
         return E_INVALID_PATH;
     }
 
@@ -252,9 +376,9 @@ void calculate_initial_rankings(const int* positions, int* rankings,
 }
 
 /*
- *Allocate the map as a contignuous chunk.
+ *Allocate the map as a contignuous chunk, from the arena if given.
  */
-int** alloc_map(int rows, int columns) {
+int** alloc_map(int rows, int columns, Arena* arena) {
     int bodySize = 0;
     int headerSize = 0;
     int** row = NULL;
@@ -264,7 +388,8 @@ int** alloc_map(int rows, int columns) {
     headerSize = rows * sizeof(int*);
     bodySize = rows * columns * sizeof(int);
 
-    row = (int**)malloc(headerSize + bodySize);
+    row = (int**)(arena ? arena_alloc(arena, headerSize + bodySize)
+            : malloc(headerSize + bodySize));
     memset(row, -1, headerSize + bodySize);
 
     buf = (int*)(row + rows);
@@ -286,6 +411,15 @@ void player_request_path(FILE* stream) {
     fflush(stream);
 }
 
+/*
+ *Player tells the dealer that it attached to the shared path, which needs
+ *not be sent.
+ */
+void player_confirm_shared_path(FILE* stream) {
+    fprintf(stream, "@");
+    fflush(stream);
+}
+
 /*
  *Dealer asks the player for his next move.
  */
@@ -308,6 +442,28 @@ void dealer_broadcast_player_move(FILE** streams, int playersCount,
     }
 }
 
+/*
+ *Format the information of a player's move as sent to the players.
+ *Returns the length of the message.
+ */
+int dealer_format_player_move(char* buffer, size_t size, int id,
+        int targetSite, int pointDiff, int moneyDiff, int newCard) {
+    return snprintf(buffer, size, "HAP%d,%d,%d,%d,%d\n",
+            id, targetSite, pointDiff, moneyDiff, newCard);
+}
+
+/*
+ *Format the start of another game of a session: the number of players, the
+ *player's new ID and whether the path follows.
+ *Example: NEWGAME3,1,0
+ *Returns the length of the message.
+ */
+int dealer_format_new_game(char* buffer, size_t size, int playersCount,
+        int id, int withPath) {
+    return snprintf(buffer, size, "NEWGAME%d,%d,%d\n",
+            playersCount, id, withPath ? 1 : 0);
+}
+
 /*
  *Send DONE to all participating players.
  */
@@ -320,6 +476,37 @@ void dealer_broadcast_end(FILE** streams, int playersCount) {
     }
 }
 
+/*
+ *Check if this player was started for a session of several games.
+ */
+int player_in_session(void) {
+    const char* value = getenv(SESSION_VARIABLE);
+
+    return value && 0 != strcmp("0", value);
+}
+
+/*
+ *Parse the start of another game of a session.
+ *Returns E_OK if the message is valid, E_COMMS_ERROR else.
+ */
+int player_parse_new_game(const char* command, int* playersCount, int* id,
+        int* withPath) {
+    int readChars = 0;
+
+    readChars = sscanf(command, "NEWGAME%d,%d,%d",
+            playersCount, id, withPath);
+    if (3 > readChars || EOF == readChars) {
+        return E_COMMS_ERROR;
+    }
+    if (!(0 < *playersCount && *playersCount <= (int)MAX_PLAYERS)) {
+        return E_COMMS_ERROR;
+    }
+    if (!(0 <= *id && *id < *playersCount)) {
+        return E_COMMS_ERROR;
+    }
+    return E_OK;
+}
+
 /*
  *Initialize all the path structure's fields.
  */
@@ -368,8 +555,19 @@ void player_free_path(Path* path) {
     free_path(path);
 }
 
+/*
+ *Release the path's text, which is not needed for playing.
+ */
+void player_drop_path_text(Path* path) {
+    free(path->buffer);
+    path->buffer = NULL;
+    path->bufferLength = 0u;
+}
+
 /*
  *Print the path including all players' positions.
+ *A windowed path is printed from the rearmost to the frontmost player's
+ *chunk only.
  */
 void player_print_path(FILE* output, Path* path, int playersCount,
         int siteCount, const int* positions, int* rankings,
@@ -377,26 +575,36 @@ void player_print_path(FILE* output, Path* path, int playersCount,
     int i, row, column = 0;
     int lineLength = 0;
     int** map = NULL;
+    ArenaMark mark;
     int playerNo = 0;
     int count = 0;
+    size_t first = 0u;
+    size_t last = path->siteCount;
 
     if (initialSorting) {
         /*Get the initial rankings of all the players on their
          * positions/sites.*/
         calculate_initial_rankings(positions, rankings, playersCount);
     }
+    if (path->window) {
+        path_window_range(path, positions, playersCount, &first, &last);
+        siteCount = (int)(last - first);
+    }
 
     /*Print the first line representing the path.*/
-    for (i = 0; i < (int)path->siteCount; i++) {
-        fprintf(output, "%s ", convert_site_name(path->sites[i].type));
+    for (i = (int)first; i < (int)last; i++) {
+        fprintf(output, "%s ", convert_site_name(path_site_type(path, i)));
         lineLength += 3;
     }
     fputs("\n", output);
 
     /*Generate a map representing all players' positions.*/
-    map = alloc_map(playersCount, siteCount);
+    if (path->arena) {
+        mark = arena_mark(path->arena);
+    }
+    map = alloc_map(playersCount, siteCount, path->arena);
     for (i = 0; i < playersCount; i++) {
-        map[rankings[i]][positions[i]] = i;
+        map[rankings[i]][positions[i] - (int)first] = i;
     }
 
     /*Print the players' positions line by line.*/
@@ -413,7 +621,11 @@ void player_print_path(FILE* output, Path* path, int playersCount,
         fputs("\n", output);
     }
 
-    free(map);
+    if (path->arena) {
+        arena_release(path->arena, mark);
+    } else {
+        free(map);
+    }
 }
 
 /*
@@ -421,13 +633,7 @@ void player_print_path(FILE* output, Path* path, int playersCount,
  */
 int player_find_x_site_ahead(enum SiteTypes type, int ownPosition,
         const Path* path) {
-    size_t i = 0;
-    for (i = ownPosition + 1; i < path->siteCount; i++) {
-        if (type == path->sites[i].type) {
-            return i;
-        }
-    }
-    return -1;
+    return path_find_site(path, type, ownPosition);
 }
 
 /*
@@ -462,10 +668,10 @@ int player_forward_to(FILE* output, int siteIdx, int barrierIdx,
             siteIdx);
     /*
      *fprintf(stderr, "Make move to %d cap:%d use:%d\n", siteIdx,
-     *        path->sites[siteIdx].capacity, siteUsage);
+     *        path_site_capacity(path, siteIdx), siteUsage);
      */
 
-    if (path->sites[siteIdx].capacity <= siteUsage) {
+    if (path_site_capacity(path, siteIdx) <= siteUsage) {
         /*This site is full*/
         return 0;
     }
@@ -529,35 +735,8 @@ int dealer_draw_card_from_deck(Deck* deck) {
  */
 void dealer_calculate_player_earnings(int id, int targetSite, int* pointDiff,
         int* moneyDiff, int* newCard, Path* path, Player* player, Deck* deck) {
-    *pointDiff = 0;
-    *moneyDiff = 0;
-    *newCard = 0;
-
-    switch (path->sites[targetSite].type) {
-        case MO:
-            player->money += 3;
-            *moneyDiff = 3;
-            break;
-        case DO:
-            *pointDiff = (int)(player->money / 2);
-            player->points += *pointDiff;
-            *moneyDiff = -(player->money);
-            player->money = 0;
-            break;
-        case V1:
-            player->v1 += 1;
-            break;
-        case V2:
-            player->v2 += 1;
-            break;
-        case RI:
-            *newCard = dealer_draw_card_from_deck(deck);
-            player->overallCards += 1;
-            player->cards[*newCard] += 1;
-            break;
-        default:
-            break;
-    }
+    site_apply_effect(site_effect(path_site_type(path, targetSite)), player,
+            deck, pointDiff, moneyDiff, newCard);
 }
 
 /*
@@ -565,17 +744,53 @@ void dealer_calculate_player_earnings(int id, int targetSite, int* pointDiff,
  */
 void player_calculate_player_earnings(int id, int targetSite, Path* path,
         Player* player) {
+    const SiteEffect* effect = site_effect(path_site_type(path, targetSite));
+
+    player->v1 += effect->v1;
+    player->v2 += effect->v2;
+}
+
+/*
+ *Book-keep a validated move of the given player.
+ *Returns the player whose earnings have changed.
+ */
+Player* player_apply_move(int id, int siteIdx, int pointDiff, int moneyDiff,
+        int newCard, int* positions, int* rankings, int playersCount,
+        int ownId, Player* thisPlayer, Player* otherPlayers, Path* path) {
+    Player* printPlayer = NULL;
 
-    switch (path->sites[targetSite].type) {
-        case V1:
-            player->v1 += 1;
-            break;
-        case V2:
-            player->v2 += 1;
-            break;
-        default:
-            break;
+    if (ownId == id) {
+        printPlayer = thisPlayer;
+        if (siteIdx != positions[id]) {
+            /*The dealer made this move for us after a timeout*/
+            player_update_position(id, playersCount, positions, rankings,
+                    siteIdx);
+        }
+    } else {
+        player_update_position(id, playersCount, positions, rankings, siteIdx);
+        printPlayer = otherPlayers + id;
+
+        /*
+         *fprintf(stderr, "Player stats: pos=%d money=%d cards=%d points=%d\n",
+         *    siteIdx,
+         *    (*otherPlayers)[id].money,
+         *    (*otherPlayers)[id].overallCards,
+         *    (*otherPlayers)[id].points
+         *    );
+         */
+    }
+    printPlayer->money += moneyDiff;
+    printPlayer->points += pointDiff;
+    if (newCard) {
+        printPlayer->overallCards += 1;
+        printPlayer->cards[newCard] += 1;
+    }
+
+    player_calculate_player_earnings(id, siteIdx, path, printPlayer);
+    if (path->window) {
+        path_window_follow(path, positions, playersCount);
     }
+    return printPlayer;
 }
 
 /*
@@ -604,29 +819,9 @@ void player_process_move_broadcast(const char* command, int* positions,
         error_return(stderr, E_COMMS_ERROR);
     }
 
-    if (ownId == id) {
-        printPlayer = thisPlayer;
-    } else {
-        player_update_position(id, playersCount, positions, rankings, siteIdx);
-        printPlayer = (*otherPlayers) + id;
-
-        /*
-         *fprintf(stderr, "Player stats: pos=%d money=%d cards=%d points=%d\n",
-         *    siteIdx,
-         *    (*otherPlayers)[id].money,
-         *    (*otherPlayers)[id].overallCards,
-         *    (*otherPlayers)[id].points
-         *    );
-         */
-    }
-    printPlayer->money += moneyDiff;
-    printPlayer->points += pointDiff;
-    if (newCard) {
-        printPlayer->overallCards += 1;
-        printPlayer->cards[newCard] += 1;
-    }
-
-    player_calculate_player_earnings(id, siteIdx, path, printPlayer);
+    printPlayer = player_apply_move(id, siteIdx, pointDiff, moneyDiff,
+            newCard, positions, rankings, playersCount, ownId, thisPlayer,
+            *otherPlayers, path);
     player_print_earnings(stderr, id, printPlayer);
     player_print_path(stderr, path, playersCount, path->siteCount,
             positions, rankings, 0);
@@ -640,6 +835,64 @@ void dealer_reset_player(Player* player) {
     reset_player(player);
 }
 
+/*
+ *Determine the rankings of all players standing on the same site.
+ */
+void dealer_init_rankings(const int* positions, int* rankings,
+        int playersCount) {
+    calculate_initial_rankings(positions, rankings, playersCount);
+}
+
+/*
+ *Determine the player, who is next.
+ */
+int dealer_calculate_next_player(int playersCount, const int* positions,
+        const int* rankings) {
+    int i = 0;
+    int minSite = INT_MAX;
+    int maxRank = 0;
+
+    /*Find the earliest used site*/
+    for (i = 0; i < playersCount; i++) {
+        minSite = MIN(minSite, positions[i]);
+    }
+
+    /*Find the highest ranking on that site*/
+    for (i = 0; i < playersCount; i++) {
+        if (minSite == positions[i]) {
+            maxRank = MAX(maxRank, rankings[i]);
+        }
+    }
+
+    /*Find the player on the evaluated site and ranking*/
+    for (i = 0; i < playersCount; i++) {
+        if (minSite == positions[i]
+                && maxRank == rankings[i]) {
+            return i;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ *Adjust the positions and ranking board for the given move.
+ */
+void dealer_move_player(int id, int targetSite, int playersCount,
+        int* positions, int* rankings) {
+    int i = 0;
+    int ranking = 0;
+
+    for (i = 0; i < playersCount; i++) {
+        if (targetSite == positions[i]) {
+            ranking += 1;
+        }
+    }
+
+    positions[id] = targetSite;
+    rankings[id] = ranking;
+}
+
 /*
  *Check if the game has ended, i.e. all players are at the final site.
  *Returns non-zero if it is.
@@ -728,7 +981,7 @@ void player_print_scores(FILE* output, int playersCount, Player* players) {
 /*
  *Build a new instance of a deck and initialize it with data from stream.
  */
-void dealer_init_deck(FILE* stream, Deck* deck) {
+void dealer_init_deck(FILE* stream, Deck* deck, Arena* arena) {
     int readChars = 0;
 
     readChars = fscanf(stream, "%zu",
@@ -736,11 +989,15 @@ void dealer_init_deck(FILE* stream, Deck* deck) {
     if (EOF == readChars || readChars < 1) {
         error_return_dealer(stderr, E_DEALER_INVALID_DECK, 1);
     }
-    deck->buffer = (char*)malloc((deck->size + 2) * sizeof(int));
+    deck->buffer = (char*)(arena
+            ? arena_alloc(arena, (deck->size + 2) * sizeof(int))
+            : malloc((deck->size + 2) * sizeof(int)));
     deck->nextCard = deck->buffer;
 
     if (!fgets(deck->buffer, deck->size + 1, stream)) {
-        free(deck->buffer);
+        if (!arena) {
+            free(deck->buffer);
+        }
         error_return_dealer(stderr, E_DEALER_INVALID_DECK, 1);
     }
 }
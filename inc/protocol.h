@@ -11,14 +11,27 @@
 #include <math.h>
 #include <string.h>
 #include <errno.h>
+#include <stdint.h>
 
 #include "../inc/errorReturn.h"
+#include "../inc/arena.h"
 
 #ifndef MAX
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 #endif
 
+/*
+ *Maximum length of a message exchanged between dealer and players.
+ */
+#define MESSAGE_LENGTH 100u
+
+/*
+ *Environment variable set for players, which stay for another game after
+ *DONE until their input ends.
+ */
+#define SESSION_VARIABLE "PIPE_SESSION"
+
 /*
  *Maximum number of players.
  */
@@ -54,22 +67,56 @@ enum CardTypes {
 };
 
 /*
- *Descriptor of a site including its type and then number player it can
- *habitate.
+ *Number of built-in site types including the unknown one, which the path
+ *keeps bitmaps of. Further types come from the site table.
+ */
+#define SITE_TYPES_COUNT (UNKNOWN_SITE_TYPE + 1)
+
+/*
+ *Capacity byte of a site, whose capacity does not fit into it. The actual
+ *capacity is kept with the path's escapes.
+ */
+#define SITE_CAPACITY_ESCAPE 255u
+
+/*
+ *Capacity of a site, which does not fit into the compact capacities.
  */
 typedef struct {
-    enum SiteTypes type;
+    size_t site;
     int capacity;
-} Site;
+} SiteEscape;
 
 /*
- *Descriptor of the path including a list of all sites in order.
+ *Descriptor of the path.
+ *The sites are kept column-wise in a single block of storage: one type byte
+ *per site, one capacity byte per site and one bitmap of sites per type.
+ *Capacities not fitting into a byte are escaped and kept in a separate list
+ *ordered by site.
+ *The text buffer is only kept for passing the path on and may be dropped
+ *once parsed. A path attached to the dealer's shared copy has its storage
+ *in the read-only mapping and no text buffer.
+ *A windowed path only materializes the columns of chunks around the
+ *players, see pathWindow.h.
+ *If the arena is set, the path is printed with scratch memory from it, and
+ *a parsed path takes its storage and escapes from it too, freeing neither
+ *of them. The text is always allocated on its own.
  */
+struct PathWindow;
 typedef struct {
     size_t siteCount;
-    Site* sites;
+    unsigned char* types;
+    unsigned char* capacities;
+    uint64_t* bitmaps;
+    size_t bitmapWords;
+    void* storage;
+    SiteEscape* escapes;
+    size_t escapeCount;
     char* buffer;
     size_t bufferLength;
+    void* mapping;
+    size_t mappingLength;
+    struct PathWindow* window;
+    Arena* arena;
 } Path;
 
 /*
@@ -101,6 +148,12 @@ typedef struct {
  */
 void player_request_path(FILE* stream);
 
+/*
+ *Player tells the dealer that it attached to the shared path, which needs
+ *not be sent.
+ */
+void player_confirm_shared_path(FILE* stream);
+
 /*
  *Dealer asks the player for his next move.
  */
@@ -112,11 +165,39 @@ void dealer_request_next_move(FILE* stream);
 void dealer_broadcast_player_move(FILE** streams, int playersCount,
         int id, int targetSite, int pointDiff, int moneyDiff, int newCard);
 
+/*
+ *Format the information of a player's move as sent to the players.
+ *Returns the length of the message.
+ */
+int dealer_format_player_move(char* buffer, size_t size, int id,
+        int targetSite, int pointDiff, int moneyDiff, int newCard);
+
+/*
+ *Format the start of another game of a session: the number of players, the
+ *player's new ID and whether the path follows.
+ *Example: NEWGAME3,1,0
+ *Returns the length of the message.
+ */
+int dealer_format_new_game(char* buffer, size_t size, int playersCount,
+        int id, int withPath);
+
 /*
  *Send DONE to all participating players.
  */
 void dealer_broadcast_end(FILE** streams, int playersCount);
 
+/*
+ *Check if this player was started for a session of several games.
+ */
+int player_in_session(void);
+
+/*
+ *Parse the start of another game of a session.
+ *Returns E_OK if the message is valid, E_COMMS_ERROR else.
+ */
+int player_parse_new_game(const char* command, int* playersCount, int* id,
+        int* withPath);
+
 /*
  *Initialize all the path structure's fields.
  */
@@ -133,6 +214,54 @@ int player_read_path(FILE* stream, int playersCount, Path* path);
  */
 void player_free_path(Path* path);
 
+/*
+ *Release the path's text, which is not needed for playing.
+ */
+void player_drop_path_text(Path* path);
+
+/*
+ *Number of bytes of storage the site columns of a path take.
+ */
+size_t path_storage_length(size_t siteCount);
+
+/*
+ *Point the site columns of the path into the given storage.
+ */
+void path_use_storage(Path* path, void* storage, size_t siteCount);
+
+/*
+ *Store a parsed site, escaping its capacity if it does not fit a byte.
+ *Blocking sites hold all players, whatever capacity the path gives them.
+ */
+void path_store_site(Path* path, size_t site, enum SiteTypes type,
+        int capacity, int playersCount);
+
+/*
+ *Type of the given site.
+ */
+enum SiteTypes path_site_type(const Path* path, size_t site);
+
+/*
+ *Number of players the given site can hold.
+ */
+int path_site_capacity(const Path* path, size_t site);
+
+/*
+ *Find the first site of the given type after the given one.
+ *Returns -1 if there is none.
+ */
+int path_find_site(const Path* path, enum SiteTypes type, int after);
+
+/*
+ *Convert site names to enumeration types.
+ */
+enum SiteTypes convert_site_type(const char* siteName);
+
+/*
+ *Convert site type enumeration to names.
+ */
+const char* convert_site_name(enum SiteTypes type);
+
 /*
  *Print the path including all players' positions.
  */
@@ -189,6 +318,14 @@ void dealer_calculate_player_earnings(int id, int targetSite, int* pointDiff,
 void player_calculate_player_earnings(int id, int targetSite, Path* path,
         Player* player);
 
+/*
+ *Book-keep a validated move of the given player.
+ *Returns the player whose earnings have changed.
+ */
+Player* player_apply_move(int id, int siteIdx, int pointDiff, int moneyDiff,
+        int newCard, int* positions, int* rankings, int playersCount,
+        int ownId, Player* thisPlayer, Player* otherPlayers, Path* path);
+
 /*
  *Deserialize the move operation of the given player for own book-keeping.
  */
@@ -201,6 +338,24 @@ void player_process_move_broadcast(const char* command, int* positions,
  */
 void dealer_reset_player(Player* player);
 
+/*
+ *Determine the rankings of all players standing on the same site.
+ */
+void dealer_init_rankings(const int* positions, int* rankings,
+        int playersCount);
+
+/*
+ *Determine the player, who is next.
+ */
+int dealer_calculate_next_player(int playersCount, const int* positions,
+        const int* rankings);
+
+/*
+ *Adjust the positions and ranking board for the given move.
+ */
+void dealer_move_player(int id, int targetSite, int playersCount,
+        int* positions, int* rankings);
+
 /*
  *Check if the game has ended, i.e. all players are at the final site.
  *Returns non-zero if it is.
@@ -220,8 +375,10 @@ void player_print_scores(FILE* output, int playersCount, Player* players);
 
 /*
  *Build a new instance of a deck and initialize it with data from stream.
+ *The cards are allocated from the arena if given, else they have to be
+ *freed.
  */
-void dealer_init_deck(FILE* stream, Deck* deck);
+void dealer_init_deck(FILE* stream, Deck* deck, Arena* arena);
 
 #endif
 
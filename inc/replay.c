@@ -0,0 +1,429 @@
+/*
+ *replay.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "../inc/protocol.h"
+#include "../inc/strategy.h"
+#include "../inc/engine.h"
+#include "../inc/journal.h"
+#include "../inc/replay.h"
+
+/*
+ *State of the game replayed at a table.
+ *active .. Whether its start has been replayed and its end not yet.
+ *scores .. Score of every player, if the game ended now.
+ *deficits .. Largest deficit of every player to the leader so far.
+ *stage, stageScores .. Stages the game has reached and the scores at each.
+ */
+typedef struct {
+    Game game;
+    Deck deck;
+    int active;
+    int* scores;
+    int* deficits;
+    int stage;
+    int* stageScores;
+} ReplayTable;
+
+/*
+ *Set up empty statistics.
+ */
+void replay_stats_init(ReplayStats* stats) {
+    memset(stats, 0, sizeof(ReplayStats));
+}
+
+/*
+ *Make room for counting the sites of a path of the given length.
+ */
+void replay_stats_grow(ReplayStats* stats, size_t siteCount) {
+    size_t added = siteCount - stats->siteCount;
+
+    if (siteCount <= stats->siteCount) {
+        return;
+    }
+    stats->arrivals = (unsigned long*)realloc(stats->arrivals,
+            siteCount * sizeof(unsigned long));
+    stats->sharedArrivals = (unsigned long*)realloc(stats->sharedArrivals,
+            siteCount * sizeof(unsigned long));
+    stats->filledArrivals = (unsigned long*)realloc(stats->filledArrivals,
+            siteCount * sizeof(unsigned long));
+    memset(stats->arrivals + stats->siteCount, 0,
+            added * sizeof(unsigned long));
+    memset(stats->sharedArrivals + stats->siteCount, 0,
+            added * sizeof(unsigned long));
+    memset(stats->filledArrivals + stats->siteCount, 0,
+            added * sizeof(unsigned long));
+    stats->siteCount = siteCount;
+}
+
+/*
+ *Add the statistics of another thread to these.
+ */
+void replay_stats_merge(ReplayStats* stats, const ReplayStats* other) {
+    size_t i = 0;
+
+    replay_stats_grow(stats, other->siteCount);
+    for (i = 0; i < other->siteCount; i++) {
+        stats->arrivals[i] += other->arrivals[i];
+        stats->sharedArrivals[i] += other->sharedArrivals[i];
+        stats->filledArrivals[i] += other->filledArrivals[i];
+    }
+    for (i = 0; i < MAX_SITE_TYPES; i++) {
+        stats->typeArrivals[i] += other->typeArrivals[i];
+        stats->typeSharedArrivals[i] += other->typeSharedArrivals[i];
+        stats->typeFilledArrivals[i] += other->typeFilledArrivals[i];
+    }
+    for (i = 0; i < STRATEGY_RULES_COUNT; i++) {
+        stats->rules[i] += other->rules[i];
+    }
+    for (i = 0; i < REPLAY_STAGES; i++) {
+        stats->leads[i] += other->leads[i];
+        stats->leadCounts[i] += other->leadCounts[i];
+    }
+    stats->offStrategy += other->offStrategy;
+    stats->unexplained += other->unexplained;
+    stats->moves += other->moves;
+    stats->games += other->games;
+    stats->aborted += other->aborted;
+    stats->unfinished += other->unfinished;
+    stats->corrupt += other->corrupt;
+    stats->deficits += other->deficits;
+    stats->comebacks += other->comebacks;
+}
+
+/*
+ *Release the statistics.
+ */
+void replay_stats_free(ReplayStats* stats) {
+    free(stats->arrivals);
+    free(stats->sharedArrivals);
+    free(stats->filledArrivals);
+    memset(stats, 0, sizeof(ReplayStats));
+}
+
+/*
+ *Check the deck text of the journal: its number of cards followed by as
+ *many cards.
+ */
+int replay_check_deck(const char* text, size_t length) {
+    size_t digits = 0u;
+    size_t size = 0u;
+
+    while (digits < length && isdigit((unsigned char)text[digits])) {
+        size = size * 10u + (size_t)(text[digits] - '0');
+        digits++;
+    }
+    return digits && size && length - digits == size;
+}
+
+/*
+ *Release the parsed path and deck.
+ */
+void replay_close(ReplayJournal* journal) {
+    player_free_path(&journal->path);
+    arena_free(&journal->arena);
+}
+
+/*
+ *Parse the journal in the given memory, which has to stay mapped until the
+ *journal is closed.
+ *Returns non-zero if successful.
+ */
+int replay_open(ReplayJournal* journal, const void* data, size_t length) {
+    const JournalHeader* header = NULL;
+    FILE* stream = NULL;
+    int success = 0;
+    uint32_t i = 0;
+
+    memset(journal, 0, sizeof(ReplayJournal));
+    arena_init(&journal->arena, ARENA_BLOCK_SIZE);
+    player_reset_path(&journal->path);
+    if (!journal_parse(data, length, &journal->view)) {
+        return 0;
+    }
+    header = journal->view.header;
+
+    /*The path and deck are read like the dealer read them*/
+    journal->path.arena = &journal->arena;
+    stream = fmemopen((void*)journal->view.pathText, header->pathLength,
+            "r");
+    success = stream && E_OK == player_read_path(stream,
+            header->playersCount, &journal->path);
+    if (stream) {
+        fclose(stream);
+    }
+    stream = success && replay_check_deck(journal->view.deckText,
+            header->deckLength) ? fmemopen((void*)journal->view.deckText,
+                    header->deckLength, "r") : NULL;
+    if (!stream) {
+        replay_close(journal);
+        return 0;
+    }
+    dealer_init_deck(stream, &journal->deck, &journal->arena);
+    fclose(stream);
+
+    journal->strategies = (enum StrategyTypes*)arena_alloc(&journal->arena,
+            header->playersCount * sizeof(enum StrategyTypes));
+    for (i = 0; i < header->playersCount; i++) {
+        journal->strategies[i] = engine_convert_strategy(
+                journal->view.strategies[i]);
+    }
+    return 1;
+}
+
+/*
+ *Put the table back to the start of a game, setting it up when it is used
+ *for the first time.
+ */
+void replay_start_game(ReplayTable* table, const ReplayJournal* journal,
+        Arena* arena) {
+    int playersCount = (int)journal->view.header->playersCount;
+
+    if (!table->game.players) {
+        table->game.path = &journal->path;
+        table->game.playersCount = playersCount;
+        table->game.positions = (int*)arena_alloc(arena,
+                playersCount * sizeof(int));
+        table->game.rankings = (int*)arena_alloc(arena,
+                playersCount * sizeof(int));
+        table->game.players = (Player*)arena_alloc(arena,
+                playersCount * sizeof(Player));
+        table->game.deck = &table->deck;
+        table->scores = (int*)arena_alloc(arena, playersCount * sizeof(int));
+        table->deficits = (int*)arena_alloc(arena,
+                playersCount * sizeof(int));
+        table->stageScores = (int*)arena_alloc(arena,
+                REPLAY_STAGES * playersCount * sizeof(int));
+    }
+    table->deck = journal->deck;
+    engine_reset_game(&table->game);
+    memset(table->scores, 0, playersCount * sizeof(int));
+    memset(table->deficits, 0, playersCount * sizeof(int));
+    table->stage = 0;
+    table->active = 1;
+}
+
+/*
+ *Count the rule the strategy of the moving seat has chosen the site by.
+ */
+void replay_count_rule(ReplayStats* stats, const ReplayJournal* journal,
+        const Game* game, int id, int site) {
+    enum StrategyRules rule = STRATEGY_RULES_COUNT;
+    StrategyView view;
+    int chosen = -1;
+
+    view.path = game->path;
+    view.playersCount = game->playersCount;
+    view.ownId = id;
+    view.positions = game->positions;
+    view.rankings = game->rankings;
+    view.players = game->players;
+    view.index = NULL;
+
+    switch (journal->strategies[id]) {
+        case STRATEGY_A:
+            chosen = strategy_a_explain_site(&view, &rule);
+            break;
+        case STRATEGY_B:
+            chosen = strategy_b_explain_site(&view, &rule);
+            break;
+        default:
+            stats->unexplained += 1;
+            return;
+    }
+    if (chosen == site) {
+        stats->rules[rule] += 1;
+    } else {
+        stats->offStrategy += 1;
+    }
+}
+
+/*
+ *Follow the scores after a move: the deficits to the leader and the
+ *scores at each stage the last player has passed.
+ */
+void replay_track_scores(ReplayTable* table) {
+    const Game* game = &table->game;
+    size_t end = game->path->siteCount - 1u;
+    int best = 0;
+    int last = game->positions[0];
+    int i = 0;
+
+    for (i = 0; i < game->playersCount; i++) {
+        best = MAX(best, table->scores[i]);
+        last = MIN(last, game->positions[i]);
+    }
+    for (i = 0; i < game->playersCount; i++) {
+        table->deficits[i] = MAX(table->deficits[i],
+                best - table->scores[i]);
+    }
+
+    while (REPLAY_STAGES > table->stage
+            && (size_t)(table->stage + 1) * end
+                    <= (size_t)last * REPLAY_STAGES) {
+        memcpy(table->stageScores + table->stage * game->playersCount,
+                table->scores, game->playersCount * sizeof(int));
+        table->stage += 1;
+    }
+}
+
+/*
+ *Replay a move with the dealer's rules and count it.
+ *Returns 0 if the move is out of range.
+ */
+int replay_move(ReplayStats* stats, const ReplayJournal* journal,
+        ReplayTable* table, const JournalRecord* record) {
+    Game* game = &table->game;
+    int id = (int)record->id;
+    int site = (int)record->site;
+    int usage = 0;
+    int type = 0;
+
+    if (game->playersCount <= id || game->path->siteCount <= record->site) {
+        return 0;
+    }
+    replay_count_rule(stats, journal, game, id, site);
+
+    usage = (int)player_get_site_usage(game->positions, game->playersCount,
+            site);
+    type = (int)path_site_type(game->path, site);
+    stats->arrivals[site] += 1;
+    stats->typeArrivals[type] += 1;
+    if (usage) {
+        stats->sharedArrivals[site] += 1;
+        stats->typeSharedArrivals[type] += 1;
+    }
+    if (path_site_capacity(game->path, site) <= usage + 1) {
+        stats->filledArrivals[site] += 1;
+        stats->typeFilledArrivals[type] += 1;
+    }
+
+    engine_play_move(game, id, site);
+    stats->moves += 1;
+    table->scores[id] = engine_final_score(game->players + id);
+    replay_track_scores(table);
+    return 1;
+}
+
+/*
+ *Lead of the given player over the best of the others.
+ */
+int replay_lead(const int* scores, int playersCount, int id) {
+    int best = 0;
+    int found = 0;
+    int i = 0;
+
+    for (i = 0; i < playersCount; i++) {
+        if (id != i && (!found || best < scores[i])) {
+            best = scores[i];
+            found = 1;
+        }
+    }
+    return scores[id] - best;
+}
+
+/*
+ *Count the game of the table, which has ended.
+ */
+void replay_end_game(ReplayStats* stats, ReplayTable* table, int regular) {
+    int playersCount = table->game.playersCount;
+    int winner = 0;
+    int lead = 0;
+    int i = 0;
+
+    table->active = 0;
+    if (!regular) {
+        stats->aborted += 1;
+        return;
+    }
+    stats->games += 1;
+    for (i = 1; i < playersCount; i++) {
+        if (table->scores[winner] < table->scores[i]) {
+            winner = i;
+        }
+    }
+    stats->deficits += table->deficits[winner];
+    if (2 > playersCount) {
+        return;
+    }
+
+    for (i = 0; i < table->stage; i++) {
+        lead = replay_lead(table->stageScores + i * playersCount,
+                playersCount, winner);
+        stats->leads[i] += lead;
+        stats->leadCounts[i] += 1;
+        if (REPLAY_STAGES / 2 - 1 == i && 0 > lead) {
+            stats->comebacks += 1;
+        }
+    }
+}
+
+/*
+ *Replay the games starting at the records from first up to last, reading
+ *on as far as it takes to finish them. The games started before first are
+ *left to whoever replays the records before, so the chunks of a journal can
+ *be replayed independently. Scratch memory is taken from the arena.
+ */
+void replay_chunk(ReplayStats* stats, const ReplayJournal* journal,
+        size_t first, size_t last, Arena* arena) {
+    const JournalView* view = &journal->view;
+    const JournalRecord* record = NULL;
+    ArenaMark mark = arena_mark(arena);
+    ReplayTable* tables = NULL;
+    ReplayTable* table = NULL;
+    int activeCount = 0;
+    size_t i = 0;
+
+    replay_stats_grow(stats, journal->path.siteCount);
+    tables = (ReplayTable*)arena_calloc(arena, view->header->tablesCount,
+            sizeof(ReplayTable));
+
+    for (i = first; i < view->recordsCount && (i < last || activeCount);
+            i++) {
+        record = view->records + i;
+        if (view->header->tablesCount <= record->table) {
+            stats->corrupt += 1;
+            continue;
+        }
+        table = tables + record->table;
+
+        switch (record->type) {
+            case JOURNAL_START:
+                if (table->active) {
+                    /*The dealer went on without ending it*/
+                    stats->unfinished += 1;
+                    table->active = 0;
+                    activeCount -= 1;
+                }
+                if (i < last) {
+                    replay_start_game(table, journal, arena);
+                    activeCount += 1;
+                }
+                break;
+            case JOURNAL_MOVE:
+                if (table->active && !replay_move(stats, journal, table,
+                        record)) {
+                    stats->corrupt += 1;
+                    table->active = 0;
+                    activeCount -= 1;
+                }
+                break;
+            case JOURNAL_END:
+                if (table->active) {
+                    replay_end_game(stats, table, record->regular);
+                    activeCount -= 1;
+                }
+                break;
+            default:
+                stats->corrupt += 1;
+        }
+    }
+    stats->unfinished += activeCount;
+    arena_release(arena, mark);
+}
+
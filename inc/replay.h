@@ -0,0 +1,114 @@
+/*
+ *replay.h
+ */
+
+#pragma once
+
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include "../inc/protocol.h"
+#include "../inc/strategy.h"
+#include "../inc/engine.h"
+#include "../inc/siteEffects.h"
+#include "../inc/journal.h"
+
+/*
+ *Points of progress the scores are taken at: every tenth of the path the
+ *last player has passed.
+ */
+#define REPLAY_STAGES 10
+
+/*
+ *What the games replayed so far add up to.
+ *Sites are counted by their index, which is only meaningful for journals of
+ *the same path.
+ *arrivals, sharedArrivals, filledArrivals .. Moves to each site, the ones
+ *finding other players there and the ones taking its last place.
+ *typeArrivals, typeSharedArrivals, typeFilledArrivals .. The same for each
+ *site type.
+ *rules .. Moves of A and B seats made by each of their strategy's rules.
+ *offStrategy .. Moves of A and B seats their strategy would not have made,
+ *e.g. made by the dealer for them.
+ *unexplained .. Moves of seats with other strategies.
+ *aborted .. Games the dealer has ended early.
+ *unfinished .. Games the journal ends in the middle of.
+ *corrupt .. Records out of range, which are skipped. A game with such a
+ *move is given up.
+ *leads, leadCounts .. Sum of the winner's lead over the best other player
+ *at each stage, of the games which have reached it.
+ *deficits .. Sum of the largest deficit each winner has made up for.
+ *comebacks .. Games won by a player, which was behind at half of the path.
+ */
+typedef struct {
+    size_t siteCount;
+    unsigned long* arrivals;
+    unsigned long* sharedArrivals;
+    unsigned long* filledArrivals;
+    unsigned long typeArrivals[MAX_SITE_TYPES];
+    unsigned long typeSharedArrivals[MAX_SITE_TYPES];
+    unsigned long typeFilledArrivals[MAX_SITE_TYPES];
+    unsigned long rules[STRATEGY_RULES_COUNT];
+    unsigned long offStrategy;
+    unsigned long unexplained;
+    unsigned long moves;
+    unsigned long games;
+    unsigned long aborted;
+    unsigned long unfinished;
+    unsigned long corrupt;
+    double leads[REPLAY_STAGES];
+    unsigned long leadCounts[REPLAY_STAGES];
+    double deficits;
+    unsigned long comebacks;
+} ReplayStats;
+
+/*
+ *A journal ready to be replayed: the path and deck parsed from it, and the
+ *strategy of every seat.
+ */
+typedef struct {
+    JournalView view;
+    Path path;
+    Deck deck;
+    enum StrategyTypes* strategies;
+    Arena arena;
+} ReplayJournal;
+
+/*
+ *Set up empty statistics.
+ */
+void replay_stats_init(ReplayStats* stats);
+
+/*
+ *Add the statistics of another thread to these.
+ */
+void replay_stats_merge(ReplayStats* stats, const ReplayStats* other);
+
+/*
+ *Release the statistics.
+ */
+void replay_stats_free(ReplayStats* stats);
+
+/*
+ *Parse the journal in the given memory, which has to stay mapped until the
+ *journal is closed.
+ *Returns non-zero if successful.
+ */
+int replay_open(ReplayJournal* journal, const void* data, size_t length);
+
+/*
+ *Release the parsed path and deck.
+ */
+void replay_close(ReplayJournal* journal);
+
+/*
+ *Replay the games starting at the records from first up to last, reading
+ *on as far as it takes to finish them. The games started before first are
+ *left to whoever replays the records before, so the chunks of a journal can
+ *be replayed independently. Scratch memory is taken from the arena.
+ */
+void replay_chunk(ReplayStats* stats, const ReplayJournal* journal,
+        size_t first, size_t last, Arena* arena);
+
+#endif
+
@@ -0,0 +1,350 @@
+/*
+ *results.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <stdio_ext.h>
+
+#include "../inc/protocol.h"
+#include "../inc/results.h"
+
+/*
+ *Round a length up to the alignment of the columns.
+ */
+size_t results_padded(size_t length) {
+    return (length + RESULTS_ALIGNMENT - 1u)
+            & ~(size_t)(RESULTS_ALIGNMENT - 1u);
+}
+
+/*
+ *Bytes a block of the given rows takes, its header included.
+ */
+size_t results_block_length(size_t rows, size_t playersCount) {
+    return sizeof(ResultsBlockHeader) + 4u * rows * sizeof(uint64_t)
+            + results_padded(rows * sizeof(uint32_t))
+            + results_padded(playersCount * rows)
+            + 5u * results_padded(playersCount * rows * sizeof(int32_t));
+}
+
+/*
+ *Check if the header starts a complete block within the given bytes.
+ */
+int results_valid_block(const ResultsBlockHeader* header, size_t left) {
+    return sizeof(ResultsBlockHeader) <= left
+            && 0 == memcmp(header->magic, RESULTS_BLOCK_MAGIC,
+                    sizeof(RESULTS_BLOCK_MAGIC))
+            && header->rows && header->playersCount
+            && MAX_PLAYERS >= header->playersCount
+            && left >= header->length && header->length
+                    == results_block_length(header->rows,
+                            header->playersCount);
+}
+
+/*
+ *Hash data, e.g. the deck or path text, for the seed and pathHash columns.
+ */
+uint64_t results_hash(const void* data, size_t length) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t hash = 14695981039346656037ull;
+    size_t i = 0u;
+
+    /*FNV-1a*/
+    for (i = 0u; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+/*
+ *Prepare a stream opened for reading and appending to take blocks: write
+ *the header if it is empty, else check the header is one of this version.
+ *Returns non-zero if successful.
+ */
+int results_write_header(FILE* stream) {
+    ResultsHeader header;
+    ResultsBlockHeader block;
+    size_t length = 0u;
+    size_t end = sizeof(ResultsHeader);
+
+    if (0 != fseek(stream, 0, SEEK_END)) {
+        return 0;
+    }
+    length = (size_t)ftell(stream);
+    if (!length) {
+        memset(&header, 0, sizeof(ResultsHeader));
+        memcpy(header.magic, RESULTS_MAGIC, sizeof(RESULTS_MAGIC));
+        header.version = RESULTS_VERSION;
+        return 1u == fwrite(&header, sizeof(ResultsHeader), 1u, stream);
+    }
+
+    rewind(stream);
+    if (1u != fread(&header, sizeof(ResultsHeader), 1u, stream)
+            || 0 != memcmp(header.magic, RESULTS_MAGIC,
+                    sizeof(RESULTS_MAGIC))
+            || RESULTS_VERSION != header.version) {
+        return 0;
+    }
+
+    /*A block cut short by an earlier run would end the file*/
+    while (1u == fread(&block, sizeof(ResultsBlockHeader), 1u, stream)
+            && results_valid_block(&block, length - end)) {
+        end += block.length;
+        fseek(stream, (long)end, SEEK_SET);
+    }
+    if (end < length && (0 != fflush(stream)
+            || 0 != ftruncate(fileno(stream), (off_t)end))) {
+        return 0;
+    }
+    return 0 == fseek(stream, 0, SEEK_END);
+}
+
+/*
+ *Set up a writer appending to the stream, whose header is written, the
+ *games of the given players with the given strategy letters.
+ */
+void results_writer_init(ResultsWriter* writer, FILE* stream,
+        int playersCount, const char* strategies, uint64_t seed,
+        uint64_t pathHash) {
+    size_t cells = playersCount * RESULTS_BLOCK_ROWS;
+    size_t i = 0u;
+    int j = 0;
+
+    memset(writer, 0, sizeof(ResultsWriter));
+    writer->stream = stream;
+    writer->playersCount = playersCount;
+    writer->games = (uint64_t*)malloc(RESULTS_BLOCK_ROWS * sizeof(uint64_t));
+    writer->seeds = (uint64_t*)malloc(RESULTS_BLOCK_ROWS * sizeof(uint64_t));
+    writer->pathHashes = (uint64_t*)malloc(RESULTS_BLOCK_ROWS
+            * sizeof(uint64_t));
+    writer->durations = (uint64_t*)malloc(RESULTS_BLOCK_ROWS
+            * sizeof(uint64_t));
+    writer->moves = (uint32_t*)malloc(RESULTS_BLOCK_ROWS * sizeof(uint32_t));
+    writer->strategies = (char*)malloc(cells);
+    writer->scores = (int32_t*)malloc(cells * sizeof(int32_t));
+    writer->v1s = (int32_t*)malloc(cells * sizeof(int32_t));
+    writer->v2s = (int32_t*)malloc(cells * sizeof(int32_t));
+    writer->cardPoints = (int32_t*)malloc(cells * sizeof(int32_t));
+    writer->moneyPoints = (int32_t*)malloc(cells * sizeof(int32_t));
+
+    /*The same for all games of the writer*/
+    for (i = 0u; i < RESULTS_BLOCK_ROWS; i++) {
+        writer->seeds[i] = seed;
+        writer->pathHashes[i] = pathHash;
+    }
+    for (j = 0; j < playersCount; j++) {
+        memset(writer->strategies + j * RESULTS_BLOCK_ROWS, strategies[j],
+                RESULTS_BLOCK_ROWS);
+    }
+}
+
+/*
+ *Add the row of a game played to its end, with the final earnings of all
+ *players, which are not altered. The block is appended once it is full.
+ */
+void results_writer_add(ResultsWriter* writer, uint64_t game,
+        uint64_t duration, uint32_t moves, const Player* players) {
+    Player copy;
+    size_t cell = writer->rows;
+    int i = 0;
+
+    writer->games[writer->rows] = game;
+    writer->durations[writer->rows] = duration;
+    writer->moves[writer->rows] = moves;
+    for (i = 0; i < writer->playersCount; i++, cell += RESULTS_BLOCK_ROWS) {
+        copy = players[i];
+        writer->v1s[cell] = copy.v1;
+        writer->v2s[cell] = copy.v2;
+        writer->moneyPoints[cell] = copy.points;
+        writer->cardPoints[cell] = dealer_calculate_card_points(&copy);
+        writer->scores[cell] = copy.v1 + copy.v2 + copy.points
+                + writer->cardPoints[cell];
+    }
+
+    writer->rows += 1u;
+    if (RESULTS_BLOCK_ROWS == writer->rows) {
+        results_writer_flush(writer);
+    }
+}
+
+/*
+ *Write the first rows of a column, for each seat if there are any, and pad
+ *it up to the alignment.
+ *Returns non-zero if all of it has been written.
+ */
+int write_column(FILE* stream, const void* column, size_t size,
+        size_t rows, int seats) {
+    const char padding[RESULTS_ALIGNMENT] = { 0 };
+    const char* bytes = (const char*)column;
+    size_t paddingLength = results_padded(seats * rows * size)
+            - seats * rows * size;
+    int i = 0;
+
+    for (i = 0; i < seats; i++) {
+        if (rows != fwrite(bytes + i * RESULTS_BLOCK_ROWS * size, size,
+                rows, stream)) {
+            return 0;
+        }
+    }
+    return paddingLength == fwrite(padding, 1u, paddingLength, stream);
+}
+
+/*
+ *Append the rows collected so far as a block, if there are any. A block
+ *which can't be written completely is cut off the file again.
+ *Returns 0 if this or an earlier block could not be written.
+ */
+int results_writer_flush(ResultsWriter* writer) {
+    ResultsBlockHeader header;
+    FILE* stream = writer->stream;
+    size_t rows = writer->rows;
+    int seats = writer->playersCount;
+    off_t start = -1;
+    int written = 0;
+
+    writer->rows = 0u;
+    if (!rows || writer->failed) {
+        return !writer->failed;
+    }
+    memset(&header, 0, sizeof(ResultsBlockHeader));
+    memcpy(header.magic, RESULTS_BLOCK_MAGIC, sizeof(RESULTS_BLOCK_MAGIC));
+    header.rows = (uint32_t)rows;
+    header.playersCount = (uint32_t)seats;
+    header.length = results_block_length(rows, seats);
+
+    /*Other writers of the stream append their blocks before or after*/
+    flockfile(stream);
+    written = 0 == fseeko(stream, 0, SEEK_END)
+            && -1 != (start = ftello(stream))
+            && 1u == fwrite(&header, sizeof(ResultsBlockHeader), 1u, stream)
+            && write_column(stream, writer->games, sizeof(uint64_t), rows, 1)
+            && write_column(stream, writer->seeds, sizeof(uint64_t), rows, 1)
+            && write_column(stream, writer->pathHashes, sizeof(uint64_t),
+                    rows, 1)
+            && write_column(stream, writer->durations, sizeof(uint64_t),
+                    rows, 1)
+            && write_column(stream, writer->moves, sizeof(uint32_t), rows, 1)
+            && write_column(stream, writer->strategies, 1u, rows, seats)
+            && write_column(stream, writer->scores, sizeof(int32_t), rows,
+                    seats)
+            && write_column(stream, writer->v1s, sizeof(int32_t), rows,
+                    seats)
+            && write_column(stream, writer->v2s, sizeof(int32_t), rows,
+                    seats)
+            && write_column(stream, writer->cardPoints, sizeof(int32_t),
+                    rows, seats)
+            && write_column(stream, writer->moneyPoints, sizeof(int32_t),
+                    rows, seats)
+            && 0 == fflush(stream);
+    if (!written && -1 != start) {
+        /*A partial block would be taken for whatever follows it*/
+        __fpurge(stream);
+        clearerr(stream);
+        if (0 == ftruncate(fileno(stream), start)) {
+            fseeko(stream, 0, SEEK_END);
+        }
+    }
+    funlockfile(stream);
+
+    writer->failed = !written;
+    writer->blocks += (unsigned long)written;
+    return written;
+}
+
+/*
+ *Append the rows left and release the writer's columns.
+ *Returns 0 if a block could not be written.
+ */
+int results_writer_free(ResultsWriter* writer) {
+    int written = results_writer_flush(writer);
+
+    free(writer->games);
+    free(writer->seeds);
+    free(writer->pathHashes);
+    free(writer->durations);
+    free(writer->moves);
+    free(writer->strategies);
+    free(writer->scores);
+    free(writer->v1s);
+    free(writer->v2s);
+    free(writer->cardPoints);
+    free(writer->moneyPoints);
+    return written;
+}
+
+/*
+ *Find the blocks of the results file in the given memory.
+ *Returns non-zero if it is a results file this version can read.
+ */
+int results_open(ResultsFile* file, const void* data, size_t length) {
+    const ResultsHeader* header = (const ResultsHeader*)data;
+
+    memset(file, 0, sizeof(ResultsFile));
+    if (length < sizeof(ResultsHeader)
+            || 0 != memcmp(header->magic, RESULTS_MAGIC,
+                    sizeof(RESULTS_MAGIC))
+            || RESULTS_VERSION != header->version) {
+        return 0;
+    }
+    file->data = (const char*)data;
+    file->length = length;
+    file->offset = sizeof(ResultsHeader);
+    return 1;
+}
+
+/*
+ *Take a column of the given bytes from the block at the cursor.
+ */
+const void* take_column(const char** cursor, size_t length) {
+    const void* column = *cursor;
+
+    *cursor += results_padded(length);
+    return column;
+}
+
+/*
+ *Find the columns of the next block. A block cut short by a writer which
+ *did not finish ends the file.
+ *Returns 0 if there are no more blocks.
+ */
+int results_next_block(ResultsFile* file, ResultsBlock* block) {
+    const char* cursor = file->data + file->offset;
+    const ResultsBlockHeader* header = (const ResultsBlockHeader*)cursor;
+    size_t cells = 0u;
+
+    memset(block, 0, sizeof(ResultsBlock));
+    if (!results_valid_block(header, file->length - file->offset)) {
+        return 0;
+    }
+    file->offset += header->length;
+
+    block->rows = header->rows;
+    block->playersCount = (int)header->playersCount;
+    cells = block->rows * header->playersCount;
+    cursor += sizeof(ResultsBlockHeader);
+    block->games = (const uint64_t*)take_column(&cursor,
+            block->rows * sizeof(uint64_t));
+    block->seeds = (const uint64_t*)take_column(&cursor,
+            block->rows * sizeof(uint64_t));
+    block->pathHashes = (const uint64_t*)take_column(&cursor,
+            block->rows * sizeof(uint64_t));
+    block->durations = (const uint64_t*)take_column(&cursor,
+            block->rows * sizeof(uint64_t));
+    block->moves = (const uint32_t*)take_column(&cursor,
+            block->rows * sizeof(uint32_t));
+    block->strategies = (const char*)take_column(&cursor, cells);
+    block->scores = (const int32_t*)take_column(&cursor,
+            cells * sizeof(int32_t));
+    block->v1s = (const int32_t*)take_column(&cursor,
+            cells * sizeof(int32_t));
+    block->v2s = (const int32_t*)take_column(&cursor,
+            cells * sizeof(int32_t));
+    block->cardPoints = (const int32_t*)take_column(&cursor,
+            cells * sizeof(int32_t));
+    block->moneyPoints = (const int32_t*)take_column(&cursor,
+            cells * sizeof(int32_t));
+    return 1;
+}
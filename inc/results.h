@@ -0,0 +1,190 @@
+/*
+ *results.h
+ */
+
+#pragma once
+
+#ifndef __RESULTS_H__
+#define __RESULTS_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "../inc/protocol.h"
+
+/*
+ *First bytes of every results file.
+ */
+#define RESULTS_MAGIC "2310RES"
+
+/*
+ *First bytes of every block of rows.
+ */
+#define RESULTS_BLOCK_MAGIC "2310RBK"
+
+/*
+ *Version of the layout described below.
+ */
+#define RESULTS_VERSION 1u
+
+/*
+ *Alignment of the blocks and of every column within them.
+ */
+#define RESULTS_ALIGNMENT 8u
+
+/*
+ *Rows a writer collects before it appends them as a block.
+ */
+#define RESULTS_BLOCK_ROWS 4096u
+
+/*
+ *Start of a results file, in the byte order of the program writing it.
+ *It is followed by blocks of rows, one row per game played to its end.
+ *Runs append blocks of their own, so a file may hold games of different
+ *paths, decks, strategies and numbers of players.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+} ResultsHeader;
+
+/*
+ *Start of a block, followed by its columns, each padded up to
+ *RESULTS_ALIGNMENT:
+ *game, seed, pathHash, duration .. uint64_t per row.
+ *moves .. uint32_t per row.
+ *strategies .. char per seat and row.
+ *scores, v1s, v2s, cardPoints, moneyPoints .. int32_t per seat and row.
+ *The columns per seat hold all rows of seat 0, then those of seat 1 and so
+ *on. length covers the block's header and columns.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t rows;
+    uint32_t playersCount;
+    uint64_t length;
+} ResultsBlockHeader;
+
+/*
+ *Collects the rows of a run's games and appends them to the stream in
+ *blocks. All games of a writer are played on the same path with the same
+ *deck and strategies, like all games of a run are.
+ *Several writers may share a stream, e.g. one per thread, each block is
+ *appended at once.
+ *seed .. Hash of the deck, which all card draws come from.
+ *pathHash .. Hash of the path's text.
+ *The columns have room for RESULTS_BLOCK_ROWS rows, the ones per seat for
+ *as many rows per seat.
+ *failed .. Set once a block could not be written, the rows are dropped
+ *from then on.
+ */
+typedef struct {
+    FILE* stream;
+    int playersCount;
+    size_t rows;
+    uint64_t* games;
+    uint64_t* seeds;
+    uint64_t* pathHashes;
+    uint64_t* durations;
+    uint32_t* moves;
+    char* strategies;
+    int32_t* scores;
+    int32_t* v1s;
+    int32_t* v2s;
+    int32_t* cardPoints;
+    int32_t* moneyPoints;
+    unsigned long blocks;
+    int failed;
+} ResultsWriter;
+
+/*
+ *A block of rows in memory, the value of a column per seat for the given
+ *seat and row is at seat * rows + row.
+ *game .. Number of the game within its run.
+ *duration .. Microseconds from the start to the end of the game.
+ *moves .. Moves made in the game.
+ *scores .. Final scores, the sums of the other four columns per seat.
+ *cardPoints .. Points for the sets of cards collected.
+ *moneyPoints .. Points earned on the path, by converting money.
+ */
+typedef struct {
+    size_t rows;
+    int playersCount;
+    const uint64_t* games;
+    const uint64_t* seeds;
+    const uint64_t* pathHashes;
+    const uint64_t* durations;
+    const uint32_t* moves;
+    const char* strategies;
+    const int32_t* scores;
+    const int32_t* v1s;
+    const int32_t* v2s;
+    const int32_t* cardPoints;
+    const int32_t* moneyPoints;
+} ResultsBlock;
+
+/*
+ *A results file in memory, read block by block.
+ *offset .. Start of the next block.
+ */
+typedef struct {
+    const char* data;
+    size_t length;
+    size_t offset;
+} ResultsFile;
+
+/*
+ *Hash data, e.g. the deck or path text, for the seed and pathHash columns.
+ */
+uint64_t results_hash(const void* data, size_t length);
+
+/*
+ *Prepare a stream opened for reading and appending to take blocks: write
+ *the header if it is empty, else check the header is one of this version.
+ *Returns non-zero if successful.
+ */
+int results_write_header(FILE* stream);
+
+/*
+ *Set up a writer appending to the stream, whose header is written, the
+ *games of the given players with the given strategy letters.
+ */
+void results_writer_init(ResultsWriter* writer, FILE* stream,
+        int playersCount, const char* strategies, uint64_t seed,
+        uint64_t pathHash);
+
+/*
+ *Add the row of a game played to its end, with the final earnings of all
+ *players, which are not altered. The block is appended once it is full.
+ */
+void results_writer_add(ResultsWriter* writer, uint64_t game,
+        uint64_t duration, uint32_t moves, const Player* players);
+
+/*
+ *Append the rows collected so far as a block, if there are any. A block
+ *which can't be written completely is cut off the file again.
+ *Returns 0 if this or an earlier block could not be written.
+ */
+int results_writer_flush(ResultsWriter* writer);
+
+/*
+ *Append the rows left and release the writer's columns.
+ *Returns 0 if a block could not be written.
+ */
+int results_writer_free(ResultsWriter* writer);
+
+/*
+ *Find the blocks of the results file in the given memory.
+ *Returns non-zero if it is a results file this version can read.
+ */
+int results_open(ResultsFile* file, const void* data, size_t length);
+
+/*
+ *Find the columns of the next block. A block cut short by a writer which
+ *did not finish ends the file.
+ *Returns 0 if there are no more blocks.
+ */
+int results_next_block(ResultsFile* file, ResultsBlock* block);
+
+#endif
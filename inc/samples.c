@@ -0,0 +1,274 @@
+/*
+ *samples.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdio_ext.h>
+
+#include "../inc/protocol.h"
+#include "../inc/engine.h"
+#include "../inc/samples.h"
+
+/*
+ *Bytes of a record of the given number of players.
+ */
+size_t samples_record_length(int playersCount) {
+    return (sizeof(SampleRecord) + playersCount * sizeof(SampleSeat)
+            + SAMPLES_ALIGNMENT - 1u) & ~(size_t)(SAMPLES_ALIGNMENT - 1u);
+}
+
+/*
+ *Write the header of a samples file of the given number of players.
+ *Returns non-zero if successful.
+ */
+int samples_write_header(FILE* stream, int playersCount) {
+    SamplesHeader header;
+
+    memset(&header, 0, sizeof(SamplesHeader));
+    memcpy(header.magic, SAMPLES_MAGIC, sizeof(SAMPLES_MAGIC));
+    header.version = SAMPLES_VERSION;
+    header.playersCount = (uint32_t)playersCount;
+    header.recordLength = (uint32_t)samples_record_length(playersCount);
+    return 1u == fwrite(&header, sizeof(SamplesHeader), 1u, stream);
+}
+
+/*
+ *Set up the records of the games of the given number of players.
+ */
+void samples_game_init(SampleGame* game, int playersCount) {
+    memset(game, 0, sizeof(SampleGame));
+    game->playersCount = playersCount;
+    game->recordLength = samples_record_length(playersCount);
+}
+
+/*
+ *Keep the decision of the given player, made in the given state of the
+ *game before the move is applied.
+ */
+void samples_game_add(SampleGame* game, uint64_t number, uint32_t move,
+        int id, int site, const int* positions, const int* rankings,
+        const Player* players) {
+    SampleRecord* record = NULL;
+    SampleSeat* seat = NULL;
+    int i = 0;
+    int j = 0;
+
+    if (game->count == game->capacity) {
+        /*Grows over the first games only, their length hardly varies*/
+        game->capacity = MAX(game->capacity * 2u, 64u);
+        game->records = (char*)realloc(game->records,
+                game->capacity * game->recordLength);
+    }
+    record = (SampleRecord*)(game->records
+            + game->count * game->recordLength);
+    memset(record, 0, game->recordLength);
+    record->game = number;
+    record->move = move;
+    record->id = (uint32_t)id;
+    record->site = site;
+
+    seat = (SampleSeat*)(record + 1);
+    for (i = 0; i < game->playersCount; i++, seat++) {
+        seat->position = (uint32_t)positions[i];
+        seat->ranking = (uint16_t)rankings[i];
+        for (j = 0; j < (int)CARD_TYPES_COUNT; j++) {
+            seat->cards[j] = (uint16_t)players[i].cards[CARD_A + j];
+        }
+        seat->money = players[i].money;
+    }
+    game->count += 1u;
+}
+
+/*
+ *Drop the records of a game which did not end regularly.
+ */
+void samples_game_clear(SampleGame* game) {
+    game->count = 0u;
+}
+
+/*
+ *Write a buffer of whole records at once, or cut what has been written of
+ *it off the file again, unless an earlier buffer has failed already.
+ *Counts the records written.
+ */
+void samples_write_buffer(SampleExporter* exporter, const char* buffer,
+        size_t length) {
+    FILE* stream = exporter->stream;
+    off_t start = -1;
+    int written = 0;
+
+    if (exporter->failed) {
+        return;
+    }
+    /*Other exporters of the stream write their buffers before or after*/
+    flockfile(stream);
+    written = -1 != (start = ftello(stream))
+            && length == fwrite(buffer, 1u, length, stream)
+            && 0 == fflush(stream);
+    if (!written && -1 != start) {
+        /*A partial record would shift all records following it*/
+        __fpurge(stream);
+        clearerr(stream);
+        if (0 == ftruncate(fileno(stream), start)) {
+            fseeko(stream, start, SEEK_SET);
+        }
+    }
+    funlockfile(stream);
+
+    exporter->failed = !written;
+    exporter->records += written ? length / exporter->recordLength : 0u;
+}
+
+/*
+ *Hand a full buffer to the thread, waiting until the other one is written,
+ *or write it right away if there is no thread.
+ */
+void samples_hand_off(SampleExporter* exporter) {
+    if (!exporter->filled) {
+        return;
+    }
+    if (!exporter->threaded) {
+        samples_write_buffer(exporter, exporter->buffers[exporter->current],
+                exporter->filled);
+        exporter->filled = 0u;
+        return;
+    }
+
+    pthread_mutex_lock(&exporter->lock);
+    if (exporter->writing) {
+        exporter->waits += 1u;
+    }
+    while (exporter->writing) {
+        pthread_cond_wait(&exporter->changed, &exporter->lock);
+    }
+    exporter->writing = exporter->filled;
+    exporter->current = 1 - exporter->current;
+    exporter->filled = 0u;
+    pthread_cond_broadcast(&exporter->changed);
+    pthread_mutex_unlock(&exporter->lock);
+}
+
+/*
+ *Fill in the outcomes from the final earnings of all players, which are
+ *not altered, and hand the game's records to the exporter.
+ */
+void samples_game_end(SampleGame* game, SampleExporter* exporter,
+        const Player* players) {
+    SampleRecord* record = NULL;
+    int scores[MAX_PLAYERS];
+    int best = 0;
+    size_t taken = 0u;
+    size_t i = 0u;
+    int j = 0;
+
+    for (j = 0; j < game->playersCount; j++) {
+        scores[j] = engine_final_score(players + j);
+    }
+    for (i = 0u; i < game->count; i++) {
+        record = (SampleRecord*)(game->records + i * game->recordLength);
+        for (best = INT32_MIN, j = 0; j < game->playersCount; j++) {
+            best = (int)record->id == j ? best : MAX(best, scores[j]);
+        }
+        record->outcome = scores[record->id]
+                - (1 < game->playersCount ? best : 0);
+    }
+
+    /*Whole records only, so exporters can share a stream*/
+    for (i = 0u; i < game->count; i += taken) {
+        taken = MIN(game->count - i, (exporter->length - exporter->filled)
+                / exporter->recordLength);
+        memcpy(exporter->buffers[exporter->current] + exporter->filled,
+                game->records + i * game->recordLength,
+                taken * game->recordLength);
+        exporter->filled += taken * game->recordLength;
+        if (exporter->filled == exporter->length) {
+            samples_hand_off(exporter);
+        }
+    }
+    game->count = 0u;
+}
+
+/*
+ *Release the records of a game.
+ */
+void samples_game_free(SampleGame* game) {
+    free(game->records);
+    memset(game, 0, sizeof(SampleGame));
+}
+
+/*
+ *Write the buffers handed off until the exporter is stopped.
+ */
+void* samples_thread(void* argument) {
+    SampleExporter* exporter = (SampleExporter*)argument;
+    const char* buffer = NULL;
+    size_t length = 0u;
+
+    pthread_mutex_lock(&exporter->lock);
+    while (1) {
+        while (!exporter->writing && !exporter->stopping) {
+            pthread_cond_wait(&exporter->changed, &exporter->lock);
+        }
+        if (!exporter->writing) {
+            break;
+        }
+        buffer = exporter->buffers[1 - exporter->current];
+        length = exporter->writing;
+        pthread_mutex_unlock(&exporter->lock);
+
+        samples_write_buffer(exporter, buffer, length);
+
+        pthread_mutex_lock(&exporter->lock);
+        exporter->writing = 0u;
+        pthread_cond_broadcast(&exporter->changed);
+    }
+    pthread_mutex_unlock(&exporter->lock);
+    return NULL;
+}
+
+/*
+ *Start an exporter writing to the stream, whose header is written, with
+ *buffers of about the given number of bytes.
+ */
+void samples_start(SampleExporter* exporter, FILE* stream, int playersCount,
+        size_t length) {
+    memset(exporter, 0, sizeof(SampleExporter));
+    exporter->stream = stream;
+    exporter->recordLength = samples_record_length(playersCount);
+    exporter->length = MAX(length / exporter->recordLength, 1u)
+            * exporter->recordLength;
+    exporter->buffers[0] = (char*)malloc(exporter->length);
+    exporter->buffers[1] = (char*)malloc(exporter->length);
+
+    pthread_mutex_init(&exporter->lock, NULL);
+    pthread_cond_init(&exporter->changed, NULL);
+    exporter->threaded = 0 == pthread_create(&exporter->thread, NULL,
+            samples_thread, exporter);
+}
+
+/*
+ *Write the records left, end the thread and release the buffers.
+ *Returns 0 if not all records could be written.
+ */
+int samples_stop(SampleExporter* exporter) {
+    samples_hand_off(exporter);
+    if (exporter->threaded) {
+        pthread_mutex_lock(&exporter->lock);
+        exporter->stopping = 1;
+        pthread_cond_broadcast(&exporter->changed);
+        pthread_mutex_unlock(&exporter->lock);
+        pthread_join(exporter->thread, NULL);
+    }
+    pthread_cond_destroy(&exporter->changed);
+    pthread_mutex_destroy(&exporter->lock);
+    free(exporter->buffers[0]);
+    free(exporter->buffers[1]);
+    exporter->buffers[0] = NULL;
+    exporter->buffers[1] = NULL;
+    return !exporter->failed;
+}
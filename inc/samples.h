@@ -0,0 +1,174 @@
+/*
+ *samples.h
+ */
+
+#pragma once
+
+#ifndef __SAMPLES_H__
+#define __SAMPLES_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "../inc/protocol.h"
+
+/*
+ *First bytes of every samples file.
+ */
+#define SAMPLES_MAGIC "2310SMP"
+
+/*
+ *Version of the layout described below.
+ */
+#define SAMPLES_VERSION 1u
+
+/*
+ *Alignment of every record, so it can be read in place.
+ */
+#define SAMPLES_ALIGNMENT 8u
+
+/*
+ *Bytes of each of the two buffers of an exporter.
+ */
+#define SAMPLES_BUFFER_SIZE (1024u * 1024u)
+
+/*
+ *Start of a samples file, in the byte order of the program writing it.
+ *It is followed by records of recordLength bytes, one per decision of a
+ *player in a game played to its end.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t playersCount;
+    uint32_t recordLength;
+    uint32_t reserved;
+} SamplesHeader;
+
+/*
+ *Start of a record, followed by a SampleSeat per seat and padded up to
+ *SAMPLES_ALIGNMENT.
+ *game .. Number of the game within its run.
+ *move .. Moves made in the game before this one.
+ *id .. Player who decided.
+ *site .. Site the player moved to.
+ *outcome .. The player's final score less the best final score of the
+ *others, its own score if it played alone.
+ */
+typedef struct {
+    uint64_t game;
+    uint32_t move;
+    uint32_t id;
+    int32_t site;
+    int32_t outcome;
+} SampleRecord;
+
+/*
+ *A seat as it was when the player decided, cards[i] counting the cards of
+ *type CARD_A + i.
+ */
+typedef struct {
+    uint32_t position;
+    uint16_t ranking;
+    uint16_t cards[CARD_TYPES_COUNT];
+    int32_t money;
+} SampleSeat;
+
+/*
+ *The records of the game being played, kept until its outcome is known.
+ */
+typedef struct {
+    int playersCount;
+    size_t recordLength;
+    char* records;
+    size_t count;
+    size_t capacity;
+} SampleGame;
+
+/*
+ *Writes the records of ended games to the stream on a thread of its own:
+ *records are copied into one buffer while the other is written. If the
+ *thread can't be started they are written right away.
+ *Several exporters may share a stream, e.g. one per thread, each buffer
+ *holds whole records and is written at once.
+ *filled .. Bytes of the buffer at current filled so far.
+ *writing .. Bytes of the other buffer left to the thread, 0 once written.
+ *waits .. Times a full buffer had to wait for the other to be written.
+ *records .. Records written so far.
+ *failed .. Set once a buffer could not be written, which is cut off the
+ *file again. The records are dropped from then on.
+ */
+typedef struct {
+    FILE* stream;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int threaded;
+    size_t recordLength;
+    char* buffers[2];
+    size_t length;
+    int current;
+    size_t filled;
+    size_t writing;
+    int stopping;
+    unsigned long records;
+    unsigned long waits;
+    int failed;
+} SampleExporter;
+
+/*
+ *Bytes of a record of the given number of players.
+ */
+size_t samples_record_length(int playersCount);
+
+/*
+ *Write the header of a samples file of the given number of players.
+ *Returns non-zero if successful.
+ */
+int samples_write_header(FILE* stream, int playersCount);
+
+/*
+ *Set up the records of the games of the given number of players.
+ */
+void samples_game_init(SampleGame* game, int playersCount);
+
+/*
+ *Keep the decision of the given player, made in the given state of the
+ *game before the move is applied.
+ */
+void samples_game_add(SampleGame* game, uint64_t number, uint32_t move,
+        int id, int site, const int* positions, const int* rankings,
+        const Player* players);
+
+/*
+ *Drop the records of a game which did not end regularly.
+ */
+void samples_game_clear(SampleGame* game);
+
+/*
+ *Fill in the outcomes from the final earnings of all players, which are
+ *not altered, and hand the game's records to the exporter.
+ */
+void samples_game_end(SampleGame* game, SampleExporter* exporter,
+        const Player* players);
+
+/*
+ *Release the records of a game.
+ */
+void samples_game_free(SampleGame* game);
+
+/*
+ *Start an exporter writing to the stream, whose header is written, with
+ *buffers of about the given number of bytes.
+ */
+void samples_start(SampleExporter* exporter, FILE* stream, int playersCount,
+        size_t length);
+
+/*
+ *Write the records left, end the thread and release the buffers.
+ *Returns 0 if not all records could be written.
+ */
+int samples_stop(SampleExporter* exporter);
+
+#endif
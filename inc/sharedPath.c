@@ -0,0 +1,243 @@
+/*
+ *sharedPath.c
+ */
+
+/*
+ *memfd_create() and file sealing are GNU extensions.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "../inc/errorReturn.h"
+#include "../inc/protocol.h"
+#include "../inc/sharedPath.h"
+#include "../inc/pathWindow.h"
+#include "../inc/siteEffects.h"
+
+/*
+ *Tag at the start of a shared path, "PATH".
+ */
+#define SHARED_PATH_MAGIC 0x48544150u
+
+/*
+ *Seals guaranteeing that the shared path never changes.
+ */
+#define SHARED_PATH_SEALS \
+        (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL)
+
+/*
+ *Layout of the shared memory file: this header followed by the storage of
+ *the site columns and the capacity escapes.
+ */
+typedef struct {
+    unsigned int magic;
+    int playersCount;
+    size_t siteCount;
+    size_t escapeCount;
+} SharedPathHeader;
+
+/*
+ *Write the whole block to the file.
+ *Returns 0 if successful, -1 else.
+ */
+int write_block(int fd, const void* block, size_t length) {
+    return (ssize_t)length == write(fd, block, length) ? 0 : -1;
+}
+
+/*
+ *Publish the parsed sites of the path in a sealed, read-only memory file.
+ *Returns the inheritable file descriptor, or -1 if sharing is not possible.
+ */
+int shared_path_publish(const Path* path, int playersCount) {
+    SharedPathHeader header;
+    int fd = -1;
+
+    fd = memfd_create("2310path", MFD_ALLOW_SEALING);
+    if (-1 == fd) {
+        return -1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = SHARED_PATH_MAGIC;
+    header.playersCount = playersCount;
+    header.siteCount = path->siteCount;
+    header.escapeCount = path->escapeCount;
+    if (write_block(fd, &header, sizeof(header))
+            || write_block(fd, path->storage,
+                    path_storage_length(path->siteCount))
+            || write_block(fd, path->escapes,
+                    path->escapeCount * sizeof(SiteEscape))
+            || -1 == fcntl(fd, F_ADD_SEALS, SHARED_PATH_SEALS)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ *Check the sites of a mapped path like a received one.
+ */
+int verify_shared_path(const Path* path) {
+    size_t i = 0;
+
+    if (BARRIER != path_site_type(path, 0)
+            || BARRIER != path_site_type(path, path->siteCount - 1)) {
+        return E_INVALID_PATH;
+    }
+    for (i = 0; i < path->siteCount; i++) {
+        if (site_table()->count <= path->types[i]) {
+            return E_INVALID_PATH;
+        }
+    }
+    for (i = 0; i < path->escapeCount; i++) {
+        if (path->siteCount <= path->escapes[i].site) {
+            return E_INVALID_PATH;
+        }
+    }
+    return E_OK;
+}
+
+/*
+ *Read the header of the sealed path file and check it matches the game and
+ *the size of the file.
+ *Returns the length of the file, or -1 if it is not a valid shared path.
+ */
+off_t read_shared_header(int fd, int playersCount, SharedPathHeader* header) {
+    off_t length = 0;
+
+    /*Only a sealed file can't change underneath us*/
+    if (SHARED_PATH_SEALS != (fcntl(fd, F_GET_SEALS) & SHARED_PATH_SEALS)) {
+        return -1;
+    }
+    length = lseek(fd, 0, SEEK_END);
+    if ((ssize_t)sizeof(SharedPathHeader)
+            != pread(fd, header, sizeof(SharedPathHeader), 0)) {
+        return -1;
+    }
+    if (SHARED_PATH_MAGIC != header->magic
+            || playersCount != header->playersCount
+            || !header->siteCount
+            || (size_t)length != sizeof(SharedPathHeader)
+                    + path_storage_length(header->siteCount)
+                    + header->escapeCount * sizeof(SiteEscape)) {
+        return -1;
+    }
+    return length;
+}
+
+/*
+ *Map the path published at the given file descriptor read-only.
+ *Returns E_OK if successful, E_INVALID_PATH else.
+ */
+int shared_path_attach(int fd, int playersCount, Path* path) {
+    SharedPathHeader header;
+    unsigned char* mapping = NULL;
+    off_t length = 0;
+
+    length = read_shared_header(fd, playersCount, &header);
+    if (0 > length) {
+        return E_INVALID_PATH;
+    }
+    mapping = (unsigned char*)mmap(NULL, length, PROT_READ, MAP_SHARED, fd,
+            0);
+    if (MAP_FAILED == (void*)mapping) {
+        return E_INVALID_PATH;
+    }
+
+    player_reset_path(path);
+    path_use_storage(path, mapping + sizeof(SharedPathHeader),
+            header.siteCount);
+    path->escapes = (SiteEscape*)(mapping + sizeof(SharedPathHeader)
+            + path_storage_length(header.siteCount));
+    path->escapeCount = header.escapeCount;
+    path->mapping = mapping;
+    path->mappingLength = length;
+    if (E_OK != verify_shared_path(path)) {
+        player_free_path(path);
+        return E_INVALID_PATH;
+    }
+    return E_OK;
+}
+
+/*
+ *Attach to the path published at the given file descriptor, keeping only a
+ *window of chunks of the given number of sites in memory.
+ *Returns E_OK if successful, E_INVALID_PATH else.
+ */
+int shared_path_attach_window(int fd, int playersCount, size_t chunkSites,
+        Path* path) {
+    SharedPathHeader header;
+    SiteEscape* escapes = NULL;
+    size_t escapesLength = 0u;
+    int windowFd = -1;
+    size_t i = 0;
+
+    if (0 > read_shared_header(fd, playersCount, &header)) {
+        return E_INVALID_PATH;
+    }
+    escapesLength = header.escapeCount * sizeof(SiteEscape);
+    escapes = (SiteEscape*)malloc(MAX(escapesLength, 1u));
+    if ((ssize_t)escapesLength != pread(fd, escapes, escapesLength,
+            sizeof(SharedPathHeader)
+                    + path_storage_length(header.siteCount))) {
+        free(escapes);
+        return E_INVALID_PATH;
+    }
+    for (i = 0; i < header.escapeCount; i++) {
+        if (header.siteCount <= escapes[i].site) {
+            free(escapes);
+            return E_INVALID_PATH;
+        }
+    }
+
+    /*The window reads the sites on demand, long after fd is closed*/
+    windowFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    player_reset_path(path);
+    if (0 > windowFd || E_OK != path_window_open(path, windowFd,
+            sizeof(SharedPathHeader), header.siteCount, chunkSites)) {
+        free(escapes);
+        return E_INVALID_PATH;
+    }
+    path->escapes = escapes;
+    path->escapeCount = header.escapeCount;
+    return E_OK;
+}
+
+/*
+ *Attach to the path the dealer handed down in the environment, if any.
+ *The file descriptor is closed afterwards, it is used only once.
+ *A non-zero number of window sites keeps only a window of the path.
+ *Returns E_OK if successful, E_INVALID_PATH else.
+ */
+int shared_path_attach_inherited(int playersCount, size_t windowSites,
+        Path* path) {
+    const char* value = getenv(SHARED_PATH_VARIABLE);
+    char* end = NULL;
+    long fd = -1;
+    int success = E_INVALID_PATH;
+
+    if (!value) {
+        return E_INVALID_PATH;
+    }
+    fd = strtol(value, &end, 10);
+    unsetenv(SHARED_PATH_VARIABLE);
+    if (end == value || '\0' != *end || 0 > fd) {
+        return E_INVALID_PATH;
+    }
+
+    success = windowSites
+            ? shared_path_attach_window((int)fd, playersCount, windowSites,
+                    path)
+            : shared_path_attach((int)fd, playersCount, path);
+    close((int)fd);
+    return success;
+}
+
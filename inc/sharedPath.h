@@ -0,0 +1,48 @@
+/*
+ *sharedPath.h
+ */
+
+#pragma once
+
+#ifndef __SHARED_PATH_H__
+#define __SHARED_PATH_H__
+
+#include "../inc/protocol.h"
+
+/*
+ *Environment variable holding the file descriptor of the shared path, which
+ *players inherit from the dealer.
+ */
+#define SHARED_PATH_VARIABLE "PIPE_PATH_FD"
+
+/*
+ *Publish the parsed sites of the path in a sealed, read-only memory file.
+ *Returns the inheritable file descriptor, or -1 if sharing is not possible.
+ */
+int shared_path_publish(const Path* path, int playersCount);
+
+/*
+ *Map the path published at the given file descriptor read-only.
+ *Returns E_OK if successful, E_INVALID_PATH else.
+ */
+int shared_path_attach(int fd, int playersCount, Path* path);
+
+/*
+ *Attach to the path published at the given file descriptor, keeping only a
+ *window of chunks of the given number of sites in memory.
+ *Returns E_OK if successful, E_INVALID_PATH else.
+ */
+int shared_path_attach_window(int fd, int playersCount, size_t chunkSites,
+        Path* path);
+
+/*
+ *Attach to the path the dealer handed down in the environment, if any.
+ *The file descriptor is closed afterwards, it is used only once.
+ *A non-zero number of window sites keeps only a window of the path.
+ *Returns E_OK if successful, E_INVALID_PATH else.
+ */
+int shared_path_attach_inherited(int playersCount, size_t windowSites,
+        Path* path);
+
+#endif
+
@@ -0,0 +1,392 @@
+/*
+ *simulation.c
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../inc/protocol.h"
+#include "../inc/engine.h"
+#include "../inc/simulation.h"
+
+/*
+ *Milliseconds of a monotonic clock.
+ */
+double sim_now() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+/*
+ *Flag of the given coroutine telling whether it is queued for the next
+ *batch.
+ */
+int* sim_queued_flag(SimScheduler* scheduler, int coroutine) {
+    SimTable* table = scheduler->tables
+            + coroutine / (scheduler->playersCount + 1);
+    int seat = coroutine % (scheduler->playersCount + 1);
+
+    return scheduler->playersCount == seat ? &table->queued
+            : &table->seats[seat].queued;
+}
+
+/*
+ *Queue a coroutine for the next batch, unless it already is.
+ */
+void sim_wake(SimScheduler* scheduler, int coroutine, int* queued) {
+    if (!*queued) {
+        *queued = 1;
+        scheduler->next[scheduler->nextCount++] = coroutine;
+    }
+}
+
+/*
+ *Deliver a message to a seat of the given table.
+ */
+void sim_post(SimScheduler* scheduler, int tableIdx, int id,
+        const SimMessage* message) {
+    SimSeat* seat = scheduler->tables[tableIdx].seats + id;
+
+    seat->inbox[seat->inboxEnd++ % SIM_INBOX_LENGTH] = *message;
+    sim_wake(scheduler, tableIdx * (scheduler->playersCount + 1) + id,
+            &seat->queued);
+}
+
+/*
+ *Put a seat's view back to the start of a game.
+ */
+void sim_reset_seat(SimSeat* seat, int playersCount) {
+    int i = 0;
+
+    for (i = 0; i < playersCount; i++) {
+        dealer_reset_player(seat->players + i);
+    }
+    memset(seat->positions, 0, playersCount * sizeof(int));
+    dealer_init_rankings(seat->positions, seat->rankings, playersCount);
+}
+
+/*
+ *Choose the site to answer YT with, like the process player does, and
+ *book-keep the own move.
+ *Returns -1 if the player would not answer.
+ */
+int sim_seat_move(const SimTable* table, SimSeat* seat, int id) {
+    Game view;
+    int site = 0;
+    int usage = 0;
+
+    view.path = table->game.path;
+    view.playersCount = table->game.playersCount;
+    view.positions = seat->positions;
+    view.rankings = seat->rankings;
+    view.players = seat->players;
+
+    site = engine_choose_site(&view, id, seat->strategy);
+    if (-1 == site) {
+        return -1;
+    }
+    usage = (int)player_get_site_usage(seat->positions, view.playersCount,
+            site);
+    if (path_site_capacity(view.path, site) <= usage) {
+        /*The process player would wait for the dealer in vain*/
+        return -1;
+    }
+    seat->positions[id] = site;
+    seat->rankings[id] = usage;
+    return site;
+}
+
+/*
+ *Resume a seat with the messages received since it was suspended.
+ */
+void sim_resume_seat(SimScheduler* scheduler, int tableIdx, int id) {
+    SimTable* table = scheduler->tables + tableIdx;
+    SimSeat* seat = table->seats + id;
+    const SimMessage* message = NULL;
+    int playersCount = scheduler->playersCount;
+
+    while (seat->inboxStart != seat->inboxEnd) {
+        message = seat->inbox + seat->inboxStart++ % SIM_INBOX_LENGTH;
+        switch (message->type) {
+            case SIM_HAPPENED:
+                player_apply_move(message->id, message->site,
+                        message->pointDiff, message->moneyDiff,
+                        message->newCard, seat->positions, seat->rankings,
+                        playersCount, id, seat->players + id, seat->players,
+                        (Path*)table->game.path);
+                break;
+            case SIM_YOUR_TURN:
+                table->reply = sim_seat_move(table, seat, id);
+                sim_wake(scheduler,
+                        tableIdx * (playersCount + 1) + playersCount,
+                        &table->queued);
+                break;
+            case SIM_DONE:
+                sim_reset_seat(seat, playersCount);
+                break;
+        }
+    }
+}
+
+/*
+ *Apply the answer of the seat whose turn it was and let everybody know.
+ *Returns 0 if the answer is invalid.
+ */
+int sim_apply_reply(SimScheduler* scheduler, int tableIdx) {
+    SimTable* table = scheduler->tables + tableIdx;
+    Game* game = &table->game;
+    SimMessage message;
+    int i = 0;
+
+    if (!(0 <= table->reply && table->reply < (int)game->path->siteCount)) {
+        return 0;
+    }
+    if (scheduler->samples) {
+        samples_game_add(&table->pendingSamples, scheduler->firstGame
+                + table->firstGame + table->gamesPlayed, table->gameMoves,
+                table->turn, table->reply, game->positions, game->rankings,
+                game->players);
+    }
+    message.type = SIM_HAPPENED;
+    message.id = table->turn;
+    message.site = table->reply;
+    dealer_move_player(table->turn, table->reply, game->playersCount,
+            game->positions, game->rankings);
+    dealer_calculate_player_earnings(table->turn, table->reply,
+            &message.pointDiff, &message.moneyDiff, &message.newCard,
+            (Path*)game->path, game->players + table->turn, game->deck);
+    table->moves += 1;
+    table->gameMoves += 1u;
+
+    for (i = 0; i < game->playersCount; i++) {
+        sim_post(scheduler, tableIdx, i, &message);
+    }
+    return 1;
+}
+
+/*
+ *End the current game of a table and start the next one, if any.
+ */
+void sim_end_game(SimScheduler* scheduler, int tableIdx, int regular) {
+    SimTable* table = scheduler->tables + tableIdx;
+    SimMessage message;
+    double now = 0.0;
+    int i = 0;
+
+    memset(&message, 0, sizeof(SimMessage));
+    message.type = SIM_DONE;
+    for (i = 0; i < table->game.playersCount; i++) {
+        if (regular) {
+            table->scores[i] += engine_final_score(table->game.players + i);
+        }
+        sim_post(scheduler, tableIdx, i, &message);
+    }
+    if (scheduler->results) {
+        now = sim_now();
+        if (regular) {
+            results_writer_add(scheduler->results, scheduler->firstGame
+                    + table->firstGame + table->gamesPlayed,
+                    (uint64_t)((now - table->gameStart) * 1e3),
+                    table->gameMoves, table->game.players);
+        }
+        table->gameStart = now;
+    }
+    if (scheduler->samples && regular) {
+        samples_game_end(&table->pendingSamples, scheduler->samples,
+                table->game.players);
+    } else if (scheduler->samples) {
+        samples_game_clear(&table->pendingSamples);
+    }
+    table->gameMoves = 0u;
+    table->gamesPlayed += 1;
+    table->failed += !regular;
+
+    table->gamesLeft -= 1;
+    if (0 < table->gamesLeft) {
+        engine_reset_game(&table->game);
+    } else {
+        table->state = SIM_OVER;
+    }
+}
+
+/*
+ *Resume the dealer of a table: take the answer it waits for and give the
+ *next turn.
+ */
+void sim_resume_table(SimScheduler* scheduler, int tableIdx) {
+    SimTable* table = scheduler->tables + tableIdx;
+    Game* game = &table->game;
+    SimMessage message;
+
+    if (SIM_WAIT_MOVE == table->state) {
+        table->state = SIM_WAIT_TURN;
+        if (!sim_apply_reply(scheduler, tableIdx)) {
+            sim_end_game(scheduler, tableIdx, 0);
+        } else if (dealer_is_finished(game->playersCount,
+                game->path->siteCount, game->positions, game->rankings)) {
+            sim_end_game(scheduler, tableIdx, 1);
+        }
+    }
+    if (SIM_WAIT_TURN != table->state) {
+        return;
+    }
+
+    memset(&message, 0, sizeof(SimMessage));
+    message.type = SIM_YOUR_TURN;
+    table->turn = dealer_calculate_next_player(game->playersCount,
+            game->positions, game->rankings);
+    table->state = SIM_WAIT_MOVE;
+    sim_post(scheduler, tableIdx, table->turn, &message);
+}
+
+/*
+ *Set up the given number of tables, sharing the given number of games of
+ *the path and deck among them, with seats driven by the given strategies.
+ */
+void sim_init(SimScheduler* scheduler, int tablesCount, int gamesCount,
+        const Path* path, const Deck* deck, int playersCount,
+        const enum StrategyTypes* strategies) {
+    Arena* arena = &scheduler->arena;
+    SimTable* table = NULL;
+    SimSeat* seat = NULL;
+    int coroutines = tablesCount * (playersCount + 1);
+    unsigned long firstGame = 0u;
+    int i = 0;
+    int j = 0;
+
+    memset(scheduler, 0, sizeof(SimScheduler));
+    arena_init(arena, ARENA_BLOCK_SIZE);
+    scheduler->tablesCount = tablesCount;
+    scheduler->playersCount = playersCount;
+    scheduler->tables = (SimTable*)arena_calloc(arena, tablesCount,
+            sizeof(SimTable));
+    scheduler->ready = (int*)arena_alloc(arena, coroutines * sizeof(int));
+    scheduler->next = (int*)arena_alloc(arena, coroutines * sizeof(int));
+
+    for (i = 0; i < tablesCount; i++) {
+        table = scheduler->tables + i;
+        table->deck = *deck;
+        table->game.path = path;
+        table->game.playersCount = playersCount;
+        table->game.positions = (int*)arena_calloc(arena, playersCount,
+                sizeof(int));
+        table->game.rankings = (int*)arena_calloc(arena, playersCount,
+                sizeof(int));
+        table->game.players = (Player*)arena_calloc(arena, playersCount,
+                sizeof(Player));
+        table->game.deck = &table->deck;
+        table->firstGame = firstGame;
+        table->gamesLeft = gamesCount / tablesCount
+                + (i < gamesCount % tablesCount);
+        firstGame += table->gamesLeft;
+        table->scores = (long*)arena_calloc(arena, playersCount,
+                sizeof(long));
+        table->seats = (SimSeat*)arena_calloc(arena, playersCount,
+                sizeof(SimSeat));
+        engine_reset_game(&table->game);
+
+        for (j = 0; j < playersCount; j++) {
+            seat = table->seats + j;
+            seat->strategy = strategies[j];
+            seat->positions = (int*)arena_calloc(arena, playersCount,
+                    sizeof(int));
+            seat->rankings = (int*)arena_calloc(arena, playersCount,
+                    sizeof(int));
+            seat->players = (Player*)arena_calloc(arena, playersCount,
+                    sizeof(Player));
+            sim_reset_seat(seat, playersCount);
+        }
+
+        table->state = 0 < table->gamesLeft ? SIM_WAIT_TURN : SIM_OVER;
+        if (SIM_OVER != table->state) {
+            sim_wake(scheduler, i * (playersCount + 1) + playersCount,
+                    &table->queued);
+        }
+    }
+}
+
+/*
+ *Add the scores of the games played from now on to the results, numbering
+ *them from the given game on.
+ */
+void sim_keep_results(SimScheduler* scheduler, ResultsWriter* results,
+        unsigned long firstGame) {
+    double now = sim_now();
+    int i = 0;
+
+    scheduler->results = results;
+    scheduler->firstGame = firstGame;
+    for (i = 0; i < scheduler->tablesCount; i++) {
+        scheduler->tables[i].gameStart = now;
+    }
+}
+
+/*
+ *Hand the decisions of the games played from now on to the exporter,
+ *numbering the games from the given game on.
+ */
+void sim_keep_samples(SimScheduler* scheduler, SampleExporter* samples,
+        unsigned long firstGame) {
+    int i = 0;
+
+    scheduler->samples = samples;
+    scheduler->firstGame = firstGame;
+    for (i = 0; i < scheduler->tablesCount; i++) {
+        samples_game_init(&scheduler->tables[i].pendingSamples,
+                scheduler->playersCount);
+    }
+}
+
+/*
+ *Run the coroutines until every table has played its games.
+ */
+void sim_run(SimScheduler* scheduler) {
+    int* swap = NULL;
+    int coroutine = 0;
+    int i = 0;
+
+    while (scheduler->nextCount) {
+        swap = scheduler->ready;
+        scheduler->ready = scheduler->next;
+        scheduler->next = swap;
+        scheduler->readyCount = scheduler->nextCount;
+        scheduler->nextCount = 0;
+        scheduler->batches += 1;
+
+        /*Messages posted during this batch queue them again*/
+        for (i = 0; i < scheduler->readyCount; i++) {
+            *sim_queued_flag(scheduler, scheduler->ready[i]) = 0;
+        }
+        for (i = 0; i < scheduler->readyCount; i++) {
+            coroutine = scheduler->ready[i];
+            if (scheduler->playersCount
+                    == coroutine % (scheduler->playersCount + 1)) {
+                sim_resume_table(scheduler,
+                        coroutine / (scheduler->playersCount + 1));
+            } else {
+                sim_resume_seat(scheduler,
+                        coroutine / (scheduler->playersCount + 1),
+                        coroutine % (scheduler->playersCount + 1));
+            }
+        }
+        scheduler->resumes += scheduler->readyCount;
+    }
+    scheduler->readyCount = 0;
+}
+
+/*
+ *Free all the tables.
+ */
+void sim_free(SimScheduler* scheduler) {
+    int i = 0;
+
+    /*The records grow with the games, outside of the arena*/
+    for (i = 0; scheduler->samples && i < scheduler->tablesCount; i++) {
+        samples_game_free(&scheduler->tables[i].pendingSamples);
+    }
+    arena_free(&scheduler->arena);
+    memset(scheduler, 0, sizeof(SimScheduler));
+}
@@ -0,0 +1,167 @@
+/*
+ *simulation.h
+ */
+
+#pragma once
+
+#ifndef __SIMULATION_H__
+#define __SIMULATION_H__
+
+#include "../inc/protocol.h"
+#include "../inc/engine.h"
+#include "../inc/results.h"
+#include "../inc/samples.h"
+
+/*
+ *Messages a seat can have pending: the HAP of the last move, DONE and its
+ *next YT, received before the seat is resumed again.
+ */
+#define SIM_INBOX_LENGTH 4u
+
+/*
+ *In-process counterparts of the messages from the dealer to a player.
+ *The answer to YT is handed to the dealer directly.
+ */
+enum SimMessageTypes {
+    SIM_YOUR_TURN, SIM_HAPPENED, SIM_DONE
+};
+
+/*
+ *A message, only the fields of its type are set.
+ *id, site .. Player and target site of HAP.
+ *pointDiff, moneyDiff, newCard .. Earnings of HAP.
+ */
+typedef struct {
+    enum SimMessageTypes type;
+    int id;
+    int site;
+    int pointDiff;
+    int moneyDiff;
+    int newCard;
+} SimMessage;
+
+/*
+ *States a coroutine is suspended in.
+ *SIM_WAIT_TURN .. The dealer is about to give the next turn, a seat waits
+ *for its messages.
+ *SIM_WAIT_MOVE .. The dealer waits for the answer to YT.
+ *SIM_OVER .. All games have been played.
+ */
+enum SimStates {
+    SIM_WAIT_TURN, SIM_WAIT_MOVE, SIM_OVER
+};
+
+/*
+ *A simulated player: the state its command loop keeps between two
+ *messages, which the process player keeps on its stack and in globals.
+ *positions, rankings, players .. Its own view of the game, updated from
+ *HAP like the process player does.
+ */
+typedef struct {
+    enum StrategyTypes strategy;
+    enum SimStates state;
+    int queued;
+    int* positions;
+    int* rankings;
+    Player* players;
+    SimMessage inbox[SIM_INBOX_LENGTH];
+    unsigned int inboxStart;
+    unsigned int inboxEnd;
+} SimSeat;
+
+/*
+ *A simulated dealer with its seats, playing a number of games in a row.
+ *game .. The dealer's state of the current game, with its own position in
+ *the shared deck.
+ *reply .. Site the seat whose turn it is has answered.
+ *scores .. Final scores of every seat summed over the games played.
+ *firstGame .. Number of the table's first game among the scheduler's.
+ *gameStart, gameMoves .. Time the current game started at and the moves
+ *made in it, kept if the results are.
+ *pendingSamples .. Decisions made in the current game so far, if they are
+ *recorded.
+ */
+typedef struct {
+    Game game;
+    Deck deck;
+    SimSeat* seats;
+    enum SimStates state;
+    int queued;
+    int turn;
+    int reply;
+    int gamesLeft;
+    int gamesPlayed;
+    int failed;
+    unsigned long moves;
+    long* scores;
+    unsigned long firstGame;
+    double gameStart;
+    unsigned int gameMoves;
+    SampleGame pendingSamples;
+} SimTable;
+
+/*
+ *Interleaves the coroutines of many tables on one thread.
+ *Coroutines which have received messages are resumed in batches: all the
+ *ones made ready by the previous batch together, as they are in the ready
+ *list.
+ *ready, next .. Lists of coroutines to resume in this and the next batch,
+ *encoded as table * (playersCount + 1) + seat, the dealer taking the seat
+ *playersCount.
+ *arena .. Memory of all the tables, nothing is allocated while they play.
+ *results .. Writer the scores of the games played to their end are added
+ *to, NULL if they are not kept.
+ *samples .. Exporter the decisions of the games played to their end are
+ *handed to, NULL if they are not recorded.
+ *firstGame .. Number of the scheduler's first game among all of the run.
+ */
+typedef struct {
+    Arena arena;
+    SimTable* tables;
+    int tablesCount;
+    int playersCount;
+    int* ready;
+    int* next;
+    int readyCount;
+    int nextCount;
+    unsigned long resumes;
+    unsigned long batches;
+    ResultsWriter* results;
+    SampleExporter* samples;
+    unsigned long firstGame;
+} SimScheduler;
+
+/*
+ *Set up the given number of tables, sharing the given number of games of
+ *the path and deck among them, with seats driven by the given strategies.
+ */
+void sim_init(SimScheduler* scheduler, int tablesCount, int gamesCount,
+        const Path* path, const Deck* deck, int playersCount,
+        const enum StrategyTypes* strategies);
+
+/*
+ *Add the scores of the games played from now on to the results, numbering
+ *them from the given game on.
+ */
+void sim_keep_results(SimScheduler* scheduler, ResultsWriter* results,
+        unsigned long firstGame);
+
+/*
+ *Hand the decisions of the games played from now on to the exporter,
+ *numbering the games from the given game on.
+ */
+void sim_keep_samples(SimScheduler* scheduler, SampleExporter* samples,
+        unsigned long firstGame);
+
+/*
+ *Run the coroutines until every table has played its games.
+ */
+void sim_run(SimScheduler* scheduler);
+
+/*
+ *Free all the tables.
+ */
+void sim_free(SimScheduler* scheduler);
+
+#endif
+
@@ -0,0 +1,196 @@
+/*
+ *siteEffects.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../inc/errorReturn.h"
+#include "../inc/protocol.h"
+#include "../inc/siteEffects.h"
+
+/*
+ *Longest line of a site table file.
+ */
+#define SITE_TABLE_LINE_LENGTH 256
+
+/*
+ *The rules of the game as specified: see enum SiteTypes.
+ */
+static const SiteTable builtinTable = {
+    SITE_TYPES_COUNT,
+    {
+        { "Mo", 3, 0, 0, 0, 0, 0, 1, 0 },
+        { "V1", 0, 0, 1, 0, 0, 0, 1, 0 },
+        { "V2", 0, 0, 0, 1, 0, 0, 1, 0 },
+        { "Do", 0, 2, 0, 0, 0, 0, 2, -1 },
+        { "Ri", 0, 0, 0, 0, 1, 0, 1, 0 },
+        { "::", 0, 0, 0, 0, 0, 1, 1, 0 },
+        { "__", 0, 0, 0, 0, 0, 0, 1, 0 }
+    }
+};
+
+/*
+ *The last table loaded.
+ */
+static SiteTable loadedTable;
+
+/*
+ *The table dealer and players evaluate moves with.
+ */
+static const SiteTable* activeTable = &builtinTable;
+
+/*
+ *Go back to the built-in site effects.
+ */
+void site_table_reset(void) {
+    activeTable = &builtinTable;
+}
+
+/*
+ *Find the type of the given name in the table.
+ *Returns -1 if there is none.
+ */
+int find_site_type(const SiteTable* table, const char* name) {
+    int type = 0;
+
+    for (type = 0; type < table->count; type++) {
+        if (name[0] == table->effects[type].name[0]
+                && name[1] == table->effects[type].name[1]) {
+            return type;
+        }
+    }
+    return -1;
+}
+
+/*
+ *Parse one line of a site table into the effect.
+ *Returns 0 for a comment or blank line, 1 for an effect, -1 if it is
+ *invalid.
+ */
+int parse_site_effect(const char* line, SiteEffect* effect) {
+    int fields = 0;
+
+    memset(effect, 0, sizeof(SiteEffect));
+    if ('#' == line[0]) {
+        return 0;
+    }
+    fields = sscanf(line, "%2s %d %d %d %d %d %d", effect->name,
+            &effect->money, &effect->convert, &effect->v1, &effect->v2,
+            &effect->cards, &effect->blocking);
+    if (EOF == fields) {
+        return 0;
+    }
+    if (7 != fields || 2 != strlen(effect->name) || 0 > effect->convert
+            || 0 > effect->v1 || 0 > effect->v2
+            || !(0 == effect->cards || 1 == effect->cards)
+            || !(0 == effect->blocking || 1 == effect->blocking)) {
+        return -1;
+    }
+    return 1;
+}
+
+/*
+ *Load the site table from stream, one type per line:
+ *name money convert v1 v2 cards blocking
+ *Lines starting with # are comments. Built-in names redefine the type,
+ *other names add one. The barrier always blocks.
+ *Returns E_OK if the table is valid, E_INVALID_PATH else, which keeps the
+ *current table.
+ */
+int site_table_load(FILE* stream) {
+    char line[SITE_TABLE_LINE_LENGTH];
+    SiteTable table;
+    SiteEffect effect;
+    int success = 0;
+    int type = 0;
+
+    memcpy(&table, &builtinTable, sizeof(SiteTable));
+    while (fgets(line, sizeof(line), stream)) {
+        success = parse_site_effect(line, &effect);
+        if (-1 == success) {
+            return E_INVALID_PATH;
+        } else if (0 == success) {
+            continue;
+        }
+
+        type = find_site_type(&table, effect.name);
+        if (-1 == type && MAX_SITE_TYPES <= table.count) {
+            return E_INVALID_PATH;
+        } else if (-1 == type) {
+            type = table.count++;
+        }
+        effect.blocking |= BARRIER == type;
+        /*Compile the conversion, so it needs no branch*/
+        effect.divisor = MAX(effect.convert, 1);
+        effect.convertMask = -(0 != effect.convert);
+        table.effects[type] = effect;
+    }
+
+    memcpy(&loadedTable, &table, sizeof(SiteTable));
+    activeTable = &loadedTable;
+    return E_OK;
+}
+
+/*
+ *Load the site table the dealer handed down in the environment, if any.
+ *Returns E_OK if there is none or it is valid, E_INVALID_PATH else.
+ */
+int site_table_load_inherited(void) {
+    const char* name = getenv(SITE_TABLE_VARIABLE);
+    FILE* stream = NULL;
+    int success = E_OK;
+
+    if (!name) {
+        return E_OK;
+    }
+    stream = fopen(name, "r");
+    if (!stream) {
+        return E_INVALID_PATH;
+    }
+    success = site_table_load(stream);
+    fclose(stream);
+    return success;
+}
+
+/*
+ *The site table in use.
+ */
+const SiteTable* site_table(void) {
+    return activeTable;
+}
+
+/*
+ *Effect of visiting a site of the given type.
+ *Types the table does not describe have no effect.
+ */
+const SiteEffect* site_effect(enum SiteTypes type) {
+    return activeTable->effects
+            + ((int)type < activeTable->count ? type : UNKNOWN_SITE_TYPE);
+}
+
+/*
+ *Apply an effect to a player, drawing from the deck if it hands out a card.
+ *Evaluated without branching on the effect: the conversion and the card
+ *are masked out if the effect has none.
+ */
+void site_apply_effect(const SiteEffect* effect, Player* player, Deck* deck,
+        int* pointDiff, int* moneyDiff, int* newCard) {
+    int drawn = effect->cards;
+    int card = (*deck->nextCard - ('A' - 1)) & -drawn;
+    char* next = deck->nextCard + drawn;
+
+    *pointDiff = player->money / effect->divisor & effect->convertMask;
+    *moneyDiff = effect->money - (player->money & effect->convertMask);
+    *newCard = card;
+    player->points += *pointDiff;
+    player->money += *moneyDiff;
+    player->v1 += effect->v1;
+    player->v2 += effect->v2;
+    player->overallCards += drawn;
+    player->cards[card] += drawn;
+
+    /*Wrap around if we ran out of cards*/
+    deck->nextCard = next < deck->buffer + deck->size ? next : deck->buffer;
+}
@@ -0,0 +1,97 @@
+/*
+ *siteEffects.h
+ */
+
+#pragma once
+
+#ifndef __SITE_EFFECTS_H__
+#define __SITE_EFFECTS_H__
+
+#include <stdio.h>
+
+#include "../inc/protocol.h"
+
+/*
+ *Environment variable holding the file of the site table, which players
+ *load like the dealer did.
+ */
+#define SITE_TABLE_VARIABLE "PIPE_SITE_TABLE"
+
+/*
+ *Most site types a table can describe, the built-in ones included.
+ */
+#define MAX_SITE_TYPES 16
+
+/*
+ *What visiting a site of a type does to the player.
+ *name .. Two letters naming the type in the path.
+ *money .. Money gained.
+ *convert .. Money per point, if all money held is converted to points
+ *before the gain, 0 else.
+ *v1, v2 .. Visits counted as V1 and V2.
+ *cards .. Cards drawn, 0 or 1.
+ *blocking .. Whether players have to stop there like at a barrier.
+ *divisor, convertMask .. Compiled from convert: the divisor is at least 1,
+ *the mask has all bits set if money is converted.
+ */
+typedef struct {
+    char name[3];
+    int money;
+    int convert;
+    int v1;
+    int v2;
+    int cards;
+    int blocking;
+    int divisor;
+    int convertMask;
+} SiteEffect;
+
+/*
+ *Effects of all site types, indexed by type. The built-in types keep their
+ *enumeration values, further types follow UNKNOWN_SITE_TYPE.
+ */
+typedef struct {
+    int count;
+    SiteEffect effects[MAX_SITE_TYPES];
+} SiteTable;
+
+/*
+ *Go back to the built-in site effects.
+ */
+void site_table_reset(void);
+
+/*
+ *Load the site table from stream, one type per line:
+ *name money convert v1 v2 cards blocking
+ *Lines starting with # are comments. Built-in names redefine the type,
+ *other names add one. The barrier always blocks.
+ *Returns E_OK if the table is valid, E_INVALID_PATH else, which keeps the
+ *current table.
+ */
+int site_table_load(FILE* stream);
+
+/*
+ *Load the site table the dealer handed down in the environment, if any.
+ *Returns E_OK if there is none or it is valid, E_INVALID_PATH else.
+ */
+int site_table_load_inherited(void);
+
+/*
+ *The site table in use.
+ */
+const SiteTable* site_table(void);
+
+/*
+ *Effect of visiting a site of the given type.
+ */
+const SiteEffect* site_effect(enum SiteTypes type);
+
+/*
+ *Apply an effect to a player, drawing from the deck if it hands out a card.
+ *Evaluated without branching on the effect.
+ */
+void site_apply_effect(const SiteEffect* effect, Player* player, Deck* deck,
+        int* pointDiff, int* moneyDiff, int* newCard);
+
+#endif
+
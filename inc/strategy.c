@@ -0,0 +1,461 @@
+/*
+ *strategy.c
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../inc/protocol.h"
+#include "../inc/strategy.h"
+
+/*
+ *Update whether the site has room for another player.
+ */
+void index_mark_site(StrategyIndex* index, const Path* path, size_t site) {
+    uint64_t bit = (uint64_t)1u << (site % 64u);
+
+    if ((int)index->usage[site] < path_site_capacity(path, site)) {
+        index->roomy[site / 64u] |= bit;
+    } else {
+        index->roomy[site / 64u] &= ~bit;
+    }
+}
+
+/*
+ *Number of other players on the given site.
+ */
+unsigned int index_other_usage(const StrategyIndex* index, size_t site) {
+    return index->usage[site]
+            - ((size_t)index->positions[index->ownId] == site);
+}
+
+/*
+ *Set up the index of a game which starts with all players at the start of
+ *the path, taking its memory from the arena. It takes two bytes and a bit
+ *per site.
+ */
+void strategy_index_init(StrategyIndex* index, const Path* path,
+        int playersCount, int ownId, Arena* arena) {
+    size_t site = 0u;
+
+    memset(index, 0, sizeof(StrategyIndex));
+    index->playersCount = playersCount;
+    index->ownId = ownId;
+    index->siteCount = path->siteCount;
+    index->bitmapWords = (path->siteCount + 63u) / 64u;
+    index->positions = (int*)arena_calloc(arena, playersCount, sizeof(int));
+    index->usage = (unsigned short*)arena_calloc(arena, path->siteCount,
+            sizeof(unsigned short));
+    index->roomy = (uint64_t*)arena_calloc(arena, index->bitmapWords,
+            sizeof(uint64_t));
+    index->usage[0] = (unsigned short)playersCount;
+    for (site = 0u; site < path->siteCount; site++) {
+        index_mark_site(index, path, site);
+    }
+    index->rearmostOther = 1 < playersCount ? 0u : path->siteCount;
+}
+
+/*
+ *Tell the index the player's position and earnings have been updated,
+ *e.g. for a move it has made.
+ */
+void strategy_index_update(StrategyIndex* index, const Path* path, int id,
+        int position, const Player* player) {
+    size_t from = (size_t)index->positions[id];
+    size_t to = (size_t)position;
+
+    if (index->ownId != id) {
+        /*Cards are only ever added*/
+        index->maxOtherCards = MAX(index->maxOtherCards,
+                player->overallCards);
+    }
+    if (from == to) {
+        return;
+    }
+    index->positions[id] = position;
+    index->usage[from] -= 1u;
+    index->usage[to] += 1u;
+    index_mark_site(index, path, from);
+    index_mark_site(index, path, to);
+
+    if (index->ownId != id && to < index->rearmostOther) {
+        index->rearmostOther = to;
+    }
+    /*Players only move forward, this passes every site once per game*/
+    while (index->rearmostOther < index->siteCount
+            && !index_other_usage(index, index->rearmostOther)) {
+        index->rearmostOther += 1u;
+    }
+}
+
+/*
+ *Find the first site after the given one, which has room for another
+ *player. Scans the bitmap a word of 64 sites at a time.
+ *Returns -1 if there is none.
+ */
+unsigned int index_find_roomy_site(const StrategyIndex* index, int after) {
+    size_t site = (size_t)(after + 1);
+    size_t word = site / 64u;
+    uint64_t bits = 0u;
+
+    if (index->siteCount <= site) {
+        return -1u;
+    }
+    bits = index->roomy[word] & (~(uint64_t)0u << (site % 64u));
+    while (!bits) {
+        word += 1u;
+        if (index->bitmapWords <= word) {
+            return -1u;
+        }
+        bits = index->roomy[word];
+    }
+    return (unsigned int)(word * 64u + __builtin_ctzll(bits));
+}
+
+/*
+ *Number of players on the given site.
+ */
+unsigned int strategy_site_usage(const StrategyView* view, int siteIdx) {
+    if (view->index) {
+        return view->index->usage[siteIdx];
+    }
+    return player_get_site_usage(view->positions, view->playersCount,
+            siteIdx);
+}
+
+/*
+ *Check if the given site, limited to the barrier, has room for this player.
+ *Returns the site if it has, -1 else.
+ */
+int strategy_try_site(const StrategyView* view, unsigned int siteToGo,
+        unsigned int barrierAhead) {
+    int siteIdx = (int)MIN(siteToGo, barrierAhead);
+    unsigned int siteUsage = 0;
+
+    siteUsage = strategy_site_usage(view, siteIdx);
+    if (path_site_capacity(view->path, siteIdx) <= (int)siteUsage) {
+        /*This site is full*/
+        return -1;
+    }
+    return siteIdx;
+}
+
+/*
+ *Name of a strategy rule, e.g. A-Do.
+ */
+const char* strategy_rule_name(enum StrategyRules rule) {
+    static const char* names[STRATEGY_RULES_COUNT] = {
+        "A-Do", "A-Mo", "A-Stop", "A-Barrier", "B-Last", "B-OddMoney",
+        "B-DrawCard", "B-V2", "B-NextFree", "B-Barrier"
+    };
+
+    return names[rule];
+}
+
+/*
+ *Determine the target of the next move according to player A's strategy.
+ *We start at the given current position not taking the site's capacity into
+ *account. The rule deciding it is stored in rule.
+ *ignoreMo: As this function might be called repeatedly, rule #2 only applies
+ *in the first iteration.
+ */
+unsigned int a_calculate_move_to(const StrategyView* view,
+        unsigned int ownPosition, int ignoreMo, enum StrategyRules* rule) {
+    const Path* path = view->path;
+    int doSiteAhead = -1;
+    unsigned int v1SiteAhead = -1u;
+    unsigned int v2SiteAhead = -1u;
+    unsigned int barrierAhead = -1u;
+    unsigned int siteToGo = -1u;
+
+    /*Rule #1: Go to next Do if you have money*/
+    if (0 < view->players[view->ownId].money) {
+        doSiteAhead = player_find_x_site_ahead(DO, ownPosition, path);
+        if (-1 != doSiteAhead) {
+            siteToGo = doSiteAhead;
+            *rule = RULE_A_DO;
+        }
+    }
+
+    /*Rule #2: Go to the next site if it is Mo.*/
+    if (-1u == siteToGo && !ignoreMo) {
+        if (MO == path_site_type(path, ownPosition + 1)) {
+            siteToGo = ownPosition + 1;
+            *rule = RULE_A_MO;
+        }
+    }
+
+    /*Rule #3: Stop at the closest V1, V2 or barrier site.*/
+    if (-1u == siteToGo) {
+        v1SiteAhead = (unsigned int)player_find_x_site_ahead(V1, ownPosition,
+                path);
+        v2SiteAhead = (unsigned int)player_find_x_site_ahead(V2, ownPosition,
+                path);
+        barrierAhead = (unsigned int)player_find_x_site_ahead(BARRIER,
+                ownPosition, path);
+        siteToGo = MIN(v1SiteAhead, v2SiteAhead);
+        siteToGo = MIN(siteToGo, barrierAhead);
+        *rule = RULE_A_STOP;
+    }
+
+    return siteToGo;
+}
+
+/*
+ *Choose the next site according to the rules of player type A and tell the
+ *rule, which has chosen it.
+ *The returned site is limited to the next barrier and has room for this
+ *player. Returns -1 if there is no move to make.
+ */
+int strategy_a_explain_site(const StrategyView* view,
+        enum StrategyRules* rule) {
+    unsigned int barrierAhead = -1u;
+    unsigned int siteToGo = -1u;
+    int ownPosition = view->positions[view->ownId];
+    int siteIdx = -1;
+    int ignoreMo = 0;
+
+    /*Rule #0: Don't move beyond the end of the path.*/
+    if ((int)view->path->siteCount <= ownPosition + 1) {
+        return -1;
+    }
+
+    /*Rule #0.1: Always stop at a barrier*/
+    barrierAhead = (unsigned int)player_find_x_site_ahead(BARRIER,
+            ownPosition, view->path);
+
+    do {
+        siteToGo = a_calculate_move_to(view, ownPosition, ignoreMo, rule);
+        ignoreMo = 1;
+        if (-1u != siteToGo) {
+            siteIdx = strategy_try_site(view, siteToGo, barrierAhead);
+        }
+        ownPosition = siteToGo;
+    } while (-1 == siteIdx && -1u != siteToGo);
+
+    if (-1 != siteIdx && (unsigned int)siteIdx < siteToGo) {
+        *rule = RULE_A_BARRIER;
+    }
+    return siteIdx;
+}
+
+/*
+ *Choose the next site according to the rules of player type A.
+ *The returned site is limited to the next barrier and has room for this
+ *player. Returns -1 if there is no move to make.
+ */
+int strategy_a_choose_site(const StrategyView* view) {
+    enum StrategyRules rule = RULE_A_STOP;
+
+    return strategy_a_explain_site(view, &rule);
+}
+
+/*
+ *Determine the next site according to this rule and return it.
+ *Rule: If the next site is not full and all other players are on later sites
+ *than us, move forward one site.
+ */
+unsigned int rule_we_are_last(const StrategyView* view, int ownPosition) {
+    int i = 0;
+    int siteUsage = 0;
+
+    siteUsage = strategy_site_usage(view, ownPosition + 1);
+
+    if (siteUsage < path_site_capacity(view->path, ownPosition + 1)) {
+        if (0 == view->rankings[view->ownId]) {
+            if (view->index) {
+                return view->index->rearmostOther > (size_t)ownPosition
+                        ? ownPosition + 1 : -1u;
+            }
+            for (i = 0; i < view->playersCount; i++) {
+                if (ownPosition >= view->positions[i] && view->ownId != i) {
+                    return -1u;
+                }
+            }
+            return ownPosition + 1;
+        }
+    }
+    return -1u;
+}
+
+/*
+ *Determine the next site according to this rule and return it.
+ *Rule: If we have an odd amount of money, and there is a Mo between us and the
+ *next barrier, then go there.
+ */
+unsigned int rule_odd_money(const StrategyView* view,
+        unsigned int barrierAhead, int ownPosition) {
+    unsigned int moSiteAhead = -1u;
+
+    if (1 == (view->players[view->ownId].money % 2)) {
+        moSiteAhead = (unsigned int)player_find_x_site_ahead(MO, ownPosition,
+                view->path);
+        if (moSiteAhead < barrierAhead) {
+            return moSiteAhead;
+        }
+    }
+    return -1u;
+}
+
+/*
+ *Count the cards of all the other players.
+ */
+int get_max_collected_cards(const StrategyView* view) {
+    int i = 0;
+    int maxCards = 0;
+
+    if (view->index) {
+        return view->index->maxOtherCards;
+    }
+    for (i = 0; i < view->playersCount; i++) {
+        if (view->ownId != i) {
+            maxCards = MAX(maxCards, view->players[i].overallCards);
+        }
+    }
+    return maxCards;
+}
+
+/*
+ *Determine the next site according to this rule and return it.
+ *Rule: If we have the most cards or if everyone has zero cards and there is a
+ *Ri between us and the next barrier, then go there.
+ */
+unsigned int rule_draw_card(const StrategyView* view,
+        unsigned int barrierAhead, int ownPosition) {
+    const Player* thisPlayer = view->players + view->ownId;
+    unsigned int riSiteAhead = -1u;
+    int maxCards = 0;
+
+    riSiteAhead = (unsigned int)player_find_x_site_ahead(RI, ownPosition,
+            view->path);
+    if (riSiteAhead < barrierAhead) {
+        maxCards = get_max_collected_cards(view);
+        if (thisPlayer->overallCards > maxCards
+                || MAX(thisPlayer->overallCards, maxCards) == 0) {
+            return riSiteAhead;
+        }
+    }
+    return -1u;
+}
+
+/*
+ *Determine the next site according to this rule and return it.
+ *Rule: If there is a V2 between us and the next barrier, then go there.
+ */
+unsigned int rule_goto_v2(const StrategyView* view, unsigned int barrierAhead,
+        int ownPosition) {
+    unsigned int v2SiteAhead = -1u;
+
+    v2SiteAhead = (unsigned int)player_find_x_site_ahead(V2, ownPosition,
+            view->path);
+    if (v2SiteAhead < barrierAhead) {
+        return v2SiteAhead;
+    }
+    return -1u;
+}
+
+/*
+ *Determine the next site according to this rule and return it.
+ *Rule: Move forward to the earliest site which has room.
+ */
+unsigned int rule_next_free(const StrategyView* view, int ownPosition) {
+    unsigned int i = 0;
+    int siteUsage = 0;
+
+    if (view->index) {
+        return index_find_roomy_site(view->index, ownPosition);
+    }
+    for (i = ownPosition + 1; i < view->path->siteCount; i++) {
+        siteUsage = player_get_site_usage(view->positions,
+                view->playersCount, i);
+        if (siteUsage < path_site_capacity(view->path, i)) {
+            return i;
+        }
+    }
+    return -1u;
+}
+
+/*
+ *Determine the target of the next move according to player B's strategy.
+ *We start at the given current position not taking the site's capacity into
+ *account. The rule deciding it is stored in rule.
+ */
+unsigned int b_calculate_move_to(const StrategyView* view,
+        unsigned int ownPosition, unsigned int barrierAhead,
+        enum StrategyRules* rule) {
+    unsigned int siteToGo = -1u;
+
+    siteToGo = rule_we_are_last(view, ownPosition);
+    *rule = RULE_B_LAST;
+
+    if (-1u == siteToGo) {
+        siteToGo = rule_odd_money(view, barrierAhead, ownPosition);
+        *rule = RULE_B_ODD_MONEY;
+    }
+
+    if (-1u == siteToGo) {
+        siteToGo = rule_draw_card(view, barrierAhead, ownPosition);
+        *rule = RULE_B_DRAW_CARD;
+    }
+
+    if (-1u == siteToGo) {
+        siteToGo = rule_goto_v2(view, barrierAhead, ownPosition);
+        *rule = RULE_B_V2;
+    }
+
+    if (-1u == siteToGo) {
+        siteToGo = rule_next_free(view, ownPosition);
+        *rule = RULE_B_NEXT_FREE;
+    }
+
+    return siteToGo;
+}
+
+/*
+ *Choose the next site according to the rules of player type B and tell the
+ *rule, which has chosen it.
+ *The returned site is limited to the next barrier and has room for this
+ *player. Returns -1 if there is no move to make.
+ */
+int strategy_b_explain_site(const StrategyView* view,
+        enum StrategyRules* rule) {
+    unsigned int barrierAhead = -1u;
+    unsigned int siteToGo = -1u;
+    int ownPosition = view->positions[view->ownId];
+    int siteIdx = -1;
+
+    /*Rule #0: Don't move beyond the end of the path.*/
+    if ((int)view->path->siteCount <= ownPosition + 1) {
+        return -1;
+    }
+
+    /*Rule #0.1: Always stop at a barrier*/
+    barrierAhead = (unsigned int)player_find_x_site_ahead(BARRIER,
+            ownPosition, view->path);
+
+    do {
+        siteToGo = b_calculate_move_to(view, ownPosition, barrierAhead,
+                rule);
+        if (-1u != siteToGo) {
+            siteIdx = strategy_try_site(view, siteToGo, barrierAhead);
+        }
+        ownPosition = siteToGo;
+    } while (-1 == siteIdx && -1u != siteToGo);
+
+    if (-1 != siteIdx && (unsigned int)siteIdx < siteToGo) {
+        *rule = RULE_B_BARRIER;
+    }
+    return siteIdx;
+}
+
+/*
+ *Choose the next site according to the rules of player type B.
+ *The returned site is limited to the next barrier and has room for this
+ *player. Returns -1 if there is no move to make.
+ */
+int strategy_b_choose_site(const StrategyView* view) {
+    enum StrategyRules rule = RULE_B_NEXT_FREE;
+
+    return strategy_b_explain_site(view, &rule);
+}
+
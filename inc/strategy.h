@@ -0,0 +1,109 @@
+/*
+ *strategy.h
+ */
+
+#pragma once
+
+#ifndef __STRATEGY_H__
+#define __STRATEGY_H__
+
+#include "../inc/protocol.h"
+
+/*
+ *Facts of the game kept up to date move by move, so a strategy does not
+ *have to scan all players and sites for them.
+ *positions .. The positions the index has last been told of.
+ *usage .. Number of players on each site.
+ *roomy .. Bitmap of the sites which have room for another player.
+ *rearmostOther .. Site of the rearmost other player, siteCount if there
+ *is none.
+ *maxOtherCards .. Most cards any other player has collected.
+ */
+typedef struct {
+    int playersCount;
+    int ownId;
+    size_t siteCount;
+    int* positions;
+    unsigned short* usage;
+    uint64_t* roomy;
+    size_t bitmapWords;
+    size_t rearmostOther;
+    int maxOtherCards;
+} StrategyIndex;
+
+/*
+ *Read-only view of the game a strategy bases its decision on.
+ *index .. Facts kept up to date with the view, NULL to find them in the
+ *view itself.
+ */
+typedef struct {
+    const Path* path;
+    int playersCount;
+    int ownId;
+    const int* positions;
+    const int* rankings;
+    const Player* players;
+    const StrategyIndex* index;
+} StrategyView;
+
+/*
+ *Rules a strategy chooses its next site by.
+ *RULE_A_BARRIER, RULE_B_BARRIER .. The site chosen by another rule lies
+ *behind the next barrier, which is taken instead.
+ */
+enum StrategyRules {
+    RULE_A_DO, RULE_A_MO, RULE_A_STOP, RULE_A_BARRIER,
+    RULE_B_LAST, RULE_B_ODD_MONEY, RULE_B_DRAW_CARD, RULE_B_V2,
+    RULE_B_NEXT_FREE, RULE_B_BARRIER, STRATEGY_RULES_COUNT
+};
+
+/*
+ *Set up the index of a game which starts with all players at the start of
+ *the path, taking its memory from the arena. It takes two bytes and a bit
+ *per site.
+ */
+void strategy_index_init(StrategyIndex* index, const Path* path,
+        int playersCount, int ownId, Arena* arena);
+
+/*
+ *Tell the index the player's position and earnings have been updated,
+ *e.g. for a move it has made.
+ */
+void strategy_index_update(StrategyIndex* index, const Path* path, int id,
+        int position, const Player* player);
+
+/*
+ *Name of a strategy rule, e.g. A-Do.
+ */
+const char* strategy_rule_name(enum StrategyRules rule);
+
+/*
+ *Choose the next site according to the rules of player type A.
+ *The returned site is limited to the next barrier and has room for this
+ *player. Returns -1 if there is no move to make.
+ */
+int strategy_a_choose_site(const StrategyView* view);
+
+/*
+ *Choose the next site like strategy_a_choose_site() and tell the rule,
+ *which has chosen it.
+ */
+int strategy_a_explain_site(const StrategyView* view,
+        enum StrategyRules* rule);
+
+/*
+ *Choose the next site according to the rules of player type B.
+ *The returned site is limited to the next barrier and has room for this
+ *player. Returns -1 if there is no move to make.
+ */
+int strategy_b_choose_site(const StrategyView* view);
+
+/*
+ *Choose the next site like strategy_b_choose_site() and tell the rule,
+ *which has chosen it.
+ */
+int strategy_b_explain_site(const StrategyView* view,
+        enum StrategyRules* rule);
+
+#endif
+
@@ -0,0 +1,285 @@
+/*
+ *workload.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+
+#include "../inc/protocol.h"
+#include "../inc/engine.h"
+#include "../inc/workload.h"
+
+/*
+ *Most sites of a path, so its text length still fits the int the players
+ *calculate it in.
+ */
+#define WORKLOAD_MAX_SITES 500000000u
+/*
+ *Number of slots of the table a site type is looked up in, the type
+ *weights are resolved to 1/TYPE_SLOTS.
+ */
+#define TYPE_SLOTS 4096u
+/*
+ *Number of random bits indexing the type table.
+ */
+#define TYPE_SLOT_BITS 12
+/*
+ *Bytes generated before they are handed to the output stream.
+ */
+#define WORKLOAD_CHUNK_SIZE 65536u
+
+/*
+ *Set a path workload to its defaults: sites of all types equally likely,
+ *capacities 1 to 4, barriers every 2 to 8 sites.
+ */
+void workload_default_path(PathWorkload* workload, size_t siteCount) {
+    int i = 0;
+
+    memset(workload, 0, sizeof(PathWorkload));
+    workload->siteCount = siteCount;
+    for (i = 0; i < BARRIER; i++) {
+        workload->weights[i] = 1u;
+    }
+    workload->minGap = 2u;
+    workload->maxGap = 8u;
+    workload->minCapacity = 1;
+    workload->maxCapacity = 4;
+}
+
+/*
+ *Set a deck workload to its defaults: all cards equally often.
+ */
+void workload_default_deck(DeckWorkload* workload, size_t cardCount) {
+    size_t i = 0;
+
+    memset(workload, 0, sizeof(DeckWorkload));
+    workload->cardCount = cardCount;
+    for (i = 0; i < CARD_TYPES_COUNT; i++) {
+        workload->weights[i] = 1u;
+    }
+}
+
+/*
+ *Sum up the given weights.
+ */
+uint64_t sum_weights(const unsigned int* weights, size_t count) {
+    uint64_t total = 0u;
+    size_t i = 0;
+
+    for (i = 0; i < count; i++) {
+        total += weights[i];
+    }
+    return total;
+}
+
+/*
+ *Check if the workload describes a path player_read_path() accepts.
+ */
+int workload_valid_path(const PathWorkload* workload) {
+    return 2u <= workload->siteCount
+            && WORKLOAD_MAX_SITES >= workload->siteCount
+            && workload->minGap <= workload->maxGap
+            && 1 <= workload->minCapacity
+            && workload->minCapacity <= workload->maxCapacity
+            && WORKLOAD_MAX_CAPACITY >= workload->maxCapacity
+            && (0u < sum_weights(workload->weights, BARRIER)
+                    || 0u == workload->maxGap);
+}
+
+/*
+ *Check if the workload describes a deck dealer_init_deck() accepts.
+ */
+int workload_valid_deck(const DeckWorkload* workload) {
+    return 1u <= workload->cardCount
+            && 0u < sum_weights(workload->weights, CARD_TYPES_COUNT);
+}
+
+/*
+ *Fill the table a random number is resolved to a site type with, each
+ *type taking slots in proportion to its weight.
+ */
+void build_type_table(const unsigned int* weights, unsigned char* table) {
+    uint64_t total = sum_weights(weights, BARRIER);
+    uint64_t reached = 0u;
+    uint64_t target = 0u;
+    int type = 0;
+    unsigned int slot = 0u;
+
+    reached = weights[0];
+    for (slot = 0u; slot < TYPE_SLOTS; slot++) {
+        /*The middle of the slot decides*/
+        target = (2u * slot + 1u) * total / (2u * TYPE_SLOTS);
+        while (reached <= target && BARRIER - 1 > type) {
+            type += 1;
+            reached += weights[type];
+        }
+        table[slot] = (unsigned char)type;
+    }
+}
+
+/*
+ *Draw a number from 0 to bound - 1.
+ */
+uint64_t draw_below(unsigned int* seed, uint64_t bound) {
+    uint64_t wide = 0u;
+
+    if (UINT32_MAX >= bound) {
+        return ((uint64_t)engine_random(seed) * bound) >> 32;
+    }
+    wide = (uint64_t)engine_random(seed) << 32;
+    wide |= engine_random(seed);
+    return wide % bound;
+}
+
+/*
+ *Draw the number of sites up to the next barrier.
+ */
+size_t draw_gap(const PathWorkload* workload, unsigned int* seed) {
+    return workload->minGap + (size_t)draw_below(seed,
+            workload->maxGap - workload->minGap + 1u);
+}
+
+/*
+ *Hand the generated bytes to the output.
+ *Returns -1 if writing failed, 0 else.
+ */
+int write_chunk(FILE* output, const char* chunk, size_t length) {
+    return length == fwrite(chunk, 1u, length, output) ? 0 : -1;
+}
+
+/*
+ *Write the path file of the given workload.
+ *The same workload and seed always produce the same file.
+ *Unusual long function: the hot loop is kept in one piece.
+ *Returns -1 if writing failed, 0 else.
+ */
+int workload_write_path(FILE* output, const PathWorkload* workload) {
+    unsigned char types[TYPE_SLOTS];
+    const char* name = NULL;
+    unsigned int seed = workload->seed;
+    unsigned int capacities = 0u;
+    unsigned int number = 0u;
+    size_t gap = 0u;
+    size_t site = 0u;
+    size_t length = 0u;
+    char* chunk = NULL;
+    int success = 0;
+
+    build_type_table(workload->weights, types);
+    capacities = (unsigned int)(workload->maxCapacity
+            - workload->minCapacity + 1);
+    chunk = (char*)malloc(WORKLOAD_CHUNK_SIZE + 8u);
+
+    length = sprintf(chunk, "%zu;::-", workload->siteCount);
+    gap = draw_gap(workload, &seed);
+    for (site = 1u; site + 1u < workload->siteCount && !success; site++) {
+        if (!gap) {
+            memcpy(chunk + length, "::-", 3u);
+            gap = draw_gap(workload, &seed);
+        } else {
+            number = engine_random(&seed);
+            name = convert_site_name(
+                    (enum SiteTypes)types[number >> (32 - TYPE_SLOT_BITS)]);
+            chunk[length] = name[0];
+            chunk[length + 1] = name[1];
+            chunk[length + 2] = (char)('0' + workload->minCapacity
+                    + number % capacities);
+            gap -= 1u;
+        }
+        length += 3u;
+
+        if (WORKLOAD_CHUNK_SIZE <= length) {
+            success = write_chunk(output, chunk, length);
+            length = 0u;
+        }
+    }
+    memcpy(chunk + length, "::-\n", 4u);
+    length += 4u;
+    if (!success) {
+        success = write_chunk(output, chunk, length);
+    }
+
+    free(chunk);
+    return success;
+}
+
+/*
+ *Number of each card in a deck of the workload: proportional to the
+ *weights, the cards left over by rounding down go to the largest
+ *remainders.
+ */
+void count_cards(const DeckWorkload* workload, size_t* counts) {
+    uint64_t total = sum_weights(workload->weights, CARD_TYPES_COUNT);
+    uint64_t remainders[CARD_TYPES_COUNT];
+    size_t assigned = 0u;
+    size_t largest = 0u;
+    size_t i = 0;
+
+    for (i = 0; i < CARD_TYPES_COUNT; i++) {
+        /*Split up the product, it may not fit 64 bits*/
+        counts[i] = (size_t)(workload->cardCount / total
+                * workload->weights[i] + workload->cardCount % total
+                * workload->weights[i] / total);
+        remainders[i] = workload->cardCount % total * workload->weights[i]
+                % total;
+        assigned += counts[i];
+    }
+    while (assigned < workload->cardCount) {
+        largest = 0u;
+        for (i = 1; i < CARD_TYPES_COUNT; i++) {
+            if (remainders[i] > remainders[largest]) {
+                largest = i;
+            }
+        }
+        counts[largest] += 1u;
+        remainders[largest] = 0u;
+        assigned += 1u;
+    }
+}
+
+/*
+ *Write the deck file of the given workload.
+ *The same workload and seed always produce the same file.
+ *Returns -1 if writing failed, 0 else.
+ */
+int workload_write_deck(FILE* output, const DeckWorkload* workload) {
+    size_t counts[CARD_TYPES_COUNT];
+    unsigned int seed = workload->seed;
+    char* cards = NULL;
+    size_t length = 0u;
+    size_t i = 0;
+    size_t other = 0u;
+    char card = '\0';
+    int success = 0;
+
+    count_cards(workload, counts);
+    cards = (char*)malloc(workload->cardCount);
+    for (i = 0; i < CARD_TYPES_COUNT; i++) {
+        memset(cards + length, 'A' + (int)i, counts[i]);
+        length += counts[i];
+    }
+
+    /*Fisher-Yates shuffle*/
+    for (i = workload->cardCount - 1u; 0u < i; i--) {
+        other = (size_t)draw_below(&seed, i + 1u);
+        card = cards[i];
+        cards[i] = cards[other];
+        cards[other] = card;
+    }
+
+    success = 0 > fprintf(output, "%zu", workload->cardCount) ? -1 : 0;
+    for (i = 0; i < workload->cardCount && !success;
+            i += WORKLOAD_CHUNK_SIZE) {
+        success = write_chunk(output, cards + i,
+                MIN(WORKLOAD_CHUNK_SIZE, workload->cardCount - i));
+    }
+    if (!success && EOF == fputc('\n', output)) {
+        success = -1;
+    }
+
+    free(cards);
+    return success;
+}
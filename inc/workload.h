@@ -0,0 +1,83 @@
+/*
+ *workload.h
+ */
+
+#pragma once
+
+#ifndef __WORKLOAD_H__
+#define __WORKLOAD_H__
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "../inc/protocol.h"
+
+/*
+ *Highest capacity a site of a path file can have, it is a single digit.
+ */
+#define WORKLOAD_MAX_CAPACITY 9
+
+/*
+ *Shape of a synthetic path.
+ *weights .. Relative frequency of each site type except BARRIER.
+ *minGap, maxGap .. Range of the number of sites between two barriers.
+ *minCapacity, maxCapacity .. Range of the capacity of the other sites.
+ */
+typedef struct {
+    size_t siteCount;
+    unsigned int weights[BARRIER];
+    size_t minGap;
+    size_t maxGap;
+    int minCapacity;
+    int maxCapacity;
+    unsigned int seed;
+} PathWorkload;
+
+/*
+ *Shape of a synthetic deck.
+ *weights .. Relative frequency of each card, the deck holds the cards in
+ *exactly these proportions (rounded) in shuffled order.
+ */
+typedef struct {
+    size_t cardCount;
+    unsigned int weights[CARD_TYPES_COUNT];
+    unsigned int seed;
+} DeckWorkload;
+
+/*
+ *Set a path workload to its defaults: sites of all types equally likely,
+ *capacities 1 to 4, barriers every 2 to 8 sites.
+ */
+void workload_default_path(PathWorkload* workload, size_t siteCount);
+
+/*
+ *Set a deck workload to its defaults: all cards equally often.
+ */
+void workload_default_deck(DeckWorkload* workload, size_t cardCount);
+
+/*
+ *Check if the workload describes a path player_read_path() accepts.
+ */
+int workload_valid_path(const PathWorkload* workload);
+
+/*
+ *Check if the workload describes a deck dealer_init_deck() accepts.
+ */
+int workload_valid_deck(const DeckWorkload* workload);
+
+/*
+ *Write the path file of the given workload.
+ *The same workload and seed always produce the same file.
+ *Returns -1 if writing failed, 0 else.
+ */
+int workload_write_path(FILE* output, const PathWorkload* workload);
+
+/*
+ *Write the deck file of the given workload.
+ *The same workload and seed always produce the same file.
+ *Returns -1 if writing failed, 0 else.
+ */
+int workload_write_deck(FILE* output, const DeckWorkload* workload);
+
+#endif
+
@@ -4,11 +4,30 @@
 #include <ctype.h>
 #include "../inc/errorReturn.h"
 #include "../inc/protocol.h"
+#include "../inc/sharedPath.h"
+#include "../inc/handoff.h"
+#include "../inc/siteEffects.h"
+#include "../inc/pathWindow.h"
+#include "../inc/strategy.h"
 
 /*
  *The path retrieved from the dealer;
  */
 Path path;
+/*
+ *Stream of the dealer's messages, stdin unless the turns are handed over
+ *in shared memory.
+ */
+FILE* commands;
+/*
+ *Stream the moves are sent to, stdout unless the turns are handed over in
+ *shared memory.
+ */
+FILE* moves;
+/*
+ *Turn slot shared with the dealer, if it offers one.
+ */
+HandoffPlayer handoff;
 /*
  *All players' positions.
  */
@@ -17,6 +36,16 @@ int* playerPositions;
  *The ranking is relevant if there are multiple players on the same site.
  */
 int* playerRankings;
+/*
+ *Memory of the current game: the path, positions and the scratch of every
+ *move.
+ */
+Arena gameArena;
+/*
+ *Position in the arena right after the path, a game of the session playing
+ *the same path again starts there.
+ */
+ArenaMark pathMark;
 
 /*
  *This player's ID.
@@ -36,109 +65,62 @@ Player* players;
  *Initialize the global field representing all players' positions.
  */
 void init_player_positions(int playersCount) {
-    playerPositions = malloc(playersCount * sizeof(int));
-    playerRankings = malloc(playersCount * sizeof(int));
-    memset(playerPositions, 0, playersCount * sizeof(int));
-    memset(playerRankings, 0, playersCount * sizeof(int));
+    playerPositions = (int*)arena_calloc(&gameArena, playersCount,
+            sizeof(int));
+    playerRankings = (int*)arena_calloc(&gameArena, playersCount,
+            sizeof(int));
 }
 
 /*
  *Request the path information from the dealer.
  */
 void get_path(int playersCount) {
+    size_t windowSites = path_window_sites();
     int success = E_OK;
 
+    /*The dealer's shared path spares parsing it*/
+    if (E_OK == shared_path_attach_inherited(playersCount, windowSites,
+            &path)) {
+        player_confirm_shared_path(stdout);
+        path.arena = &gameArena;
+        return;
+    }
+
     player_request_path(stdout);
-    success = player_read_path(stdin, playersCount, &path);
+    path.arena = windowSites ? NULL : &gameArena;
+    success = windowSites
+            ? path_window_read(commands, playersCount, windowSites, &path)
+            : player_read_path(commands, playersCount, &path);
     if(E_OK != success) {
         error_return(stderr, success);
     }
-}
-
-/*
- *Determine the target of the next move according to the player's strategy.
- *We start at the given current position not taking the site's capacity into
- *account.
- *ignoreMo: As this function might be called repeatedly, rule #2 only applies
- *in the first iteration.
- */
-unsigned int calculate_move_to(int playersCount, unsigned int ownPosition,
-        int ignoreMo) {
-    int doSiteAhead = -1;
-    unsigned int v1SiteAhead = -1u;
-    unsigned int v2SiteAhead = -1u;
-    unsigned int barrierAhead = -1u;
-    unsigned int siteToGo = -1u;
-
-    /*Rule #1: Go to next Do if you have money*/
-    if (0 < thisPlayer->money) {
-        doSiteAhead = player_find_x_site_ahead(DO, ownPosition, &path);
-        if (-1 != doSiteAhead) {
-            siteToGo = doSiteAhead;
-        }
-    }
-
-    /*Rule #2: Go to the next site if it is Mo.*/
-    if (-1u == siteToGo && !ignoreMo) {
-        if (MO == path.sites[ownPosition + 1].type) {
-            siteToGo = ownPosition + 1;
-            /*BTW, money balance is adapted upon receiving the dealer's
-             * broadcast.*/
-        }
-    }
-
-    /*Rule #3: Stop at the closest V1, V2 or barrier site.*/
-    if (-1u == siteToGo) {
-        v1SiteAhead = (unsigned int)player_find_x_site_ahead(V1, ownPosition,
-                &path);
-        v2SiteAhead = (unsigned int)player_find_x_site_ahead(V2, ownPosition,
-                &path);
-        barrierAhead = (unsigned int)player_find_x_site_ahead(BARRIER,
-                ownPosition, &path);
-        siteToGo = MIN(v1SiteAhead, v2SiteAhead);
-        siteToGo = MIN(siteToGo, barrierAhead);
-    }
-
-    return siteToGo;
+    /*Only the parsed sites are needed for playing*/
+    player_drop_path_text(&path);
+    /*A windowed path still prints the board with the arena's scratch*/
+    path.arena = &gameArena;
 }
 
 /*
  *Calculate the next move and send it.
  */
 void make_move(int playersCount) {
-    unsigned int barrierAhead = -1u;
-    unsigned int siteToGo = -1u;
-    int ownPosition = playerPositions[ownId];
-    int moved = 0;
-    int ignoreMo = 0;
-
-    /*Rule #0: Don't move beyond the end of the path.*/
-    if (path.siteCount <= ownPosition + 1) {
-        return;
-    }
+    StrategyView view;
+    int siteToGo = -1;
 
-    /*Rule #0.1: Always stop at a barrier*/
-    barrierAhead = (unsigned int)player_find_x_site_ahead(BARRIER, ownPosition,
-            &path);
+    view.path = &path;
+    view.playersCount = playersCount;
+    view.ownId = ownId;
+    view.positions = playerPositions;
+    view.rankings = playerRankings;
+    view.players = players;
+    view.index = NULL;
 
-    do {
-        siteToGo = calculate_move_to(playersCount, ownPosition, ignoreMo);
-        ignoreMo = 1;
-        /*fprintf(stderr, "Positions: %2d %2d %2d \n",*/
-                /*playerPositions[0],*/
-                /*playerPositions[1],*/
-                /*playerPositions[2]*/
-               /*);*/
-        if (-1u != siteToGo) {
-            /*Make sure to not move beyond the end of the path*/
-            moved = player_forward_to(stdout, siteToGo, barrierAhead,
-                    playersCount, playerPositions, playerRankings, ownId,
-                    &path);
-        }
-        ownPosition = siteToGo;
-    } while (!moved && (-1 != siteToGo));
-
-    return;
+    siteToGo = strategy_a_choose_site(&view);
+    if (-1 != siteToGo) {
+        /*The chosen site is already limited to the next barrier*/
+        player_forward_to(moves, siteToGo, siteToGo, playersCount,
+                playerPositions, playerRankings, ownId, &path);
+    }
 }
 
 /*
@@ -161,26 +143,68 @@ int process_command(const char* command, int playersCount) {
 }
 
 /*
- *Game play loop.
+ *Wait for the dealer to start another game of the session and set it up.
+ *Returns 0 if the session is over.
+ */
+int next_game(int* playersCount) {
+    char command[100];
+    int withPath = 0;
+    int i = 0;
+
+    if (!fgets(command, sizeof(command), commands)) {
+        return 0;
+    }
+    if (E_OK != player_parse_new_game(command, playersCount, &ownId,
+            &withPath)) {
+        player_free_path(&path);
+        error_return(stderr, E_COMMS_ERROR);
+    }
+
+    thisPlayer = &(players[ownId]);
+    for (i = 0; i < MAX_PLAYERS; i++) {
+        dealer_reset_player(&(players[i]));
+    }
+
+    /*Without a new path the last one is played again*/
+    if (withPath) {
+        player_free_path(&path);
+        player_reset_path(&path);
+        arena_reset(&gameArena);
+        get_path(*playersCount);
+        pathMark = arena_mark(&gameArena);
+    } else {
+        arena_release(&gameArena, pathMark);
+    }
+    init_player_positions(*playersCount);
+    return 1;
+}
+
+/*
+ *Game play loop, repeated for every game of a session.
  */
 void run_game(int playersCount) {
     char command[100];
     int run = 1;
 
     get_path(playersCount);
+    pathMark = arena_mark(&gameArena);
+    init_player_positions(playersCount);
 
-    player_print_path(stderr, &path, playersCount, path.siteCount,
-            playerPositions, playerRankings, 1);
+    do {
+        player_print_path(stderr, &path, playersCount, path.siteCount,
+                playerPositions, playerRankings, 1);
 
-    while (run) {
-        if (!fgets(command, sizeof(command), stdin)) {
-            player_free_path(&path);
-            error_return(stderr, E_COMMS_ERROR);
+        run = 1;
+        while (run) {
+            if (!fgets(command, sizeof(command), commands)) {
+                player_free_path(&path);
+                error_return(stderr, E_COMMS_ERROR);
+            }
+            run = process_command(command, playersCount);
         }
-        run = process_command(command, playersCount);
-    }
 
-    player_print_scores(stderr, playersCount, players);
+        player_print_scores(stderr, playersCount, players);
+    } while (player_in_session() && next_game(&playersCount));
 }
 
 int main(int argc, char* argv[]) {
@@ -214,6 +238,11 @@ int main(int argc, char* argv[]) {
     if (playersCount <= playerID) {
         error_return(stderr, E_INVALID_PLAYER_ID);
     }
+
+    /*Site types as the dealer has them*/
+    if (E_OK != site_table_load_inherited()) {
+        error_return(stderr, E_INVALID_PATH);
+    }
     ownId = playerID;
     players = malloc(MAX_PLAYERS * sizeof(Player));
     thisPlayer = &(players[ownId]);
@@ -221,13 +250,28 @@ int main(int argc, char* argv[]) {
         dealer_reset_player(&(players[i]));
     }
 
-    init_player_positions(playersCount);
+    /*Turns handed over in shared memory spare the pipes' wakeups*/
+    commands = stdin;
+    moves = stdout;
+    if (E_OK == handoff_attach_inherited(&handoff)) {
+        commands = handoff_open_input(&handoff);
+        moves = handoff_open_moves(&handoff);
+        if (!commands || !moves) {
+            error_return(stderr, E_COMMS_ERROR);
+        }
+    }
 
+    arena_init(&gameArena, ARENA_BLOCK_SIZE);
     run_game(playersCount);
 
     free(players);
-    free(playerPositions);
-    free(playerRankings);
+    player_free_path(&path);
+    arena_free(&gameArena);
+    if (stdin != commands) {
+        fclose(commands);
+        fclose(moves);
+        handoff_detach(&handoff);
+    }
 
     return EXIT_SUCCESS;
 }
@@ -4,251 +4,155 @@
 #include <ctype.h>
 #include "../inc/errorReturn.h"
 #include "../inc/protocol.h"
+#include "../inc/sharedPath.h"
+#include "../inc/handoff.h"
+#include "../inc/siteEffects.h"
+#include "../inc/pathWindow.h"
+#include "../inc/strategy.h"
 
 /*
  *The path retrieved from the dealer;
  */
 Path path;
 /*
- *All players' positions.
+ *Stream of the dealer's messages, stdin unless the turns are handed over
+ *in shared memory.
  */
-int* playerPositions;
+FILE* commands;
 /*
- *The ranking is relevant if there are multiple players on the same site.
+ *Stream the moves are sent to, stdout unless the turns are handed over in
+ *shared memory.
  */
-int* playerRankings;
-
+FILE* moves;
 /*
- *This player's ID.
+ *Turn slot shared with the dealer, if it offers one.
  */
-int ownId;
-
+HandoffPlayer handoff;
 /*
- *This player's earnings.
+ *All players' positions.
  */
-Player* thisPlayer;
-
+int* playerPositions;
 /*
- *Book-keeping representation of participating players.
+ *The ranking is relevant if there are multiple players on the same site.
  */
-Player* players;
-
-
+int* playerRankings;
 /*
- *Initialize the global field representing all players' positions.
+ *Facts the rules need, kept up to date with every move. A windowed path
+ *keeps the memory per site small, so they are looked up in the positions
+ *instead.
  */
-void init_player_positions(int playersCount) {
-    playerPositions = malloc(playersCount * sizeof(int));
-    playerRankings = malloc(playersCount * sizeof(int));
-    memset(playerPositions, 0, playersCount * sizeof(int));
-    memset(playerRankings, 0, playersCount * sizeof(int));
-}
-
+StrategyIndex strategyIndex;
 /*
- *Request the path information from the dealer.
+ *Memory of the current game: the path, positions and the scratch of every
+ *move.
  */
-void get_path(int playersCount) {
-    int success = E_OK;
-
-    player_request_path(stdout);
-    success = player_read_path(stdin, playersCount, &path);
-    if(E_OK != success) {
-        error_return(stderr, success);
-    }
-}
-
+Arena gameArena;
 /*
- *Determine the next site according to this rule and return it.
- *Rule: If the next site is not full and all other players are on later sites
- *than us, move forward one site.
+ *Position in the arena right after the path, a game of the session playing
+ *the same path again starts there.
  */
-unsigned int rule_we_are_last(int playersCount, int ownPosition) {
-    int i = 0;
-    int siteUsage = 0;
-
-    siteUsage = player_get_site_usage(playerPositions, playersCount,
-            ownPosition + 1);
-
-    if (siteUsage < path.sites[ownPosition + 1].capacity) {
-        if (0 == playerRankings[ownId]) {
-            for (i = 0; i < playersCount; i++) {
-                if (ownPosition >= playerPositions[i] && ownId != i) {
-                    return -1u;
-                }
-            }
-            return ownPosition + 1;
-        }
-    }
-    return -1u;
-}
+ArenaMark pathMark;
 
 /*
- *Determine the next site according to this rule and return it.
- *Rule: If we have an odd amount of money, and there is a Mo between us and the
- *next barrier, then go there.
+ *This player's ID.
  */
-unsigned int rule_odd_money(int playersCount, unsigned int barrierAhead,
-        int ownPosition) {
-    unsigned int moSiteAhead = -1u;
-
-    if (1 == (thisPlayer->money % 2)) {
-        moSiteAhead = (unsigned int)player_find_x_site_ahead(MO, ownPosition,
-                &path);
-        if (moSiteAhead < barrierAhead) {
-            return moSiteAhead;
-        }
-    }
-    return -1u;
-}
+int ownId;
 
 /*
- *Count the cards of all the other players.
+ *This player's earnings.
  */
-int get_max_collected_cards(int playersCount) {
-    int i = 0;
-    int maxCards = 0;
-
-    for (i = 0; i < playersCount; i++) {
-        if (ownId != i) {
-            maxCards = MAX(maxCards, players[i].overallCards);
-        }
-    }
-    return maxCards;
-}
+Player* thisPlayer;
 
 /*
- *Determine the next site according to this rule and return it.
- *Rule: If we have the most cards or if everyone has zero cards and there is a
- *Ri between us and the next barrier, then go there.
+ *Book-keeping representation of participating players.
  */
-unsigned int rule_draw_card(int playersCount, unsigned int barrierAhead,
-        int ownPosition) {
-    unsigned int riSiteAhead = -1u;
-    int maxCards = 0;
-
-    riSiteAhead = (unsigned int)player_find_x_site_ahead(RI, ownPosition,
-            &path);
-    if (riSiteAhead < barrierAhead) {
-        maxCards = get_max_collected_cards(playersCount);
-        if (thisPlayer->overallCards > maxCards
-                || MAX(thisPlayer->overallCards, maxCards) == 0) {
-            return riSiteAhead;
-        }
-    }
-    return -1u;
-}
+Player* players;
+
 
 /*
- *Determine the next site according to this rule and return it.
- *Rule: If there is a V2 between us and the next barrier, then go there.
+ *Initialize the global field representing all players' positions, and
+ *the index of the facts the rules need.
  */
-unsigned int rule_goto_v2(int playersCount, unsigned int barrierAhead,
-        int ownPosition) {
-    unsigned int v2SiteAhead = -1u;
-
-    v2SiteAhead = (unsigned int)player_find_x_site_ahead(V2, ownPosition,
-            &path);
-    if (v2SiteAhead < barrierAhead) {
-        return v2SiteAhead;
+void init_player_positions(int playersCount) {
+    playerPositions = (int*)arena_calloc(&gameArena, playersCount,
+            sizeof(int));
+    playerRankings = (int*)arena_calloc(&gameArena, playersCount,
+            sizeof(int));
+    if (!path.window) {
+        strategy_index_init(&strategyIndex, &path, playersCount, ownId,
+                &gameArena);
     }
-    return -1u;
 }
 
-
 /*
- *Determine the next site according to this rule and return it.
- *Rule: Move forward to the earliest site which has room.
+ *Tell the index about the player's new position and earnings.
  */
-unsigned int rule_next_free(int playersCount, int ownPosition) {
-    unsigned int i = 0;
-    int siteUsage = 0;
-
-    for (i = ownPosition + 1; i < path.siteCount; i++) {
-        siteUsage = player_get_site_usage(playerPositions, playersCount, i);
-        if (siteUsage < path.sites[i].capacity) {
-            return i;
-        }
+void update_index(int id) {
+    if (!path.window) {
+        strategy_index_update(&strategyIndex, &path, id, playerPositions[id],
+                players + id);
     }
-    return -1u;
 }
 
 /*
- *Determine the target of the next move according to the player's strategy.
- *We start at the given current position not taking the site's capacity into
- *account.
+ *Request the path information from the dealer.
  */
-unsigned int calculate_move_to(int playersCount, unsigned int ownPosition,
-        unsigned int barrierAhead) {
-    unsigned int siteToGo = -1u;
-
-    siteToGo = rule_we_are_last(playersCount, ownPosition);
-    /*fprintf(stderr, "Chose %d", siteToGo);*/
-
-    if (-1u == siteToGo) {
-        siteToGo = rule_odd_money(playersCount, barrierAhead, ownPosition);
-        /*fprintf(stderr, " 2->%d", siteToGo);*/
-    }
-
-    if (-1u == siteToGo) {
-        siteToGo = rule_draw_card(playersCount, barrierAhead, ownPosition);
-        /*fprintf(stderr, " 3->%d", siteToGo);*/
-    }
+void get_path(int playersCount) {
+    size_t windowSites = path_window_sites();
+    int success = E_OK;
 
-    if (-1u == siteToGo) {
-        siteToGo = rule_goto_v2(playersCount, barrierAhead, ownPosition);
-        /*fprintf(stderr, " 4->%d", siteToGo);*/
+    /*The dealer's shared path spares parsing it*/
+    if (E_OK == shared_path_attach_inherited(playersCount, windowSites,
+            &path)) {
+        player_confirm_shared_path(stdout);
+        path.arena = &gameArena;
+        return;
     }
 
-    if (-1u == siteToGo) {
-        siteToGo = rule_next_free(playersCount, ownPosition);
-        /*fprintf(stderr, " 5->%d", siteToGo);*/
+    player_request_path(stdout);
+    path.arena = windowSites ? NULL : &gameArena;
+    success = windowSites
+            ? path_window_read(commands, playersCount, windowSites, &path)
+            : player_read_path(commands, playersCount, &path);
+    if(E_OK != success) {
+        error_return(stderr, success);
     }
-
-    /*fprintf(stderr, " finally %d\n", siteToGo);*/
-    return siteToGo;
+    /*Only the parsed sites are needed for playing*/
+    player_drop_path_text(&path);
+    /*A windowed path still prints the board with the arena's scratch*/
+    path.arena = &gameArena;
 }
 
 /*
  *Calculate the next move and send it.
  */
 void make_move(int playersCount) {
-    unsigned int barrierAhead = -1u;
-    unsigned int siteToGo = -1u;
-    int ownPosition = playerPositions[ownId];
-    int moved = 0;
-
-    /*Rule #0: Don't move beyond the end of the path.*/
-    if (path.siteCount <= ownPosition + 1) {
-        return;
+    StrategyView view;
+    int siteToGo = -1;
+
+    view.path = &path;
+    view.playersCount = playersCount;
+    view.ownId = ownId;
+    view.positions = playerPositions;
+    view.rankings = playerRankings;
+    view.players = players;
+    view.index = path.window ? NULL : &strategyIndex;
+
+    siteToGo = strategy_b_choose_site(&view);
+    if (-1 != siteToGo) {
+        /*The chosen site is already limited to the next barrier*/
+        player_forward_to(moves, siteToGo, siteToGo, playersCount,
+                playerPositions, playerRankings, ownId, &path);
+        update_index(ownId);
     }
-
-    /*Rule #0.1: Always stop at a barrier*/
-    barrierAhead = (unsigned int)player_find_x_site_ahead(BARRIER, ownPosition,
-            &path);
-
-    do {
-        siteToGo = calculate_move_to(playersCount, ownPosition, barrierAhead);
-        /*fprintf(stderr, "Positions: %2d %2d %2d \n",*/
-                /*playerPositions[0],*/
-                /*playerPositions[1],*/
-                /*playerPositions[2]*/
-               /*);*/
-        if (-1u != siteToGo) {
-            /*Make sure to not move beyond the end of the path*/
-            moved = player_forward_to(stdout, siteToGo, barrierAhead,
-                    playersCount, playerPositions, playerRankings, ownId,
-                    &path);
-        }
-        ownPosition = siteToGo;
-    } while (!moved && (-1 != siteToGo));
-
-    return;
 }
 
 /*
  *Upon receiving some message, execute it as long as it is valid.
  */
 int process_command(const char* command, int playersCount) {
+    int id = 0;
+
     if (0 == strncmp("EARLY", command, 5u)) {
         error_return(stderr, E_EARLY_GAME_OVER);
     } else if (0 == strncmp("DONE", command, 4u)) {
@@ -263,6 +167,9 @@ int process_command(const char* command, int playersCount) {
     } else if (0 == strncmp("HAP", command, 3u)) {
         player_process_move_broadcast(command, playerPositions, playerRankings,
                 playersCount, ownId, thisPlayer, &players, &path);
+        /*The broadcast has been checked already*/
+        sscanf(command, "HAP%d", &id);
+        update_index(id);
     } else {
         error_return(stderr, E_COMMS_ERROR);
     }
@@ -270,26 +177,68 @@ int process_command(const char* command, int playersCount) {
 }
 
 /*
- *Game play loop.
+ *Wait for the dealer to start another game of the session and set it up.
+ *Returns 0 if the session is over.
+ */
+int next_game(int* playersCount) {
+    char command[100];
+    int withPath = 0;
+    int i = 0;
+
+    if (!fgets(command, sizeof(command), commands)) {
+        return 0;
+    }
+    if (E_OK != player_parse_new_game(command, playersCount, &ownId,
+            &withPath)) {
+        player_free_path(&path);
+        error_return(stderr, E_COMMS_ERROR);
+    }
+
+    thisPlayer = &(players[ownId]);
+    for (i = 0; i < MAX_PLAYERS; i++) {
+        dealer_reset_player(&(players[i]));
+    }
+
+    /*Without a new path the last one is played again*/
+    if (withPath) {
+        player_free_path(&path);
+        player_reset_path(&path);
+        arena_reset(&gameArena);
+        get_path(*playersCount);
+        pathMark = arena_mark(&gameArena);
+    } else {
+        arena_release(&gameArena, pathMark);
+    }
+    init_player_positions(*playersCount);
+    return 1;
+}
+
+/*
+ *Game play loop, repeated for every game of a session.
  */
 void run_game(int playersCount) {
     char command[100];
     int run = 1;
 
     get_path(playersCount);
+    pathMark = arena_mark(&gameArena);
+    init_player_positions(playersCount);
 
-    player_print_path(stderr, &path, playersCount, path.siteCount,
-            playerPositions, playerRankings, 1);
-
-    while (run) {
-        if (!fgets(command, sizeof(command), stdin)) {
-            player_free_path(&path);
-            error_return(stderr, E_COMMS_ERROR);
+    do {
+        player_print_path(stderr, &path, playersCount, path.siteCount,
+                playerPositions, playerRankings, 1);
+
+        run = 1;
+        while (run) {
+            if (!fgets(command, sizeof(command), commands)) {
+                player_free_path(&path);
+                error_return(stderr, E_COMMS_ERROR);
+            }
+            run = process_command(command, playersCount);
         }
-        run = process_command(command, playersCount);
-    }
 
-    player_print_scores(stderr, playersCount, players);
+        player_print_scores(stderr, playersCount, players);
+    } while (player_in_session() && next_game(&playersCount));
 }
 
 int main(int argc, char* argv[]) {
@@ -323,6 +272,11 @@ int main(int argc, char* argv[]) {
     if (playersCount <= playerID) {
         error_return(stderr, E_INVALID_PLAYER_ID);
     }
+
+    /*Site types as the dealer has them*/
+    if (E_OK != site_table_load_inherited()) {
+        error_return(stderr, E_INVALID_PATH);
+    }
     ownId = playerID;
     players = malloc(MAX_PLAYERS * sizeof(Player));
     thisPlayer = &(players[ownId]);
@@ -330,13 +284,28 @@ int main(int argc, char* argv[]) {
         dealer_reset_player(&(players[i]));
     }
 
-    init_player_positions(playersCount);
+    /*Turns handed over in shared memory spare the pipes' wakeups*/
+    commands = stdin;
+    moves = stdout;
+    if (E_OK == handoff_attach_inherited(&handoff)) {
+        commands = handoff_open_input(&handoff);
+        moves = handoff_open_moves(&handoff);
+        if (!commands || !moves) {
+            error_return(stderr, E_COMMS_ERROR);
+        }
+    }
 
+    arena_init(&gameArena, ARENA_BLOCK_SIZE);
     run_game(playersCount);
 
     free(players);
-    free(playerPositions);
-    free(playerRankings);
+    player_free_path(&path);
+    arena_free(&gameArena);
+    if (stdin != commands) {
+        fclose(commands);
+        fclose(moves);
+        handoff_detach(&handoff);
+    }
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,595 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "../inc/errorReturn.h"
+#include "../inc/protocol.h"
+#include "../inc/sharedPath.h"
+#include "../inc/handoff.h"
+#include "../inc/siteEffects.h"
+#include "../inc/strategy.h"
+#include "../inc/engine.h"
+
+/*
+ *Time budget per move in milliseconds if PLAYER_C_BUDGET_MS is not set.
+ */
+#define DEFAULT_BUDGET_MS 20
+/*
+ *Strategy assumed for opponents if PLAYER_C_MODEL does not name one.
+ */
+#define DEFAULT_MODEL STRATEGY_B
+
+/*
+ *Statistics a search thread gathers for its candidate sites.
+ */
+typedef struct {
+    pthread_t thread;
+    const Game* root;
+    const enum StrategyTypes* strategies;
+    const int* candidates;
+    int candidateCount;
+    Game game;
+    double* rewards;
+    long* visits;
+    long rollouts;
+    unsigned int seed;
+    struct timespec deadline;
+} SearchWorker;
+
+/*
+ *The path retrieved from the dealer;
+ */
+Path path;
+/*
+ *Stream of the dealer's messages, stdin unless the turns are handed over
+ *in shared memory.
+ */
+FILE* commands;
+/*
+ *Stream the moves are sent to, stdout unless the turns are handed over in
+ *shared memory.
+ */
+FILE* moves;
+/*
+ *Turn slot shared with the dealer, if it offers one.
+ */
+HandoffPlayer handoff;
+/*
+ *All players' positions.
+ */
+int* playerPositions;
+/*
+ *The ranking is relevant if there are multiple players on the same site.
+ */
+int* playerRankings;
+/*
+ *Memory of the current game: the path, positions and the scratch of every
+ *move.
+ */
+Arena gameArena;
+/*
+ *Position in the arena right after the path, a game of the session playing
+ *the same path again starts there.
+ */
+ArenaMark pathMark;
+
+/*
+ *This player's ID.
+ */
+int ownId;
+
+/*
+ *This player's earnings.
+ */
+Player* thisPlayer;
+
+/*
+ *Book-keeping representation of participating players.
+ */
+Player* players;
+
+/*
+ *Strategies assumed for all seats during the simulation.
+ */
+enum StrategyTypes* strategies;
+
+/*
+ *Time budget per move in milliseconds.
+ */
+long budgetMs;
+
+/*
+ *Number of search threads working on a move in parallel.
+ */
+int threadsCount;
+
+/*
+ *Seed of the random card draws during the simulation.
+ */
+unsigned int searchSeed;
+
+/*
+ *Set to print what each search did to stderr.
+ */
+int verbose;
+
+/*
+ *Initialize the global field representing all players' positions.
+ */
+void init_player_positions(int playersCount) {
+    playerPositions = (int*)arena_calloc(&gameArena, playersCount,
+            sizeof(int));
+    playerRankings = (int*)arena_calloc(&gameArena, playersCount,
+            sizeof(int));
+}
+
+/*
+ *Read the search configuration from the environment.
+ *PLAYER_C_BUDGET_MS .. time budget per move.
+ *PLAYER_C_THREADS .. number of search threads, all cores by default.
+ *PLAYER_C_MODEL .. one strategy letter per seat, e.g. "AB", for opponents.
+ *PLAYER_C_SEED .. seed of the simulated card draws.
+ *PLAYER_C_VERBOSE .. print the rollouts of every move to stderr, if set.
+ */
+void init_search(int playersCount) {
+    const char* value = NULL;
+    int i = 0;
+    int length = 0;
+
+    value = getenv("PLAYER_C_BUDGET_MS");
+    budgetMs = value ? atol(value) : DEFAULT_BUDGET_MS;
+    budgetMs = MAX(budgetMs, 1);
+
+    value = getenv("PLAYER_C_THREADS");
+    threadsCount = value ? atoi(value) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    threadsCount = MAX(threadsCount, 1);
+
+    value = getenv("PLAYER_C_SEED");
+    searchSeed = value ? (unsigned int)strtoul(value, NULL, 10)
+            : (unsigned int)time(NULL) ^ (unsigned int)getpid();
+
+    verbose = NULL != getenv("PLAYER_C_VERBOSE");
+
+    value = getenv("PLAYER_C_MODEL");
+    length = value ? strlen(value) : 0;
+    strategies = (enum StrategyTypes*)arena_alloc(&gameArena,
+            playersCount * sizeof(enum StrategyTypes));
+    for (i = 0; i < playersCount; i++) {
+        strategies[i] = i < length ? engine_convert_strategy(value[i])
+                : DEFAULT_MODEL;
+        if (UNKNOWN_STRATEGY == strategies[i]) {
+            strategies[i] = DEFAULT_MODEL;
+        }
+    }
+    /*Our own later moves are simulated with the greedy B rules*/
+    strategies[ownId] = STRATEGY_B;
+}
+
+/*
+ *Request the path information from the dealer.
+ */
+void get_path(int playersCount) {
+    int success = E_OK;
+
+    /*The dealer's shared path spares parsing it*/
+    /*Rollouts play to the end of the path, so no window is kept*/
+    if (E_OK == shared_path_attach_inherited(playersCount, 0u, &path)) {
+        player_confirm_shared_path(stdout);
+        path.arena = &gameArena;
+        return;
+    }
+
+    player_request_path(stdout);
+    path.arena = &gameArena;
+    success = player_read_path(commands, playersCount, &path);
+    if(E_OK != success) {
+        error_return(stderr, success);
+    }
+    /*Only the parsed sites are needed for playing*/
+    player_drop_path_text(&path);
+}
+
+/*
+ *Check if the given point in time has passed.
+ */
+int deadline_passed(const struct timespec* deadline) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec > deadline->tv_sec
+            || (now.tv_sec == deadline->tv_sec
+            && now.tv_nsec >= deadline->tv_nsec);
+}
+
+/*
+ *Rate the outcome of a simulated game from our point of view: the margin
+ *to the best opponent.
+ */
+double rate_outcome(const Game* game) {
+    int i = 0;
+    int bestOther = INT_MIN;
+
+    for (i = 0; i < game->playersCount; i++) {
+        if (ownId != i) {
+            bestOther = MAX(bestOther, engine_final_score(game->players + i));
+        }
+    }
+    if (INT_MIN == bestOther) {
+        bestOther = 0;
+    }
+    return engine_final_score(game->players + ownId) - bestOther;
+}
+
+/*
+ *Pick the candidate to simulate next by the UCB1 rule.
+ *Candidates which were not tried yet come first.
+ */
+int select_candidate(const SearchWorker* worker, double rewardRange) {
+    int i = 0;
+    int best = 0;
+    double bestValue = -HUGE_VAL;
+    double value = 0.0;
+
+    for (i = 0; i < worker->candidateCount; i++) {
+        if (0 == worker->visits[i]) {
+            return i;
+        }
+        value = worker->rewards[i] / worker->visits[i]
+                + rewardRange * sqrt(2.0 * log((double)worker->rollouts)
+                / worker->visits[i]);
+        if (value > bestValue) {
+            bestValue = value;
+            best = i;
+        }
+    }
+    return best;
+}
+
+/*
+ *Search thread: simulate games starting with each candidate until the
+ *deadline passes.
+ */
+void* run_search_worker(void* arg) {
+    SearchWorker* worker = (SearchWorker*)arg;
+    Game* game = &worker->game;
+    int pick = 0;
+    double reward = 0.0;
+    double minReward = HUGE_VAL;
+    double maxReward = -HUGE_VAL;
+
+    while (!deadline_passed(&worker->deadline)) {
+        pick = select_candidate(worker,
+                MAX(maxReward - minReward, 1.0));
+
+        engine_copy_game(game, worker->root);
+        game->seed = worker->seed;
+        engine_play_move(game, ownId, worker->candidates[pick]);
+        engine_play_out(game, worker->strategies);
+        worker->seed = game->seed;
+
+        reward = rate_outcome(game);
+        minReward = MIN(minReward, reward);
+        maxReward = MAX(maxReward, reward);
+        worker->rewards[pick] += reward;
+        worker->visits[pick] += 1;
+        worker->rollouts += 1;
+    }
+    return NULL;
+}
+
+/*
+ *Collect all the sites up to the next barrier, which have room for us.
+ */
+int find_candidates(int playersCount, int* candidates) {
+    int i = 0;
+    int count = 0;
+    int ownPosition = playerPositions[ownId];
+    int barrierAhead = 0;
+
+    barrierAhead = player_find_x_site_ahead(BARRIER, ownPosition, &path);
+    for (i = ownPosition + 1; i <= barrierAhead; i++) {
+        if ((int)player_get_site_usage(playerPositions, playersCount, i)
+                < path_site_capacity(&path, i)) {
+            candidates[count++] = i;
+        }
+    }
+    return count;
+}
+
+/*
+ *Search the best site to go to within the time budget.
+ *Every thread runs its own search from the root, whose statistics are merged
+ *afterwards (root parallelism).
+ *Returns -1 if no simulation finished in time.
+ */
+int search_site(int playersCount, const int* candidates, int candidateCount) {
+    SearchWorker* workers = NULL;
+    Game root;
+    struct timespec deadline;
+    int i = 0;
+    int j = 0;
+    int best = -1;
+    long visits = 0;
+    long rollouts = 0;
+    double reward = 0.0;
+    double bestMean = -HUGE_VAL;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += budgetMs / 1000;
+    deadline.tv_nsec += (budgetMs % 1000) * 1000000L;
+    if (1000000000L <= deadline.tv_nsec) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    root.path = &path;
+    root.playersCount = playersCount;
+    root.positions = playerPositions;
+    root.rankings = playerRankings;
+    root.players = players;
+    root.deck = NULL;
+    root.seed = 0u;
+
+    /*The threads play on copies allocated ahead, from the move's scratch*/
+    workers = (SearchWorker*)arena_calloc(&gameArena, threadsCount,
+            sizeof(SearchWorker));
+    for (i = 0; i < threadsCount; i++) {
+        workers[i].root = &root;
+        workers[i].strategies = strategies;
+        workers[i].candidates = candidates;
+        workers[i].candidateCount = candidateCount;
+        workers[i].game.positions = (int*)arena_alloc(&gameArena,
+                playersCount * sizeof(int));
+        workers[i].game.rankings = (int*)arena_alloc(&gameArena,
+                playersCount * sizeof(int));
+        workers[i].game.players = (Player*)arena_alloc(&gameArena,
+                playersCount * sizeof(Player));
+        workers[i].rewards = (double*)arena_calloc(&gameArena,
+                candidateCount, sizeof(double));
+        workers[i].visits = (long*)arena_calloc(&gameArena, candidateCount,
+                sizeof(long));
+        workers[i].seed = engine_random(&searchSeed);
+        workers[i].deadline = deadline;
+        if (0 != pthread_create(&workers[i].thread, NULL,
+                run_search_worker, workers + i)) {
+            /*Run out of threads: search on the ones we've got*/
+            workers[i].candidateCount = 0;
+        }
+    }
+
+    for (i = 0; i < threadsCount; i++) {
+        if (workers[i].candidateCount) {
+            pthread_join(workers[i].thread, NULL);
+        }
+        rollouts += workers[i].rollouts;
+    }
+
+    /*Merge the statistics of all the threads*/
+    for (j = 0; j < candidateCount; j++) {
+        visits = 0;
+        reward = 0.0;
+        for (i = 0; i < threadsCount; i++) {
+            visits += workers[i].visits[j];
+            reward += workers[i].rewards[j];
+        }
+        if (visits && reward / visits > bestMean) {
+            bestMean = reward / visits;
+            best = j;
+        }
+    }
+
+    if (verbose) {
+        fprintf(stderr, "Search: %ld rollouts on %d threads, %d candidates\n",
+                rollouts, threadsCount, candidateCount);
+    }
+
+    return -1 == best ? -1 : candidates[best];
+}
+
+/*
+ *Calculate the next move and send it.
+ */
+void make_move(int playersCount) {
+    StrategyView view;
+    ArenaMark mark = arena_mark(&gameArena);
+    int* candidates = NULL;
+    int candidateCount = 0;
+    int siteToGo = -1;
+
+    /*Rule #0: Don't move beyond the end of the path.*/
+    if ((int)path.siteCount <= playerPositions[ownId] + 1) {
+        return;
+    }
+
+    /*Everything the search needs is scratch of this move*/
+    candidates = (int*)arena_alloc(&gameArena, path.siteCount * sizeof(int));
+    candidateCount = find_candidates(playersCount, candidates);
+    if (1 == candidateCount) {
+        siteToGo = candidates[0];
+    } else if (1 < candidateCount) {
+        siteToGo = search_site(playersCount, candidates, candidateCount);
+    }
+    arena_release(&gameArena, mark);
+
+    if (-1 == siteToGo) {
+        /*Fall back to the greedy rules*/
+        view.path = &path;
+        view.playersCount = playersCount;
+        view.ownId = ownId;
+        view.positions = playerPositions;
+        view.rankings = playerRankings;
+        view.players = players;
+        siteToGo = strategy_b_choose_site(&view);
+    }
+
+    if (-1 != siteToGo) {
+        /*The chosen site is already limited to the next barrier*/
+        player_forward_to(moves, siteToGo, siteToGo, playersCount,
+                playerPositions, playerRankings, ownId, &path);
+    }
+}
+
+/*
+ *Upon receiving some message, execute it as long as it is valid.
+ */
+int process_command(const char* command, int playersCount) {
+    if (0 == strncmp("EARLY", command, 5u)) {
+        error_return(stderr, E_EARLY_GAME_OVER);
+    } else if (0 == strncmp("DONE", command, 4u)) {
+        return 0;
+    } else if (0 == strncmp("YT", command, 2u)) {
+        if (!('\0' == command[2]
+                || '\n' == command[2]
+                || EOF == command[2])) {
+            error_return(stderr, E_COMMS_ERROR);
+        }
+        make_move(playersCount);
+    } else if (0 == strncmp("HAP", command, 3u)) {
+        player_process_move_broadcast(command, playerPositions, playerRankings,
+                playersCount, ownId, thisPlayer, &players, &path);
+    } else {
+        error_return(stderr, E_COMMS_ERROR);
+    }
+    return 1;
+}
+
+/*
+ *Wait for the dealer to start another game of the session and set it up.
+ *Returns 0 if the session is over.
+ */
+int next_game(int* playersCount) {
+    char command[100];
+    int withPath = 0;
+    int i = 0;
+
+    if (!fgets(command, sizeof(command), commands)) {
+        return 0;
+    }
+    if (E_OK != player_parse_new_game(command, playersCount, &ownId,
+            &withPath)) {
+        player_free_path(&path);
+        error_return(stderr, E_COMMS_ERROR);
+    }
+
+    thisPlayer = &(players[ownId]);
+    for (i = 0; i < MAX_PLAYERS; i++) {
+        dealer_reset_player(&(players[i]));
+    }
+
+    /*Without a new path the last one is played again*/
+    if (withPath) {
+        player_free_path(&path);
+        player_reset_path(&path);
+        arena_reset(&gameArena);
+        get_path(*playersCount);
+        pathMark = arena_mark(&gameArena);
+    } else {
+        arena_release(&gameArena, pathMark);
+    }
+    init_player_positions(*playersCount);
+    init_search(*playersCount);
+    return 1;
+}
+
+/*
+ *Game play loop, repeated for every game of a session.
+ */
+void run_game(int playersCount) {
+    char command[100];
+    int run = 1;
+
+    get_path(playersCount);
+    pathMark = arena_mark(&gameArena);
+    init_player_positions(playersCount);
+    init_search(playersCount);
+
+    do {
+        player_print_path(stderr, &path, playersCount, path.siteCount,
+                playerPositions, playerRankings, 1);
+
+        run = 1;
+        while (run) {
+            if (!fgets(command, sizeof(command), commands)) {
+                player_free_path(&path);
+                error_return(stderr, E_COMMS_ERROR);
+            }
+            run = process_command(command, playersCount);
+        }
+
+        player_print_scores(stderr, playersCount, players);
+    } while (player_in_session() && next_game(&playersCount));
+}
+
+int main(int argc, char* argv[]) {
+    int playersCount = 0;
+    int playerID = 0;
+    int i = 0;
+
+    /*Check for valid number of parameters*/
+    if (3 != argc) {
+        error_return(stderr, E_INVALID_ARGS_COUNT);
+    }
+
+    /*Check for valid number of players*/
+    for (i = 0; i < strlen(argv[1]); i++) {
+        if (!isdigit(argv[1][i])) {
+            error_return(stderr, E_INVALID_PLAYER_COUNT);
+        }
+    }
+    playersCount = atoi(argv[1]);
+    if (1 > playersCount) {
+        error_return(stderr, E_INVALID_PLAYER_COUNT);
+    }
+
+    /*Check for valid player ID*/
+    for (i = 0; i < strlen(argv[2]); i++) {
+        if (!isdigit(argv[2][i])) {
+            error_return(stderr, E_INVALID_PLAYER_ID);
+        }
+    }
+    playerID = atoi(argv[2]);
+    if (playersCount <= playerID) {
+        error_return(stderr, E_INVALID_PLAYER_ID);
+    }
+
+    /*Site types as the dealer has them*/
+    if (E_OK != site_table_load_inherited()) {
+        error_return(stderr, E_INVALID_PATH);
+    }
+    ownId = playerID;
+    players = malloc(MAX_PLAYERS * sizeof(Player));
+    thisPlayer = &(players[ownId]);
+    for (i = 0; i < MAX_PLAYERS; i++) {
+        dealer_reset_player(&(players[i]));
+    }
+
+    /*Turns handed over in shared memory spare the pipes' wakeups*/
+    commands = stdin;
+    moves = stdout;
+    if (E_OK == handoff_attach_inherited(&handoff)) {
+        commands = handoff_open_input(&handoff);
+        moves = handoff_open_moves(&handoff);
+        if (!commands || !moves) {
+            error_return(stderr, E_COMMS_ERROR);
+        }
+    }
+
+    arena_init(&gameArena, ARENA_BLOCK_SIZE);
+    run_game(playersCount);
+
+    free(players);
+    player_free_path(&path);
+    arena_free(&gameArena);
+    if (stdin != commands) {
+        fclose(commands);
+        fclose(moves);
+        handoff_detach(&handoff);
+    }
+
+    return EXIT_SUCCESS;
+}
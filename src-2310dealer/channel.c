@@ -0,0 +1,560 @@
+/*
+ *channel.c
+ */
+
+/*
+ *sendmmsg() and memrchr() are GNU extensions.
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "../inc/protocol.h"
+#include "channel.h"
+
+/*
+ *Most packets handed to the kernel by a single sendmmsg() call.
+ */
+#define PACKETS_PER_CALL 16
+
+/*
+ *Make the given file descriptor non-blocking.
+ */
+void set_non_blocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+
+    if (-1 != flags) {
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+}
+
+/*
+ *Connect the channel to the given pipe ends and make them non-blocking.
+ */
+void channel_init(Channel* channel, int readFd, int writeFd) {
+    memset(channel, 0, sizeof(Channel));
+    channel->readFd = readFd;
+    channel->writeFd = writeFd;
+    set_non_blocking(readFd);
+    set_non_blocking(writeFd);
+}
+
+/*
+ *Connect the channel to the given SOCK_SEQPACKET socket and make it
+ *non-blocking.
+ */
+void channel_init_socket(Channel* channel, int fd) {
+    channel_init(channel, fd, fd);
+    channel->packets = 1;
+}
+
+/*
+ *Stop reading from the player.
+ *A socket is only closed once both directions are.
+ */
+void close_input(Channel* channel) {
+    channel->inputClosed = 1;
+    if (channel->readFd != channel->writeFd || channel->outputClosed) {
+        close(channel->readFd);
+    }
+}
+
+/*
+ *Stop writing to the player, nobody will read the rest of the queue.
+ *A socket is only closed once both directions are.
+ */
+void close_output(Channel* channel) {
+    channel->outputClosed = 1;
+    channel->outputLength = 0u;
+    channel->exemptLength = 0u;
+    if (channel->readFd != channel->writeFd || channel->inputClosed) {
+        close(channel->writeFd);
+    }
+}
+
+/*
+ *Close both directions and release the queue.
+ */
+void channel_close(Channel* channel) {
+    if (!channel->inputClosed) {
+        close_input(channel);
+    }
+    if (!channel->outputClosed) {
+        close_output(channel);
+    }
+    free(channel->output);
+    channel->output = NULL;
+    channel->outputStart = 0u;
+    channel->outputLength = 0u;
+    channel->outputCapacity = 0u;
+    channel->exemptLength = 0u;
+}
+
+/*
+ *Append a message to the output queue.
+ *Exempt messages (e.g. the path) don't count against the queue budget.
+ */
+void channel_queue(Channel* channel, const char* message, size_t length,
+        int exempt) {
+    size_t needed = 0u;
+
+    if (channel->outputClosed) {
+        return;
+    }
+
+    needed = channel->outputLength + length;
+    if (channel->outputStart + needed > channel->outputCapacity) {
+        /*Move the pending bytes to the front before growing the buffer*/
+        memmove(channel->output, channel->output + channel->outputStart,
+                channel->outputLength);
+        channel->outputStart = 0u;
+        if (needed > channel->outputCapacity) {
+            channel->outputCapacity = MAX(needed,
+                    2u * channel->outputCapacity);
+            channel->output = (char*)realloc(channel->output,
+                    channel->outputCapacity);
+        }
+    }
+
+    memcpy(channel->output + channel->outputStart + channel->outputLength,
+            message, length);
+    channel->outputLength += length;
+    channel->queuedTotal += length;
+    if (exempt) {
+        channel->exemptLength += length;
+    }
+}
+
+/*
+ *Number of queued bytes which count against the queue budget.
+ */
+size_t channel_pending(const Channel* channel) {
+    return channel->outputLength - channel->exemptLength;
+}
+
+/*
+ *Remove the given number of written bytes from the front of the queue.
+ *Written bytes are accounted to the exempt part first.
+ */
+void consume_output(Channel* channel, size_t written) {
+    channel->exemptLength -= MIN(written, channel->exemptLength);
+    channel->outputStart += written;
+    channel->outputLength -= written;
+}
+
+/*
+ *Length of the packet starting at data, cut after the last whole line that
+ *fits, unless a single line is longer than a packet.
+ */
+size_t packet_length(const char* data, size_t length) {
+    const char* lineBreak = NULL;
+
+    if (CHANNEL_PACKET_SIZE >= length) {
+        return length;
+    }
+    lineBreak = (const char*)memrchr(data, '\n', CHANNEL_PACKET_SIZE);
+    return lineBreak ? (size_t)(lineBreak - data + 1) : CHANNEL_PACKET_SIZE;
+}
+
+/*
+ *Send as much of the queue as the socket accepts without blocking.
+ *Each packet carries complete messages unless a single line is longer than
+ *a packet. Up to PACKETS_PER_CALL packets go out with one system call.
+ *Returns -1 if the player can't be written to anymore, 0 else.
+ */
+int flush_packets(Channel* channel) {
+    struct mmsghdr packets[PACKETS_PER_CALL];
+    struct iovec parts[PACKETS_PER_CALL];
+    char* start = NULL;
+    size_t offset = 0u;
+    size_t length = 0u;
+    int count = 0;
+    int sent = 0;
+    int i = 0;
+
+    while (channel->outputLength && !channel->outputClosed) {
+        start = channel->output + channel->outputStart;
+        memset(packets, 0, sizeof(packets));
+        offset = 0u;
+        for (count = 0; PACKETS_PER_CALL > count
+                && offset < channel->outputLength; count++) {
+            length = packet_length(start + offset,
+                    channel->outputLength - offset);
+            parts[count].iov_base = start + offset;
+            parts[count].iov_len = length;
+            packets[count].msg_hdr.msg_iov = parts + count;
+            packets[count].msg_hdr.msg_iovlen = 1;
+            offset += length;
+        }
+
+        sent = sendmmsg(channel->writeFd, packets, count, MSG_NOSIGNAL);
+        if (0 > sent) {
+            if (EINTR == errno) {
+                continue;
+            }
+            if (EAGAIN == errno || EWOULDBLOCK == errno) {
+                return 0;
+            }
+            close_output(channel);
+            return -1;
+        }
+        for (i = 0; i < sent; i++) {
+            consume_output(channel, packets[i].msg_len);
+        }
+        if (sent < count) {
+            /*The socket is full*/
+            break;
+        }
+    }
+    if (!channel->outputLength) {
+        channel->outputStart = 0u;
+    }
+    return channel->outputClosed ? -1 : 0;
+}
+
+/*
+ *Write as much of the queue as the player's end accepts without blocking.
+ *Returns -1 if the player can't be written to anymore, 0 else.
+ */
+int channel_flush(Channel* channel) {
+    ssize_t written = 0;
+
+    if (channel->packets) {
+        return flush_packets(channel);
+    }
+
+    while (channel->outputLength && !channel->outputClosed) {
+        written = write(channel->writeFd,
+                channel->output + channel->outputStart,
+                channel->outputLength);
+        if (0 > written) {
+            if (EINTR == errno) {
+                continue;
+            }
+            if (EAGAIN == errno || EWOULDBLOCK == errno) {
+                return 0;
+            }
+            /*The player has gone, nobody will read the rest*/
+            close_output(channel);
+            return -1;
+        }
+        consume_output(channel, (size_t)written);
+    }
+    if (!channel->outputLength) {
+        channel->outputStart = 0u;
+    }
+    return channel->outputClosed ? -1 : 0;
+}
+
+/*
+ *Length of the next write from the queue, at most a packet for a socket.
+ *data is set to the first queued byte.
+ */
+size_t channel_next_write(const Channel* channel, const char** data) {
+    *data = channel->output + channel->outputStart;
+    if (channel->packets) {
+        return packet_length(*data, channel->outputLength);
+    }
+    return channel->outputLength;
+}
+
+/*
+ *Account for a write of the queue done elsewhere, result being the number
+ *of bytes written or a negative errno value.
+ *Returns -1 if the player can't be written to anymore, 0 else.
+ */
+int channel_written(Channel* channel, long result) {
+    if (channel->outputClosed) {
+        return -1;
+    }
+    if (0 < result) {
+        consume_output(channel, (size_t)result);
+        if (!channel->outputLength) {
+            channel->outputStart = 0u;
+        }
+    } else if (0 > result && -EAGAIN != result && -EWOULDBLOCK != result
+            && -EINTR != result) {
+        close_output(channel);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ *Block until at most limit bytes counting against the budget are queued.
+ *Returns -1 if the player can't be written to anymore, 0 else.
+ */
+int channel_drain(Channel* channel, size_t limit) {
+    struct pollfd fd;
+
+    fd.fd = channel->writeFd;
+    fd.events = POLLOUT;
+
+    while (-1 != channel_flush(channel)) {
+        if (channel_pending(channel) <= limit) {
+            return 0;
+        }
+        if (0 > poll(&fd, 1, -1) && EINTR != errno) {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+/*
+ *Receive the next packet into the free part of the input.
+ *A packet which does not fit is an error, its rest would be lost.
+ *Returns the number of bytes received like read().
+ */
+ssize_t receive_packet(Channel* channel) {
+    struct msghdr packet;
+    struct iovec part;
+    ssize_t received = 0;
+
+    memset(&packet, 0, sizeof(packet));
+    part.iov_base = channel->input + channel->inputLength;
+    part.iov_len = CHANNEL_INPUT_SIZE - channel->inputLength;
+    packet.msg_iov = &part;
+    packet.msg_iovlen = 1;
+
+    received = recvmsg(channel->readFd, &packet, 0);
+    if (0 < received && (MSG_TRUNC & packet.msg_flags)) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    return received;
+}
+
+/*
+ *Read everything the player has sent so far without blocking.
+ */
+void channel_fill(Channel* channel) {
+    ssize_t readBytes = 0;
+
+    while (!channel->inputClosed
+            && CHANNEL_INPUT_SIZE > channel->inputLength) {
+        if (channel->packets) {
+            readBytes = receive_packet(channel);
+        } else {
+            readBytes = read(channel->readFd,
+                    channel->input + channel->inputLength,
+                    CHANNEL_INPUT_SIZE - channel->inputLength);
+        }
+        if (0 < readBytes) {
+            channel->inputLength += readBytes;
+        } else if (0 > readBytes && EINTR == errno) {
+            continue;
+        } else if (0 > readBytes
+                && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+            return;
+        } else {
+            /*End of file, a broken connection or an oversized packet*/
+            close_input(channel);
+        }
+    }
+}
+
+/*
+ *Append input read elsewhere, result being the number of bytes read, zero
+ *at the end of input or a negative errno value.
+ *Input which does not fit the buffer ends it, like a broken connection.
+ */
+void channel_received(Channel* channel, const char* data, long result) {
+    if (channel->inputClosed) {
+        return;
+    }
+    if (0 < result
+            && (size_t)result <= CHANNEL_INPUT_SIZE - channel->inputLength) {
+        memcpy(channel->input + channel->inputLength, data, result);
+        channel->inputLength += result;
+    } else if (-EAGAIN != result && -EWOULDBLOCK != result
+            && -EINTR != result) {
+        close_input(channel);
+    }
+}
+
+/*
+ *Check if the channel holds a complete message or has reached its end.
+ *The path request and the shared path confirmation are the only messages
+ *without a line break.
+ */
+int channel_has_message(const Channel* channel) {
+    return channel->inputClosed
+            || CHANNEL_INPUT_SIZE == channel->inputLength
+            || (channel->inputLength && ('^' == channel->input[0]
+                    || '@' == channel->input[0]))
+            || memchr(channel->input, '\n', channel->inputLength);
+}
+
+/*
+ *Remove the given number of bytes from the front of the input.
+ */
+void consume_input(Channel* channel, size_t length) {
+    memmove(channel->input, channel->input + length,
+            channel->inputLength - length);
+    channel->inputLength -= length;
+}
+
+/*
+ *Take the next byte of input.
+ *Returns EOF if there is none.
+ */
+int channel_take_byte(Channel* channel) {
+    int byte = EOF;
+
+    if (channel->inputLength) {
+        byte = (unsigned char)channel->input[0];
+        consume_input(channel, 1u);
+    }
+    return byte;
+}
+
+/*
+ *Take the next line of input including its line break.
+ *A line which does not fit the buffer, or the rest before the end of input,
+ *is taken as it is.
+ *Returns 0 if there is no complete line.
+ */
+int channel_take_line(Channel* channel, char* line, size_t size) {
+    char* lineBreak = NULL;
+    size_t length = 0u;
+
+    lineBreak = (char*)memchr(channel->input, '\n', channel->inputLength);
+    if (lineBreak) {
+        length = lineBreak - channel->input + 1;
+    } else if (channel->inputLength && (channel->inputClosed
+            || CHANNEL_INPUT_SIZE == channel->inputLength)) {
+        length = channel->inputLength;
+    } else {
+        return 0;
+    }
+
+    length = MIN(length, size - 1);
+    memcpy(line, channel->input, length);
+    line[length] = '\0';
+    consume_input(channel, length);
+    return 1;
+}
+
+/*
+ *Calculate the milliseconds left until the deadline, at least zero.
+ */
+int remaining_time(const struct timespec* deadline) {
+    struct timespec now;
+    long milliseconds = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    milliseconds = (deadline->tv_sec - now.tv_sec) * 1000L
+            + (deadline->tv_nsec - now.tv_nsec) / 1000000L;
+    return (int)MAX(milliseconds, 0L);
+}
+
+/*
+ *Find an awaited seat holding a message.
+ *Returns -1 if there is none.
+ */
+int find_message(const Channel* channels, int count, const int* awaited) {
+    int i = 0;
+
+    for (i = 0; i < count; i++) {
+        if (awaited[i] && channel_has_message(channels + i)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ *Allocate the descriptors to poll the given number of channels with.
+ *Returns -1 if there is no memory for them, 0 else.
+ */
+int channel_poll_init(ChannelPoll* set, int count) {
+    set->fds = (struct pollfd*)malloc(2 * count * sizeof(struct pollfd));
+    set->owners = (int*)malloc(2 * count * sizeof(int));
+    if (!set->fds || !set->owners) {
+        channel_poll_free(set);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ *Release the descriptors.
+ */
+void channel_poll_free(ChannelPoll* set) {
+    free(set->fds);
+    free(set->owners);
+    set->fds = NULL;
+    set->owners = NULL;
+}
+
+/*
+ *Wait until any of the seats marked in awaited has a message, writing the
+ *queues of all channels meanwhile.
+ *Returns the seat with a message, or -1 if the timeout (milliseconds, -1
+ *for none) expired.
+ */
+int channels_wait_any(Channel* channels, int count, ChannelPoll* set,
+        const int* awaited, int timeout) {
+    struct pollfd* fds = set->fds;
+    int* owners = set->owners;
+    struct timespec deadline;
+    int ready = -1;
+    int used = 0;
+    int polled = 0;
+    int i = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += MAX(timeout, 0) / 1000;
+    deadline.tv_nsec += (MAX(timeout, 0) % 1000) * 1000000L;
+    if (1000000000L <= deadline.tv_nsec) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    while (-1 == (ready = find_message(channels, count, awaited))) {
+        used = 0;
+        for (i = 0; i < count; i++) {
+            if (awaited[i] && !channels[i].inputClosed) {
+                fds[used].fd = channels[i].readFd;
+                fds[used].events = POLLIN;
+                owners[used++] = i;
+            }
+            if (channels[i].outputLength && !channels[i].outputClosed) {
+                fds[used].fd = channels[i].writeFd;
+                fds[used].events = POLLOUT;
+                owners[used++] = i;
+            }
+        }
+
+        polled = poll(fds, used,
+                -1 == timeout ? -1 : remaining_time(&deadline));
+        if (0 == polled || (0 > polled && EINTR != errno)) {
+            break;
+        } else if (0 > polled) {
+            continue;
+        }
+
+        for (i = 0; i < used; i++) {
+            if (!fds[i].revents) {
+                continue;
+            }
+            if (POLLOUT == fds[i].events) {
+                channel_flush(channels + owners[i]);
+            } else {
+                channel_fill(channels + owners[i]);
+            }
+        }
+    }
+
+    return ready;
+}
@@ -0,0 +1,156 @@
+/*
+ *channel.h
+ */
+
+#pragma once
+
+#ifndef __CHANNEL_H__
+#define __CHANNEL_H__
+
+#include <stddef.h>
+#include <poll.h>
+
+/*
+ *Number of bytes buffered from a player before they are taken as messages.
+ */
+#define CHANNEL_INPUT_SIZE 4096
+/*
+ *Largest packet sent over a socket. The players read through stdio, whose
+ *buffer for a socket is one page, and the rest of a longer packet is lost.
+ */
+#define CHANNEL_PACKET_SIZE 4096
+
+/*
+ *Non-blocking bidirectional connection to a player, either a pair of pipes
+ *or a single SOCK_SEQPACKET socket (packets is set, readFd is writeFd).
+ *Outgoing messages are kept in a queue, which is written whenever the
+ *player's end accepts more data. Incoming bytes are buffered until they
+ *form a complete message.
+ *queuedTotal .. Bytes ever queued, a player taking its turns from shared
+ *memory reads up to this before its turn.
+ */
+typedef struct {
+    int readFd;
+    int writeFd;
+    char* output;
+    size_t outputStart;
+    size_t outputLength;
+    size_t outputCapacity;
+    size_t exemptLength;
+    size_t queuedTotal;
+    char input[CHANNEL_INPUT_SIZE];
+    size_t inputLength;
+    int inputClosed;
+    int outputClosed;
+    int packets;
+} Channel;
+
+/*
+ *Descriptors polled while waiting for messages, set up once for a number
+ *of channels: the read and the write end of each of them.
+ *owners .. Channel of every descriptor.
+ */
+typedef struct {
+    struct pollfd* fds;
+    int* owners;
+} ChannelPoll;
+
+/*
+ *Connect the channel to the given pipe ends and make them non-blocking.
+ */
+void channel_init(Channel* channel, int readFd, int writeFd);
+
+/*
+ *Connect the channel to the given SOCK_SEQPACKET socket and make it
+ *non-blocking.
+ */
+void channel_init_socket(Channel* channel, int fd);
+
+/*
+ *Close both directions and release the queue.
+ */
+void channel_close(Channel* channel);
+
+/*
+ *Append a message to the output queue.
+ *Exempt messages (e.g. the path) don't count against the queue budget.
+ */
+void channel_queue(Channel* channel, const char* message, size_t length,
+        int exempt);
+
+/*
+ *Number of queued bytes which count against the queue budget.
+ */
+size_t channel_pending(const Channel* channel);
+
+/*
+ *Write as much of the queue as the pipe accepts without blocking.
+ *Returns -1 if the player can't be written to anymore, 0 else.
+ */
+int channel_flush(Channel* channel);
+
+/*
+ *Length of the next write from the queue, at most a packet for a socket.
+ *data is set to the first queued byte.
+ */
+size_t channel_next_write(const Channel* channel, const char** data);
+
+/*
+ *Account for a write of the queue done elsewhere, result being the number
+ *of bytes written or a negative errno value.
+ *Returns -1 if the player can't be written to anymore, 0 else.
+ */
+int channel_written(Channel* channel, long result);
+
+/*
+ *Append input read elsewhere, result being the number of bytes read, zero
+ *at the end of input or a negative errno value.
+ *Input which does not fit the buffer ends it, like a broken connection.
+ */
+void channel_received(Channel* channel, const char* data, long result);
+
+/*
+ *Block until at most limit bytes counting against the budget are queued.
+ *Returns -1 if the player can't be written to anymore, 0 else.
+ */
+int channel_drain(Channel* channel, size_t limit);
+
+/*
+ *Check if the channel holds a complete message or has reached its end.
+ */
+int channel_has_message(const Channel* channel);
+
+/*
+ *Take the next byte of input.
+ *Returns EOF if there is none.
+ */
+int channel_take_byte(Channel* channel);
+
+/*
+ *Take the next line of input including its line break.
+ *Returns 0 if there is no complete line.
+ */
+int channel_take_line(Channel* channel, char* line, size_t size);
+
+/*
+ *Allocate the descriptors to poll the given number of channels with.
+ *Returns -1 if there is no memory for them, 0 else.
+ */
+int channel_poll_init(ChannelPoll* set, int count);
+
+/*
+ *Release the descriptors.
+ */
+void channel_poll_free(ChannelPoll* set);
+
+/*
+ *Wait until any of the seats marked in awaited has a message, writing the
+ *queues of all channels meanwhile.
+ *Returns the seat with a message, or -1 if the timeout (milliseconds, -1
+ *for none) expired.
+ */
+int channels_wait_any(Channel* channels, int count, ChannelPoll* set,
+        const int* awaited, int timeout);
+
+#endif
+
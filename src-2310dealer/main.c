@@ -1,3 +1,8 @@
+/*
+ *pipe2() is a GNU extension.
+ */
+#define _GNU_SOURCE
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <limits.h>
@@ -7,8 +12,27 @@
 #include <sys/wait.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
 #include "../inc/errorReturn.h"
 #include "../inc/protocol.h"
+#include "../inc/sharedPath.h"
+#include "../inc/pathWindow.h"
+#include "../inc/siteEffects.h"
+#include "../inc/journal.h"
+#include "../inc/results.h"
+#include "../inc/samples.h"
+#include "../inc/handoff.h"
+#include "../inc/counters.h"
+#include "options.h"
+#include "channel.h"
+#include "report.h"
+#include "table.h"
+#include "ring.h"
+#include "metrics.h"
+#include "render.h"
+#include "placement.h"
 
 /*
  *The write end of a pipe.
@@ -18,7 +42,33 @@
  *The read end of a pipe.
  */
 #define READ_END 0
+/*
+ *Buffer of the journal, records are written in blocks of this size.
+ */
+#define JOURNAL_BUFFER_SIZE (1024u * 1024u)
+/*
+ *Environment handed over to the players.
+ */
+extern char** environ;
 
+/*
+ *Options given on the command line.
+ */
+DealerOptions options;
+/*
+ *Measurements of this run.
+ */
+DealerReport report;
+/*
+ *Live counters of this run.
+ */
+DealerMetrics metrics;
+
+/*
+ *Memory of the path, the deck and the players' names, and the scratch of
+ *printing the board.
+ */
+Arena arena;
 /*
  *Deck object holding a sequence of cards to draw.
  */
@@ -28,279 +78,409 @@ Deck deck;
  */
 Path path;
 /*
- *All players' positions.
+ *The actual number of players in each game.
  */
-int* playerPositions;
+int playersCount = 0;
+
 /*
- *The ranking is relevant if there are multiple players on the same site.
+ *All tables hosted by this dealer.
  */
-int* playerRankings;
+Table* tables = NULL;
 /*
- *The actual number of players in the game.
+ *Number of seats at all tables, each table has playersCount of them.
  */
-int playersCount = 0;
+int seatsCount = 0;
 /*
- *Array of players used for book-keeping.
+ *PIDs of all player processes, table by table.
  */
-Player players[MAX_PLAYERS];
-
+pid_t* pids = NULL;
+/*
+ *Non-blocking connections to all players, table by table.
+ */
+Channel* channels = NULL;
+/*
+ *Seats the event loop is waiting for a message from.
+ */
+int* awaited = NULL;
+/*
+ *io_uring serving all seats, if options.io asks for it.
+ */
+Ring ring;
+/*
+ *Descriptors of all seats polled for their messages, unless io_uring
+ *serves them.
+ */
+ChannelPoll channelPoll;
+/*
+ *Board output of each table, collected in memory if there are several.
+ */
+char** transcripts = NULL;
+/*
+ *Sizes of the collected board outputs.
+ */
+size_t* transcriptLengths = NULL;
 /*
- *PIDs of all player processes.
+ *Number of tables whose output has been printed.
  */
-pid_t pids[MAX_PLAYERS];
+int printedTables = 0;
 /*
- *Pipes directing to all players.
+ *CPUs and scheduling class of the dealer and the players.
  */
-int pipeToPlayerNo[MAX_PLAYERS][2];
+Placement placement;
 /*
- *Pipes sourcing from all players.
+ *Journal all tables record their games in, if options.journal asks for it.
  */
-int pipeToDealerNo[MAX_PLAYERS][2];
+FILE* journal = NULL;
 /*
- *Streams directing to all players.
+ *File the scores of all games are appended to, if options.results asks
+ *for it, and the writer all tables add them with.
  */
-FILE* streamToPlayer[MAX_PLAYERS][2];
+FILE* resultsFile = NULL;
+ResultsWriter results;
 /*
- *Streams sourcing from all players.
+ *File the players' decisions are recorded in, if options.samples asks for
+ *it, and the exporter all tables hand them to.
  */
-FILE* streamToDealer[MAX_PLAYERS][2];
+FILE* samplesFile = NULL;
+SampleExporter samples;
 /*
- *Streams that are to be used for broadcasts.
+ *Render thread printing the boards of all tables, if options.render asks
+ *for it.
  */
-FILE* broadcastStreams[MAX_PLAYERS];
+Renderer renderer;
+/*
+ *Turn slots of all seats, if options.handoff asks for them.
+ */
+Handoff handoff;
+/*
+ *Events counted by the dealer, if options.counters asks for them.
+ */
+Counters dealerCounters;
+/*
+ *Events counted by each seat, the ones of the first table sum up all
+ *tables in the end.
+ */
+Counters* seatCounters = NULL;
 
 /*
- *Initialize the global field representing all players' positions.
+ *Set up all tables, each printing its board to stdout or, if there are
+ *several, to memory.
  */
-void init_player_positions() {
-    playerPositions = malloc(playersCount * sizeof(int));
-    playerRankings = malloc(playersCount * sizeof(int));
-    memset(playerPositions, 0, playersCount * sizeof(int));
-    memset(playerRankings, 0, playersCount * sizeof(int));
+void init_tables() {
+    FILE* output = stdout;
+    int i = 0;
+
+    tables = malloc(options.tables * sizeof(Table));
+    transcripts = calloc(options.tables, sizeof(char*));
+    transcriptLengths = calloc(options.tables, sizeof(size_t));
+    awaited = calloc(seatsCount, sizeof(int));
+    for (i = 0; i < options.tables; i++) {
+        if (1 < options.tables) {
+            output = open_memstream(transcripts + i, transcriptLengths + i);
+            fprintf(output, "Table %d\n", i);
+        }
+        table_init(tables + i, i, playersCount, &path, &deck,
+                channels + i * playersCount, pids + i * playersCount,
+                &options, &report, &metrics, output, journal,
+                RENDER_ASYNC == options.render ? &renderer : NULL,
+                HANDOFF_FUTEX == options.handoff ? &handoff : NULL,
+                resultsFile ? &results : NULL,
+                samplesFile ? &samples : NULL);
+    }
 }
 
 /*
- *Open a set of streams representing bidirectional communication to a player.
+ *Print the output of the finished tables, always in the order of the
+ *tables.
  */
-int open_stream(int playerId) {
-    streamToPlayer[playerId][READ_END]
-            = fdopen(pipeToPlayerNo[playerId][READ_END], "r");
-    streamToPlayer[playerId][WRITE_END]
-            = fdopen(pipeToPlayerNo[playerId][WRITE_END], "w");
-    streamToDealer[playerId][READ_END]
-            = fdopen(pipeToDealerNo[playerId][READ_END], "r");
-    streamToDealer[playerId][WRITE_END]
-            = fdopen(pipeToDealerNo[playerId][WRITE_END], "w");
+void print_finished_tables() {
+    Table* table = NULL;
 
-    if (!(streamToPlayer[playerId][READ_END]
-            || streamToPlayer[playerId][WRITE_END]
-            || streamToDealer[playerId][READ_END]
-            || streamToDealer[playerId][WRITE_END])) {
-        error_return_dealer(stderr, E_DEALER_INVALID_START_PLAYER, 0);
+    while (printedTables < options.tables) {
+        table = tables + printedTables;
+        if (TABLE_CLOSED != table->state) {
+            return;
+        }
+        if (stdout != table->output) {
+            if (RENDER_ASYNC == options.render) {
+                renderer_drain(&renderer);
+            }
+            fclose(table->output);
+            fwrite(transcripts[printedTables], 1u,
+                    transcriptLengths[printedTables], stdout);
+            free(transcripts[printedTables]);
+            fflush(stdout);
+        }
+        printedTables += 1;
     }
-
-    broadcastStreams[playerId] = streamToPlayer[playerId][WRITE_END];
-    return E_DEALER_OK;
 }
 
 /*
- *Determine the player, who is next.
+ *Milliseconds until the earliest deadline of all tables or the next metrics
+ *export.
+ *Returns -1 if there is none.
  */
-int calculate_next_player(const int* positions, const int* rankings) {
+int next_timeout() {
+    double earliest = -1.0;
+    double deadline = 0.0;
+    double now = report_elapsed_ms(&report);
+    int timeout = metrics_timeout(&metrics, now);
     int i = 0;
-    int minSite = INT_MAX;
-    int maxRank = 0;
 
-    /*Find the earliest used site*/
-    for (i = 0; i < playersCount; i++) {
-        minSite = MIN(minSite, positions[i]);
-    }
-
-    /*Find the highest ranking on that site*/
-    for (i = 0; i < playersCount; i++) {
-        if (minSite == positions[i]) {
-            maxRank = MAX(maxRank, rankings[i]);
+    for (i = 0; i < options.tables; i++) {
+        deadline = table_deadline(tables + i);
+        if (0.0 <= deadline && (0.0 > earliest || deadline < earliest)) {
+            earliest = deadline;
         }
     }
-
-    /*Find the player on the evaluated site and ranking*/
-    for (i = 0; i < playersCount; i++) {
-        if (minSite == positions[i]
-                && maxRank == rankings[i]) {
-            return i;
-        }
+    if (0.0 > earliest) {
+        return timeout;
     }
-
-    return 0;
+    /*Round up, waking up early would only spin*/
+    deadline = MAX(earliest - now + 1.0, 0.0);
+    return -1 == timeout ? (int)deadline : (int)MIN(deadline, timeout);
 }
 
 /*
- *Adjust the gobal positions and ranking board.
+ *Check if the tables only wait for moves and every queue is written, so
+ *nothing but the turn slots has to be watched.
  */
-void move_player(int id, int targetSite, int* positions, int* rankings) {
+int only_turns_awaited() {
     int i = 0;
-    int ranking = 0;
 
-    for (i = 0; i < playersCount; i++) {
-        if (targetSite == positions[i]) {
-            ranking += 1;
+    for (i = 0; i < options.tables; i++) {
+        if (TABLE_HANDSHAKE == tables[i].state) {
+            return 0;
         }
     }
-
-    positions[id] = targetSite;
-    rankings[id] = ranking;
+    for (i = 0; i < seatsCount; i++) {
+        if (channels[i].outputLength) {
+            return 0;
+        }
+    }
+    return 1;
 }
 
 /*
- *Listen for the next move from the given player.
- *Returns zero in case the game has ended, non-zero else.
+ *Wait for a seat a table is waiting for.
+ *Moves in the turn slots are waited for on their futex, as long as
+ *nothing else is. The connections are still looked at every
+ *HANDOFF_CHECK_MS, for players which have gone.
+ *Returns the seat, or -1 if the timeout expired.
  */
-int receive_next_move(FILE* readStream, int id, int* positions,
-        int* rankings) {
-    char buffer[100];
-    int targetSite = 0;
-    int readChars = 0;
-    int pointDiff = 0;
-    int moneyDiff = 0;
-    int newCard = 0;
-
-    if (!fgets(buffer, sizeof(buffer), readStream)) {
-        error_return_dealer(stdout, E_DEALER_COMMS_ERROR, 1);
+int wait_for_seat() {
+    int timeout = next_timeout();
+    int seat = -1;
+
+    if (HANDOFF_FUTEX == options.handoff) {
+        if (only_turns_awaited()) {
+            seat = handoff_wait_move(&handoff, awaited, seatsCount,
+                    -1 == timeout ? HANDOFF_CHECK_MS
+                            : MIN(timeout, HANDOFF_CHECK_MS));
+            if (-1 != seat) {
+                return seat;
+            }
+            timeout = 0;
+        } else {
+            seat = handoff_find_move(&handoff, awaited, seatsCount);
+            if (-1 != seat) {
+                return seat;
+            }
+            /*Moves are looked for at least every millisecond meanwhile*/
+            timeout = -1 == timeout ? 1 : MIN(timeout, 1);
+        }
     }
 
-    readChars = sscanf(buffer, "DO%d", &targetSite);
-    if (1 > readChars || EOF == readChars) {
-        error_return_dealer(stdout, E_DEALER_COMMS_ERROR, 1);
+    if (IO_URING == options.io) {
+        return ring_wait_any(&ring, channels, seatsCount, awaited, timeout);
     }
-    if (path.siteCount < targetSite + 1) {
-        error_return_dealer(stdout, E_DEALER_COMMS_ERROR, 1);
-    }
-
-    move_player(id, targetSite, positions, rankings);
-    dealer_calculate_player_earnings(id, targetSite, &pointDiff, &moneyDiff,
-            &newCard, &path, players + id, &deck);
-    player_print_earnings(stdout, id, players + id);
-    player_print_path(stdout, &path, playersCount, path.siteCount,
-            positions, rankings, 0);
-    dealer_broadcast_player_move(broadcastStreams, playersCount, id,
-            targetSite, pointDiff, moneyDiff, newCard);
-
-    return dealer_is_finished(playersCount, path.siteCount, positions,
-            rankings);
+    return channels_wait_any(channels, seatsCount, &channelPoll, awaited,
+            timeout);
 }
 
 /*
- *Execute the dealer's business logic.
+ *Execute the dealer's business logic: run the games of all tables on one
+ *event loop, which waits for the seats the tables are waiting for.
  */
 void run_dealer() {
+    int seat = 0;
     int i = 0;
-    int run = 1;
-    int nextPlayer = 0;
-
-    for (i = 0; i < playersCount; i++) {
-        open_stream(i);
 
-        fclose(streamToPlayer[i][READ_END]);
-        fclose(streamToDealer[i][WRITE_END]);
+    for (i = 0; i < options.tables; i++) {
+        table_start(tables + i);
     }
 
-    /*First, print the path*/
-    player_print_path(stdout, &path, playersCount, path.siteCount,
-            playerPositions, playerRankings, 1);
-    fflush(stdout);
+    while (printedTables < options.tables) {
+        for (seat = 0; seat < seatsCount; seat++) {
+            awaited[seat] = table_awaits(tables + seat / playersCount,
+                    seat % playersCount);
+        }
 
-    /*Next, all players need to ask for the path*/
-    for (i = 0; i < playersCount; i++) {
-        if ('^' == fgetc(streamToDealer[i][READ_END])) {
-            /*fprintf(stdout, "%zu;%s", path.siteCount, path.buffer);*/
-            fprintf(streamToPlayer[i][WRITE_END], "%zu;%s", path.siteCount,
-                    path.buffer);
-            fflush(streamToPlayer[i][WRITE_END]);
+        seat = wait_for_seat();
+        if (-1 == seat) {
+            for (i = 0; i < options.tables; i++) {
+                table_check_timeout(tables + i);
+            }
+        } else {
+            table_receive(tables + seat / playersCount, seat % playersCount);
         }
+        print_finished_tables();
+        metrics_export(&metrics, report_elapsed_ms(&report), channels,
+                seatsCount);
     }
+}
 
-    while (run) {
-        /*Next, let the player make his move, which is furtherst back*/
-        nextPlayer = calculate_next_player(playerPositions, playerRankings);
-        dealer_request_next_move(streamToPlayer[nextPlayer][WRITE_END]);
-        run = receive_next_move(streamToDealer[nextPlayer][READ_END],
-                nextPlayer, playerPositions, playerRankings) ? 0 : 1;
+/*
+ *Create the connection for the given seat and connect the seat's channel to
+ *the dealer's end. The player's ends for stdin and stdout are stored in
+ *playerEnds, they are the same socket for the SEQPACKET transport.
+ *All ends are closed on exec, except the ones duplicated for the player.
+ */
+void connect_player(int seat, int playerEnds[2]) {
+    int pipeToPlayer[2];
+    int pipeToDealer[2];
+    int sockets[2];
+
+    if (TRANSPORT_SEQPACKET == options.transport) {
+        if (0 != socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0,
+                sockets)) {
+            error_return_dealer(stderr, E_DEALER_INVALID_START_PLAYER, 1);
+        }
+        playerEnds[READ_END] = sockets[1];
+        playerEnds[WRITE_END] = sockets[1];
+        channel_init_socket(channels + seat, sockets[0]);
+        return;
     }
 
-    /*Finally, quit all the players and print the scores*/
-    dealer_broadcast_end(broadcastStreams, playersCount);
-    player_print_scores(stdout, playersCount, players);
+    if (0 != pipe2(pipeToPlayer, O_CLOEXEC)
+            || 0 != pipe2(pipeToDealer, O_CLOEXEC)) {
+        error_return_dealer(stderr, E_DEALER_INVALID_START_PLAYER, 1);
+    }
+    playerEnds[READ_END] = pipeToPlayer[READ_END];
+    playerEnds[WRITE_END] = pipeToDealer[WRITE_END];
+    channel_init(channels + seat, pipeToDealer[READ_END],
+            pipeToPlayer[WRITE_END]);
 }
 
 /*
- *Launch the player processes.
+ *Launch the player process for the given seat with its stdin and stdout
+ *redirected to its connection and stderr to /dev/null.
  */
-void run_player(int id, const char** playerNames) {
-    char buffer[100];
-    char bufferCount[10];
-    char bufferId[10];
-    int devNull = 0;
+void spawn_player(int seat, const char** playerNames) {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attributes;
+    int playerEnds[2];
+    char bufferCount[12];
+    char bufferId[12];
+    char value[40];
+    char* args[4];
+    int id = seat % playersCount;
+    int success = 0;
+
+    connect_player(seat, playerEnds);
 
-    *buffer = '\0';
-    *bufferCount = '\0';
-    *bufferId = '\0';
-
-    open_stream(id);
+    sprintf(bufferCount, "%d", playersCount);
+    sprintf(bufferId, "%d", id);
+    args[0] = (char*)playerNames[id];
+    args[1] = bufferCount;
+    args[2] = bufferId;
+    args[3] = NULL;
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, playerEnds[READ_END],
+            STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, playerEnds[WRITE_END],
+            STDOUT_FILENO);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null",
+            O_WRONLY, 0);
+
+    placement_spawn_attributes(&placement, &attributes);
+    if (HANDOFF_FUTEX == options.handoff) {
+        snprintf(value, sizeof(value), "%d,%d,%d", handoff.fd, seat,
+                options.handoffSpin);
+        setenv(HANDOFF_VARIABLE, value, 1);
+    }
 
-    /*Redirect stdin, stdout of the players*/
-    dup2(pipeToPlayerNo[id][READ_END], READ_END);
-    dup2(pipeToDealerNo[id][WRITE_END], WRITE_END);
+    success = posix_spawnp(pids + seat, playerNames[id], &actions,
+            &attributes, args, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
 
-    /*Redirect stderr to /dev/null*/
-    devNull = open("/dev/null", O_WRONLY);
-    dup2(devNull, STDERR_FILENO);
+    if (0 != success) {
+        error_return_dealer(stderr, E_DEALER_INVALID_START_PLAYER, 1);
+    }
+    placement_pin_player(&placement, pids[seat]);
+    if (options.counters) {
+        counters_open(seatCounters + seat, pids[seat], 1);
+    }
 
-    fclose(streamToPlayer[id][READ_END]);
-    fclose(streamToPlayer[id][WRITE_END]);
-    fclose(streamToDealer[id][READ_END]);
-    fclose(streamToDealer[id][WRITE_END]);
+    close(playerEnds[READ_END]);
+    if (playerEnds[WRITE_END] != playerEnds[READ_END]) {
+        close(playerEnds[WRITE_END]);
+    }
+}
 
-    sprintf(bufferCount, "%d", playersCount);
-    sprintf(bufferId, "%d", id);
-    execlp(playerNames[id], playerNames[id], bufferCount, bufferId, NULL);
+/*
+ *Allow as many open files as possible, each seat takes one or two of them.
+ */
+void raise_file_limit() {
+    struct rlimit limit;
 
-    /*Should not happen!*/
-    error_return_dealer(stderr, E_DEALER_INVALID_START_PLAYER, 0);
+    if (0 == getrlimit(RLIMIT_NOFILE, &limit)
+            && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
 }
 
 /*
- *Create child processes for the given players.
+ *Create child processes for the given players at every table.
  */
 void start_players(const char** playerNames) {
-    int i = 0;
-    pid_t pid = 0;
+    char value[24];
+    int sharedPath = -1;
+    int seat = 0;
+
+    pids = calloc(options.tables * playersCount, sizeof(pid_t));
+    seatCounters = calloc(options.tables * playersCount, sizeof(Counters));
+    for (seat = 0; seat < options.tables * playersCount; seat++) {
+        counters_init(seatCounters + seat);
+    }
+    channels = calloc(options.tables * playersCount, sizeof(Channel));
+    if (1 < options.tables) {
+        raise_file_limit();
+    }
 
-    for (i = 0; i < playersCount; i++) {
-        pipe(pipeToPlayerNo[i]);
-        pipe(pipeToDealerNo[i]);
+    /*Players in a session stay for the next game after DONE*/
+    if (1 < options.games) {
+        setenv(SESSION_VARIABLE, "1", 1);
     }
 
-    /*Create all the players*/
-    for (i = 0; i < playersCount; i++) {
-        pid = fork();
+    /*Players keep only the chunks of the path around their positions*/
+    if (options.pathWindow) {
+        snprintf(value, sizeof(value), "%zu", options.pathWindow);
+        setenv(PATH_WINDOW_VARIABLE, value, 1);
+    }
 
-        if (0 > pid) {
-            error_return_dealer(stderr, E_DEALER_INVALID_START_PLAYER, 1);
-        }
+    /*Players inherit the parsed path instead of parsing it again*/
+    sharedPath = shared_path_publish(&path, playersCount);
+    if (-1 != sharedPath) {
+        snprintf(value, sizeof(value), "%d", sharedPath);
+        setenv(SHARED_PATH_VARIABLE, value, 1);
+    }
 
-        if (0 == pid) {
-        /*Player context*/
-            run_player(i, playerNames);
-            break;
-        } else {
-        /*Dealer context*/
-            pids[i] = pid;
-        }
+    /*Create all the players*/
+    for (seat = 0; seat < options.tables * playersCount; seat++) {
+        spawn_player(seat, playerNames);
+        seatsCount = seat + 1;
     }
 
-    if (0 < pid) {
-        /*Dealer context*/
-        run_dealer();
+    if (-1 != sharedPath) {
+        close(sharedPath);
+        unsetenv(SHARED_PATH_VARIABLE);
+    }
+    if (HANDOFF_FUTEX == options.handoff) {
+        unsetenv(HANDOFF_VARIABLE);
     }
 }
 
@@ -310,12 +490,92 @@ void start_players(const char** playerNames) {
 void get_path(FILE* stream) {
     int success = E_OK;
 
+    path.arena = &arena;
     success = player_read_path(stream, playersCount, &path);
     if(E_OK != success) {
         error_return_dealer(stderr, E_DEALER_INVALID_PATH, 1);
     }
 }
 
+/*
+ *The strategy letters of the players. A player's strategy is told by the
+ *last letter of its program (2310A, 2310B).
+ */
+char* strategy_letters(const char** playerNames) {
+    char* strategies = (char*)arena_alloc(&arena, playersCount);
+    const char* name = NULL;
+    int i = 0;
+
+    for (i = 0; i < playersCount; i++) {
+        name = playerNames[i];
+        strategies[i] = name[strlen(name) - 1];
+    }
+    return strategies;
+}
+
+/*
+ *Create the journal and record what all games are played with.
+ */
+void open_journal(const char** playerNames) {
+    char* strategies = strategy_letters(playerNames);
+
+    journal = fopen(options.journal, "wb");
+    if (!journal) {
+        error_return_dealer(stderr, E_DEALER_FILE_ERROR, 1);
+    }
+    setvbuf(journal, NULL, _IOFBF, JOURNAL_BUFFER_SIZE);
+    if (!journal_write_header(journal, playersCount, options.tables,
+            strategies, &path, &deck)) {
+        error_return_dealer(stderr, E_DEALER_FILE_ERROR, 1);
+    }
+}
+
+/*
+ *Open the results file, creating it if needed, to append the scores of
+ *all games to.
+ */
+void open_results(const char** playerNames) {
+    resultsFile = fopen(options.results, "a+b");
+    if (!resultsFile || !results_write_header(resultsFile)) {
+        error_return_dealer(stderr, E_DEALER_FILE_ERROR, 1);
+    }
+    results_writer_init(&results, resultsFile, playersCount,
+            strategy_letters(playerNames),
+            results_hash(deck.buffer, deck.size),
+            results_hash(path.buffer, strlen(path.buffer)));
+}
+
+/*
+ *Create the samples file and start the exporter writing the players'
+ *decisions to it.
+ */
+void open_samples() {
+    samplesFile = fopen(options.samples, "wb");
+    if (!samplesFile || !samples_write_header(samplesFile, playersCount)) {
+        error_return_dealer(stderr, E_DEALER_FILE_ERROR, 1);
+    }
+    samples_start(&samples, samplesFile, playersCount, SAMPLES_BUFFER_SIZE);
+}
+
+/*
+ *Read the counters of the dealer and of the players, which have ended,
+ *and sum them up per player over all tables for the report.
+ */
+void collect_counters() {
+    int seat = 0;
+
+    counters_read(&dealerCounters);
+    for (seat = 0; seat < seatsCount; seat++) {
+        counters_read(seatCounters + seat);
+        if (playersCount <= seat) {
+            counters_add(seatCounters + seat % playersCount,
+                    seatCounters + seat);
+        }
+    }
+    report.counters = &dealerCounters;
+    report.playerCounters = seatCounters;
+}
+
 /*
  *Handle the SIGHUP signal by interrupting the players.
  */
@@ -324,11 +584,15 @@ void signal_handler(int signal) {
 
     switch (signal) {
         case SIGHUP:
-            for (i = 0; i < playersCount; i++) {
-                fprintf(streamToPlayer[i][WRITE_END], "EARLY\n");
-                fflush(streamToPlayer[i][WRITE_END]);
+            for (i = 0; i < seatsCount; i++) {
+                if (!channels[i].outputClosed) {
+                    write(channels[i].writeFd, "EARLY\n", 6u);
+                }
+                if (handoff.slots) {
+                    handoff_close_seat(&handoff, i);
+                }
             }
-            for (i = 0; i < playersCount; i++) {
+            for (i = 0; i < seatsCount; i++) {
                 waitpid(pids[i], NULL, 0);
             }
     }
@@ -367,20 +631,48 @@ void verify_args(int argc, char* argv[], FILE** pathStream,
 int main(int argc, char* argv[]) {
     char** playerNames = NULL;
     int i = 0;
+    int status = EXIT_SUCCESS;
+    int journalWritten = 1;
+    int resultsWritten = 1;
+    int samplesWritten = 1;
     FILE* pathStream = NULL;
     FILE* deckStream = NULL;
     FILE* file = NULL;
 
     playersCount = 0;
-    playerPositions = NULL;
-    playerRankings = NULL;
 
+    report_start(&report);
     signal(SIGHUP, signal_handler);
+    /*A player which has gone is noticed by the failing write instead*/
+    signal(SIGPIPE, SIG_IGN);
+
+    /*Skip the options, so the positional arguments start at argv[1]*/
+    i = parse_options(argc, argv, &options);
+    argc -= i - 1;
+    argv += i - 1;
 
     verify_args(argc, argv, &pathStream, &deckStream);
 
+    /*Players are spawned into the dealer's scheduling class*/
+    if (-1 == placement_init(&placement, &options)) {
+        error_return_dealer(stderr, E_DEALER_INVALID_ARGS_COUNT, 1);
+    }
+    placement_apply_dealer(&placement);
+    report.placement = &placement;
+
+    /*Site types have to be known before the path is parsed*/
+    if (options.siteTable) {
+        file = fopen(options.siteTable, "r");
+        if (!file || E_OK != site_table_load(file)) {
+            error_return_dealer(stderr, E_DEALER_FILE_ERROR, 1);
+        }
+        fclose(file);
+        setenv(SITE_TABLE_VARIABLE, options.siteTable, 1);
+    }
+
     /*Remember the player program names*/
-    playerNames = malloc((argc - 3) * sizeof(char*));
+    arena_init(&arena, ARENA_BLOCK_SIZE);
+    playerNames = (char**)arena_alloc(&arena, (argc - 3) * sizeof(char*));
     for (i = 3; i < argc; i++, playersCount++) {
         playerNames[i - 3] = argv[i];
 
@@ -393,26 +685,120 @@ int main(int argc, char* argv[]) {
 
     }
 
-    for (i = 0; i < playersCount; i++) {
-        dealer_reset_player(players + i);
+    metrics_init(&metrics);
+    if (options.metrics && -1 == metrics_open(&metrics, options.metrics,
+            options.metricsInterval, playersCount)) {
+        error_return_dealer(stderr, E_DEALER_FILE_ERROR, 1);
     }
-    init_player_positions();
+
     get_path(pathStream);
     fclose(pathStream);
-    dealer_init_deck(deckStream, &deck);
+    dealer_init_deck(deckStream, &deck, &arena);
     fclose(deckStream);
+    if (options.journal) {
+        open_journal((const char**)playerNames);
+    }
+    if (options.results) {
+        open_results((const char**)playerNames);
+    }
+    if (options.samples) {
+        open_samples();
+    }
 
+    if (HANDOFF_FUTEX == options.handoff && -1 == handoff_create(&handoff,
+            options.tables * playersCount, options.handoffSpin)) {
+        /*Without memory files the turns go over the connections*/
+        options.handoff = HANDOFF_PIPE;
+    }
     start_players((const char**)playerNames);
+    counters_init(&dealerCounters);
+    if (options.counters) {
+        /*Only threads started from now on are counted along, no players*/
+        counters_open(&dealerCounters, 0, 1);
+    }
+    if (IO_URING == options.io && -1 == ring_init(&ring, seatsCount)) {
+        /*The kernel is too old or io_uring is disabled*/
+        options.io = IO_POLL;
+    }
+    if (IO_POLL == options.io
+            && -1 == channel_poll_init(&channelPoll, seatsCount)) {
+        error_return_dealer(stderr, E_DEALER_COMMS_ERROR, 1);
+    }
+    if (RENDER_ASYNC == options.render && -1 == renderer_start(&renderer,
+            options.renderQueue, playersCount, &path, &metrics)) {
+        options.render = RENDER_SYNC;
+    }
+    init_tables();
+    run_dealer();
+    if (RENDER_ASYNC == options.render) {
+        renderer_stop(&renderer);
+        report.framesRendered = renderer.rendered;
+        report.framesDropped = renderer.dropped;
+    }
+    metrics_close(&metrics, report_elapsed_ms(&report), channels, seatsCount);
+    if (journal) {
+        /*Set by any record which could not be written*/
+        journalWritten = !ferror(journal);
+        journalWritten = 0 == fclose(journal) && journalWritten;
+    }
+    if (resultsFile) {
+        resultsWritten = results_writer_free(&results);
+        resultsWritten = 0 == fclose(resultsFile) && resultsWritten;
+    }
+    if (samplesFile) {
+        samplesWritten = samples_stop(&samples);
+        samplesWritten = 0 == fclose(samplesFile) && samplesWritten;
+        report.samplesWritten = samples.records;
+        report.samplesWaits = samples.waits;
+    }
+    if (IO_URING == options.io) {
+        ring_free(&ring);
+    } else {
+        channel_poll_free(&channelPoll);
+    }
+    if (HANDOFF_FUTEX == options.handoff) {
+        handoff_destroy(&handoff);
+    }
 
-    for (i = 0; i < playersCount; i++) {
+    for (i = 0; i < seatsCount; i++) {
         waitpid(pids[i], NULL, 0);
     }
+    if (options.counters) {
+        collect_counters();
+    }
+
+    if (options.report) {
+        report_print(stderr, &report, playersCount, &arena);
+    }
 
-    free(playerPositions);
-    free(playerRankings);
-    free(playerNames);
-    free(deck.buffer);
+    /*The first table, which failed, determines the exit status*/
+    for (i = options.tables - 1; 0 <= i; i--) {
+        status = tables[i].status ? tables[i].status : status;
+        table_free(tables + i);
+    }
+    if (EXIT_SUCCESS == status && !resultsWritten) {
+        /*The games went fine, but not all of their scores are kept*/
+        error_return_dealer(stderr, E_DEALER_FILE_ERROR, 1);
+    }
+    if (EXIT_SUCCESS == status && !journalWritten) {
+        /*A journal cut short would replay as a different run*/
+        error_return_dealer(stderr, E_DEALER_FILE_ERROR, 1);
+    }
+    if (EXIT_SUCCESS == status && !samplesWritten) {
+        /*The file holds the decisions written before the failure*/
+        error_return_dealer(stderr, E_DEALER_FILE_ERROR, 1);
+    }
 
-    return EXIT_SUCCESS;
+    free(tables);
+    free(transcripts);
+    free(transcriptLengths);
+    free(awaited);
+    free(channels);
+    free(pids);
+    free(seatCounters);
+    player_free_path(&path);
+    arena_free(&arena);
+
+    return status;
 }
 
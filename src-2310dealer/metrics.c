@@ -0,0 +1,295 @@
+/*
+ *metrics.c
+ */
+
+/*
+ *accept4() is a GNU extension.
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "metrics.h"
+
+/*
+ *Connections waiting for the next export on the metrics socket.
+ */
+#define METRICS_BACKLOG 16
+
+/*
+ *Add to a counter.
+ */
+void add_counter(uint64_t* counter, uint64_t amount) {
+    __atomic_fetch_add(counter, amount, __ATOMIC_RELAXED);
+}
+
+/*
+ *Read a counter.
+ */
+uint64_t read_counter(const uint64_t* counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+/*
+ *Start without an export target, the counters are kept anyway.
+ */
+void metrics_init(DealerMetrics* metrics) {
+    memset(metrics, 0, sizeof(DealerMetrics));
+    metrics->listenFd = -1;
+}
+
+/*
+ *Listen on the Unix domain socket at the given path, replacing a stale one.
+ *Returns -1 on failure, the socket else.
+ */
+int listen_metrics(const char* path) {
+    struct sockaddr_un address;
+    int fd = -1;
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (0 > fd) {
+        return -1;
+    }
+    unlink(path);
+    if (0 != bind(fd, (struct sockaddr*)&address, sizeof(address))
+            || 0 != listen(fd, METRICS_BACKLOG)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ *Write one metric family in the Prometheus text format.
+ */
+void print_family(FILE* output, const char* name, const char* type,
+        const char* help) {
+    fprintf(output, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/*
+ *Write all metrics in the Prometheus text format.
+ */
+void print_metrics(FILE* output, const DealerMetrics* metrics, double nowMs,
+        const Channel* channels, int seatsCount) {
+    uint64_t moves = read_counter(&metrics->moves);
+    double elapsedMs = nowMs - metrics->lastExportMs;
+    size_t pending = 0u;
+    size_t mostPending = 0u;
+    int active = 0;
+    int i = 0;
+
+    for (i = 0; i < seatsCount; i++) {
+        pending += channels[i].outputLength;
+        mostPending = MAX(mostPending, channels[i].outputLength);
+        active += !channels[i].inputClosed && !channels[i].outputClosed;
+    }
+
+    print_family(output, "dealer_moves_total", "counter",
+            "Moves applied at all tables.");
+    fprintf(output, "dealer_moves_total %llu\n", (unsigned long long)moves);
+    print_family(output, "dealer_moves_per_second", "gauge",
+            "Moves applied per second since the previous export.");
+    fprintf(output, "dealer_moves_per_second %.3f\n", 0.0 < elapsedMs
+            ? (moves - metrics->lastMoves) * 1e3 / elapsedMs : 0.0);
+    print_family(output, "dealer_broadcast_bytes_total", "counter",
+            "Bytes of move broadcasts queued for the players.");
+    fprintf(output, "dealer_broadcast_bytes_total %llu\n",
+            (unsigned long long)read_counter(&metrics->broadcastBytes));
+    print_family(output, "dealer_reply_latency_seconds", "summary",
+            "Time from YT to the player's move, by player ID.");
+    for (i = 0; i < metrics->playersCount; i++) {
+        fprintf(output, "dealer_reply_latency_seconds_sum{player=\"%d\"} "
+                "%.9f\n", i, read_counter(metrics->replyNs + i) / 1e9);
+        fprintf(output, "dealer_reply_latency_seconds_count{player=\"%d\"} "
+                "%llu\n", i,
+                (unsigned long long)read_counter(metrics->replies + i));
+    }
+    print_family(output, "dealer_render_seconds_total", "counter",
+            "Time spent printing the board.");
+    fprintf(output, "dealer_render_seconds_total %.9f\n",
+            read_counter(&metrics->renderNs) / 1e9);
+    print_family(output, "dealer_pending_bytes", "gauge",
+            "Bytes queued for all players, not written yet.");
+    fprintf(output, "dealer_pending_bytes %zu\n", pending);
+    print_family(output, "dealer_pending_bytes_max", "gauge",
+            "Most bytes queued for a single player.");
+    fprintf(output, "dealer_pending_bytes_max %zu\n", mostPending);
+    print_family(output, "dealer_active_seats", "gauge",
+            "Seats still connected to their player.");
+    fprintf(output, "dealer_active_seats %d\n", active);
+}
+
+/*
+ *Replace the metrics file, through a temporary file, so a reader never
+ *sees a partial export.
+ *Returns -1 on failure, 0 else.
+ */
+int write_metrics_file(const char* path, const char* text, size_t length) {
+    char* temporary = NULL;
+    FILE* file = NULL;
+    int success = -1;
+
+    temporary = (char*)malloc(strlen(path) + 5);
+    sprintf(temporary, "%s.tmp", path);
+    file = fopen(temporary, "w");
+    if (file) {
+        success = length == fwrite(text, 1u, length, file) ? 0 : -1;
+        success = 0 != fclose(file) ? -1 : success;
+        success = 0 == success ? rename(temporary, path) : -1;
+    }
+    free(temporary);
+    return success;
+}
+
+/*
+ *Answer every connection waiting on the metrics socket with the export and
+ *close it. Clients which don't read it right away get nothing.
+ */
+void serve_metrics(int listenFd, const char* text, size_t length) {
+    int client = -1;
+
+    while (0 <= (client = accept4(listenFd, NULL, NULL, SOCK_CLOEXEC))
+            || EINTR == errno) {
+        if (0 <= client) {
+            send(client, text, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+            close(client);
+        }
+    }
+}
+
+/*
+ *Export all metrics to the target now.
+ *Returns -1 if the target can't be written, 0 else.
+ */
+int publish_metrics(DealerMetrics* metrics, double nowMs,
+        const Channel* channels, int seatsCount) {
+    FILE* output = NULL;
+    char* text = NULL;
+    size_t length = 0u;
+    int success = 0;
+
+    output = open_memstream(&text, &length);
+    print_metrics(output, metrics, nowMs, channels, seatsCount);
+    fclose(output);
+
+    if (0 <= metrics->listenFd) {
+        serve_metrics(metrics->listenFd, text, length);
+    } else {
+        success = write_metrics_file(metrics->target, text, length);
+    }
+    free(text);
+
+    metrics->lastExportMs = nowMs;
+    metrics->lastMoves = read_counter(&metrics->moves);
+    return success;
+}
+
+/*
+ *Export to the given file, or Unix domain socket if it starts with
+ *METRICS_SOCKET_PREFIX, every interval milliseconds.
+ *Returns -1 if the target can't be used, 0 else.
+ */
+int metrics_open(DealerMetrics* metrics, const char* target, int interval,
+        int playersCount) {
+    size_t prefixLength = strlen(METRICS_SOCKET_PREFIX);
+
+    metrics->target = target;
+    metrics->interval = interval;
+    metrics->playersCount = playersCount;
+    if (0 == strncmp(METRICS_SOCKET_PREFIX, target, prefixLength)) {
+        metrics->target = target + prefixLength;
+        metrics->listenFd = listen_metrics(metrics->target);
+        if (0 > metrics->listenFd) {
+            return -1;
+        }
+    }
+    /*Tell early if the file can't be written*/
+    return publish_metrics(metrics, 0.0, NULL, 0);
+}
+
+/*
+ *Count an applied move.
+ */
+void metrics_count_move(DealerMetrics* metrics) {
+    add_counter(&metrics->moves, 1u);
+}
+
+/*
+ *Count bytes of a move broadcast queued for the players.
+ */
+void metrics_count_broadcast(DealerMetrics* metrics, size_t bytes) {
+    add_counter(&metrics->broadcastBytes, bytes);
+}
+
+/*
+ *Count the time the given player took to reply to YT.
+ */
+void metrics_count_reply(DealerMetrics* metrics, int id, double ms) {
+    add_counter(metrics->replyNs + id, (uint64_t)(ms * 1e6));
+    add_counter(metrics->replies + id, 1u);
+}
+
+/*
+ *Count time spent printing the board.
+ */
+void metrics_count_render(DealerMetrics* metrics, double ms) {
+    add_counter(&metrics->renderNs, (uint64_t)(ms * 1e6));
+}
+
+/*
+ *Milliseconds until the next export is due, given the current time
+ *(milliseconds into the run).
+ *Returns -1 if there is no export target.
+ */
+int metrics_timeout(const DealerMetrics* metrics, double nowMs) {
+    double due = metrics->lastExportMs + metrics->interval - nowMs;
+
+    if (!metrics->target) {
+        return -1;
+    }
+    /*Round up, waking up early would only spin*/
+    return (int)MAX(due + 1.0, 0.0);
+}
+
+/*
+ *Export all metrics if the interval has passed. The queue depth and the
+ *active seats are taken from the channels.
+ */
+void metrics_export(DealerMetrics* metrics, double nowMs,
+        const Channel* channels, int seatsCount) {
+    if (metrics->target
+            && nowMs >= metrics->lastExportMs + metrics->interval) {
+        publish_metrics(metrics, nowMs, channels, seatsCount);
+    }
+}
+
+/*
+ *Export the final values and remove the socket, if any.
+ */
+void metrics_close(DealerMetrics* metrics, double nowMs,
+        const Channel* channels, int seatsCount) {
+    if (!metrics->target) {
+        return;
+    }
+    publish_metrics(metrics, nowMs, channels, seatsCount);
+    if (0 <= metrics->listenFd) {
+        close(metrics->listenFd);
+        unlink(metrics->target);
+        metrics->listenFd = -1;
+    }
+    metrics->target = NULL;
+}
@@ -0,0 +1,95 @@
+/*
+ *metrics.h
+ */
+
+#pragma once
+
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../inc/protocol.h"
+#include "channel.h"
+
+/*
+ *Prefix of a metrics target, which is a Unix domain socket, not a file.
+ */
+#define METRICS_SOCKET_PREFIX "unix:"
+
+/*
+ *Live counters of a dealer run, exported periodically in the Prometheus
+ *text format while the games go on.
+ *The counters are updated atomically, so they may be counted from other
+ *threads than the exporting one.
+ */
+typedef struct {
+    uint64_t moves;
+    uint64_t broadcastBytes;
+    uint64_t renderNs;
+    uint64_t replyNs[MAX_PLAYERS];
+    uint64_t replies[MAX_PLAYERS];
+    int playersCount;
+    const char* target;
+    int listenFd;
+    int interval;
+    double lastExportMs;
+    uint64_t lastMoves;
+} DealerMetrics;
+
+/*
+ *Start without an export target, the counters are kept anyway.
+ */
+void metrics_init(DealerMetrics* metrics);
+
+/*
+ *Export to the given file, or Unix domain socket if it starts with
+ *METRICS_SOCKET_PREFIX, every interval milliseconds.
+ *Returns -1 if the target can't be used, 0 else.
+ */
+int metrics_open(DealerMetrics* metrics, const char* target, int interval,
+        int playersCount);
+
+/*
+ *Count an applied move.
+ */
+void metrics_count_move(DealerMetrics* metrics);
+
+/*
+ *Count bytes of a move broadcast queued for the players.
+ */
+void metrics_count_broadcast(DealerMetrics* metrics, size_t bytes);
+
+/*
+ *Count the time the given player took to reply to YT.
+ */
+void metrics_count_reply(DealerMetrics* metrics, int id, double ms);
+
+/*
+ *Count time spent printing the board.
+ */
+void metrics_count_render(DealerMetrics* metrics, double ms);
+
+/*
+ *Milliseconds until the next export is due, given the current time
+ *(milliseconds into the run).
+ *Returns -1 if there is no export target.
+ */
+int metrics_timeout(const DealerMetrics* metrics, double nowMs);
+
+/*
+ *Export all metrics if the interval has passed. The queue depth and the
+ *active seats are taken from the channels.
+ */
+void metrics_export(DealerMetrics* metrics, double nowMs,
+        const Channel* channels, int seatsCount);
+
+/*
+ *Export the final values and remove the socket, if any.
+ */
+void metrics_close(DealerMetrics* metrics, double nowMs,
+        const Channel* channels, int seatsCount);
+
+#endif
+
@@ -0,0 +1,406 @@
+/*
+ *options.c
+ */
+
+/*
+ *SCHED_BATCH and SCHED_IDLE are GNU extensions.
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <limits.h>
+#include <sched.h>
+
+#include "../inc/errorReturn.h"
+#include "../inc/protocol.h"
+#include "options.h"
+
+/*
+ *Bytes queued per player before the queue policy applies, by default.
+ */
+#define DEFAULT_QUEUE_BUDGET 65536u
+/*
+ *Milliseconds between two metrics exports, by default.
+ */
+#define DEFAULT_METRICS_INTERVAL 1000
+/*
+ *Frames queued for the render thread, by default.
+ */
+#define DEFAULT_RENDER_QUEUE 64u
+
+/*
+ *Identifiers of the long options.
+ */
+enum OptionIds {
+    OPTION_DELIVERY = 1,
+    OPTION_QUEUE_BUDGET,
+    OPTION_QUEUE_POLICY,
+    OPTION_REPORT,
+    OPTION_GAMES,
+    OPTION_MOVE_TIMEOUT,
+    OPTION_GAME_TIMEOUT,
+    OPTION_ON_TIMEOUT,
+    OPTION_TABLES,
+    OPTION_TRANSPORT,
+    OPTION_IO,
+    OPTION_METRICS,
+    OPTION_METRICS_INTERVAL,
+    OPTION_PATH_WINDOW,
+    OPTION_SITE_TABLE,
+    OPTION_JOURNAL,
+    OPTION_RENDER,
+    OPTION_RENDER_QUEUE,
+    OPTION_PIN_DEALER,
+    OPTION_PLACEMENT,
+    OPTION_SCHED,
+    OPTION_HANDOFF,
+    OPTION_HANDOFF_SPIN,
+    OPTION_COUNTERS,
+    OPTION_RESULTS,
+    OPTION_SAMPLES
+};
+
+/*
+ *All the options the dealer understands.
+ */
+const struct option longOptions[] = {
+    { "delivery", required_argument, NULL, OPTION_DELIVERY },
+    { "queue-budget", required_argument, NULL, OPTION_QUEUE_BUDGET },
+    { "queue-policy", required_argument, NULL, OPTION_QUEUE_POLICY },
+    { "report", no_argument, NULL, OPTION_REPORT },
+    { "games", required_argument, NULL, OPTION_GAMES },
+    { "move-timeout", required_argument, NULL, OPTION_MOVE_TIMEOUT },
+    { "game-timeout", required_argument, NULL, OPTION_GAME_TIMEOUT },
+    { "on-timeout", required_argument, NULL, OPTION_ON_TIMEOUT },
+    { "tables", required_argument, NULL, OPTION_TABLES },
+    { "transport", required_argument, NULL, OPTION_TRANSPORT },
+    { "io", required_argument, NULL, OPTION_IO },
+    { "metrics", required_argument, NULL, OPTION_METRICS },
+    { "metrics-interval", required_argument, NULL,
+            OPTION_METRICS_INTERVAL },
+    { "path-window", required_argument, NULL, OPTION_PATH_WINDOW },
+    { "site-table", required_argument, NULL, OPTION_SITE_TABLE },
+    { "journal", required_argument, NULL, OPTION_JOURNAL },
+    { "render", required_argument, NULL, OPTION_RENDER },
+    { "render-queue", required_argument, NULL, OPTION_RENDER_QUEUE },
+    { "pin-dealer", required_argument, NULL, OPTION_PIN_DEALER },
+    { "placement", required_argument, NULL, OPTION_PLACEMENT },
+    { "sched", required_argument, NULL, OPTION_SCHED },
+    { "handoff", required_argument, NULL, OPTION_HANDOFF },
+    { "handoff-spin", required_argument, NULL, OPTION_HANDOFF_SPIN },
+    { "counters", no_argument, NULL, OPTION_COUNTERS },
+    { "results", required_argument, NULL, OPTION_RESULTS },
+    { "samples", required_argument, NULL, OPTION_SAMPLES },
+    { NULL, 0, NULL, 0 }
+};
+
+/*
+ *Set all options to their defaults.
+ */
+void reset_options(DealerOptions* options) {
+    memset(options, 0, sizeof(DealerOptions));
+    options->delivery = DELIVERY_EAGER;
+    options->queueBudget = DEFAULT_QUEUE_BUDGET;
+    options->queuePolicy = QUEUE_BLOCK;
+    options->games = 1;
+    options->moveTimeout = 0;
+    options->gameTimeout = 0;
+    options->timeoutPolicy = TIMEOUT_FORFEIT;
+    options->tables = 1;
+    options->transport = TRANSPORT_PIPE;
+    options->io = IO_POLL;
+    options->metrics = NULL;
+    options->metricsInterval = DEFAULT_METRICS_INTERVAL;
+    options->pathWindow = 0u;
+    options->siteTable = NULL;
+    options->journal = NULL;
+    options->results = NULL;
+    options->samples = NULL;
+    options->render = RENDER_SYNC;
+    options->renderQueue = DEFAULT_RENDER_QUEUE;
+    options->dealerCpu = -1;
+    options->placement = PLACEMENT_NONE;
+    options->schedPolicy = -1;
+    options->schedPriority = 0;
+    options->handoff = HANDOFF_PIPE;
+    options->handoffSpin = 0;
+}
+
+/*
+ *Convert the name of a delivery mode.
+ */
+enum DeliveryModes convert_delivery_mode(const char* name) {
+    if (0 == strcmp("eager", name)) {
+        return DELIVERY_EAGER;
+    } else if (0 == strcmp("lazy", name)) {
+        return DELIVERY_LAZY;
+    }
+    error_return_dealer(stderr, E_DEALER_INVALID_ARGS_COUNT, 1);
+    return DELIVERY_EAGER;
+}
+
+/*
+ *Convert the name of a queue policy.
+ */
+enum QueuePolicies convert_queue_policy(const char* name) {
+    if (0 == strcmp("block", name)) {
+        return QUEUE_BLOCK;
+    } else if (0 == strcmp("drop", name)) {
+        return QUEUE_DROP;
+    } else if (0 == strcmp("abort", name)) {
+        return QUEUE_ABORT;
+    }
+    error_return_dealer(stderr, E_DEALER_INVALID_ARGS_COUNT, 1);
+    return QUEUE_BLOCK;
+}
+
+/*
+ *Convert the name of a timeout policy.
+ */
+enum TimeoutPolicies convert_timeout_policy(const char* name) {
+    if (0 == strcmp("forfeit", name)) {
+        return TIMEOUT_FORFEIT;
+    } else if (0 == strcmp("kill", name)) {
+        return TIMEOUT_KILL;
+    } else if (0 == strcmp("abort", name)) {
+        return TIMEOUT_ABORT;
+    }
+    error_return_dealer(stderr, E_DEALER_INVALID_ARGS_COUNT, 1);
+    return TIMEOUT_FORFEIT;
+}
+
+/*
+ *Convert the name of a transport.
+ */
+enum Transports convert_transport(const char* name) {
+    if (0 == strcmp("pipe", name)) {
+        return TRANSPORT_PIPE;
+    } else if (0 == strcmp("seqpacket", name)) {
+        return TRANSPORT_SEQPACKET;
+    }
+    error_return_dealer(stderr, E_DEALER_INVALID_ARGS_COUNT, 1);
+    return TRANSPORT_PIPE;
+}
+
+/*
+ *Convert the name of an I/O backend.
+ */
+enum IoBackends convert_io_backend(const char* name) {
+    if (0 == strcmp("poll", name)) {
+        return IO_POLL;
+    } else if (0 == strcmp("uring", name)) {
+        return IO_URING;
+    }
+    error_return_dealer(stderr, E_DEALER_INVALID_ARGS_COUNT, 1);
+    return IO_POLL;
+}
+
+/*
+ *Convert the name of a render mode.
+ */
+enum RenderModes convert_render_mode(const char* name) {
+    if (0 == strcmp("sync", name)) {
+        return RENDER_SYNC;
+    } else if (0 == strcmp("async", name)) {
+        return RENDER_ASYNC;
+    }
+    error_return_dealer(stderr, E_DEALER_INVALID_ARGS_COUNT, 1);
+    return RENDER_SYNC;
+}
+
+/*
+ *Convert the name of a turn handoff.
+ */
+enum TurnHandoffs convert_handoff(const char* name) {
+    if (0 == strcmp("pipe", name)) {
+        return HANDOFF_PIPE;
+    } else if (0 == strcmp("futex", name)) {
+        return HANDOFF_FUTEX;
+    }
+    error_return_dealer(stderr, E_DEALER_INVALID_ARGS_COUNT, 1);
+    return HANDOFF_PIPE;
+}
+
+/*
+ *Convert the name of a player placement.
+ */
+enum PlayerPlacements convert_placement(const char* name) {
+    if (0 == strcmp("none", name)) {
+        return PLACEMENT_NONE;
+    } else if (0 == strcmp("colocate", name)) {
+        return PLACEMENT_COLOCATE;
+    } else if (0 == strcmp("spread", name)) {
+        return PLACEMENT_SPREAD;
+    }
+    error_return_dealer(stderr, E_DEALER_INVALID_ARGS_COUNT, 1);
+    return PLACEMENT_NONE;
+}
+
+/*
+ *Convert a non-negative number.
+ */
+long convert_number(const char* text) {
+    char* end = NULL;
+    long number = 0;
+
+    number = strtol(text, &end, 10);
+    if (end == text || '\0' != *end || 0 > number) {
+        error_return_dealer(stderr, E_DEALER_INVALID_ARGS_COUNT, 1);
+    }
+    return number;
+}
+
+/*
+ *Convert a scheduling class, other, batch or idle, or fifo or rr followed
+ *by a colon and the real-time priority.
+ */
+void convert_sched(const char* text, DealerOptions* options) {
+    const char* colon = strchr(text, ':');
+    size_t length = colon ? (size_t)(colon - text) : strlen(text);
+    int realTime = 0;
+
+    options->schedPriority = 0;
+    if (5 == length && 0 == strncmp("other", text, length)) {
+        options->schedPolicy = SCHED_OTHER;
+    } else if (5 == length && 0 == strncmp("batch", text, length)) {
+        options->schedPolicy = SCHED_BATCH;
+    } else if (4 == length && 0 == strncmp("idle", text, length)) {
+        options->schedPolicy = SCHED_IDLE;
+    } else if (4 == length && 0 == strncmp("fifo", text, length)) {
+        options->schedPolicy = SCHED_FIFO;
+        realTime = 1;
+    } else if (2 == length && 0 == strncmp("rr", text, length)) {
+        options->schedPolicy = SCHED_RR;
+        realTime = 1;
+    } else {
+        error_return_dealer(stderr, E_DEALER_INVALID_ARGS_COUNT, 1);
+    }
+
+    /*Only the real-time classes have a priority, and need one*/
+    if (realTime != !!colon) {
+        error_return_dealer(stderr, E_DEALER_INVALID_ARGS_COUNT, 1);
+    }
+    if (realTime) {
+        options->schedPriority = (int)convert_number(colon + 1);
+        if (sched_get_priority_min(options->schedPolicy)
+                > options->schedPriority || options->schedPriority
+                > sched_get_priority_max(options->schedPolicy)) {
+            error_return_dealer(stderr, E_DEALER_INVALID_ARGS_COUNT, 1);
+        }
+    }
+}
+
+/*
+ *Parse the leading --name=value options.
+ *Returns the index of the first positional argument.
+ */
+int parse_options(int argc, char* argv[], DealerOptions* options) {
+    int option = 0;
+
+    reset_options(options);
+    opterr = 0;
+
+    /*Stop at the first positional argument, player names follow it*/
+    while (-1 != (option = getopt_long(argc, argv, "+", longOptions,
+            NULL))) {
+        switch (option) {
+            case OPTION_DELIVERY:
+                options->delivery = convert_delivery_mode(optarg);
+                break;
+            case OPTION_QUEUE_BUDGET:
+                options->queueBudget = (size_t)convert_number(optarg);
+                break;
+            case OPTION_QUEUE_POLICY:
+                options->queuePolicy = convert_queue_policy(optarg);
+                break;
+            case OPTION_REPORT:
+                options->report = 1;
+                break;
+            case OPTION_GAMES:
+                options->games = (int)MIN(MAX(convert_number(optarg), 1),
+                        INT_MAX);
+                break;
+            case OPTION_MOVE_TIMEOUT:
+                options->moveTimeout = (int)MIN(convert_number(optarg),
+                        INT_MAX);
+                break;
+            case OPTION_GAME_TIMEOUT:
+                options->gameTimeout = (int)MIN(convert_number(optarg),
+                        INT_MAX);
+                break;
+            case OPTION_ON_TIMEOUT:
+                options->timeoutPolicy = convert_timeout_policy(optarg);
+                break;
+            case OPTION_TABLES:
+                options->tables = (int)MIN(MAX(convert_number(optarg), 1),
+                        INT_MAX);
+                break;
+            case OPTION_TRANSPORT:
+                options->transport = convert_transport(optarg);
+                break;
+            case OPTION_IO:
+                options->io = convert_io_backend(optarg);
+                break;
+            case OPTION_METRICS:
+                options->metrics = optarg;
+                break;
+            case OPTION_METRICS_INTERVAL:
+                options->metricsInterval = (int)MIN(MAX(
+                        convert_number(optarg), 1), INT_MAX);
+                break;
+            case OPTION_PATH_WINDOW:
+                options->pathWindow = (size_t)convert_number(optarg);
+                break;
+            case OPTION_SITE_TABLE:
+                options->siteTable = optarg;
+                break;
+            case OPTION_JOURNAL:
+                options->journal = optarg;
+                break;
+            case OPTION_RENDER:
+                options->render = convert_render_mode(optarg);
+                break;
+            case OPTION_RENDER_QUEUE:
+                /*One frame is being printed, another one replaced*/
+                options->renderQueue = (size_t)MAX(convert_number(optarg),
+                        2);
+                break;
+            case OPTION_PIN_DEALER:
+                options->dealerCpu = (int)MIN(convert_number(optarg),
+                        INT_MAX);
+                break;
+            case OPTION_PLACEMENT:
+                options->placement = convert_placement(optarg);
+                break;
+            case OPTION_SCHED:
+                convert_sched(optarg, options);
+                break;
+            case OPTION_HANDOFF:
+                options->handoff = convert_handoff(optarg);
+                break;
+            case OPTION_HANDOFF_SPIN:
+                options->handoffSpin = (int)MIN(convert_number(optarg),
+                        INT_MAX);
+                break;
+            case OPTION_COUNTERS:
+                /*The counts are only shown in the report*/
+                options->counters = 1;
+                options->report = 1;
+                break;
+            case OPTION_RESULTS:
+                options->results = optarg;
+                break;
+            case OPTION_SAMPLES:
+                options->samples = optarg;
+                break;
+            default:
+                error_return_dealer(stderr, E_DEALER_INVALID_ARGS_COUNT, 1);
+        }
+    }
+
+    return optind;
+}
+
@@ -0,0 +1,155 @@
+/*
+ *options.h
+ */
+
+#pragma once
+
+#ifndef __OPTIONS_H__
+#define __OPTIONS_H__
+
+#include <stddef.h>
+
+/*
+ *How move broadcasts are delivered to the players.
+ *EAGER .. Write and flush HAP to every player right after each move.
+ *LAZY .. Queue HAP per player and flush it together with the player's next
+ *YT (or DONE).
+ */
+enum DeliveryModes {
+    DELIVERY_EAGER, DELIVERY_LAZY
+};
+
+/*
+ *What to do if a player's output queue exceeds its budget.
+ *BLOCK .. Wait until the player has read enough.
+ *DROP .. Disconnect the player, the dealer moves the seat from then on.
+ *ABORT .. End the game for everybody with EARLY.
+ */
+enum QueuePolicies {
+    QUEUE_BLOCK, QUEUE_DROP, QUEUE_ABORT
+};
+
+/*
+ *What to do if a player misses its deadline for a move.
+ *FORFEIT .. The dealer makes this move for the player, a late answer is
+ *discarded.
+ *KILL .. Kill the player, the dealer moves the seat from then on.
+ *ABORT .. End the game for everybody with EARLY.
+ */
+enum TimeoutPolicies {
+    TIMEOUT_FORFEIT, TIMEOUT_KILL, TIMEOUT_ABORT
+};
+
+/*
+ *How the dealer is connected to each player.
+ *PIPE .. One pipe in each direction.
+ *SEQPACKET .. A single Unix domain SOCK_SEQPACKET socket.
+ */
+enum Transports {
+    TRANSPORT_PIPE, TRANSPORT_SEQPACKET
+};
+
+/*
+ *How the dealer waits for and writes to the players.
+ *POLL .. poll() and a read or write per player and message.
+ *URING .. io_uring with reads posted on all players and the writes of all
+ *players submitted together. Falls back to POLL if the kernel lacks it.
+ */
+enum IoBackends {
+    IO_POLL, IO_URING
+};
+
+/*
+ *How the board is printed.
+ *SYNC .. By the event loop right after each move.
+ *ASYNC .. By a render thread from snapshots the event loop queues, dropping
+ *frames while it is behind, see render.h.
+ */
+enum RenderModes {
+    RENDER_SYNC, RENDER_ASYNC
+};
+
+/*
+ *How a player is given its turn and answers it.
+ *PIPE .. YT and DO over the player's connection.
+ *FUTEX .. In a turn slot in shared memory, woken by a futex. Everything
+ *else still goes over the connection, see handoff.h.
+ */
+enum TurnHandoffs {
+    HANDOFF_PIPE, HANDOFF_FUTEX
+};
+
+/*
+ *Where the players run.
+ *NONE .. Wherever the scheduler puts them.
+ *COLOCATE .. On the dealer's CPU, so every move is handed over on the
+ *same core. The dealer is pinned to its first allowed CPU, unless
+ *--pin-dealer says otherwise.
+ *SPREAD .. Seat after seat on the next allowed CPU, leaving out the
+ *dealer's one while there are others.
+ */
+enum PlayerPlacements {
+    PLACEMENT_NONE, PLACEMENT_COLOCATE, PLACEMENT_SPREAD
+};
+
+/*
+ *Tuning options of the dealer given ahead of the positional arguments.
+ *pathWindow .. Sites per chunk of the path the players keep in memory
+ *around their positions, 0 to keep the whole path.
+ *siteTable .. File describing the site types, NULL for the built-in ones.
+ *journal .. File to record the moves of all games in, NULL for none.
+ *renderQueue .. Frames queued for the render thread at most.
+ *dealerCpu .. CPU to pin the dealer to, -1 to leave it unpinned.
+ *schedPolicy, schedPriority .. Scheduling class of the dealer and the
+ *players, -1 to keep the inherited one.
+ *handoffSpin .. Times the dealer and the players look at a turn slot
+ *before they sleep on it.
+ *counters .. Count hardware events of the dealer and the players, with
+ *all their threads, for the report, which it turns on.
+ *results .. File to append the scores of all games to, NULL for none.
+ *samples .. File to record the players' decisions with the outcomes of
+ *their games in, NULL for none.
+ */
+typedef struct {
+    enum DeliveryModes delivery;
+    size_t queueBudget;
+    enum QueuePolicies queuePolicy;
+    int report;
+    int games;
+    int moveTimeout;
+    int gameTimeout;
+    enum TimeoutPolicies timeoutPolicy;
+    int tables;
+    enum Transports transport;
+    enum IoBackends io;
+    const char* metrics;
+    int metricsInterval;
+    size_t pathWindow;
+    const char* siteTable;
+    const char* journal;
+    enum RenderModes render;
+    size_t renderQueue;
+    int dealerCpu;
+    enum PlayerPlacements placement;
+    int schedPolicy;
+    int schedPriority;
+    enum TurnHandoffs handoff;
+    int handoffSpin;
+    int counters;
+    const char* results;
+    const char* samples;
+} DealerOptions;
+
+/*
+ *Set all options to their defaults.
+ */
+void reset_options(DealerOptions* options);
+
+/*
+ *Parse the leading --name=value options.
+ *Returns the index of the first positional argument.
+ */
+int parse_options(int argc, char* argv[], DealerOptions* options);
+
+#endif
+
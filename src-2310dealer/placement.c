@@ -0,0 +1,210 @@
+/*
+ *placement.c
+ */
+
+/*
+ *CPU affinity and SCHED_BATCH are GNU extensions.
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <spawn.h>
+#include <sys/types.h>
+
+#include "placement.h"
+
+/*
+ *Take the placement asked for by the options, with the CPUs the dealer
+ *may run on now.
+ *Returns -1 if the dealer's CPU is not one of them, 0 else.
+ */
+int placement_init(Placement* placement, const DealerOptions* options) {
+    cpu_set_t allowed;
+    int cpu = 0;
+
+    memset(placement, 0, sizeof(Placement));
+    placement->dealerCpu = options->dealerCpu;
+    placement->players = options->placement;
+    placement->policy = options->schedPolicy;
+    placement->priority = options->schedPriority;
+
+    CPU_ZERO(&allowed);
+    if (0 == sched_getaffinity(0, sizeof(cpu_set_t), &allowed)) {
+        for (cpu = 0; cpu < PLACEMENT_MAX_CPUS; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                placement->cpus[placement->cpusCount++] = cpu;
+            }
+        }
+    }
+
+    if (-1 != placement->dealerCpu && (PLACEMENT_MAX_CPUS
+            <= placement->dealerCpu
+            || !CPU_ISSET(placement->dealerCpu, &allowed))) {
+        return -1;
+    }
+    /*Colocated players need the dealer to stay on one CPU*/
+    if (PLACEMENT_COLOCATE == placement->players
+            && -1 == placement->dealerCpu && placement->cpusCount) {
+        placement->dealerCpu = placement->cpus[0];
+    }
+    return 0;
+}
+
+/*
+ *Pin the dealer and switch it to the scheduling class. Failures are noted
+ *for the report, the dealer runs on as it is.
+ */
+void placement_apply_dealer(Placement* placement) {
+    struct sched_param parameter;
+    cpu_set_t set;
+
+    if (-1 != placement->dealerCpu) {
+        CPU_ZERO(&set);
+        CPU_SET(placement->dealerCpu, &set);
+        if (0 != sched_setaffinity(0, sizeof(cpu_set_t), &set)) {
+            placement->dealerCpu = -1;
+        }
+    }
+
+    if (-1 != placement->policy) {
+        memset(&parameter, 0, sizeof(parameter));
+        parameter.sched_priority = placement->priority;
+        /*Real-time classes take CAP_SYS_NICE or an RLIMIT_RTPRIO*/
+        placement->denied = 0 != sched_setscheduler(0, placement->policy,
+                &parameter);
+    }
+}
+
+/*
+ *Set up the attributes of spawning a player, so it starts in the
+ *scheduling class of the dealer.
+ */
+void placement_spawn_attributes(const Placement* placement,
+        posix_spawnattr_t* attributes) {
+    struct sched_param parameter;
+
+    posix_spawnattr_init(attributes);
+    if (-1 == placement->policy || placement->denied) {
+        return;
+    }
+    memset(&parameter, 0, sizeof(parameter));
+    parameter.sched_priority = placement->priority;
+    posix_spawnattr_setschedpolicy(attributes, placement->policy);
+    posix_spawnattr_setschedparam(attributes, &parameter);
+    posix_spawnattr_setflags(attributes, POSIX_SPAWN_SETSCHEDULER);
+}
+
+/*
+ *CPU the next player is pinned to, -1 for none.
+ */
+int next_player_cpu(Placement* placement) {
+    int cpu = -1;
+
+    switch (placement->players) {
+        case PLACEMENT_NONE:
+            break;
+        case PLACEMENT_COLOCATE:
+            cpu = placement->dealerCpu;
+            break;
+        case PLACEMENT_SPREAD:
+            if (!placement->cpusCount) {
+                break;
+            }
+            cpu = placement->cpus[placement->nextCpu++
+                    % placement->cpusCount];
+            /*Keep the dealer's CPU to itself while there are others*/
+            if (cpu == placement->dealerCpu && 1 < placement->cpusCount) {
+                cpu = placement->cpus[placement->nextCpu++
+                        % placement->cpusCount];
+            }
+            break;
+    }
+    return cpu;
+}
+
+/*
+ *Pin a freshly spawned player to its CPU, if the placement asks for it.
+ *The player may have run its first instructions elsewhere by then, which
+ *is long before its first move.
+ */
+void placement_pin_player(Placement* placement, pid_t pid) {
+    cpu_set_t set;
+    int cpu = 0;
+
+    if (PLACEMENT_NONE == placement->players) {
+        return;
+    }
+    cpu = next_player_cpu(placement);
+    CPU_ZERO(&set);
+    if (-1 != cpu) {
+        CPU_SET(cpu, &set);
+    }
+    if (-1 == cpu || 0 != sched_setaffinity(pid, sizeof(cpu_set_t), &set)) {
+        placement->pinFailures += 1;
+        return;
+    }
+    if (!placement->used[cpu]) {
+        placement->used[cpu] = 1;
+        placement->playerCpus += 1;
+    }
+}
+
+/*
+ *Name of a scheduling class.
+ */
+const char* sched_policy_name(int policy) {
+    switch (policy) {
+        case SCHED_OTHER:
+            return "other";
+        case SCHED_BATCH:
+            return "batch";
+        case SCHED_IDLE:
+            return "idle";
+        case SCHED_FIFO:
+            return "fifo";
+        case SCHED_RR:
+            return "rr";
+        default:
+            return "inherited";
+    }
+}
+
+/*
+ *Print where the dealer and the players run, as a line of the report.
+ */
+void placement_print(FILE* output, const Placement* placement) {
+    fprintf(output, "Placement: ");
+    if (-1 == placement->dealerCpu) {
+        fprintf(output, "dealer unpinned");
+    } else {
+        fprintf(output, "dealer on CPU %d", placement->dealerCpu);
+    }
+
+    switch (placement->players) {
+        case PLACEMENT_NONE:
+            fprintf(output, ", players unpinned");
+            break;
+        case PLACEMENT_COLOCATE:
+            fprintf(output, ", players colocated with it");
+            break;
+        case PLACEMENT_SPREAD:
+            fprintf(output, ", players spread over %d CPUs",
+                    placement->playerCpus);
+            break;
+    }
+    if (placement->pinFailures) {
+        fprintf(output, " (%d not pinned)", placement->pinFailures);
+    }
+
+    fprintf(output, ", class %s", sched_policy_name(placement->policy));
+    if (SCHED_FIFO == placement->policy || SCHED_RR == placement->policy) {
+        fprintf(output, ":%d", placement->priority);
+    }
+    if (placement->denied) {
+        fprintf(output, " (denied)");
+    }
+    fputc('\n', output);
+}
+
@@ -0,0 +1,81 @@
+/*
+ *placement.h
+ */
+
+#pragma once
+
+#ifndef __PLACEMENT_H__
+#define __PLACEMENT_H__
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <spawn.h>
+
+#include "options.h"
+
+/*
+ *CPUs a placement can tell apart, as many as a cpu_set_t holds.
+ */
+#define PLACEMENT_MAX_CPUS 1024
+
+/*
+ *Where the dealer and the players have been put, and in which scheduling
+ *class they run.
+ *cpus .. CPUs the dealer was allowed on at the start, the players are
+ *pinned to these.
+ *dealerCpu .. CPU the dealer is pinned to, -1 if it is not.
+ *used .. Set for every CPU a player has been pinned to.
+ *playerCpus .. Number of CPUs the players have been pinned to.
+ *pinFailures .. Players the kernel has refused to pin.
+ *nextCpu .. Index of cpus the next player is spread to.
+ *policy, priority .. Scheduling class asked for, -1 to keep the inherited
+ *one.
+ *denied .. Set if the dealer may not switch to that class, the players
+ *keep the inherited one then as well.
+ */
+typedef struct {
+    int cpus[PLACEMENT_MAX_CPUS];
+    int cpusCount;
+    int dealerCpu;
+    enum PlayerPlacements players;
+    unsigned char used[PLACEMENT_MAX_CPUS];
+    int playerCpus;
+    int pinFailures;
+    int nextCpu;
+    int policy;
+    int priority;
+    int denied;
+} Placement;
+
+/*
+ *Take the placement asked for by the options, with the CPUs the dealer
+ *may run on now.
+ *Returns -1 if the dealer's CPU is not one of them, 0 else.
+ */
+int placement_init(Placement* placement, const DealerOptions* options);
+
+/*
+ *Pin the dealer and switch it to the scheduling class. Failures are noted
+ *for the report, the dealer runs on as it is.
+ */
+void placement_apply_dealer(Placement* placement);
+
+/*
+ *Set up the attributes of spawning a player, so it starts in the
+ *scheduling class of the dealer.
+ */
+void placement_spawn_attributes(const Placement* placement,
+        posix_spawnattr_t* attributes);
+
+/*
+ *Pin a freshly spawned player to its CPU, if the placement asks for it.
+ */
+void placement_pin_player(Placement* placement, pid_t pid);
+
+/*
+ *Print where the dealer and the players run, as a line of the report.
+ */
+void placement_print(FILE* output, const Placement* placement);
+
+#endif
+
@@ -0,0 +1,255 @@
+/*
+ *render.c
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "../inc/protocol.h"
+#include "render.h"
+
+/*
+ *Frame at the given position of the queue.
+ */
+RenderFrame* frame_at(Renderer* renderer, size_t position) {
+    return renderer->frames + position % renderer->length;
+}
+
+/*
+ *Milliseconds of a monotonic clock.
+ */
+double render_now() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+/*
+ *Print a frame like the event loop would have printed it.
+ */
+void render_frame(Renderer* renderer, RenderFrame* frame) {
+    switch (frame->type) {
+        case FRAME_MOVE:
+            player_print_earnings(frame->output, frame->id,
+                    frame->players + frame->id);
+            /*Fall through*/
+        case FRAME_BOARD:
+            player_print_path(frame->output, &renderer->path,
+                    renderer->playersCount, renderer->path.siteCount,
+                    frame->positions, frame->rankings, 0);
+            break;
+        case FRAME_SCORES:
+            player_print_scores(frame->output, renderer->playersCount,
+                    frame->players);
+            break;
+        case FRAME_TEXT:
+            fprintf(frame->output, "%s\n", frame->text);
+            break;
+    }
+}
+
+/*
+ *Print the queued frames until the renderer is stopped. The output is
+ *flushed whenever the thread has caught up.
+ */
+void* render_thread(void* argument) {
+    Renderer* renderer = (Renderer*)argument;
+    RenderFrame* frame = NULL;
+    double start = 0.0;
+    int caughtUp = 0;
+
+    pthread_mutex_lock(&renderer->lock);
+    while (1) {
+        while (renderer->head == renderer->tail && !renderer->stopping) {
+            pthread_cond_wait(&renderer->changed, &renderer->lock);
+        }
+        if (renderer->head == renderer->tail) {
+            break;
+        }
+        frame = frame_at(renderer, renderer->head);
+        pthread_mutex_unlock(&renderer->lock);
+
+        start = render_now();
+        render_frame(renderer, frame);
+        metrics_count_render(renderer->metrics, render_now() - start);
+
+        pthread_mutex_lock(&renderer->lock);
+        caughtUp = renderer->head + 1 == renderer->tail;
+        pthread_mutex_unlock(&renderer->lock);
+        if (caughtUp) {
+            fflush(frame->output);
+        }
+
+        pthread_mutex_lock(&renderer->lock);
+        renderer->head += 1;
+        renderer->rendered += 1;
+        pthread_cond_broadcast(&renderer->changed);
+    }
+    pthread_mutex_unlock(&renderer->lock);
+    return NULL;
+}
+
+/*
+ *Start the render thread with a queue of the given number of frames for
+ *tables of the given number of players.
+ *Returns -1 if the thread can't be started, 0 else.
+ */
+int renderer_start(Renderer* renderer, size_t length, int playersCount,
+        const Path* path, DealerMetrics* metrics) {
+    RenderFrame* frame = NULL;
+    size_t i = 0u;
+
+    memset(renderer, 0, sizeof(Renderer));
+    arena_init(&renderer->arena, ARENA_BLOCK_SIZE);
+    renderer->length = MAX(length, 2u);
+    renderer->playersCount = playersCount;
+    renderer->path = *path;
+    renderer->path.arena = &renderer->arena;
+    renderer->metrics = metrics;
+
+    renderer->frames = (RenderFrame*)arena_calloc(&renderer->arena,
+            renderer->length, sizeof(RenderFrame));
+    for (i = 0u; i < renderer->length; i++) {
+        frame = renderer->frames + i;
+        frame->players = (Player*)arena_alloc(&renderer->arena,
+                playersCount * sizeof(Player));
+        frame->positions = (int*)arena_alloc(&renderer->arena,
+                playersCount * sizeof(int));
+        frame->rankings = (int*)arena_alloc(&renderer->arena,
+                playersCount * sizeof(int));
+    }
+
+    pthread_mutex_init(&renderer->lock, NULL);
+    pthread_cond_init(&renderer->changed, NULL);
+    if (0 != pthread_create(&renderer->thread, NULL, render_thread,
+            renderer)) {
+        pthread_cond_destroy(&renderer->changed);
+        pthread_mutex_destroy(&renderer->lock);
+        arena_free(&renderer->arena);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ *Take the frame to fill with a snapshot, with the lock held until
+ *release_frame(). If the queue is full, a MOVE frame replaces the newest
+ *MOVE frame of its output, which is waiting to be printed, else it waits.
+ */
+RenderFrame* acquire_frame(Renderer* renderer, enum FrameTypes type,
+        FILE* output) {
+    RenderFrame* frame = NULL;
+    size_t i = 0u;
+
+    pthread_mutex_lock(&renderer->lock);
+    while (renderer->tail - renderer->head == renderer->length) {
+        /*The frame at head may be printed right now*/
+        for (i = renderer->tail - 1u; FRAME_MOVE == type
+                && renderer->head < i; i--) {
+            frame = frame_at(renderer, i);
+            if (output == frame->output) {
+                break;
+            }
+        }
+        if (FRAME_MOVE == type && renderer->head < i
+                && FRAME_MOVE == frame->type) {
+            renderer->dropped += 1;
+            return frame;
+        }
+        pthread_cond_wait(&renderer->changed, &renderer->lock);
+    }
+
+    frame = frame_at(renderer, renderer->tail);
+    renderer->tail += 1;
+    frame->type = type;
+    frame->output = output;
+    return frame;
+}
+
+/*
+ *Hand the filled frame over to the render thread.
+ */
+void release_frame(Renderer* renderer) {
+    pthread_cond_broadcast(&renderer->changed);
+    pthread_mutex_unlock(&renderer->lock);
+}
+
+/*
+ *Queue the path with all players at their positions.
+ */
+void renderer_board(Renderer* renderer, FILE* output, const int* positions,
+        const int* rankings) {
+    RenderFrame* frame = acquire_frame(renderer, FRAME_BOARD, output);
+
+    memcpy(frame->positions, positions,
+            renderer->playersCount * sizeof(int));
+    memcpy(frame->rankings, rankings, renderer->playersCount * sizeof(int));
+    release_frame(renderer);
+}
+
+/*
+ *Queue the earnings of the player who moved and the path.
+ */
+void renderer_move(Renderer* renderer, FILE* output, int id,
+        const Player* player, const int* positions, const int* rankings) {
+    RenderFrame* frame = acquire_frame(renderer, FRAME_MOVE, output);
+
+    frame->id = id;
+    frame->players[id] = *player;
+    memcpy(frame->positions, positions,
+            renderer->playersCount * sizeof(int));
+    memcpy(frame->rankings, rankings, renderer->playersCount * sizeof(int));
+    release_frame(renderer);
+}
+
+/*
+ *Queue the final scores of all players.
+ */
+void renderer_scores(Renderer* renderer, FILE* output,
+        const Player* players) {
+    RenderFrame* frame = acquire_frame(renderer, FRAME_SCORES, output);
+
+    memcpy(frame->players, players,
+            renderer->playersCount * sizeof(Player));
+    release_frame(renderer);
+}
+
+/*
+ *Queue a line of static text.
+ */
+void renderer_text(Renderer* renderer, FILE* output, const char* text) {
+    RenderFrame* frame = acquire_frame(renderer, FRAME_TEXT, output);
+
+    frame->text = text;
+    release_frame(renderer);
+}
+
+/*
+ *Wait until every queued frame has been printed and flushed.
+ */
+void renderer_drain(Renderer* renderer) {
+    pthread_mutex_lock(&renderer->lock);
+    while (renderer->head != renderer->tail) {
+        pthread_cond_wait(&renderer->changed, &renderer->lock);
+    }
+    pthread_mutex_unlock(&renderer->lock);
+}
+
+/*
+ *Print what is queued, end the thread and release the queue.
+ */
+void renderer_stop(Renderer* renderer) {
+    pthread_mutex_lock(&renderer->lock);
+    renderer->stopping = 1;
+    pthread_cond_broadcast(&renderer->changed);
+    pthread_mutex_unlock(&renderer->lock);
+    pthread_join(renderer->thread, NULL);
+
+    pthread_cond_destroy(&renderer->changed);
+    pthread_mutex_destroy(&renderer->lock);
+    arena_free(&renderer->arena);
+}
+
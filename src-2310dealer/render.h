@@ -0,0 +1,114 @@
+/*
+ *render.h
+ */
+
+#pragma once
+
+#ifndef __RENDER_H__
+#define __RENDER_H__
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include "../inc/protocol.h"
+#include "metrics.h"
+
+/*
+ *Kinds of output the render thread prints.
+ *BOARD .. The path with all players, at the start of a game.
+ *MOVE .. The earnings of the player who moved and the path.
+ *SCORES .. The final scores of a game.
+ *TEXT .. A line of text, e.g. an error message.
+ */
+enum FrameTypes {
+    FRAME_BOARD, FRAME_MOVE, FRAME_SCORES, FRAME_TEXT
+};
+
+/*
+ *Snapshot of what a table prints, taken when it happened.
+ *players .. Earnings of all players for SCORES, only the one of id is set
+ *for MOVE.
+ *text .. Static text of TEXT.
+ */
+typedef struct {
+    enum FrameTypes type;
+    FILE* output;
+    int id;
+    Player* players;
+    int* positions;
+    int* rankings;
+    const char* text;
+} RenderFrame;
+
+/*
+ *Thread printing the boards of all tables from a queue of frames, so the
+ *event loop never waits for a slow output.
+ *If the queue is full, the newest MOVE frame of the same output which is
+ *not printed yet is replaced by the new one, so frames are dropped while
+ *the thread is behind. Every other frame is waited for, so the last board
+ *of a game, followed by the scores, is always printed.
+ *frames .. Ring of length frames, those from head up to tail are queued.
+ *The one at head is the one being printed.
+ *path .. Copy of the path, printed with scratch memory of the thread's
+ *arena.
+ */
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    RenderFrame* frames;
+    size_t length;
+    size_t head;
+    size_t tail;
+    int stopping;
+    int playersCount;
+    Path path;
+    Arena arena;
+    DealerMetrics* metrics;
+    unsigned long rendered;
+    unsigned long dropped;
+} Renderer;
+
+/*
+ *Start the render thread with a queue of the given number of frames for
+ *tables of the given number of players.
+ *Returns -1 if the thread can't be started, 0 else.
+ */
+int renderer_start(Renderer* renderer, size_t length, int playersCount,
+        const Path* path, DealerMetrics* metrics);
+
+/*
+ *Queue the path with all players at their positions.
+ */
+void renderer_board(Renderer* renderer, FILE* output, const int* positions,
+        const int* rankings);
+
+/*
+ *Queue the earnings of the player who moved and the path.
+ */
+void renderer_move(Renderer* renderer, FILE* output, int id,
+        const Player* player, const int* positions, const int* rankings);
+
+/*
+ *Queue the final scores of all players.
+ */
+void renderer_scores(Renderer* renderer, FILE* output,
+        const Player* players);
+
+/*
+ *Queue a line of static text.
+ */
+void renderer_text(Renderer* renderer, FILE* output, const char* text);
+
+/*
+ *Wait until every queued frame has been printed and flushed.
+ */
+void renderer_drain(Renderer* renderer);
+
+/*
+ *Print what is queued, end the thread and release the queue.
+ */
+void renderer_stop(Renderer* renderer);
+
+#endif
+
@@ -0,0 +1,102 @@
+/*
+ *report.c
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "report.h"
+
+/*
+ *Start measuring a dealer run.
+ */
+void report_start(DealerReport* report) {
+    memset(report, 0, sizeof(DealerReport));
+    report->firstTurnMs = -1.0;
+    clock_gettime(CLOCK_MONOTONIC, &report->start);
+}
+
+/*
+ *Milliseconds passed since the run started.
+ */
+double report_elapsed_ms(const DealerReport* report) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - report->start.tv_sec) * 1e3
+            + (now.tv_nsec - report->start.tv_nsec) / 1e6;
+}
+
+/*
+ *Note the first YT of the run.
+ */
+void report_first_turn(DealerReport* report) {
+    if (0.0 > report->firstTurnMs) {
+        report->firstTurnMs = report_elapsed_ms(report);
+    }
+}
+
+/*
+ *Note the end of a game.
+ */
+void report_game_end(DealerReport* report) {
+    report->lastGameMs = report_elapsed_ms(report);
+    if (!report->games) {
+        report->firstGameMs = report->lastGameMs;
+    }
+    report->games += 1;
+}
+
+/*
+ *Count a missed move deadline of the given player.
+ */
+void report_timeout(DealerReport* report, int id) {
+    report->timeouts[id] += 1;
+}
+
+/*
+ *Print all the measurements, along with the counters of the dealer's arena.
+ */
+void report_print(FILE* output, const DealerReport* report,
+        int playersCount, const Arena* arena) {
+    char prefix[32];
+    int i = 0;
+
+    fprintf(output, "Startup: %.3f ms to the first YT\n",
+            report->firstTurnMs);
+    if (1 < report->games) {
+        /*Later games run on the warm players*/
+        fprintf(output, "Games: %d, %.3f ms per game after the first\n",
+                report->games, (report->lastGameMs - report->firstGameMs)
+                / (report->games - 1));
+    }
+    fprintf(output, "Timeouts: ");
+    for (i = 0; i < playersCount; i++) {
+        fprintf(output, i ? ",%d" : "%d", report->timeouts[i]);
+    }
+    fputc('\n', output);
+    if (report->placement) {
+        placement_print(output, report->placement);
+    }
+    if (report->framesRendered) {
+        fprintf(output, "Render: %lu frames, %lu dropped\n",
+                report->framesRendered, report->framesDropped);
+    }
+    if (report->samplesWritten) {
+        fprintf(output, "Samples: %lu decisions, %lu waits for the writer\n",
+                report->samplesWritten, report->samplesWaits);
+    }
+    fprintf(output, "Arena: %zu allocations, %zu from the system, "
+            "%zu bytes at most\n", arena->allocations,
+            arena->systemAllocations, arena->peakBytes);
+    if (report->counters) {
+        counters_print(output, "Counters: dealer ", report->counters);
+        for (i = 0; i < playersCount; i++) {
+            snprintf(prefix, sizeof(prefix), "Counters: player %d ", i);
+            counters_print(output, prefix, report->playerCounters + i);
+        }
+    }
+    fprintf(output, "Total: %.3f ms\n", report_elapsed_ms(report));
+}
+
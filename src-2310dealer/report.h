@@ -0,0 +1,75 @@
+/*
+ *report.h
+ */
+
+#pragma once
+
+#ifndef __REPORT_H__
+#define __REPORT_H__
+
+#include <stdio.h>
+#include <time.h>
+
+#include "../inc/protocol.h"
+#include "../inc/counters.h"
+#include "placement.h"
+
+/*
+ *Measurements of a dealer run, printed at the end with --report.
+ *framesRendered, framesDropped .. Frames the render thread has printed and
+ *dropped, none if the board is printed by the event loop.
+ *samplesWritten, samplesWaits .. Decisions recorded and times the event
+ *loop waited for the samples to be written, none if they are not recorded.
+ *placement .. Where the dealer and the players run, NULL if unknown.
+ *counters, playerCounters .. Events counted by the dealer and by each
+ *player, summed up over all tables. NULL if they are not counted.
+ */
+typedef struct {
+    struct timespec start;
+    double firstTurnMs;
+    double firstGameMs;
+    double lastGameMs;
+    int games;
+    int timeouts[MAX_PLAYERS];
+    unsigned long framesRendered;
+    unsigned long framesDropped;
+    unsigned long samplesWritten;
+    unsigned long samplesWaits;
+    const Placement* placement;
+    const Counters* counters;
+    const Counters* playerCounters;
+} DealerReport;
+
+/*
+ *Start measuring a dealer run.
+ */
+void report_start(DealerReport* report);
+
+/*
+ *Milliseconds passed since the run started.
+ */
+double report_elapsed_ms(const DealerReport* report);
+
+/*
+ *Note the first YT of the run.
+ */
+void report_first_turn(DealerReport* report);
+
+/*
+ *Note the end of a game.
+ */
+void report_game_end(DealerReport* report);
+
+/*
+ *Count a missed move deadline of the given player.
+ */
+void report_timeout(DealerReport* report, int id);
+
+/*
+ *Print all the measurements, along with the counters of the dealer's arena.
+ */
+void report_print(FILE* output, const DealerReport* report,
+        int playersCount, const Arena* arena);
+
+#endif
+
@@ -0,0 +1,537 @@
+/*
+ *ring.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "../inc/protocol.h"
+#include "ring.h"
+
+/*
+ *Multishot read, available since Linux 6.7. Older headers lack it, the
+ *kernel is probed for it.
+ */
+#define RING_OP_READ_MULTISHOT 49
+/*
+ *Size of a provided buffer. Messages from the players are much shorter, a
+ *longer read continues in the next buffer.
+ */
+#define RING_BUFFER_SIZE 1024u
+/*
+ *Smallest and largest number of entries of a ring.
+ */
+#define RING_MIN_ENTRIES 8u
+#define RING_MAX_ENTRIES 32768u
+/*
+ *Group of the provided buffers.
+ */
+#define RING_BUFFER_GROUP 0
+/*
+ *Number of low bits of the user data telling what was requested, the rest
+ *holds the seat.
+ */
+#define REQUEST_KIND_BITS 2
+
+/*
+ *What a completion belongs to.
+ */
+enum RequestKinds {
+    REQUEST_READ, REQUEST_WRITE, REQUEST_POLL, REQUEST_CANCEL
+};
+
+/*
+ *What is posted for a seat, or has to be.
+ *FULL .. The last write found the player's end full, wait for it to drain.
+ */
+enum SeatStates {
+    SEAT_READING = 1, SEAT_WRITING = 2, SEAT_POLLING = 4, SEAT_FULL = 8,
+    SEAT_READ_CANCELLED = 16, SEAT_POLL_CANCELLED = 32
+};
+
+/*
+ *Create an io_uring instance, glibc has no wrapper for it.
+ */
+int ring_setup(unsigned entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+/*
+ *Submit queued requests and wait for completions.
+ */
+int ring_enter(Ring* ring, unsigned submitted, unsigned completed,
+        unsigned flags, void* argument, size_t argumentLength) {
+    return (int)syscall(__NR_io_uring_enter, ring->fd, submitted, completed,
+            flags, argument, argumentLength);
+}
+
+/*
+ *Register resources with the ring or query it.
+ */
+int ring_register(int fd, unsigned opcode, void* argument, unsigned count) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, argument, count);
+}
+
+/*
+ *Smallest power of two of at least RING_MIN_ENTRIES holding count entries,
+ *limited to RING_MAX_ENTRIES.
+ */
+unsigned ring_size(unsigned count) {
+    unsigned size = RING_MIN_ENTRIES;
+
+    while (size < count && size < RING_MAX_ENTRIES) {
+        size <<= 1;
+    }
+    return size;
+}
+
+/*
+ *Check if the kernel supports all operations the ring posts.
+ */
+int supports_operations(int fd) {
+    const int needed[] = { IORING_OP_WRITE, IORING_OP_POLL_ADD,
+            IORING_OP_ASYNC_CANCEL, RING_OP_READ_MULTISHOT };
+    struct io_uring_probe* probe = NULL;
+    int supported = 0;
+    size_t i = 0;
+
+    probe = (struct io_uring_probe*)calloc(1, sizeof(struct io_uring_probe)
+            + 256 * sizeof(struct io_uring_probe_op));
+    supported = 0 == ring_register(fd, IORING_REGISTER_PROBE, probe, 256);
+    for (i = 0; supported && i < sizeof(needed) / sizeof(int); i++) {
+        supported = probe->last_op >= needed[i]
+                && (IO_URING_OP_SUPPORTED & probe->ops[needed[i]].flags);
+    }
+    free(probe);
+    return supported;
+}
+
+/*
+ *Map the submission and completion queues of the ring.
+ *Returns -1 on failure, 0 else.
+ */
+int map_queues(Ring* ring, const struct io_uring_params* params) {
+    char* sq = NULL;
+    char* cq = NULL;
+
+    ring->sqMappingLength = params->sq_off.array
+            + params->sq_entries * sizeof(unsigned);
+    ring->cqMappingLength = params->cq_off.cqes
+            + params->cq_entries * sizeof(struct io_uring_cqe);
+    if (IORING_FEAT_SINGLE_MMAP & params->features) {
+        ring->sqMappingLength = MAX(ring->sqMappingLength,
+                ring->cqMappingLength);
+        ring->cqMappingLength = 0u;
+    }
+
+    ring->sqMapping = mmap(NULL, ring->sqMappingLength,
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+            IORING_OFF_SQ_RING);
+    if (MAP_FAILED == ring->sqMapping) {
+        ring->sqMapping = NULL;
+        return -1;
+    }
+    if (ring->cqMappingLength) {
+        ring->cqMapping = mmap(NULL, ring->cqMappingLength,
+                PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                IORING_OFF_CQ_RING);
+        if (MAP_FAILED == ring->cqMapping) {
+            ring->cqMapping = NULL;
+            return -1;
+        }
+    }
+    ring->sqesLength = params->sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqesLength,
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+            IORING_OFF_SQES);
+    if (MAP_FAILED == (void*)ring->sqes) {
+        ring->sqes = NULL;
+        return -1;
+    }
+
+    sq = (char*)ring->sqMapping;
+    cq = ring->cqMapping ? (char*)ring->cqMapping : sq;
+    ring->sqHead = (unsigned*)(sq + params->sq_off.head);
+    ring->sqTail = (unsigned*)(sq + params->sq_off.tail);
+    ring->sqMask = (unsigned*)(sq + params->sq_off.ring_mask);
+    ring->sqArray = (unsigned*)(sq + params->sq_off.array);
+    ring->cqHead = (unsigned*)(cq + params->cq_off.head);
+    ring->cqTail = (unsigned*)(cq + params->cq_off.tail);
+    ring->cqMask = (unsigned*)(cq + params->cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params->cq_off.cqes);
+    ring->entries = params->sq_entries;
+    return 0;
+}
+
+/*
+ *Hand the buffer with the given id (back) to the kernel.
+ */
+void recycle_buffer(Ring* ring, unsigned id) {
+    unsigned short tail = ring->bufferRing->tail;
+    struct io_uring_buf* buffer = ring->bufferRing->bufs
+            + (tail & (ring->bufferCount - 1));
+
+    buffer->addr = (uint64_t)(uintptr_t)(ring->buffers
+            + id * RING_BUFFER_SIZE);
+    buffer->len = RING_BUFFER_SIZE;
+    buffer->bid = (unsigned short)id;
+    __atomic_store_n(&ring->bufferRing->tail, (unsigned short)(tail + 1),
+            __ATOMIC_RELEASE);
+}
+
+/*
+ *Register the buffers the multishot reads fill.
+ *Returns -1 on failure, 0 else.
+ */
+int provide_buffers(Ring* ring) {
+    struct io_uring_buf_reg registration;
+    unsigned i = 0;
+
+    ring->bufferRingLength = ring->bufferCount * sizeof(struct io_uring_buf);
+    ring->bufferRing = (struct io_uring_buf_ring*)mmap(NULL,
+            ring->bufferRingLength, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == (void*)ring->bufferRing) {
+        ring->bufferRing = NULL;
+        return -1;
+    }
+    ring->buffers = (char*)malloc(ring->bufferCount * RING_BUFFER_SIZE);
+
+    memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = (uint64_t)(uintptr_t)ring->bufferRing;
+    registration.ring_entries = ring->bufferCount;
+    registration.bgid = RING_BUFFER_GROUP;
+    if (0 != ring_register(ring->fd, IORING_REGISTER_PBUF_RING,
+            &registration, 1)) {
+        return -1;
+    }
+
+    for (i = 0; i < ring->bufferCount; i++) {
+        recycle_buffer(ring, i);
+    }
+    return 0;
+}
+
+/*
+ *Set up the ring for the given number of seats.
+ *Returns -1 if the kernel does not offer what the ring needs, 0 else.
+ */
+int ring_init(Ring* ring, int seatsCount) {
+    struct io_uring_params params;
+
+    memset(ring, 0, sizeof(Ring));
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_SUBMIT_ALL;
+
+    /*A read, a write and a cancel per seat fit a single submission*/
+    ring->fd = ring_setup(ring_size(4u * seatsCount), &params);
+    if (0 > ring->fd) {
+        return -1;
+    }
+    ring->bufferCount = ring_size(2u * seatsCount);
+    ring->seatsCount = seatsCount;
+    ring->seatStates = (int*)calloc(seatsCount, sizeof(int));
+
+    if (!(IORING_FEAT_EXT_ARG & params.features)
+            || !supports_operations(ring->fd)
+            || 0 != map_queues(ring, &params)
+            || 0 != provide_buffers(ring)) {
+        ring_free(ring);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ *Cancel everything still posted and release the ring.
+ *Closing the ring cancels its requests.
+ */
+void ring_free(Ring* ring) {
+    if (0 <= ring->fd) {
+        close(ring->fd);
+    }
+    if (ring->sqMapping) {
+        munmap(ring->sqMapping, ring->sqMappingLength);
+    }
+    if (ring->cqMapping) {
+        munmap(ring->cqMapping, ring->cqMappingLength);
+    }
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqesLength);
+    }
+    if (ring->bufferRing) {
+        munmap(ring->bufferRing, ring->bufferRingLength);
+    }
+    free(ring->buffers);
+    free(ring->seatStates);
+    memset(ring, 0, sizeof(Ring));
+    ring->fd = -1;
+}
+
+/*
+ *Hand the queued submissions to the kernel.
+ */
+void submit_queued(Ring* ring) {
+    int submitted = 0;
+
+    while (ring->queued) {
+        submitted = ring_enter(ring, ring->queued, 0, 0, NULL, 0);
+        if (0 < submitted) {
+            ring->queued -= submitted;
+        } else if (0 > submitted && EINTR != errno) {
+            return;
+        }
+    }
+}
+
+/*
+ *Take the next free submission for the given seat and request, submitting
+ *the queued ones first if the queue is full.
+ */
+struct io_uring_sqe* next_submission(Ring* ring, int seat,
+        enum RequestKinds kind) {
+    struct io_uring_sqe* submission = NULL;
+    unsigned tail = *ring->sqTail;
+    unsigned index = 0u;
+
+    if (tail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE)
+            >= ring->entries) {
+        submit_queued(ring);
+    }
+
+    index = tail & *ring->sqMask;
+    submission = ring->sqes + index;
+    memset(submission, 0, sizeof(struct io_uring_sqe));
+    submission->user_data = ((uint64_t)seat << REQUEST_KIND_BITS) | kind;
+    ring->sqArray[index] = index;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    ring->queued++;
+    return submission;
+}
+
+/*
+ *Cancel the given seat's request of the given kind.
+ */
+void cancel_request(Ring* ring, int seat, enum RequestKinds kind) {
+    struct io_uring_sqe* submission = next_submission(ring, seat,
+            REQUEST_CANCEL);
+
+    submission->opcode = IORING_OP_ASYNC_CANCEL;
+    submission->fd = -1;
+    submission->addr = ((uint64_t)seat << REQUEST_KIND_BITS) | kind;
+}
+
+/*
+ *Post what a seat lacks: a multishot read while its input is open, a write
+ *if output is queued, a poll if its end was full. Requests of closed
+ *directions are cancelled.
+ */
+void post_seat(Ring* ring, Channel* channel, int seat) {
+    struct io_uring_sqe* submission = NULL;
+    int* state = ring->seatStates + seat;
+    const char* data = NULL;
+    size_t length = 0u;
+
+    if (!channel->inputClosed && !(SEAT_READING & *state)) {
+        submission = next_submission(ring, seat, REQUEST_READ);
+        submission->opcode = RING_OP_READ_MULTISHOT;
+        submission->fd = channel->readFd;
+        submission->off = (uint64_t)-1;
+        submission->flags = IOSQE_BUFFER_SELECT;
+        submission->buf_group = RING_BUFFER_GROUP;
+        *state |= SEAT_READING;
+    } else if (channel->inputClosed && (SEAT_READING & *state)
+            && !(SEAT_READ_CANCELLED & *state)) {
+        cancel_request(ring, seat, REQUEST_READ);
+        *state |= SEAT_READ_CANCELLED;
+    }
+
+    if (channel->outputClosed) {
+        *state &= ~SEAT_FULL;
+        if ((SEAT_POLLING & *state) && !(SEAT_POLL_CANCELLED & *state)) {
+            cancel_request(ring, seat, REQUEST_POLL);
+            *state |= SEAT_POLL_CANCELLED;
+        }
+    } else if ((SEAT_FULL & *state) && !(SEAT_POLLING & *state)) {
+        submission = next_submission(ring, seat, REQUEST_POLL);
+        submission->opcode = IORING_OP_POLL_ADD;
+        submission->fd = channel->writeFd;
+        submission->poll32_events = POLLOUT;
+        *state = (*state & ~SEAT_FULL) | SEAT_POLLING;
+    } else if (channel->outputLength
+            && !((SEAT_WRITING | SEAT_POLLING) & *state)) {
+        length = channel_next_write(channel, &data);
+        submission = next_submission(ring, seat, REQUEST_WRITE);
+        submission->opcode = IORING_OP_WRITE;
+        submission->fd = channel->writeFd;
+        submission->addr = (uint64_t)(uintptr_t)data;
+        submission->len = (unsigned)length;
+        submission->off = (uint64_t)-1;
+        *state |= SEAT_WRITING;
+        ring->writes++;
+    }
+}
+
+/*
+ *Apply a completion to its seat's channel.
+ */
+void complete_request(Ring* ring, Channel* channels,
+        const struct io_uring_cqe* completion) {
+    int seat = (int)(completion->user_data >> REQUEST_KIND_BITS);
+    int kind = (int)(completion->user_data
+            & ((1u << REQUEST_KIND_BITS) - 1u));
+    int* state = ring->seatStates + seat;
+    const char* data = NULL;
+    unsigned id = 0u;
+
+    switch (kind) {
+        case REQUEST_READ:
+            if (IORING_CQE_F_BUFFER & completion->flags) {
+                id = completion->flags >> IORING_CQE_BUFFER_SHIFT;
+                data = ring->buffers + id * RING_BUFFER_SIZE;
+            }
+            /*Running out of buffers only ends the multishot read*/
+            if (-ENOBUFS != completion->res
+                    && -ECANCELED != completion->res) {
+                channel_received(channels + seat, data, completion->res);
+            }
+            if (data) {
+                recycle_buffer(ring, id);
+            }
+            if (!(IORING_CQE_F_MORE & completion->flags)) {
+                *state &= ~SEAT_READING;
+            }
+            break;
+        case REQUEST_WRITE:
+            *state &= ~SEAT_WRITING;
+            ring->writes--;
+            channel_written(channels + seat, completion->res);
+            if (-EAGAIN == completion->res
+                    || -EWOULDBLOCK == completion->res) {
+                *state |= SEAT_FULL;
+            }
+            break;
+        case REQUEST_POLL:
+            *state &= ~SEAT_POLLING;
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ *Apply all completions the kernel has posted.
+ */
+void reap_completions(Ring* ring, Channel* channels) {
+    unsigned head = *ring->cqHead;
+    unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+        complete_request(ring, channels,
+                ring->cqes + (head & *ring->cqMask));
+        head++;
+    }
+    __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+}
+
+/*
+ *Find an awaited seat holding a message.
+ *Returns -1 if there is none.
+ */
+int find_awaited(const Channel* channels, int count, const int* awaited) {
+    int i = 0;
+
+    for (i = 0; i < count; i++) {
+        if (awaited[i] && channel_has_message(channels + i)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ *Calculate the time left until the deadline, at least zero.
+ */
+struct __kernel_timespec time_left(const struct timespec* deadline) {
+    struct __kernel_timespec left;
+    struct timespec now;
+    long nanoseconds = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    nanoseconds = (deadline->tv_sec - now.tv_sec) * 1000000000L
+            + (deadline->tv_nsec - now.tv_nsec);
+    nanoseconds = MAX(nanoseconds, 0L);
+    left.tv_sec = nanoseconds / 1000000000L;
+    left.tv_nsec = nanoseconds % 1000000000L;
+    return left;
+}
+
+/*
+ *Wait until any of the seats marked in awaited has a message, writing the
+ *queues of all channels meanwhile. Behaves like channels_wait_any().
+ *The writes are non-blocking, so they have all completed whenever this
+ *returns and the queues may be changed again.
+ *Returns the seat with a message, or -1 if the timeout (milliseconds, -1
+ *for none) expired.
+ */
+int ring_wait_any(Ring* ring, Channel* channels, int count,
+        const int* awaited, int timeout) {
+    struct io_uring_getevents_arg wait;
+    struct __kernel_timespec left;
+    struct timespec deadline;
+    int ready = -1;
+    int entered = 0;
+    int timedOut = 0;
+    int i = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += MAX(timeout, 0) / 1000;
+    deadline.tv_nsec += (MAX(timeout, 0) % 1000) * 1000000L;
+    if (1000000000L <= deadline.tv_nsec) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    while (!timedOut
+            && -1 == (ready = find_awaited(channels, count, awaited))) {
+        for (i = 0; i < count; i++) {
+            post_seat(ring, channels + i, i);
+        }
+
+        memset(&wait, 0, sizeof(wait));
+        if (-1 != timeout) {
+            left = time_left(&deadline);
+            wait.ts = (uint64_t)(uintptr_t)&left;
+        }
+        entered = ring_enter(ring, ring->queued, 1,
+                IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &wait,
+                sizeof(wait));
+        if (0 < entered) {
+            ring->queued -= MIN((unsigned)entered, ring->queued);
+        } else if (0 > entered && ETIME == errno) {
+            timedOut = 1;
+        } else if (0 > entered && EINTR != errno) {
+            break;
+        }
+
+        reap_completions(ring, channels);
+        while (ring->writes) {
+            if (0 <= ring_enter(ring, 0, 1, IORING_ENTER_GETEVENTS, NULL,
+                    0) || EINTR == errno) {
+                reap_completions(ring, channels);
+            } else {
+                break;
+            }
+        }
+    }
+
+    return timedOut ? find_awaited(channels, count, awaited) : ready;
+}
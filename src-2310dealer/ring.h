@@ -0,0 +1,69 @@
+/*
+ *ring.h
+ */
+
+#pragma once
+
+#ifndef __RING_H__
+#define __RING_H__
+
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+#include "channel.h"
+
+/*
+ *io_uring instance serving the channels of all seats.
+ *Every seat keeps a multishot read posted, which fills buffers of the
+ *provided buffer ring. The queued output of all seats is written with one
+ *submission per wait.
+ */
+typedef struct {
+    int fd;
+    unsigned entries;
+    void* sqMapping;
+    size_t sqMappingLength;
+    void* cqMapping;
+    size_t cqMappingLength;
+    struct io_uring_sqe* sqes;
+    size_t sqesLength;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    struct io_uring_cqe* cqes;
+    unsigned queued;
+    struct io_uring_buf_ring* bufferRing;
+    size_t bufferRingLength;
+    char* buffers;
+    unsigned bufferCount;
+    int seatsCount;
+    int* seatStates;
+    int writes;
+} Ring;
+
+/*
+ *Set up the ring for the given number of seats.
+ *Returns -1 if the kernel does not offer what the ring needs, 0 else.
+ */
+int ring_init(Ring* ring, int seatsCount);
+
+/*
+ *Cancel everything still posted and release the ring.
+ */
+void ring_free(Ring* ring);
+
+/*
+ *Wait until any of the seats marked in awaited has a message, writing the
+ *queues of all channels meanwhile. Behaves like channels_wait_any().
+ *Returns the seat with a message, or -1 if the timeout (milliseconds, -1
+ *for none) expired.
+ */
+int ring_wait_any(Ring* ring, Channel* channels, int count,
+        const int* awaited, int timeout);
+
+#endif
+
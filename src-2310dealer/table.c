@@ -0,0 +1,669 @@
+/*
+ *table.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/types.h>
+
+#include "../inc/errorReturn.h"
+#include "../inc/protocol.h"
+#include "../inc/journal.h"
+#include "table.h"
+
+/*
+ *Set up a table for the given players. The deck's cards are shared, the
+ *table draws from its own position. The board is printed to output, by
+ *the renderer if there is one. The games are recorded to the journal if
+ *there is one. Turns are given in the turn slots if there are any. The
+ *scores are added to the results if they are kept, the players' decisions
+ *are handed to the exporter if they are recorded.
+ */
+void table_init(Table* table, int number, int playersCount, const Path* path,
+        const Deck* deck, Channel* channels, pid_t* pids,
+        const DealerOptions* options, DealerReport* report,
+        DealerMetrics* metrics, FILE* output, FILE* journal,
+        Renderer* renderer, Handoff* handoff, ResultsWriter* results,
+        SampleExporter* samples) {
+    int i = 0;
+
+    memset(table, 0, sizeof(Table));
+    table->number = number;
+    table->playersCount = playersCount;
+    table->path = path;
+    table->deck = *deck;
+    table->deck.nextCard = table->deck.buffer;
+    table->channels = channels;
+    table->pids = pids;
+    table->options = options;
+    table->report = report;
+    table->metrics = metrics;
+    table->output = output;
+    table->journal = journal;
+    table->renderer = renderer;
+    table->handoff = handoff;
+    table->results = results;
+    table->samples = samples;
+    table->state = TABLE_HANDSHAKE;
+
+    table->players = (Player*)malloc(playersCount * sizeof(Player));
+    table->positions = (int*)calloc(playersCount, sizeof(int));
+    table->rankings = (int*)calloc(playersCount, sizeof(int));
+    table->droppedSeats = (int*)calloc(playersCount, sizeof(int));
+    table->staleMoves = (int*)calloc(playersCount, sizeof(int));
+    table->awaited = (int*)calloc(playersCount, sizeof(int));
+    for (i = 0; i < playersCount; i++) {
+        dealer_reset_player(table->players + i);
+    }
+    if (samples) {
+        samples_game_init(&table->pendingSamples, playersCount);
+    }
+}
+
+/*
+ *Release the table's book-keeping.
+ */
+void table_free(Table* table) {
+    free(table->players);
+    free(table->positions);
+    free(table->rankings);
+    free(table->droppedSeats);
+    free(table->staleMoves);
+    free(table->awaited);
+    samples_game_free(&table->pendingSamples);
+}
+
+/*
+ *Milliseconds passed since the run started.
+ */
+double table_now(const Table* table) {
+    return report_elapsed_ms(table->report);
+}
+
+/*
+ *Record what happened at the table, if the games are recorded.
+ */
+void record(Table* table, enum JournalRecordTypes type, int id, int site,
+        int regular) {
+    if (table->journal) {
+        journal_write_record(table->journal, table->number, type, id, site,
+                regular);
+    }
+}
+
+/*
+ *Number of the given player's seat among the seats of all tables.
+ */
+int table_seat(const Table* table, int id) {
+    return table->number * table->playersCount + id;
+}
+
+/*
+ *Let a player taking its turns from shared memory read everything queued
+ *for it so far, e.g. DONE, which it would only read with its next turn.
+ */
+void notify_seat(Table* table, int id) {
+    if (table->handoff) {
+        handoff_notify(table->handoff, table_seat(table, id),
+                table->channels[id].queuedTotal);
+    }
+}
+
+/*
+ *Close the connection to a player, which reads it up to its end.
+ */
+void close_seat(Table* table, int id) {
+    channel_close(table->channels + id);
+    if (table->handoff) {
+        handoff_close_seat(table->handoff, table_seat(table, id));
+    }
+}
+
+/*
+ *End the table with the given error, e.g. for a broken message.
+ *The players notice the closed pipes.
+ */
+void fail_table(Table* table, enum DealerErrorCodes code) {
+    int i = 0;
+
+    if (TABLE_CLOSED != table->state) {
+        record(table, JOURNAL_END, 0, 0, 0);
+    }
+    if (table->renderer) {
+        renderer_text(table->renderer, table->output,
+                dealerErrorTexts[code]);
+    } else {
+        fprintf(table->output, "%s\n", dealerErrorTexts[code]);
+    }
+    table->status = code;
+    for (i = 0; i < table->playersCount; i++) {
+        close_seat(table, i);
+    }
+    table->state = TABLE_CLOSED;
+}
+
+/*
+ *Disconnect a player, which does not keep up with reading its messages or
+ *with its moves. The dealer makes the seat's moves from then on.
+ */
+void drop_seat(Table* table, int id) {
+    if (1 < table->options->tables) {
+        fprintf(stderr, "Dropped player %d at table %d\n", id,
+                table->number);
+    } else {
+        fprintf(stderr, "Dropped player %d\n", id);
+    }
+    kill(table->pids[id], SIGKILL);
+    close_seat(table, id);
+    table->droppedSeats[id] = 1;
+}
+
+/*
+ *End the game for everybody at the table, because a player does not keep
+ *up with reading its messages or with its moves.
+ */
+void abort_table(Table* table) {
+    int i = 0;
+
+    for (i = 0; i < table->playersCount; i++) {
+        channel_queue(table->channels + i, "EARLY\n", 6u, 1);
+        channel_flush(table->channels + i);
+        notify_seat(table, i);
+        if (table->channels[i].outputLength) {
+            /*This one would never read it*/
+            kill(table->pids[i], SIGKILL);
+        }
+    }
+    fail_table(table, E_DEALER_COMMS_ERROR);
+}
+
+/*
+ *Queue a message for the given player and apply the queue policy if the
+ *player's queue exceeds its budget.
+ *The queue is written right away if flush is set, unless io_uring writes
+ *the queues of all players with the next wait.
+ */
+void send_to_player(Table* table, int id, const char* message,
+        size_t length, int flush) {
+    Channel* channel = table->channels + id;
+    size_t budget = table->options->queueBudget;
+
+    if (table->droppedSeats[id] || TABLE_CLOSED == table->state) {
+        return;
+    }
+
+    channel_queue(channel, message, length, 0);
+    if ((flush && IO_POLL == table->options->io)
+            || budget < channel_pending(channel)) {
+        channel_flush(channel);
+        if (channel->outputLength) {
+            /*It has to read before its turn for the queue to go down*/
+            notify_seat(table, id);
+        }
+    }
+
+    if (budget < channel_pending(channel)) {
+        switch (table->options->queuePolicy) {
+            case QUEUE_BLOCK:
+                channel_drain(channel, budget);
+                break;
+            case QUEUE_DROP:
+                drop_seat(table, id);
+                break;
+            case QUEUE_ABORT:
+                abort_table(table);
+                break;
+        }
+    }
+}
+
+/*
+ *Send a message to all the players of the table.
+ *In lazy delivery mode the queues are only written with the next YT or DONE.
+ */
+void broadcast(Table* table, const char* message, size_t length,
+        int flush) {
+    int i = 0;
+
+    for (i = 0; i < table->playersCount; i++) {
+        if (!table->droppedSeats[i] && TABLE_CLOSED != table->state) {
+            metrics_count_broadcast(table->metrics, length);
+        }
+        send_to_player(table, i, message, length, flush);
+    }
+}
+
+/*
+ *Choose a site for a seat the dealer moves itself: the earliest site up to
+ *the next barrier, which has room.
+ */
+int choose_default_site(const Table* table, int id) {
+    int i = 0;
+    int barrierAhead = 0;
+
+    barrierAhead = player_find_x_site_ahead(BARRIER, table->positions[id],
+            table->path);
+    for (i = table->positions[id] + 1; i < barrierAhead; i++) {
+        if ((int)player_get_site_usage(table->positions, table->playersCount,
+                i) < path_site_capacity(table->path, i)) {
+            return i;
+        }
+    }
+    return barrierAhead;
+}
+
+/*
+ *Apply the move of the given player, print the board and let everybody
+ *know about it.
+ *Returns non-zero in case the game has ended, zero else.
+ */
+int apply_move(Table* table, int id, int targetSite) {
+    char buffer[MESSAGE_LENGTH];
+    int length = 0;
+    int pointDiff = 0;
+    int moneyDiff = 0;
+    int newCard = 0;
+    double renderStart = 0.0;
+
+    record(table, JOURNAL_MOVE, id, targetSite, 0);
+    table->gameMoves += 1u;
+    dealer_move_player(id, targetSite, table->playersCount, table->positions,
+            table->rankings);
+    dealer_calculate_player_earnings(id, targetSite, &pointDiff, &moneyDiff,
+            &newCard, (Path*)table->path, table->players + id, &table->deck);
+    metrics_count_move(table->metrics);
+    if (table->renderer) {
+        /*Counts its rendering time itself*/
+        renderer_move(table->renderer, table->output, id, table->players + id,
+                table->positions, table->rankings);
+    } else {
+        renderStart = table_now(table);
+        player_print_earnings(table->output, id, table->players + id);
+        player_print_path(table->output, (Path*)table->path,
+                table->playersCount, table->path->siteCount,
+                table->positions, table->rankings, 0);
+        metrics_count_render(table->metrics, table_now(table) - renderStart);
+    }
+
+    /*In lazy mode delivered along with each player's next YT or DONE*/
+    length = dealer_format_player_move(buffer, sizeof(buffer), id, targetSite,
+            pointDiff, moneyDiff, newCard);
+    broadcast(table, buffer, length,
+            DELIVERY_EAGER == table->options->delivery);
+
+    return TABLE_CLOSED != table->state
+            && dealer_is_finished(table->playersCount,
+                    table->path->siteCount, table->positions,
+                    table->rankings);
+}
+
+/*
+ *Print the path with all players at its start.
+ */
+void print_start(Table* table) {
+    if (table->renderer) {
+        /*The players' initial order on the start site, as printing sorts*/
+        dealer_init_rankings(table->positions, table->rankings,
+                table->playersCount);
+        renderer_board(table->renderer, table->output, table->positions,
+                table->rankings);
+        return;
+    }
+    player_print_path(table->output, (Path*)table->path, table->playersCount,
+            table->path->siteCount, table->positions, table->rankings, 1);
+    fflush(table->output);
+}
+
+/*
+ *Print the path and wait for the players asking for it.
+ */
+void table_start(Table* table) {
+    int i = 0;
+
+    table->gameDeadline = table_now(table) + table->options->gameTimeout;
+    table->moveDeadline = table_now(table) + table->options->moveTimeout;
+    table->gameStart = table_now(table);
+    record(table, JOURNAL_START, 0, 0, 0);
+    print_start(table);
+
+    /*All players need to ask for the path, in any order*/
+    table->state = TABLE_HANDSHAKE;
+    for (i = 0; i < table->playersCount; i++) {
+        table->awaited[i] = 1;
+    }
+    table->awaitedCount = table->playersCount;
+}
+
+/*
+ *Put everybody back to the start for another game with the same players.
+ */
+void start_new_game(Table* table) {
+    char buffer[MESSAGE_LENGTH];
+    int length = 0;
+    int i = 0;
+
+    table->gameDeadline = table_now(table) + table->options->gameTimeout;
+    for (i = 0; i < table->playersCount; i++) {
+        dealer_reset_player(table->players + i);
+    }
+    memset(table->positions, 0, table->playersCount * sizeof(int));
+    memset(table->rankings, 0, table->playersCount * sizeof(int));
+    table->deck.nextCard = table->deck.buffer;
+    table->gameStart = table_now(table);
+    table->gameMoves = 0u;
+    record(table, JOURNAL_START, 0, 0, 0);
+
+    /*The players keep the path they already have*/
+    for (i = 0; i < table->playersCount; i++) {
+        length = dealer_format_new_game(buffer, sizeof(buffer),
+                table->playersCount, i, 0);
+        send_to_player(table, i, buffer, length, 1);
+        notify_seat(table, i);
+    }
+    print_start(table);
+}
+
+/*
+ *Let the players go once all games have ended.
+ */
+void close_table(Table* table) {
+    int i = 0;
+
+    for (i = 0; i < table->playersCount; i++) {
+        if (table->staleMoves[i] || (table->handoff && handoff_busy(
+                table->handoff, table_seat(table, i)))) {
+            /*Still busy with a forfeited turn, it would hold up the end*/
+            kill(table->pids[i], SIGKILL);
+        } else {
+            channel_drain(table->channels + i, 0u);
+        }
+        close_seat(table, i);
+    }
+    table->state = TABLE_CLOSED;
+}
+
+/*
+ *Finish the current game: quit the players, print the scores and start the
+ *next game of the session, if any.
+ */
+void end_game(Table* table) {
+    int i = 0;
+
+    record(table, JOURNAL_END, 0, 0, 1);
+    broadcast(table, "DONE\n", 5u, 1);
+    for (i = 0; i < table->playersCount; i++) {
+        notify_seat(table, i);
+    }
+    if (table->samples) {
+        samples_game_end(&table->pendingSamples, table->samples,
+                table->players);
+    }
+    if (table->results) {
+        results_writer_add(table->results, (uint64_t)table->number
+                * table->options->games + table->game,
+                (uint64_t)((table_now(table) - table->gameStart) * 1e3),
+                table->gameMoves, table->players);
+    }
+    if (table->renderer) {
+        renderer_scores(table->renderer, table->output, table->players);
+    } else {
+        player_print_scores(table->output, table->playersCount,
+                table->players);
+    }
+    report_game_end(table->report);
+
+    table->game += 1;
+    if (table->game < table->options->games) {
+        start_new_game(table);
+    } else {
+        close_table(table);
+    }
+}
+
+/*
+ *Give the player its turn: YT over its connection, or in its turn slot
+ *once the queue is written.
+ */
+void give_turn(Table* table, int id) {
+    Channel* channel = table->channels + id;
+
+    if (!table->handoff) {
+        send_to_player(table, id, "YT\n", 3u, 1);
+        return;
+    }
+    /*io_uring writes the queue with the next wait*/
+    if (IO_POLL == table->options->io) {
+        channel_flush(channel);
+    }
+    handoff_post_turn(table->handoff, table_seat(table, id),
+            channel->queuedTotal);
+}
+
+/*
+ *Let the players move until one of them has to be waited for.
+ *Seats dropped by the dealer are moved right away.
+ */
+void play_turns(Table* table) {
+    int nextPlayer = 0;
+
+    while (TABLE_CLOSED != table->state) {
+        /*Next, let the player make his move, which is furtherst back*/
+        nextPlayer = dealer_calculate_next_player(table->playersCount,
+                table->positions, table->rankings);
+        if (table->droppedSeats[nextPlayer]) {
+            if (apply_move(table, nextPlayer,
+                    choose_default_site(table, nextPlayer))) {
+                end_game(table);
+            }
+            continue;
+        }
+
+        table->state = TABLE_MOVE;
+        table->turn = nextPlayer;
+        table->turnStart = table_now(table);
+        table->moveDeadline = table->turnStart + table->options->moveTimeout;
+        give_turn(table, nextPlayer);
+        report_first_turn(table->report);
+        return;
+    }
+}
+
+/*
+ *Check if the table is waiting for a message from the given seat.
+ */
+int table_awaits(const Table* table, int seat) {
+    switch (table->state) {
+        case TABLE_HANDSHAKE:
+            return table->awaited[seat];
+        case TABLE_MOVE:
+            return seat == table->turn;
+        default:
+            return 0;
+    }
+}
+
+/*
+ *Time (milliseconds into the run) the table stops waiting at.
+ *Returns -1 if it waits without limit.
+ */
+double table_deadline(const Table* table) {
+    double deadline = -1.0;
+
+    if (TABLE_CLOSED == table->state) {
+        return -1.0;
+    }
+    if (table->options->moveTimeout) {
+        deadline = table->moveDeadline;
+    }
+    if (table->options->gameTimeout) {
+        deadline = 0.0 > deadline ? table->gameDeadline
+                : MIN(deadline, table->gameDeadline);
+    }
+    return deadline;
+}
+
+/*
+ *Serve the path to a player asking for it.
+ *Players attached to the shared path ('@') need nothing more.
+ */
+void serve_path_request(Table* table, int seat) {
+    const Path* path = table->path;
+    ArenaMark mark = arena_mark(path->arena);
+    char* message = NULL;
+    int length = 0;
+
+    table->awaited[seat] = 0;
+    table->awaitedCount -= 1;
+    if ('^' == channel_take_byte(table->channels + seat)) {
+        message = (char*)arena_alloc(path->arena, path->bufferLength + 32);
+        length = sprintf(message, "%zu;%s", path->siteCount, path->buffer);
+        /*The path does not count against the queue budget*/
+        channel_queue(table->channels + seat, message, length, 1);
+        channel_flush(table->channels + seat);
+        notify_seat(table, seat);
+        arena_release(path->arena, mark);
+    }
+}
+
+/*
+ *Take the move the player, whose turn it is, has sent.
+ *Returns non-zero in case the game has ended, zero else.
+ */
+int receive_move(Table* table, int seat) {
+    char buffer[MESSAGE_LENGTH];
+    int targetSite = 0;
+    int readChars = 0;
+
+    if (table->handoff) {
+        /*Anything on the connection instead, e.g. its end, is an error*/
+        targetSite = handoff_take_move(table->handoff,
+                table_seat(table, seat));
+        readChars = -1 == targetSite ? 0 : 1;
+    } else if (channel_take_line(table->channels + seat, buffer,
+            sizeof(buffer))) {
+        readChars = sscanf(buffer, "DO%d", &targetSite);
+    }
+    if (1 > readChars || EOF == readChars || 0 > targetSite
+            || (int)table->path->siteCount < targetSite + 1) {
+        fail_table(table, E_DEALER_COMMS_ERROR);
+        return 0;
+    }
+    metrics_count_reply(table->metrics, seat,
+            table_now(table) - table->turnStart);
+    if (table->samples) {
+        /*Only the players' own decisions, no forced or default moves*/
+        samples_game_add(&table->pendingSamples, (uint64_t)table->number
+                * table->options->games + table->game, table->gameMoves,
+                seat, targetSite, table->positions, table->rankings,
+                table->players);
+    }
+
+    return apply_move(table, seat, targetSite);
+}
+
+/*
+ *Discard the late answer to a forfeited turn, the player is still waited
+ *for.
+ */
+void discard_stale_move(Table* table, int seat) {
+    char buffer[MESSAGE_LENGTH];
+
+    if (!channel_take_line(table->channels + seat, buffer, sizeof(buffer))) {
+        fail_table(table, E_DEALER_COMMS_ERROR);
+        return;
+    }
+    table->staleMoves[seat] -= 1;
+}
+
+/*
+ *Process the message the given seat has sent and carry on with the game
+ *until the table has to wait again.
+ */
+void table_receive(Table* table, int seat) {
+    if (TABLE_HANDSHAKE == table->state) {
+        serve_path_request(table, seat);
+        if (!table->awaitedCount) {
+            play_turns(table);
+        }
+    } else if (TABLE_MOVE == table->state && seat == table->turn) {
+        if (table->staleMoves[seat]) {
+            discard_stale_move(table, seat);
+            return;
+        }
+        if (receive_move(table, seat)) {
+            end_game(table);
+        }
+        play_turns(table);
+    }
+}
+
+/*
+ *Give up on the players, which did not ask for the path in time.
+ *Without the path they can't play, so their seats are dropped unless the
+ *table is aborted.
+ */
+void drop_silent_seats(Table* table) {
+    int i = 0;
+
+    for (i = 0; i < table->playersCount; i++) {
+        if (table->awaited[i]) {
+            report_timeout(table->report, i);
+            if (TIMEOUT_ABORT == table->options->timeoutPolicy) {
+                /*A silent player would not read EARLY either*/
+                kill(table->pids[i], SIGKILL);
+                abort_table(table);
+                return;
+            }
+            drop_seat(table, i);
+            table->awaited[i] = 0;
+        }
+    }
+    table->awaitedCount = 0;
+}
+
+/*
+ *Apply the timeout policy to the player, whose turn it is, and make the
+ *move for it.
+ *Returns non-zero in case the game has ended, zero else.
+ */
+int handle_timeout(Table* table, int id) {
+    report_timeout(table->report, id);
+    switch (table->options->timeoutPolicy) {
+        case TIMEOUT_FORFEIT:
+            /*A late answer in the turn slot is for an old turn*/
+            if (!table->handoff) {
+                table->staleMoves[id] += 1;
+            }
+            break;
+        case TIMEOUT_KILL:
+            drop_seat(table, id);
+            break;
+        case TIMEOUT_ABORT:
+            /*A hung player would not read EARLY either*/
+            kill(table->pids[id], SIGKILL);
+            abort_table(table);
+            return 0;
+    }
+    return apply_move(table, id, choose_default_site(table, id));
+}
+
+/*
+ *Apply the timeout policy if the table's deadline has passed.
+ */
+void table_check_timeout(Table* table) {
+    double deadline = table_deadline(table);
+
+    if (0.0 > deadline || table_now(table) < deadline) {
+        return;
+    }
+
+    if (TABLE_HANDSHAKE == table->state) {
+        drop_silent_seats(table);
+    } else if (handle_timeout(table, table->turn)) {
+        end_game(table);
+    }
+    play_turns(table);
+}
+
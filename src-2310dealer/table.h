@@ -0,0 +1,134 @@
+/*
+ *table.h
+ */
+
+#pragma once
+
+#ifndef __TABLE_H__
+#define __TABLE_H__
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "../inc/protocol.h"
+#include "../inc/handoff.h"
+#include "../inc/results.h"
+#include "../inc/samples.h"
+#include "options.h"
+#include "channel.h"
+#include "report.h"
+#include "metrics.h"
+#include "render.h"
+
+/*
+ *What a table is waiting for.
+ *HANDSHAKE .. The players asking for the path.
+ *MOVE .. The move of the player, whose turn it is.
+ *CLOSED .. Nothing, all its games have ended.
+ */
+enum TableStates {
+    TABLE_HANDSHAKE, TABLE_MOVE, TABLE_CLOSED
+};
+
+/*
+ *A game with its own players and deck. The path is shared by all tables.
+ *The channels and PIDs are slices of the dealer's arrays, so all tables can
+ *be waited for at once.
+ *journal .. Stream shared by all tables to record the games in, NULL if
+ *they are not recorded.
+ *renderer .. Render thread printing the board, NULL if the table prints it
+ *itself.
+ *handoff .. Turn slots of all seats, the table's are the ones from
+ *number * playersCount on. NULL if turns are sent over the connections.
+ *results .. Writer shared by all tables to add the scores of their games
+ *to, NULL if they are not kept.
+ *gameStart, gameMoves .. Time the current game started at and the moves
+ *made in it.
+ *samples .. Exporter shared by all tables to hand the decisions of their
+ *games to, NULL if they are not recorded.
+ *pendingSamples .. Decisions made in the current game so far.
+ */
+typedef struct {
+    int number;
+    int playersCount;
+    const Path* path;
+    Deck deck;
+    Player* players;
+    int* positions;
+    int* rankings;
+    pid_t* pids;
+    Channel* channels;
+    int* droppedSeats;
+    int* staleMoves;
+    int* awaited;
+    int awaitedCount;
+    enum TableStates state;
+    int turn;
+    int game;
+    double turnStart;
+    double moveDeadline;
+    double gameDeadline;
+    double gameStart;
+    unsigned int gameMoves;
+    FILE* output;
+    int status;
+    const DealerOptions* options;
+    DealerReport* report;
+    DealerMetrics* metrics;
+    FILE* journal;
+    Renderer* renderer;
+    Handoff* handoff;
+    ResultsWriter* results;
+    SampleExporter* samples;
+    SampleGame pendingSamples;
+} Table;
+
+/*
+ *Set up a table for the given players. The deck's cards are shared, the
+ *table draws from its own position. The board is printed to output, by
+ *the renderer if there is one. The games are recorded to the journal if
+ *there is one. Turns are given in the turn slots if there are any. The
+ *scores are added to the results if they are kept, the players' decisions
+ *are handed to the exporter if they are recorded.
+ */
+void table_init(Table* table, int number, int playersCount, const Path* path,
+        const Deck* deck, Channel* channels, pid_t* pids,
+        const DealerOptions* options, DealerReport* report,
+        DealerMetrics* metrics, FILE* output, FILE* journal,
+        Renderer* renderer, Handoff* handoff, ResultsWriter* results,
+        SampleExporter* samples);
+
+/*
+ *Release the table's book-keeping.
+ */
+void table_free(Table* table);
+
+/*
+ *Print the path and wait for the players asking for it.
+ */
+void table_start(Table* table);
+
+/*
+ *Check if the table is waiting for a message from the given seat.
+ */
+int table_awaits(const Table* table, int seat);
+
+/*
+ *Time (milliseconds into the run) the table stops waiting at.
+ *Returns -1 if it waits without limit.
+ */
+double table_deadline(const Table* table);
+
+/*
+ *Process the message the given seat has sent and carry on with the game
+ *until the table has to wait again.
+ */
+void table_receive(Table* table, int seat);
+
+/*
+ *Apply the timeout policy if the table's deadline has passed.
+ */
+void table_check_timeout(Table* table);
+
+#endif
+
@@ -0,0 +1,193 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include "../inc/protocol.h"
+#include "../inc/workload.h"
+
+/*
+ *Largest weight of a site type or card, so the deck proportions can be
+ *calculated in 64 bits.
+ */
+#define MAX_WEIGHT 1000000ul
+
+/*
+ *Identifiers of the long options.
+ */
+enum OptionIds {
+    OPTION_SEED = 1,
+    OPTION_SITES,
+    OPTION_CARDS,
+    OPTION_MIX,
+    OPTION_CAPACITY,
+    OPTION_BARRIER_GAP
+};
+
+/*
+ *All the options the generator understands.
+ */
+const struct option longOptions[] = {
+    { "seed", required_argument, NULL, OPTION_SEED },
+    { "sites", required_argument, NULL, OPTION_SITES },
+    { "cards", required_argument, NULL, OPTION_CARDS },
+    { "mix", required_argument, NULL, OPTION_MIX },
+    { "capacity", required_argument, NULL, OPTION_CAPACITY },
+    { "barrier-gap", required_argument, NULL, OPTION_BARRIER_GAP },
+    { NULL, 0, NULL, 0 }
+};
+
+/*
+ *Shape of the path to generate.
+ */
+PathWorkload pathWorkload;
+/*
+ *Shape of the deck to generate.
+ */
+DeckWorkload deckWorkload;
+
+/*
+ *Print how to call the generator and exit.
+ */
+void usage_return() {
+    fprintf(stderr, "Usage: 2310gen [--seed=S] [--sites=N] [--mix=Mo,V1,V2,"
+            "Do,Ri] [--capacity=MIN-MAX] [--barrier-gap=MIN-MAX] path\n"
+            "       2310gen [--seed=S] [--cards=N] [--mix=A,B,C,D,E] "
+            "deck\n");
+    exit(1);
+}
+
+/*
+ *Convert a non-negative number up to the given maximum.
+ *Returns the end of the number.
+ */
+char* convert_number(const char* text, unsigned long maximum,
+        unsigned long* number) {
+    char* end = NULL;
+
+    if ('-' == *text || '+' == *text) {
+        usage_return();
+    }
+    *number = strtoul(text, &end, 10);
+    if (end == text || maximum < *number) {
+        usage_return();
+    }
+    return end;
+}
+
+/*
+ *Convert a range "MIN-MAX", or a single number for both ends.
+ */
+void convert_range(const char* text, unsigned long maximum,
+        unsigned long* low, unsigned long* high) {
+    char* end = convert_number(text, maximum, low);
+
+    *high = *low;
+    if ('-' == *end) {
+        end = convert_number(end + 1, maximum, high);
+    }
+    if ('\0' != *end) {
+        usage_return();
+    }
+}
+
+/*
+ *Convert the five comma separated weights of a mix.
+ */
+void convert_mix(const char* text, unsigned int* weights) {
+    unsigned long weight = 0ul;
+    const char* pos = text;
+    int i = 0;
+
+    for (i = 0; i < 5; i++) {
+        pos = convert_number(pos, MAX_WEIGHT, &weight);
+        weights[i] = (unsigned int)weight;
+        if ((4 > i && ',' != *pos) || (4 == i && '\0' != *pos)) {
+            usage_return();
+        }
+        pos += 1;
+    }
+}
+
+/*
+ *Parse the options into both workloads.
+ *Returns the index of the kind of file to generate.
+ */
+int parse_options(int argc, char* argv[]) {
+    unsigned long low = 0ul;
+    unsigned long high = 0ul;
+    unsigned int weights[5];
+    int option = 0;
+
+    opterr = 0;
+    while (-1 != (option = getopt_long(argc, argv, "+", longOptions,
+            NULL))) {
+        switch (option) {
+            case OPTION_SEED:
+                convert_range(optarg, 0xfffffffful, &low, &high);
+                pathWorkload.seed = (unsigned int)low;
+                deckWorkload.seed = (unsigned int)low;
+                break;
+            case OPTION_SITES:
+                convert_range(optarg, 0xfffffffful, &low, &high);
+                pathWorkload.siteCount = (size_t)low;
+                break;
+            case OPTION_CARDS:
+                convert_range(optarg, (unsigned long)-1, &low, &high);
+                deckWorkload.cardCount = (size_t)low;
+                break;
+            case OPTION_MIX:
+                convert_mix(optarg, weights);
+                memcpy(pathWorkload.weights, weights, sizeof(weights));
+                memcpy(deckWorkload.weights, weights, sizeof(weights));
+                break;
+            case OPTION_CAPACITY:
+                convert_range(optarg, WORKLOAD_MAX_CAPACITY, &low, &high);
+                pathWorkload.minCapacity = (int)low;
+                pathWorkload.maxCapacity = (int)high;
+                break;
+            case OPTION_BARRIER_GAP:
+                convert_range(optarg, 0xfffffffful, &low, &high);
+                pathWorkload.minGap = (size_t)low;
+                pathWorkload.maxGap = (size_t)high;
+                break;
+            default:
+                usage_return();
+        }
+    }
+    return optind;
+}
+
+/*
+ *Write a synthetic path or deck file to stdout.
+ */
+int main(int argc, char* argv[]) {
+    int success = 0;
+    int i = 0;
+
+    workload_default_path(&pathWorkload, 1000u);
+    workload_default_deck(&deckWorkload, 100u);
+    i = parse_options(argc, argv);
+    if (i + 1 != argc) {
+        usage_return();
+    }
+
+    if (0 == strcmp("path", argv[i])) {
+        if (!workload_valid_path(&pathWorkload)) {
+            usage_return();
+        }
+        success = workload_write_path(stdout, &pathWorkload);
+    } else if (0 == strcmp("deck", argv[i])) {
+        if (!workload_valid_deck(&deckWorkload)) {
+            usage_return();
+        }
+        success = workload_write_deck(stdout, &deckWorkload);
+    } else {
+        usage_return();
+    }
+
+    if (0 != success || 0 != fflush(stdout)) {
+        fprintf(stderr, "Could not write the output\n");
+        return 2;
+    }
+    return 0;
+}
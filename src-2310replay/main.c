@@ -0,0 +1,392 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../inc/errorReturn.h"
+#include "../inc/protocol.h"
+#include "../inc/siteEffects.h"
+#include "../inc/counters.h"
+#include "../inc/strategy.h"
+#include "../inc/journal.h"
+#include "../inc/replay.h"
+
+/*
+ *Records per chunk handed to a thread, by default.
+ */
+#define DEFAULT_CHUNK_RECORDS (1024 * 1024)
+
+/*
+ *Number of the most crowded sites printed.
+ */
+#define TOP_SITES 10
+
+/*
+ *Identifiers of the long options.
+ */
+enum OptionIds {
+    OPTION_THREADS = 1,
+    OPTION_CHUNK,
+    OPTION_SITE_TABLE,
+    OPTION_COUNTERS
+};
+
+/*
+ *All the options the analyzer understands.
+ */
+const struct option longOptions[] = {
+    { "threads", required_argument, NULL, OPTION_THREADS },
+    { "chunk", required_argument, NULL, OPTION_CHUNK },
+    { "site-table", required_argument, NULL, OPTION_SITE_TABLE },
+    { "counters", no_argument, NULL, OPTION_COUNTERS },
+    { NULL, 0, NULL, 0 }
+};
+
+/*
+ *A journal file mapped into memory.
+ */
+typedef struct {
+    void* data;
+    size_t length;
+    ReplayJournal journal;
+} MappedJournal;
+
+/*
+ *Records of one journal replayed by a single thread.
+ */
+typedef struct {
+    int journal;
+    size_t first;
+    size_t last;
+} Chunk;
+
+/*
+ *A thread replaying chunks, with statistics of its own.
+ */
+typedef struct {
+    pthread_t thread;
+    ReplayStats stats;
+    Arena arena;
+} Worker;
+
+/*
+ *Number of threads to replay on, by default one per processor.
+ */
+int threadsCount = 0;
+/*
+ *Records per chunk.
+ */
+int chunkRecords = DEFAULT_CHUNK_RECORDS;
+/*
+ *File describing the site types, NULL for the built-in ones.
+ */
+const char* siteTableName = NULL;
+/*
+ *Set to count hardware events while measuring.
+ */
+int countersEnabled = 0;
+/*
+ *All journals given.
+ */
+MappedJournal* journals = NULL;
+/*
+ *Number of journals given.
+ */
+int journalsCount = 0;
+/*
+ *The chunks of all journals.
+ */
+Chunk* chunks = NULL;
+/*
+ *Number of chunks.
+ */
+size_t chunksCount = 0u;
+/*
+ *Next chunk to be taken by a thread.
+ */
+size_t nextChunk = 0u;
+
+/*
+ *Print how to call the analyzer and exit.
+ */
+void usage_return() {
+    fprintf(stderr, "Usage: 2310replay [--threads=N] [--chunk=N] "
+            "[--site-table=FILE] [--counters] journal {journal}\n");
+    exit(1);
+}
+
+/*
+ *Convert a positive number.
+ */
+int convert_count(const char* text) {
+    char* end = NULL;
+    long number = 0;
+
+    number = strtol(text, &end, 10);
+    if (end == text || '\0' != *end || 1 > number || 1000000000 < number) {
+        usage_return();
+    }
+    return (int)number;
+}
+
+/*
+ *Parse the leading --name=value options.
+ *Returns the index of the first positional argument.
+ */
+int parse_options(int argc, char* argv[]) {
+    int option = 0;
+
+    opterr = 0;
+    while (-1 != (option = getopt_long(argc, argv, "+", longOptions,
+            NULL))) {
+        switch (option) {
+            case OPTION_THREADS:
+                threadsCount = convert_count(optarg);
+                break;
+            case OPTION_CHUNK:
+                chunkRecords = convert_count(optarg);
+                break;
+            case OPTION_SITE_TABLE:
+                siteTableName = optarg;
+                break;
+            case OPTION_COUNTERS:
+                countersEnabled = 1;
+                break;
+            default:
+                usage_return();
+        }
+    }
+    return optind;
+}
+
+/*
+ *Map a journal read-only and parse its header.
+ *Exits if the file is no journal.
+ */
+void map_journal(MappedJournal* mapped, const char* name) {
+    struct stat status;
+    int fd = open(name, O_RDONLY);
+
+    if (-1 == fd || 0 != fstat(fd, &status) || !status.st_size) {
+        fprintf(stderr, "Unable to read journal %s\n", name);
+        exit(2);
+    }
+    mapped->length = (size_t)status.st_size;
+    mapped->data = mmap(NULL, mapped->length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == mapped->data) {
+        fprintf(stderr, "Unable to read journal %s\n", name);
+        exit(2);
+    }
+    /*Every record is read once, in order*/
+    madvise(mapped->data, mapped->length, MADV_SEQUENTIAL);
+
+    if (!replay_open(&mapped->journal, mapped->data, mapped->length)) {
+        fprintf(stderr, "Invalid journal %s\n", name);
+        exit(3);
+    }
+}
+
+/*
+ *Map all journals and cut them into chunks.
+ */
+void read_journals(int argc, char* argv[]) {
+    FILE* stream = NULL;
+    size_t records = 0u;
+    size_t first = 0u;
+    int i = 0;
+
+    if (siteTableName) {
+        stream = fopen(siteTableName, "r");
+        if (!stream || E_OK != site_table_load(stream)) {
+            usage_return();
+        }
+        fclose(stream);
+    }
+
+    journalsCount = argc;
+    journals = (MappedJournal*)calloc(journalsCount, sizeof(MappedJournal));
+    for (i = 0; i < journalsCount; i++) {
+        map_journal(journals + i, argv[i]);
+        records = journals[i].journal.view.recordsCount;
+        chunksCount += (records + chunkRecords - 1) / chunkRecords;
+    }
+
+    chunks = (Chunk*)malloc(chunksCount * sizeof(Chunk));
+    chunksCount = 0u;
+    for (i = 0; i < journalsCount; i++) {
+        records = journals[i].journal.view.recordsCount;
+        for (first = 0u; first < records; first += chunkRecords) {
+            chunks[chunksCount].journal = i;
+            chunks[chunksCount].first = first;
+            chunks[chunksCount].last = MIN(first + chunkRecords, records);
+            chunksCount++;
+        }
+    }
+}
+
+/*
+ *Replay chunks until none are left.
+ */
+void* run_worker(void* argument) {
+    Worker* worker = (Worker*)argument;
+    const Chunk* chunk = NULL;
+    size_t i = 0u;
+
+    while ((i = __atomic_fetch_add(&nextChunk, 1u, __ATOMIC_RELAXED))
+            < chunksCount) {
+        chunk = chunks + i;
+        replay_chunk(&worker->stats, &journals[chunk->journal].journal,
+                chunk->first, chunk->last, &worker->arena);
+    }
+    return NULL;
+}
+
+/*
+ *Print the sites most often found occupied on arrival.
+ */
+void print_crowded_sites(const ReplayStats* stats) {
+    int* printed = (int*)calloc(stats->siteCount, sizeof(int));
+    size_t best = 0u;
+    size_t i = 0u;
+    int j = 0;
+
+    for (j = 0; j < TOP_SITES; j++) {
+        best = stats->siteCount;
+        for (i = 0u; i < stats->siteCount; i++) {
+            if (!printed[i] && stats->sharedArrivals[i] && (best
+                    == stats->siteCount || stats->sharedArrivals[best]
+                            < stats->sharedArrivals[i])) {
+                best = i;
+            }
+        }
+        if (best == stats->siteCount) {
+            break;
+        }
+        printed[best] = 1;
+        printf("Site %zu Arrivals=%lu Shared=%lu Filled=%lu\n", best,
+                stats->arrivals[best], stats->sharedArrivals[best],
+                stats->filledArrivals[best]);
+    }
+    free(printed);
+}
+
+/*
+ *Print what all games add up to and how fast they have been replayed.
+ */
+void print_results(const ReplayStats* stats, size_t bytes,
+        double seconds) {
+    int i = 0;
+
+    printf("Journals=%d Games=%lu Aborted=%lu Unfinished=%lu Corrupt=%lu "
+            "Moves=%lu\n", journalsCount, stats->games, stats->aborted,
+            stats->unfinished, stats->corrupt, stats->moves);
+
+    for (i = 0; i < site_table()->count; i++) {
+        if (stats->typeArrivals[i]) {
+            printf("Type %s Arrivals=%lu Shared=%lu Filled=%lu\n",
+                    site_table()->effects[i].name, stats->typeArrivals[i],
+                    stats->typeSharedArrivals[i],
+                    stats->typeFilledArrivals[i]);
+        }
+    }
+    print_crowded_sites(stats);
+
+    for (i = 0; i < STRATEGY_RULES_COUNT; i++) {
+        printf("Rule %s=%lu\n", strategy_rule_name((enum StrategyRules)i),
+                stats->rules[i]);
+    }
+    printf("OffStrategy=%lu Unexplained=%lu\n", stats->offStrategy,
+            stats->unexplained);
+
+    for (i = 0; i < REPLAY_STAGES; i++) {
+        printf("Stage %d%% Lead=%.2f\n", (i + 1) * 100 / REPLAY_STAGES,
+                stats->leadCounts[i]
+                        ? stats->leads[i] / stats->leadCounts[i] : 0.0);
+    }
+    printf("Comebacks=%lu Deficit=%.2f\n", stats->comebacks,
+            stats->games ? stats->deficits / stats->games : 0.0);
+
+    printf("Seconds=%.3f MB/s=%.1f\n", seconds, 0.0 < seconds
+            ? bytes / seconds / (1024.0 * 1024.0) : 0.0);
+}
+
+/*
+ *Replay recorded games from their journals on several threads, each
+ *adding up its own statistics, which are merged in the end.
+ */
+int main(int argc, char* argv[]) {
+    Worker* workers = NULL;
+    ReplayStats stats;
+    Counters counters;
+    struct timespec start;
+    struct timespec end;
+    size_t bytes = 0u;
+    int i = 0;
+
+    i = parse_options(argc, argv);
+    argc -= i;
+    argv += i;
+    if (1 > argc) {
+        usage_return();
+    }
+    if (!threadsCount) {
+        threadsCount = (int)MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
+    }
+
+    counters_init(&counters);
+    if (countersEnabled) {
+        /*Inherited by the worker threads started from now on*/
+        counters_open(&counters, 0, 1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    read_journals(argc, argv);
+    threadsCount = (int)MAX(MIN((size_t)threadsCount, chunksCount), 1u);
+    workers = (Worker*)calloc(threadsCount, sizeof(Worker));
+    for (i = 0; i < threadsCount; i++) {
+        replay_stats_init(&workers[i].stats);
+        arena_init(&workers[i].arena, ARENA_BLOCK_SIZE);
+        if (0 != pthread_create(&workers[i].thread, NULL, run_worker,
+                workers + i)) {
+            /*Replay on the main thread what the others leave*/
+            run_worker(workers + i);
+            workers[i].thread = pthread_self();
+        }
+    }
+
+    replay_stats_init(&stats);
+    for (i = 0; i < threadsCount; i++) {
+        if (!pthread_equal(workers[i].thread, pthread_self())) {
+            pthread_join(workers[i].thread, NULL);
+        }
+        replay_stats_merge(&stats, &workers[i].stats);
+        replay_stats_free(&workers[i].stats);
+        arena_free(&workers[i].arena);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    counters_read(&counters);
+
+    for (i = 0; i < journalsCount; i++) {
+        bytes += journals[i].length;
+    }
+    print_results(&stats, bytes, (double)(end.tv_sec - start.tv_sec)
+            + (end.tv_nsec - start.tv_nsec) / 1e9);
+    if (countersEnabled) {
+        counters_print(stdout, "", &counters);
+    }
+
+    for (i = 0; i < journalsCount; i++) {
+        replay_close(&journals[i].journal);
+        munmap(journals[i].data, journals[i].length);
+    }
+    replay_stats_free(&stats);
+    free(journals);
+    free(chunks);
+    free(workers);
+    return 0;
+}
@@ -0,0 +1,365 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../inc/protocol.h"
+#include "../inc/results.h"
+
+/*
+ *Number of strategy letters a total is kept for.
+ */
+#define LETTERS (UCHAR_MAX + 1)
+
+/*
+ *Identifiers of the long options.
+ */
+enum OptionIds {
+    OPTION_THREADS = 1
+};
+
+/*
+ *All the options the scanner understands.
+ */
+const struct option longOptions[] = {
+    { "threads", required_argument, NULL, OPTION_THREADS },
+    { NULL, 0, NULL, 0 }
+};
+
+/*
+ *A results file mapped into memory.
+ */
+typedef struct {
+    void* data;
+    size_t length;
+} MappedResults;
+
+/*
+ *What the seats of a strategy add up to.
+ *wins .. Games the seat has the best score of, shared ones included.
+ */
+typedef struct {
+    unsigned long seats;
+    long long scores;
+    long long v1s;
+    long long v2s;
+    long long cardPoints;
+    long long moneyPoints;
+    unsigned long wins;
+} StrategyTotals;
+
+/*
+ *A thread scanning blocks, with totals of its own.
+ *best .. Best score of every row of the block being scanned.
+ */
+typedef struct {
+    pthread_t thread;
+    StrategyTotals strategies[LETTERS];
+    unsigned long games;
+    unsigned long long moves;
+    unsigned long long durations;
+    int32_t* best;
+    size_t bestLength;
+} Worker;
+
+/*
+ *Number of threads to scan on, by default one per processor.
+ */
+int threadsCount = 0;
+/*
+ *All results files given.
+ */
+MappedResults* files = NULL;
+/*
+ *Number of results files given.
+ */
+int filesCount = 0;
+/*
+ *The blocks of all files.
+ */
+ResultsBlock* blocks = NULL;
+/*
+ *Number of blocks.
+ */
+size_t blocksCount = 0u;
+/*
+ *Next block to be taken by a thread.
+ */
+size_t nextBlock = 0u;
+
+/*
+ *Print how to call the scanner and exit.
+ */
+void usage_return() {
+    fprintf(stderr, "Usage: 2310results [--threads=N] results {results}\n");
+    exit(1);
+}
+
+/*
+ *Convert a positive number.
+ */
+int convert_count(const char* text) {
+    char* end = NULL;
+    long number = 0;
+
+    number = strtol(text, &end, 10);
+    if (end == text || '\0' != *end || 1 > number || 1000000000 < number) {
+        usage_return();
+    }
+    return (int)number;
+}
+
+/*
+ *Parse the leading --name=value options.
+ *Returns the index of the first positional argument.
+ */
+int parse_options(int argc, char* argv[]) {
+    int option = 0;
+
+    opterr = 0;
+    while (-1 != (option = getopt_long(argc, argv, "+", longOptions,
+            NULL))) {
+        switch (option) {
+            case OPTION_THREADS:
+                threadsCount = convert_count(optarg);
+                break;
+            default:
+                usage_return();
+        }
+    }
+    return optind;
+}
+
+/*
+ *Map a results file read-only and find its blocks, which are added to
+ *the given ones.
+ *Exits if the file holds no results.
+ */
+void map_results(MappedResults* mapped, const char* name,
+        size_t* capacity) {
+    ResultsFile file;
+    struct stat status;
+    int fd = open(name, O_RDONLY);
+
+    if (-1 == fd || 0 != fstat(fd, &status) || !status.st_size) {
+        fprintf(stderr, "Unable to read results %s\n", name);
+        exit(2);
+    }
+    mapped->length = (size_t)status.st_size;
+    mapped->data = mmap(NULL, mapped->length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == mapped->data) {
+        fprintf(stderr, "Unable to read results %s\n", name);
+        exit(2);
+    }
+    /*Every column is read once, in order*/
+    madvise(mapped->data, mapped->length, MADV_SEQUENTIAL);
+
+    if (!results_open(&file, mapped->data, mapped->length)) {
+        fprintf(stderr, "Invalid results %s\n", name);
+        exit(3);
+    }
+    while (1) {
+        if (blocksCount == *capacity) {
+            *capacity = MAX(*capacity * 2u, 64u);
+            blocks = (ResultsBlock*)realloc(blocks,
+                    *capacity * sizeof(ResultsBlock));
+        }
+        if (!results_next_block(&file, blocks + blocksCount)) {
+            break;
+        }
+        blocksCount++;
+    }
+}
+
+/*
+ *Map all results files and find their blocks.
+ */
+void read_results(int argc, char* argv[]) {
+    size_t capacity = 0u;
+    int i = 0;
+
+    filesCount = argc;
+    files = (MappedResults*)calloc(filesCount, sizeof(MappedResults));
+    for (i = 0; i < filesCount; i++) {
+        map_results(files + i, argv[i], &capacity);
+    }
+}
+
+/*
+ *Add up the columns of a block, one column after the other.
+ */
+void scan_block(Worker* worker, const ResultsBlock* block) {
+    StrategyTotals* totals = NULL;
+    size_t rows = block->rows;
+    size_t cell = 0u;
+    size_t i = 0u;
+    int seat = 0;
+
+    for (i = 0u; i < rows; i++) {
+        worker->moves += block->moves[i];
+        worker->durations += block->durations[i];
+    }
+    worker->games += rows;
+
+    if (worker->bestLength < rows) {
+        worker->bestLength = rows;
+        worker->best = (int32_t*)realloc(worker->best,
+                rows * sizeof(int32_t));
+    }
+    for (i = 0u; i < rows; i++) {
+        worker->best[i] = INT32_MIN;
+    }
+    for (cell = 0u, seat = 0; seat < block->playersCount; seat++) {
+        for (i = 0u; i < rows; i++, cell++) {
+            worker->best[i] = MAX(worker->best[i], block->scores[cell]);
+        }
+    }
+
+    for (cell = 0u, seat = 0; seat < block->playersCount; seat++) {
+        for (i = 0u; i < rows; i++, cell++) {
+            totals = worker->strategies
+                    + (unsigned char)block->strategies[cell];
+            totals->seats += 1u;
+            totals->scores += block->scores[cell];
+            totals->v1s += block->v1s[cell];
+            totals->v2s += block->v2s[cell];
+            totals->cardPoints += block->cardPoints[cell];
+            totals->moneyPoints += block->moneyPoints[cell];
+            totals->wins += worker->best[i] == block->scores[cell];
+        }
+    }
+}
+
+/*
+ *Scan blocks until none are left.
+ */
+void* run_worker(void* argument) {
+    Worker* worker = (Worker*)argument;
+    size_t i = 0u;
+
+    while ((i = __atomic_fetch_add(&nextBlock, 1u, __ATOMIC_RELAXED))
+            < blocksCount) {
+        scan_block(worker, blocks + i);
+    }
+    return NULL;
+}
+
+/*
+ *Add the totals of a worker to the first one's.
+ */
+void merge_worker(Worker* totals, const Worker* worker) {
+    StrategyTotals* strategy = NULL;
+    const StrategyTotals* other = NULL;
+    int i = 0;
+
+    totals->games += worker->games;
+    totals->moves += worker->moves;
+    totals->durations += worker->durations;
+    for (i = 0; i < LETTERS; i++) {
+        strategy = totals->strategies + i;
+        other = worker->strategies + i;
+        strategy->seats += other->seats;
+        strategy->scores += other->scores;
+        strategy->v1s += other->v1s;
+        strategy->v2s += other->v2s;
+        strategy->cardPoints += other->cardPoints;
+        strategy->moneyPoints += other->moneyPoints;
+        strategy->wins += other->wins;
+    }
+}
+
+/*
+ *Print what all games add up to and how fast they have been scanned.
+ */
+void print_results(const Worker* totals, size_t bytes, double seconds) {
+    const StrategyTotals* strategy = NULL;
+    double games = totals->games ? (double)totals->games : 1.0;
+    int i = 0;
+
+    printf("Files=%d Blocks=%zu Games=%lu Moves=%.2f Duration=%.0fus\n",
+            filesCount, blocksCount, totals->games, totals->moves / games,
+            totals->durations / games);
+    for (i = 0; i < LETTERS; i++) {
+        strategy = totals->strategies + i;
+        if (!strategy->seats) {
+            continue;
+        }
+        printf("Strategy %c Seats=%lu Mean=%.2f V1=%.2f V2=%.2f Cards=%.2f "
+                "Money=%.2f Wins=%lu\n", i, strategy->seats,
+                (double)strategy->scores / strategy->seats,
+                (double)strategy->v1s / strategy->seats,
+                (double)strategy->v2s / strategy->seats,
+                (double)strategy->cardPoints / strategy->seats,
+                (double)strategy->moneyPoints / strategy->seats,
+                strategy->wins);
+    }
+    printf("Seconds=%.3f Games/s=%.0f MB/s=%.1f\n", seconds,
+            0.0 < seconds ? totals->games / seconds : 0.0, 0.0 < seconds
+            ? bytes / seconds / (1024.0 * 1024.0) : 0.0);
+}
+
+/*
+ *Scan results files on several threads, each adding up the columns of the
+ *blocks it takes, which are merged in the end.
+ */
+int main(int argc, char* argv[]) {
+    Worker* workers = NULL;
+    struct timespec start;
+    struct timespec end;
+    size_t bytes = 0u;
+    int i = 0;
+
+    i = parse_options(argc, argv);
+    argc -= i;
+    argv += i;
+    if (1 > argc) {
+        usage_return();
+    }
+    if (!threadsCount) {
+        threadsCount = (int)MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    read_results(argc, argv);
+    threadsCount = (int)MAX(MIN((size_t)threadsCount, blocksCount), 1u);
+    workers = (Worker*)calloc(threadsCount, sizeof(Worker));
+    for (i = 0; i < threadsCount; i++) {
+        if (0 != pthread_create(&workers[i].thread, NULL, run_worker,
+                workers + i)) {
+            /*Scan on the main thread what the others leave*/
+            run_worker(workers + i);
+            workers[i].thread = pthread_self();
+        }
+    }
+    for (i = 0; i < threadsCount; i++) {
+        if (!pthread_equal(workers[i].thread, pthread_self())) {
+            pthread_join(workers[i].thread, NULL);
+        }
+        if (i) {
+            merge_worker(workers, workers + i);
+        }
+        free(workers[i].best);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for (i = 0; i < filesCount; i++) {
+        bytes += files[i].length;
+    }
+    print_results(workers, bytes, (double)(end.tv_sec - start.tv_sec)
+            + (end.tv_nsec - start.tv_nsec) / 1e9);
+
+    for (i = 0; i < filesCount; i++) {
+        munmap(files[i].data, files[i].length);
+    }
+    free(files);
+    free(blocks);
+    free(workers);
+    return 0;
+}
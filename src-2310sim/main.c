@@ -0,0 +1,423 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include "../inc/errorReturn.h"
+#include "../inc/protocol.h"
+#include "../inc/siteEffects.h"
+#include "../inc/counters.h"
+#include "../inc/results.h"
+#include "../inc/samples.h"
+#include "../inc/engine.h"
+#include "../inc/simulation.h"
+
+/*
+ *Games in flight on every thread, by default.
+ */
+#define DEFAULT_TABLES 1000
+
+/*
+ *Identifiers of the long options.
+ */
+enum OptionIds {
+    OPTION_GAMES = 1,
+    OPTION_TABLES,
+    OPTION_THREADS,
+    OPTION_SITE_TABLE,
+    OPTION_COUNTERS,
+    OPTION_RESULTS,
+    OPTION_SAMPLES
+};
+
+/*
+ *All the options the simulator understands.
+ */
+const struct option longOptions[] = {
+    { "games", required_argument, NULL, OPTION_GAMES },
+    { "tables", required_argument, NULL, OPTION_TABLES },
+    { "threads", required_argument, NULL, OPTION_THREADS },
+    { "site-table", required_argument, NULL, OPTION_SITE_TABLE },
+    { "counters", no_argument, NULL, OPTION_COUNTERS },
+    { "results", required_argument, NULL, OPTION_RESULTS },
+    { "samples", required_argument, NULL, OPTION_SAMPLES },
+    { NULL, 0, NULL, 0 }
+};
+
+/*
+ *Games played on one thread, numbered from firstGame on.
+ */
+typedef struct {
+    pthread_t thread;
+    SimScheduler scheduler;
+    int games;
+    unsigned long firstGame;
+    ResultsWriter results;
+    SampleExporter samples;
+} Worker;
+
+/*
+ *Number of games to play.
+ */
+int gamesCount = 1;
+/*
+ *Number of games in flight on every thread.
+ */
+int tablesCount = DEFAULT_TABLES;
+/*
+ *Number of threads to play on.
+ */
+int threadsCount = 1;
+/*
+ *File describing the site types, NULL for the built-in ones.
+ */
+const char* siteTableName = NULL;
+/*
+ *Set to count hardware events while measuring.
+ */
+int countersEnabled = 0;
+/*
+ *File to append the scores of all games to, NULL for none.
+ */
+const char* resultsName = NULL;
+/*
+ *The results file, once opened.
+ */
+FILE* resultsFile = NULL;
+/*
+ *File to record the players' decisions in, NULL for none.
+ */
+const char* samplesName = NULL;
+/*
+ *The samples file, once opened.
+ */
+FILE* samplesFile = NULL;
+/*
+ *Number of players of every game.
+ */
+int playersCount = 0;
+/*
+ *Strategy of each seat.
+ */
+enum StrategyTypes* strategies = NULL;
+/*
+ *Strategy letter of each seat.
+ */
+char* strategyLetters = NULL;
+/*
+ *Hash of the path's text, which is dropped once parsed.
+ */
+uint64_t pathHash = 0u;
+/*
+ *Path all games are played on.
+ */
+Path path;
+/*
+ *Deck all games draw from, each from its start.
+ */
+Deck deck;
+
+/*
+ *Print how to call the simulator and exit.
+ */
+void usage_return() {
+    fprintf(stderr, "Usage: 2310sim [--games=N] [--tables=N] [--threads=N] "
+            "[--site-table=FILE] [--counters] [--results=FILE] "
+            "[--samples=FILE] deck path p1 {p2}\n");
+    exit(1);
+}
+
+/*
+ *Convert a positive number.
+ */
+int convert_count(const char* text) {
+    char* end = NULL;
+    long number = 0;
+
+    number = strtol(text, &end, 10);
+    if (end == text || '\0' != *end || 1 > number || 1000000000 < number) {
+        usage_return();
+    }
+    return (int)number;
+}
+
+/*
+ *Parse the leading --name=value options.
+ *Returns the index of the first positional argument.
+ */
+int parse_options(int argc, char* argv[]) {
+    int option = 0;
+
+    opterr = 0;
+    while (-1 != (option = getopt_long(argc, argv, "+", longOptions,
+            NULL))) {
+        switch (option) {
+            case OPTION_GAMES:
+                gamesCount = convert_count(optarg);
+                break;
+            case OPTION_TABLES:
+                tablesCount = convert_count(optarg);
+                break;
+            case OPTION_THREADS:
+                threadsCount = convert_count(optarg);
+                break;
+            case OPTION_SITE_TABLE:
+                siteTableName = optarg;
+                break;
+            case OPTION_COUNTERS:
+                countersEnabled = 1;
+                break;
+            case OPTION_RESULTS:
+                resultsName = optarg;
+                break;
+            case OPTION_SAMPLES:
+                samplesName = optarg;
+                break;
+            default:
+                usage_return();
+        }
+    }
+    return optind;
+}
+
+/*
+ *Read the site table, deck and path, and the strategies of the players.
+ *A player is named by the program playing it, whose last letter tells the
+ *strategy (2310A, 2310B).
+ */
+void read_inputs(int argc, char* argv[]) {
+    FILE* stream = NULL;
+    const char* name = NULL;
+    int i = 0;
+
+    if (siteTableName) {
+        stream = fopen(siteTableName, "r");
+        if (!stream || E_OK != site_table_load(stream)) {
+            usage_return();
+        }
+        fclose(stream);
+    }
+
+    playersCount = argc - 2;
+    strategies = (enum StrategyTypes*)malloc(playersCount
+            * sizeof(enum StrategyTypes));
+    strategyLetters = (char*)malloc(playersCount);
+    for (i = 0; i < playersCount; i++) {
+        name = argv[i + 2];
+        strategyLetters[i] = name[strlen(name) - 1];
+        strategies[i] = engine_convert_strategy(name[strlen(name) - 1]);
+        if (UNKNOWN_STRATEGY == strategies[i]) {
+            usage_return();
+        }
+    }
+
+    stream = fopen(argv[0], "r");
+    if (!stream) {
+        error_return_dealer(stderr, E_DEALER_INVALID_DECK, 1);
+    }
+    dealer_init_deck(stream, &deck, NULL);
+    fclose(stream);
+
+    stream = fopen(argv[1], "r");
+    player_reset_path(&path);
+    if (!stream || E_OK != player_read_path(stream, playersCount, &path)) {
+        error_return_dealer(stderr, E_DEALER_INVALID_PATH, 1);
+    }
+    fclose(stream);
+    pathHash = results_hash(path.buffer, strlen(path.buffer));
+    player_drop_path_text(&path);
+}
+
+/*
+ *Open the results file, creating it if needed, and set up a writer
+ *appending to it for every thread.
+ */
+void open_results(Worker* workers) {
+    uint64_t seed = results_hash(deck.buffer, deck.size);
+    int i = 0;
+
+    resultsFile = fopen(resultsName, "a+b");
+    if (!resultsFile || !results_write_header(resultsFile)) {
+        usage_return();
+    }
+    for (i = 0; i < threadsCount; i++) {
+        results_writer_init(&workers[i].results, resultsFile, playersCount,
+                strategyLetters, seed, pathHash);
+    }
+}
+
+/*
+ *Create the samples file and start an exporter writing to it for every
+ *thread.
+ */
+void open_samples(Worker* workers) {
+    int i = 0;
+
+    samplesFile = fopen(samplesName, "wb");
+    if (!samplesFile || !samples_write_header(samplesFile, playersCount)) {
+        usage_return();
+    }
+    for (i = 0; i < threadsCount; i++) {
+        samples_start(&workers[i].samples, samplesFile, playersCount,
+                SAMPLES_BUFFER_SIZE);
+    }
+}
+
+/*
+ *Play the games of one thread.
+ */
+void* run_worker(void* argument) {
+    Worker* worker = (Worker*)argument;
+
+    sim_init(&worker->scheduler, MIN(tablesCount, worker->games),
+            worker->games, &path, &deck, playersCount, strategies);
+    if (resultsFile) {
+        sim_keep_results(&worker->scheduler, &worker->results,
+                worker->firstGame);
+    }
+    if (samplesFile) {
+        sim_keep_samples(&worker->scheduler, &worker->samples,
+                worker->firstGame);
+    }
+    sim_run(&worker->scheduler);
+    return NULL;
+}
+
+/*
+ *Print the mean score of every seat and how the games were scheduled.
+ */
+void print_results(const Worker* workers, double seconds) {
+    const SimScheduler* scheduler = NULL;
+    long* scores = (long*)calloc(playersCount, sizeof(long));
+    unsigned long moves = 0ul;
+    unsigned long resumes = 0ul;
+    unsigned long batches = 0ul;
+    unsigned long samples = 0ul;
+    unsigned long waits = 0ul;
+    size_t allocations = 0u;
+    size_t systemAllocations = 0u;
+    int failed = 0;
+    int i = 0;
+    int j = 0;
+    int k = 0;
+
+    for (i = 0; i < threadsCount; i++) {
+        scheduler = &workers[i].scheduler;
+        resumes += scheduler->resumes;
+        batches += scheduler->batches;
+        allocations += scheduler->arena.allocations;
+        systemAllocations += scheduler->arena.systemAllocations;
+        samples += workers[i].samples.records;
+        waits += workers[i].samples.waits;
+        for (j = 0; j < scheduler->tablesCount; j++) {
+            moves += scheduler->tables[j].moves;
+            failed += scheduler->tables[j].failed;
+            for (k = 0; k < playersCount; k++) {
+                scores[k] += scheduler->tables[j].scores[k];
+            }
+        }
+    }
+
+    printf("Games=%d Failed=%d Moves=%lu Resumes=%lu Batches=%lu\n",
+            gamesCount, failed, moves, resumes, batches);
+    for (k = 0; k < playersCount; k++) {
+        printf("Player %d Mean=%.2f\n", k, failed < gamesCount
+                ? (double)scores[k] / (gamesCount - failed) : 0.0);
+    }
+    printf("Allocations=%zu SystemAllocations=%zu\n", allocations,
+            systemAllocations);
+    if (samplesFile) {
+        printf("Samples=%lu Waits=%lu\n", samples, waits);
+    }
+    printf("Seconds=%.3f Games/s=%.0f\n", seconds,
+            0.0 < seconds ? gamesCount / seconds : 0.0);
+    free(scores);
+}
+
+/*
+ *Play many games in-process, every seat a coroutine resumed by the
+ *scheduler of its thread instead of a process of its own.
+ */
+int main(int argc, char* argv[]) {
+    Worker* workers = NULL;
+    Counters counters;
+    struct timespec start;
+    struct timespec end;
+    int status = 0;
+    int samplesWritten = 1;
+    int i = 0;
+
+    i = parse_options(argc, argv);
+    argc -= i;
+    argv += i;
+    if (3 > argc) {
+        usage_return();
+    }
+    read_inputs(argc, argv);
+
+    threadsCount = MIN(threadsCount, gamesCount);
+    workers = (Worker*)calloc(threadsCount, sizeof(Worker));
+    if (resultsName) {
+        open_results(workers);
+    }
+    if (samplesName) {
+        open_samples(workers);
+    }
+    counters_init(&counters);
+    if (countersEnabled) {
+        /*Inherited by the worker threads started from now on*/
+        counters_open(&counters, 0, 1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < threadsCount; i++) {
+        workers[i].games = gamesCount / threadsCount
+                + (i < gamesCount % threadsCount);
+        workers[i].firstGame = i ? workers[i - 1].firstGame
+                + workers[i - 1].games : 0u;
+        if (0 != pthread_create(&workers[i].thread, NULL, run_worker,
+                workers + i)) {
+            /*Play this share of the games on the main thread*/
+            run_worker(workers + i);
+            workers[i].thread = pthread_self();
+        }
+    }
+    for (i = 0; i < threadsCount; i++) {
+        if (!pthread_equal(workers[i].thread, pthread_self())) {
+            pthread_join(workers[i].thread, NULL);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    counters_read(&counters);
+    for (i = 0; samplesFile && i < threadsCount; i++) {
+        /*What is left to write is not measured*/
+        samplesWritten = samples_stop(&workers[i].samples) && samplesWritten;
+    }
+
+    print_results(workers, (double)(end.tv_sec - start.tv_sec)
+            + (end.tv_nsec - start.tv_nsec) / 1e9);
+    if (countersEnabled) {
+        counters_print(stdout, "", &counters);
+    }
+
+    for (i = 0; i < threadsCount; i++) {
+        sim_free(&workers[i].scheduler);
+        if (resultsFile && !results_writer_free(&workers[i].results)) {
+            status = 2;
+        }
+    }
+    if (resultsFile && (0 != fclose(resultsFile) || status)) {
+        fprintf(stderr, "Unable to write results %s\n", resultsName);
+        status = 2;
+    }
+    if (samplesFile && (0 != fclose(samplesFile) || !samplesWritten)) {
+        fprintf(stderr, "Unable to write samples %s\n", samplesName);
+        status = 2;
+    }
+    free(workers);
+    free(strategies);
+    free(strategyLetters);
+    free(deck.buffer);
+    player_free_path(&path);
+    return status;
+}
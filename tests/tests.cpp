@@ -1,7 +1,35 @@
 #include "../inc/errorReturn.h"
 //#include "../inc/errorReturn.c"
+#include "../inc/arena.h"
+#include "../inc/arena.c"
 #include "../inc/protocol.h"
 #include "../inc/protocol.c"
+#include "../inc/strategy.h"
+#include "../inc/strategy.c"
+#include "../inc/engine.h"
+#include "../inc/engine.c"
+#include "../inc/sharedPath.h"
+#include "../inc/sharedPath.c"
+#include "../inc/pathWindow.h"
+#include "../inc/pathWindow.c"
+#include "../inc/workload.h"
+#include "../inc/workload.c"
+#include "../inc/siteEffects.h"
+#include "../inc/siteEffects.c"
+#include "../inc/simulation.h"
+#include "../inc/simulation.c"
+#include "../inc/journal.h"
+#include "../inc/journal.c"
+#include "../inc/replay.h"
+#include "../inc/replay.c"
+#include "../inc/handoff.h"
+#include "../inc/handoff.c"
+#include "../inc/counters.h"
+#include "../inc/counters.c"
+#include "../inc/results.h"
+#include "../inc/results.c"
+#include "../inc/samples.h"
+#include "../inc/samples.c"
 #include <vector>
 #include <array>
 #include <string>
@@ -106,18 +134,18 @@ TEST_F(PlayerASuite, test_read_path) {
     EXPECT_EQ(E_OK, player_read_path(fileStream[0], 2, path));
     EXPECT_EQ(7, path->siteCount);
     EXPECT_EQ(25, path->bufferLength);
-    EXPECT_EQ(BARRIER, path->sites[0].type);
-    EXPECT_EQ(MO, path->sites[1].type);
-    EXPECT_EQ(V1, path->sites[2].type);
-    EXPECT_EQ(V2, path->sites[3].type);
-    EXPECT_EQ(MO, path->sites[4].type);
-    EXPECT_EQ(MO, path->sites[5].type);
-    EXPECT_EQ(BARRIER, path->sites[6].type);
-    EXPECT_EQ(1, path->sites[1].capacity);
-    EXPECT_EQ(1, path->sites[2].capacity);
-    EXPECT_EQ(2, path->sites[3].capacity);
-    EXPECT_EQ(1, path->sites[4].capacity);
-    EXPECT_EQ(1, path->sites[5].capacity);
+    EXPECT_EQ(BARRIER, path_site_type(path, 0));
+    EXPECT_EQ(MO, path_site_type(path, 1));
+    EXPECT_EQ(V1, path_site_type(path, 2));
+    EXPECT_EQ(V2, path_site_type(path, 3));
+    EXPECT_EQ(MO, path_site_type(path, 4));
+    EXPECT_EQ(MO, path_site_type(path, 5));
+    EXPECT_EQ(BARRIER, path_site_type(path, 6));
+    EXPECT_EQ(1, path_site_capacity(path, 1));
+    EXPECT_EQ(1, path_site_capacity(path, 2));
+    EXPECT_EQ(2, path_site_capacity(path, 3));
+    EXPECT_EQ(1, path_site_capacity(path, 4));
+    EXPECT_EQ(1, path_site_capacity(path, 5));
 }
 
 TEST_F(PlayerASuite, test_read_path_wrong_beginning) {
@@ -223,6 +251,58 @@ TEST_F(PlayerASuite, test_print_path) {
     player_print_path(stdout, path, 4, 7, positions, rankings, 1);
 }
 
+TEST_F(PlayerASuite, test_arena) {
+    Arena arena;
+    ArenaMark mark;
+    Path parsed;
+    int positions[] = { 1, 2 };
+    int rankings[] = { 0, 0 };
+    char* first = nullptr;
+    size_t bytes = 0u;
+    size_t allocations = 0u;
+    arena_init(&arena, 64u);
+
+    first = (char*)arena_alloc(&arena, 40u);
+    EXPECT_EQ(0u, (uintptr_t)first % ARENA_ALIGNMENT);
+    arena_alloc(&arena, 40u);
+    EXPECT_EQ(2u, arena.systemAllocations);
+    mark = arena_mark(&arena);
+    arena_alloc(&arena, 100u);
+    arena_release(&arena, mark);
+    EXPECT_EQ(96u, arena.bytes);
+    // The spare block serves the same scratch again
+    arena_alloc(&arena, 100u);
+    EXPECT_EQ(3u, arena.systemAllocations);
+
+    // Grown blocks are merged, so the next game fits into one
+    arena_reset(&arena);
+    EXPECT_EQ(4u, arena.systemAllocations);
+    EXPECT_EQ(nullptr, arena.block->previous);
+    arena_alloc(&arena, 40u);
+    arena_alloc(&arena, 40u);
+    arena_alloc(&arena, 100u);
+    EXPECT_EQ(4u, arena.systemAllocations);
+    EXPECT_EQ(208u, arena.peakBytes);
+
+    // A path in the arena prints without allocating for good
+    arena_reset(&arena);
+    fputs("7;::-Mo1V11V22Mo1Mo1::-\n", fileStream[1]);
+    fclose(fileStream[1]);
+    fileStream[1] = nullptr;
+    player_reset_path(&parsed);
+    parsed.arena = &arena;
+    allocations = arena.allocations;
+    ASSERT_EQ(E_OK, player_read_path(fileStream[0], 2, &parsed));
+    // Only the sites are taken from it, the text can be dropped
+    EXPECT_EQ(allocations + 1u, arena.allocations);
+    player_drop_path_text(&parsed);
+    bytes = arena.bytes;
+    player_print_path(stdout, &parsed, 2, 7, positions, rankings, 1);
+    EXPECT_EQ(bytes, arena.bytes);
+    player_free_path(&parsed);
+    arena_free(&arena);
+}
+
 TEST_F(PlayerASuite, test_site_usage0) {
     int positions[] = { 1, 2, 2, 0 };
     int usage = player_get_site_usage(positions, 4, 2);
@@ -283,3 +363,887 @@ TEST_F(PlayerASuite, test_calculate_card_points0) {
     EXPECT_EQ(0, dealer_calculate_card_points(&player));
 }
 
+TEST_F(PlayerASuite, test_strategy_first_moves) {
+    int positions[] = { 0, 0 };
+    int rankings[] = { 1, 0 };
+    Player players[2];
+    StrategyView view;
+    const char buffer[] = "7;::-Mo1V11V22Mo1Mo1::-\n";
+    fputs(buffer, fileStream[1]);
+    fclose(fileStream[1]);
+    fileStream[1] = nullptr;
+    EXPECT_EQ(E_OK, player_read_path(fileStream[0], 2, path));
+    dealer_reset_player(players);
+    dealer_reset_player(players + 1);
+
+    view.path = path;
+    view.playersCount = 2;
+    view.positions = positions;
+    view.rankings = rankings;
+    view.players = players;
+    view.index = nullptr;
+
+    view.ownId = 0;
+    EXPECT_EQ(1, strategy_a_choose_site(&view));
+    view.ownId = 1;
+    EXPECT_EQ(1, strategy_b_choose_site(&view));
+
+    /*The first Mo is taken now, so B heads for the next one*/
+    positions[0] = 1;
+    rankings[0] = 0;
+    EXPECT_EQ(4, strategy_b_choose_site(&view));
+}
+
+TEST_F(PlayerASuite, test_engine_play_out) {
+    int positions[2];
+    int rankings[2];
+    Player players[2];
+    char cards[] = "ABACDEE";
+    enum StrategyTypes strategies[] = { STRATEGY_A, STRATEGY_B };
+    Deck deck;
+    Game game;
+    const char buffer[] = "7;::-Mo1V11V22Mo1Mo1::-\n";
+    fputs(buffer, fileStream[1]);
+    fclose(fileStream[1]);
+    fileStream[1] = nullptr;
+    EXPECT_EQ(E_OK, player_read_path(fileStream[0], 2, path));
+
+    deck.buffer = cards;
+    deck.size = 7u;
+    game.path = path;
+    game.playersCount = 2;
+    game.positions = positions;
+    game.rankings = rankings;
+    game.players = players;
+    game.deck = &deck;
+    game.seed = 1u;
+    engine_reset_game(&game);
+
+    EXPECT_EQ(0, dealer_calculate_next_player(2, positions, rankings));
+    EXPECT_NE(0, engine_play_out(&game, strategies));
+    EXPECT_EQ(6, positions[0]);
+    EXPECT_EQ(6, positions[1]);
+    EXPECT_EQ(2, engine_final_score(players));
+    EXPECT_EQ(0, engine_final_score(players + 1));
+}
+
+TEST_F(PlayerASuite, test_strategy_index) {
+    int positions[4];
+    int rankings[4];
+    Player players[4];
+    char cards[] = "ABACDEEBCA";
+    StrategyIndex indices[4];
+    StrategyView view;
+    Arena arena;
+    Deck deck;
+    Game game;
+    enum StrategyRules scanned = RULE_B_NEXT_FREE;
+    enum StrategyRules indexed = RULE_B_NEXT_FREE;
+    int pointDiff = 0;
+    int moneyDiff = 0;
+    int newCard = 0;
+    int moves = 0;
+    int site = 0;
+    int id = 0;
+    int i = 0;
+    const char buffer[] = "10;::-Mo1V11Ri1V21Do1Mo2Ri1V12::-\n";
+    fputs(buffer, fileStream[1]);
+    fclose(fileStream[1]);
+    fileStream[1] = nullptr;
+    EXPECT_EQ(E_OK, player_read_path(fileStream[0], 4, path));
+
+    deck.buffer = cards;
+    deck.size = 10u;
+    game.path = path;
+    game.playersCount = 4;
+    game.positions = positions;
+    game.rankings = rankings;
+    game.players = players;
+    game.deck = &deck;
+    game.seed = 1u;
+    engine_reset_game(&game);
+    arena_init(&arena, ARENA_BLOCK_SIZE);
+    for (i = 0; i < 4; i++) {
+        strategy_index_init(indices + i, path, 4, i, &arena);
+    }
+    view.path = path;
+    view.playersCount = 4;
+    view.positions = positions;
+    view.rankings = rankings;
+    view.players = players;
+
+    // Every B seat decides the same with the index as by scanning
+    while (!dealer_is_finished(4, path->siteCount, positions, rankings)) {
+        id = dealer_calculate_next_player(4, positions, rankings);
+        view.ownId = id;
+        view.index = nullptr;
+        site = strategy_b_explain_site(&view, &scanned);
+        view.index = indices + id;
+        EXPECT_EQ(site, strategy_b_explain_site(&view, &indexed));
+        EXPECT_EQ(scanned, indexed);
+        ASSERT_NE(-1, site);
+
+        dealer_move_player(id, site, 4, positions, rankings);
+        dealer_calculate_player_earnings(id, site, &pointDiff, &moneyDiff,
+                &newCard, path, players + id, &deck);
+        for (i = 0; i < 4; i++) {
+            strategy_index_update(indices + i, path, id, site, players + id);
+        }
+        moves++;
+    }
+    EXPECT_LT(4, moves);
+    EXPECT_EQ(4u, indices[0].usage[9]);
+    EXPECT_EQ(9u, indices[1].rearmostOther);
+    arena_free(&arena);
+}
+
+TEST_F(PlayerASuite, test_engine_random) {
+    unsigned int first = 0u;
+    unsigned int second = 0u;
+    EXPECT_NE(0u, engine_random(&first));
+    EXPECT_EQ(engine_random(&second), first);
+    EXPECT_EQ(STRATEGY_A, engine_convert_strategy('A'));
+    EXPECT_EQ(STRATEGY_B, engine_convert_strategy('b'));
+    EXPECT_EQ(UNKNOWN_STRATEGY, engine_convert_strategy('Z'));
+}
+
+TEST_F(PlayerASuite, test_new_game) {
+    char buffer[MESSAGE_LENGTH];
+    int playersCount = 0;
+    int id = 0;
+    int withPath = 0;
+    EXPECT_EQ(13, dealer_format_new_game(buffer, sizeof(buffer), 3, 1, 0));
+    EXPECT_STREQ("NEWGAME3,1,0\n", buffer);
+    EXPECT_EQ(E_OK, player_parse_new_game(buffer, &playersCount, &id,
+            &withPath));
+    EXPECT_EQ(3, playersCount);
+    EXPECT_EQ(1, id);
+    EXPECT_EQ(0, withPath);
+    EXPECT_EQ(E_COMMS_ERROR, player_parse_new_game("NEWGAME2,2,0\n",
+            &playersCount, &id, &withPath));
+    EXPECT_EQ(E_COMMS_ERROR, player_parse_new_game("DONE\n",
+            &playersCount, &id, &withPath));
+}
+
+TEST_F(PlayerASuite, test_shared_path) {
+    Path shared;
+    int fd = -1;
+    const char buffer[] = "7;::-Mo1V11V22Mo1Mo1::-\n";
+    fputs(buffer, fileStream[1]);
+    fclose(fileStream[1]);
+    fileStream[1] = nullptr;
+    EXPECT_EQ(E_OK, player_read_path(fileStream[0], 2, path));
+
+    fd = shared_path_publish(path, 2);
+    ASSERT_NE(-1, fd);
+    EXPECT_EQ(E_INVALID_PATH, shared_path_attach(fd, 3, &shared));
+    EXPECT_EQ(E_OK, shared_path_attach(fd, 2, &shared));
+    close(fd);
+    EXPECT_EQ(7, shared.siteCount);
+    EXPECT_EQ(0, memcmp(path->storage, shared.storage,
+            path_storage_length(7)));
+    EXPECT_EQ(nullptr, shared.buffer);
+    player_free_path(&shared);
+    EXPECT_EQ(nullptr, shared.storage);
+}
+
+TEST_F(PlayerASuite, test_forfeited_move_broadcast) {
+    int positions[] = { 2, 0 };
+    int rankings[] = { 0, 0 };
+    Player players[2];
+    Player* others = players;
+    const char buffer[] = "7;::-Mo1V11V22Mo1Mo1::-\n";
+    fputs(buffer, fileStream[1]);
+    fclose(fileStream[1]);
+    fileStream[1] = nullptr;
+    EXPECT_EQ(E_OK, player_read_path(fileStream[0], 2, path));
+    dealer_reset_player(players);
+    dealer_reset_player(players + 1);
+
+    /*We sent DO2 too late, the dealer moved us to site 1 instead*/
+    player_process_move_broadcast("HAP0,1,0,3,0\n", positions, rankings, 2,
+            0, players, &others, path);
+    EXPECT_EQ(1, positions[0]);
+    EXPECT_EQ(0, rankings[0]);
+    EXPECT_EQ(10, players[0].money);
+}
+
+TEST_F(PlayerASuite, test_compact_path) {
+    const char buffer[] = "9;::-Mo1V11::-V22Mo1Ri1Do1::-\n";
+    fputs(buffer, fileStream[1]);
+    fclose(fileStream[1]);
+    fileStream[1] = nullptr;
+    EXPECT_EQ(E_OK, player_read_path(fileStream[0], 300, path));
+
+    /*Barriers hold all 300 players, which needs an escape*/
+    EXPECT_EQ(3, path->escapeCount);
+    EXPECT_EQ(300, path_site_capacity(path, 0));
+    EXPECT_EQ(300, path_site_capacity(path, 3));
+    EXPECT_EQ(2, path_site_capacity(path, 4));
+    EXPECT_EQ(3, path_find_site(path, BARRIER, 0));
+    EXPECT_EQ(8, path_find_site(path, BARRIER, 3));
+    EXPECT_EQ(7, path_find_site(path, DO, -1));
+    EXPECT_EQ(-1, path_find_site(path, V1, 2));
+
+    player_drop_path_text(path);
+    EXPECT_EQ(nullptr, path->buffer);
+    EXPECT_EQ(RI, path_site_type(path, 6));
+}
+
+TEST_F(PlayerASuite, test_workload_path) {
+    PathWorkload workload;
+    FILE* file = tmpfile();
+    size_t i = 0;
+    int barrierGap = 0;
+
+    workload_default_path(&workload, 1000u);
+    workload.seed = 42u;
+    workload.weights[DO] = 0u;
+    workload.minCapacity = 2;
+    workload.maxCapacity = 3;
+    ASSERT_TRUE(workload_valid_path(&workload));
+    ASSERT_EQ(0, workload_write_path(file, &workload));
+    rewind(file);
+    ASSERT_EQ(E_OK, player_read_path(file, 4, path));
+    fclose(file);
+
+    EXPECT_EQ(1000u, path->siteCount);
+    /*The last barrier may cut its gap short*/
+    for (i = 1; i + 1 < path->siteCount; i++) {
+        if (BARRIER == path_site_type(path, i)) {
+            EXPECT_LE(2, barrierGap);
+            EXPECT_GE(8, barrierGap);
+            barrierGap = 0;
+            continue;
+        }
+        barrierGap += 1;
+        EXPECT_NE(DO, path_site_type(path, i));
+        EXPECT_LE(2, path_site_capacity(path, i));
+        EXPECT_GE(3, path_site_capacity(path, i));
+    }
+    EXPECT_EQ(BARRIER, path_site_type(path, 999));
+}
+
+TEST_F(PlayerASuite, test_workload_deck) {
+    DeckWorkload workload;
+    Deck deck;
+    char* first = NULL;
+    char* second = NULL;
+    size_t firstLength = 0u;
+    size_t secondLength = 0u;
+    FILE* file = open_memstream(&first, &firstLength);
+    int counts[CARD_TYPES_COUNT] = { 0 };
+    size_t i = 0;
+
+    workload_default_deck(&workload, 10u);
+    workload.seed = 7u;
+    workload.weights[0] = 3u;
+    workload.weights[4] = 0u;
+    ASSERT_EQ(0, workload_write_deck(file, &workload));
+    fclose(file);
+    file = open_memstream(&second, &secondLength);
+    ASSERT_EQ(0, workload_write_deck(file, &workload));
+    fclose(file);
+
+    /*Deterministic for the seed*/
+    EXPECT_EQ(string(first), string(second));
+
+    file = fmemopen(first, firstLength, "r");
+    dealer_init_deck(file, &deck, nullptr);
+    fclose(file);
+    EXPECT_EQ(10u, deck.size);
+    for (i = 0; i < deck.size; i++) {
+        counts[deck.buffer[i] - 'A'] += 1;
+    }
+    /*3:1:1:1:0 of 10 cards*/
+    EXPECT_EQ(5, counts[0]);
+    EXPECT_EQ(0, counts[4]);
+    EXPECT_EQ(10, counts[0] + counts[1] + counts[2] + counts[3]);
+
+    free(deck.buffer);
+    free(first);
+    free(second);
+}
+
+TEST_F(PlayerASuite, test_path_window) {
+    PathWorkload workload;
+    Path windowed;
+    Path shared;
+    FILE* file = tmpfile();
+    int positions[] = { 70000, 90000 };
+    int fd = -1;
+    size_t i = 0;
+    int type = 0;
+
+    workload_default_path(&workload, 100000u);
+    workload.seed = 3u;
+    workload.weights[DO] = 0u;
+    workload.maxGap = 20u;
+    ASSERT_EQ(0, workload_write_path(file, &workload));
+    rewind(file);
+    ASSERT_EQ(E_OK, player_read_path(file, 2, path));
+    rewind(file);
+    ASSERT_EQ(E_OK, path_window_read(file, 2, 1u, &windowed));
+    fclose(file);
+
+    /*Nothing is kept after reading, chunks come back on demand*/
+    EXPECT_EQ(100000u, windowed.siteCount);
+    EXPECT_EQ(0u, windowed.window->loaded[0]);
+    for (i = 0; i < path->siteCount; i += 7u) {
+        EXPECT_EQ(path_site_type(path, i), path_site_type(&windowed, i));
+        EXPECT_EQ(path_site_capacity(path, i),
+                path_site_capacity(&windowed, i));
+    }
+    for (type = 0; type < BARRIER + 1; type++) {
+        for (i = 0; i < path->siteCount; i += 9973u) {
+            EXPECT_EQ(path_find_site(path, (enum SiteTypes)type, (int)i),
+                    path_find_site(&windowed, (enum SiteTypes)type, (int)i));
+        }
+    }
+
+    /*Chunks behind every player are released*/
+    path_window_follow(&windowed, positions, 2);
+    EXPECT_EQ(0u, windowed.window->loaded[0]);
+    EXPECT_EQ(1u, windowed.window->loaded[70000u
+            / windowed.window->chunkSites]);
+    EXPECT_EQ(path_site_type(path, 5), path_site_type(&windowed, 5));
+    player_free_path(&windowed);
+
+    fd = shared_path_publish(path, 2);
+    ASSERT_NE(-1, fd);
+    EXPECT_EQ(E_INVALID_PATH, shared_path_attach_window(fd, 3, 1u, &shared));
+    EXPECT_EQ(E_OK, shared_path_attach_window(fd, 2, 1u, &shared));
+    close(fd);
+    for (i = 0; i < path->siteCount; i += 11u) {
+        EXPECT_EQ(path_site_type(path, i), path_site_type(&shared, i));
+    }
+    EXPECT_EQ(-1, path_find_site(&shared, DO, 0));
+    player_free_path(&shared);
+}
+
+TEST_F(PlayerASuite, test_path_window_invalid) {
+    Path windowed;
+    const char buffer[] = "7;::-Mo1V11V22Mo1Mo1Mo1\n";
+    fputs(buffer, fileStream[1]);
+    fclose(fileStream[1]);
+    fileStream[1] = nullptr;
+    EXPECT_EQ(E_INVALID_PATH, path_window_read(fileStream[0], 2, 1u,
+            &windowed));
+    EXPECT_EQ(nullptr, windowed.window);
+}
+
+TEST_F(PlayerASuite, test_simulation) {
+    int positions[3];
+    int rankings[3];
+    Player players[3];
+    char cards[] = "ABACDEE";
+    enum StrategyTypes strategies[] = { STRATEGY_A, STRATEGY_B, STRATEGY_A };
+    Deck deck;
+    Game game;
+    SimScheduler scheduler;
+    long scores[3] = { 0, 0, 0 };
+    int i = 0;
+    const char buffer[] = "11;::-Mo1V12Ri2Do1::-V21Mo2Ri1Do2::-\n";
+    fputs(buffer, fileStream[1]);
+    fclose(fileStream[1]);
+    fileStream[1] = nullptr;
+    ASSERT_EQ(E_OK, player_read_path(fileStream[0], 3, path));
+
+    deck.buffer = cards;
+    deck.size = 7u;
+    deck.nextCard = cards;
+    game.path = path;
+    game.playersCount = 3;
+    game.positions = positions;
+    game.rankings = rankings;
+    game.players = players;
+    game.deck = &deck;
+    game.seed = 1u;
+    engine_reset_game(&game);
+    ASSERT_NE(0, engine_play_out(&game, strategies));
+
+    // Seats only knowing what HAP tells them play the same game
+    sim_init(&scheduler, 3, 7, path, &deck, 3, strategies);
+    sim_run(&scheduler);
+    for (i = 0; i < scheduler.tablesCount; i++) {
+        EXPECT_EQ(SIM_OVER, scheduler.tables[i].state);
+        EXPECT_EQ(0, scheduler.tables[i].failed);
+        scores[0] += scheduler.tables[i].scores[0];
+        scores[1] += scheduler.tables[i].scores[1];
+        scores[2] += scheduler.tables[i].scores[2];
+    }
+    EXPECT_EQ(3, scheduler.tables[0].gamesPlayed);
+    EXPECT_EQ(2, scheduler.tables[2].gamesPlayed);
+    for (i = 0; i < 3; i++) {
+        EXPECT_EQ(7 * engine_final_score(players + i), scores[i]);
+    }
+    sim_free(&scheduler);
+}
+
+TEST_F(PlayerASuite, test_site_table) {
+    Path loaded;
+    Player player;
+    char cards[] = { 'C' };
+    Deck deck;
+    int pointDiff = 0;
+    int moneyDiff = 0;
+    int newCard = 0;
+    FILE* table = tmpfile();
+    fputs("# name money convert v1 v2 cards blocking\n"
+            "Mo 5 0 0 0 0 0\n"
+            "Gd 1 0 0 1 1 0\n"
+            "Wl 0 0 0 0 0 1\n", table);
+    rewind(table);
+    ASSERT_EQ(E_OK, site_table_load(table));
+    fclose(table);
+    EXPECT_EQ(SITE_TYPES_COUNT + 2, site_table()->count);
+    EXPECT_EQ(SITE_TYPES_COUNT, convert_site_type("Gd"));
+    EXPECT_STREQ("Wl", convert_site_name(
+            (enum SiteTypes)(SITE_TYPES_COUNT + 1)));
+
+    // A new blocking type stops players like a barrier
+    fputs("5;::-Gd1Wl1Mo1::-\n", fileStream[1]);
+    fclose(fileStream[1]);
+    fileStream[1] = nullptr;
+    player_reset_path(&loaded);
+    ASSERT_EQ(E_OK, player_read_path(fileStream[0], 2, &loaded));
+    EXPECT_EQ(2, player_find_x_site_ahead(BARRIER, 0, &loaded));
+    EXPECT_EQ(-1, path_find_site(&loaded, DO, 0));
+
+    memset(&player, 0, sizeof(Player));
+    player.money = 7;
+    deck.buffer = cards;
+    deck.size = 1u;
+    deck.nextCard = deck.buffer;
+    dealer_calculate_player_earnings(0, 1, &pointDiff, &moneyDiff, &newCard,
+            &loaded, &player, &deck);
+    EXPECT_EQ(0, pointDiff);
+    EXPECT_EQ(1, moneyDiff);
+    EXPECT_EQ(CARD_C, newCard);
+    EXPECT_EQ(1, player.v2);
+    EXPECT_EQ(1, player.cards[CARD_C]);
+    dealer_calculate_player_earnings(0, 3, &pointDiff, &moneyDiff, &newCard,
+            &loaded, &player, &deck);
+    EXPECT_EQ(5, moneyDiff);
+    EXPECT_EQ(13, player.money);
+    EXPECT_EQ(0, newCard);
+    player_free_path(&loaded);
+    site_table_reset();
+}
+
+TEST_F(PlayerASuite, test_site_table_invalid) {
+    FILE* table = tmpfile();
+    fputs("Gd 1 0 0 1 2 0\n", table);
+    rewind(table);
+    EXPECT_EQ(E_INVALID_PATH, site_table_load(table));
+    fclose(table);
+    EXPECT_EQ(SITE_TYPES_COUNT, site_table()->count);
+    EXPECT_EQ(UNKNOWN_SITE_TYPE, convert_site_type("Gd"));
+}
+
+TEST_F(PlayerASuite, test_site_table_blocking) {
+    int positions[2];
+    int rankings[2];
+    Player players[2];
+    char cards[] = "ABC";
+    enum StrategyTypes strategies[] = { STRATEGY_A, STRATEGY_B };
+    Deck deck;
+    Game game;
+    FILE* table = tmpfile();
+    fputs("Bk 0 0 0 0 0 1\n", table);
+    rewind(table);
+    ASSERT_EQ(E_OK, site_table_load(table));
+    fclose(table);
+
+    // A blocking site holds all players, like a barrier
+    fputs("9;::-Mo1Xx1V11Bk1V22Mo1Mo1::-\n", fileStream[1]);
+    fclose(fileStream[1]);
+    fileStream[1] = nullptr;
+    ASSERT_EQ(E_OK, player_read_path(fileStream[0], 2, path));
+    EXPECT_EQ(2, path_site_capacity(path, 4u));
+    EXPECT_EQ(1, path_site_capacity(path, 3u));
+
+    deck.buffer = cards;
+    deck.size = 3u;
+    deck.nextCard = cards;
+    game.path = path;
+    game.playersCount = 2;
+    game.positions = positions;
+    game.rankings = rankings;
+    game.players = players;
+    game.deck = &deck;
+    game.seed = 1u;
+    engine_reset_game(&game);
+    EXPECT_NE(0, engine_play_out(&game, strategies));
+    EXPECT_EQ(8, positions[0]);
+    EXPECT_EQ(8, positions[1]);
+    site_table_reset();
+}
+
+TEST_F(PlayerASuite, test_replay) {
+    int positions[2];
+    int rankings[2];
+    Player players[2];
+    char cards[] = "ABACDEE";
+    enum StrategyTypes strategies[] = { STRATEGY_A, STRATEGY_B };
+    Deck deck;
+    Game game;
+    ReplayJournal journal;
+    ReplayStats stats;
+    ReplayStats other;
+    Arena arena;
+    char* data = nullptr;
+    size_t length = 0u;
+    unsigned long explained = 0ul;
+    int id = 0;
+    int site = 0;
+    int i = 0;
+    FILE* stream = open_memstream(&data, &length);
+    const char buffer[] = "7;::-Mo1V11V22Mo1Mo1::-\n";
+    fputs(buffer, fileStream[1]);
+    fclose(fileStream[1]);
+    fileStream[1] = nullptr;
+    ASSERT_EQ(E_OK, player_read_path(fileStream[0], 2, path));
+
+    // Record the same game at two tables, move by move
+    deck.buffer = cards;
+    deck.size = 7u;
+    deck.nextCard = cards;
+    game.path = path;
+    game.playersCount = 2;
+    game.positions = positions;
+    game.rankings = rankings;
+    game.players = players;
+    game.deck = &deck;
+    game.seed = 1u;
+    engine_reset_game(&game);
+    ASSERT_NE(0, journal_write_header(stream, 2, 2, "AB", path, &deck));
+    EXPECT_NE(0, journal_write_record(stream, 0, JOURNAL_START, 0, 0, 0));
+    EXPECT_NE(0, journal_write_record(stream, 1, JOURNAL_START, 0, 0, 0));
+    while (!dealer_is_finished(2, 7, positions, rankings)) {
+        id = dealer_calculate_next_player(2, positions, rankings);
+        site = engine_choose_site(&game, id, strategies[id]);
+        journal_write_record(stream, 0, JOURNAL_MOVE, id, site, 0);
+        journal_write_record(stream, 1, JOURNAL_MOVE, id, site, 0);
+        engine_play_move(&game, id, site);
+    }
+    journal_write_record(stream, 0, JOURNAL_END, 0, 0, 1);
+    journal_write_record(stream, 1, JOURNAL_END, 0, 0, 1);
+    fclose(stream);
+
+    ASSERT_NE(0, replay_open(&journal, data, length));
+    EXPECT_EQ(7u, journal.path.siteCount);
+    EXPECT_EQ(STRATEGY_B, journal.strategies[1]);
+    arena_init(&arena, ARENA_BLOCK_SIZE);
+
+    // Chunks only replay the games starting in them, reading on to the end
+    replay_stats_init(&stats);
+    replay_stats_init(&other);
+    replay_chunk(&stats, &journal, 0u, 1u, &arena);
+    replay_chunk(&other, &journal, 1u, journal.view.recordsCount, &arena);
+    EXPECT_EQ(1ul, stats.games);
+    EXPECT_EQ(1ul, other.games);
+    replay_stats_merge(&stats, &other);
+    EXPECT_EQ(2ul, stats.games);
+    EXPECT_EQ(0ul, stats.unfinished);
+    EXPECT_EQ(journal.view.recordsCount - 4u, stats.moves);
+    EXPECT_EQ(0ul, stats.offStrategy);
+    for (i = 0; i < STRATEGY_RULES_COUNT; i++) {
+        explained += stats.rules[i];
+    }
+    EXPECT_EQ(stats.moves, explained);
+    EXPECT_EQ(4ul, stats.arrivals[6]);
+    EXPECT_EQ(2ul, stats.sharedArrivals[6]);
+    EXPECT_EQ(2.0 * (engine_final_score(players)
+            - engine_final_score(players + 1)), stats.leads[9]);
+
+    // A journal cut short leaves its games unfinished
+    replay_stats_free(&other);
+    replay_stats_init(&other);
+    journal.view.recordsCount -= 2u;
+    replay_chunk(&other, &journal, 0u, 2u, &arena);
+    EXPECT_EQ(0ul, other.games);
+    EXPECT_EQ(2ul, other.unfinished);
+
+    replay_stats_free(&stats);
+    replay_stats_free(&other);
+    arena_free(&arena);
+    replay_close(&journal);
+    free(data);
+    EXPECT_EQ(0, journal_parse("2310JNX", 8u, &journal.view));
+
+    // No record follows one which could not be written
+    stream = fopen("/dev/full", "wb");
+    ASSERT_NE(nullptr, stream);
+    setvbuf(stream, NULL, _IONBF, 0u);
+    EXPECT_EQ(0, journal_write_record(stream, 0, JOURNAL_START, 0, 0, 0));
+    EXPECT_NE(0, ferror(stream));
+    EXPECT_EQ(0, journal_write_record(stream, 0, JOURNAL_END, 0, 0, 1));
+    fclose(stream);
+}
+
+TEST_F(PlayerASuite, test_handoff) {
+    Handoff handoff;
+    HandoffPlayer player;
+    FILE* input = NULL;
+    FILE* output = NULL;
+    char line[MESSAGE_LENGTH];
+    int awaited[2] = {1, 1};
+    int fds[2];
+
+    ASSERT_EQ(0, pipe(fds));
+    ASSERT_EQ(0, handoff_create(&handoff, 2, 10));
+    EXPECT_EQ(E_COMMS_ERROR, handoff_attach(&player, handoff.fd, 2, 0,
+            fds[0]));
+    ASSERT_EQ(E_OK, handoff_attach(&player, handoff.fd, 1, 10, fds[0]));
+    input = handoff_open_input(&player);
+    output = handoff_open_moves(&player);
+    ASSERT_NE(nullptr, input);
+    ASSERT_NE(nullptr, output);
+
+    // The broadcasts before the turn are read first, the later ones after
+    ASSERT_EQ(12, write(fds[1], "HAP0,1,0,0,0", 12));
+    ASSERT_EQ(1, write(fds[1], "\n", 1));
+    handoff_post_turn(&handoff, 1, 13u);
+    ASSERT_EQ(8, write(fds[1], "HAP1,2\n\n", 8));
+    ASSERT_NE(nullptr, fgets(line, sizeof(line), input));
+    EXPECT_STREQ("HAP0,1,0,0,0\n", line);
+    ASSERT_NE(nullptr, fgets(line, sizeof(line), input));
+    EXPECT_STREQ("YT\n", line);
+
+    EXPECT_TRUE(handoff_busy(&handoff, 1));
+    EXPECT_EQ(-1, handoff_find_move(&handoff, awaited, 2));
+    fprintf(output, "DO%d\n", 5);
+    fflush(output);
+    EXPECT_EQ(1, handoff_wait_move(&handoff, awaited, 2, 0));
+    EXPECT_EQ(5, handoff_take_move(&handoff, 1));
+    EXPECT_EQ(-1, handoff_take_move(&handoff, 1));
+    EXPECT_FALSE(handoff_busy(&handoff, 1));
+    EXPECT_EQ(-1, handoff_wait_move(&handoff, awaited, 2, 0));
+
+    // A closed seat reads the rest up to the end
+    close(fds[1]);
+    handoff_close_seat(&handoff, 1);
+    ASSERT_NE(nullptr, fgets(line, sizeof(line), input));
+    EXPECT_STREQ("HAP1,2\n", line);
+    ASSERT_NE(nullptr, fgets(line, sizeof(line), input));
+    EXPECT_STREQ("\n", line);
+    EXPECT_EQ(nullptr, fgets(line, sizeof(line), input));
+
+    fclose(input);
+    fclose(output);
+    close(fds[0]);
+    handoff_detach(&player);
+    handoff_destroy(&handoff);
+}
+
+TEST_F(PlayerASuite, test_counters) {
+    Counters counters;
+    Counters other;
+    char* text = NULL;
+    size_t length = 0u;
+    FILE* file = NULL;
+
+    counters_init(&counters);
+    counters_init(&other);
+    other.values[COUNTER_CYCLES] = 200u;
+    other.values[COUNTER_INSTRUCTIONS] = 300u;
+    other.counted[COUNTER_CYCLES] = 1;
+    other.counted[COUNTER_INSTRUCTIONS] = 1;
+    counters_add(&counters, &other);
+    counters_add(&counters, &other);
+
+    file = open_memstream(&text, &length);
+    ASSERT_NE(nullptr, file);
+    counters_print(file, "Counters: ", &counters);
+    fclose(file);
+    EXPECT_STREQ("Counters: Cycles=400 Instructions=600 CacheMisses=n/a "
+            "BranchMisses=n/a ContextSwitches=n/a IPC=1.50\n", text);
+    free(text);
+
+    // Whatever the machine allows to be counted, reading never fails
+    counters_init(&counters);
+    EXPECT_LE(0, counters_open(&counters, 0, 1));
+    counters_read(&counters);
+    for (int i = 0; i < COUNTER_EVENTS_COUNT; i++) {
+        EXPECT_EQ(-1, counters.fds[i]);
+    }
+}
+
+TEST_F(PlayerASuite, test_results) {
+    ResultsWriter writer;
+    ResultsFile file;
+    ResultsBlock block;
+    Player players[2];
+    FILE* stream = tmpfile();
+    char* data = NULL;
+    long length = 0;
+
+    ASSERT_NE(nullptr, stream);
+    ASSERT_TRUE(results_write_header(stream));
+    dealer_reset_player(players);
+    dealer_reset_player(players + 1);
+    players[0].v1 = 4;
+    players[0].points = 3;
+    players[0].cards[1] = 2;
+    players[0].cards[2] = 1;
+    players[1].v2 = 6;
+
+    results_writer_init(&writer, stream, 2, "AB", 7u, 9u);
+    results_writer_add(&writer, 0u, 100u, 12u, players);
+    results_writer_add(&writer, 1u, 200u, 14u, players);
+    EXPECT_TRUE(results_writer_free(&writer));
+    EXPECT_EQ(2, players[0].cards[1]);
+
+    // Another run appends a block of its own after a cut short one
+    ASSERT_EQ(5u, fwrite("2310R", 1u, 5u, stream));
+    ASSERT_TRUE(results_write_header(stream));
+    results_writer_init(&writer, stream, 1, "C", 8u, 9u);
+    results_writer_add(&writer, 5u, 300u, 20u, players + 1);
+    EXPECT_TRUE(results_writer_free(&writer));
+
+    ASSERT_EQ(0, fseek(stream, 0, SEEK_END));
+    length = ftell(stream);
+    data = (char*)malloc(length);
+    rewind(stream);
+    ASSERT_EQ((size_t)length, fread(data, 1u, length, stream));
+    fclose(stream);
+
+    ASSERT_TRUE(results_open(&file, data, length));
+    ASSERT_TRUE(results_next_block(&file, &block));
+    ASSERT_EQ(2u, block.rows);
+    ASSERT_EQ(2, block.playersCount);
+    EXPECT_EQ(1u, block.games[1]);
+    EXPECT_EQ(7u, block.seeds[0]);
+    EXPECT_EQ(9u, block.pathHashes[1]);
+    EXPECT_EQ(200u, block.durations[1]);
+    EXPECT_EQ(14u, block.moves[1]);
+    EXPECT_EQ('A', block.strategies[1]);
+    EXPECT_EQ('B', block.strategies[2]);
+    // Two sets of cards: 3 points for two types, 1 for the one left
+    EXPECT_EQ(4, block.cardPoints[0]);
+    EXPECT_EQ(3, block.moneyPoints[1]);
+    EXPECT_EQ(11, block.scores[0]);
+    EXPECT_EQ(6, block.scores[2]);
+    EXPECT_EQ(6, block.v2s[3]);
+
+    ASSERT_TRUE(results_next_block(&file, &block));
+    ASSERT_EQ(1u, block.rows);
+    EXPECT_EQ(5u, block.games[0]);
+    EXPECT_EQ('C', block.strategies[0]);
+    EXPECT_EQ(6, block.scores[0]);
+    EXPECT_FALSE(results_next_block(&file, &block));
+
+    // A block cut short ends the file
+    EXPECT_FALSE(results_open(&file, data, 8u));
+    ASSERT_TRUE(results_open(&file, data, length - 8));
+    EXPECT_TRUE(results_next_block(&file, &block));
+    EXPECT_FALSE(results_next_block(&file, &block));
+    free(data);
+
+    // A block which can't be written is reported, and so are later ones
+    stream = fopen("/dev/full", "a+b");
+    ASSERT_NE(nullptr, stream);
+    results_writer_init(&writer, stream, 2, "AB", 7u, 9u);
+    results_writer_add(&writer, 0u, 100u, 12u, players);
+    EXPECT_FALSE(results_writer_flush(&writer));
+    EXPECT_EQ(0u, writer.blocks);
+    results_writer_add(&writer, 1u, 100u, 12u, players);
+    EXPECT_FALSE(results_writer_free(&writer));
+    fclose(stream);
+}
+
+TEST_F(PlayerASuite, test_samples) {
+    SampleExporter exporter;
+    SampleGame game;
+    SamplesHeader header;
+    const SampleRecord* record = NULL;
+    const SampleSeat* seat = NULL;
+    Player players[3];
+    int positions[3] = { 0, 2, 5 };
+    int rankings[3] = { 0, 0, 1 };
+    size_t recordLength = samples_record_length(3);
+    FILE* stream = tmpfile();
+    char* data = NULL;
+    long length = 0;
+    int i = 0;
+
+    ASSERT_NE(nullptr, stream);
+    ASSERT_EQ(0u, recordLength % SAMPLES_ALIGNMENT);
+    ASSERT_TRUE(samples_write_header(stream, 3));
+    for (i = 0; i < 3; i++) {
+        dealer_reset_player(players + i);
+    }
+    players[1].cards[CARD_C] = 2;
+    players[2].money = 9;
+
+    // Buffers of two records, so the game's records are handed off twice
+    samples_start(&exporter, stream, 3, 2u * recordLength + 1u);
+    samples_game_init(&game, 3);
+    for (i = 0; i < 5; i++) {
+        samples_game_add(&game, 4u, (uint32_t)i, i % 3, 6 + i, positions,
+                rankings, players);
+    }
+    players[0].points = 10;
+    players[1].v1 = 4;
+    players[2].v2 = 7;
+    samples_game_end(&game, &exporter, players);
+
+    // A game which did not end regularly is dropped
+    samples_game_add(&game, 5u, 0u, 0, 1, positions, rankings, players);
+    samples_game_clear(&game);
+    samples_game_free(&game);
+    EXPECT_TRUE(samples_stop(&exporter));
+    EXPECT_EQ(5u, exporter.records);
+
+    ASSERT_EQ(0, fseek(stream, 0, SEEK_END));
+    length = ftell(stream);
+    ASSERT_EQ(sizeof(SamplesHeader) + 5u * recordLength, (size_t)length);
+    data = (char*)malloc(length);
+    rewind(stream);
+    ASSERT_EQ((size_t)length, fread(data, 1u, length, stream));
+    fclose(stream);
+
+    memcpy(&header, data, sizeof(SamplesHeader));
+    EXPECT_EQ(0, memcmp(header.magic, SAMPLES_MAGIC, sizeof(SAMPLES_MAGIC)));
+    EXPECT_EQ(SAMPLES_VERSION, header.version);
+    EXPECT_EQ(3u, header.playersCount);
+    EXPECT_EQ(recordLength, header.recordLength);
+
+    for (i = 0; i < 5; i++) {
+        record = (const SampleRecord*)(data + sizeof(SamplesHeader)
+                + i * recordLength);
+        EXPECT_EQ(4u, record->game);
+        EXPECT_EQ((uint32_t)i, record->move);
+        EXPECT_EQ((uint32_t)(i % 3), record->id);
+        EXPECT_EQ(6 + i, record->site);
+    }
+    // Scores 10, 4 + 2 for two sets of one card, 7
+    record = (const SampleRecord*)(data + sizeof(SamplesHeader));
+    EXPECT_EQ(3, record->outcome);
+    record = (const SampleRecord*)((const char*)record + recordLength);
+    EXPECT_EQ(-4, record->outcome);
+    seat = (const SampleSeat*)(record + 1);
+    EXPECT_EQ(5u, seat[2].position);
+    EXPECT_EQ(1u, seat[2].ranking);
+    EXPECT_EQ(9, seat[2].money);
+    EXPECT_EQ(2u, seat[1].cards[CARD_C - CARD_A]);
+    record = (const SampleRecord*)((const char*)record + recordLength);
+    EXPECT_EQ(-3, record->outcome);
+    free(data);
+
+    // Records which can't be written are not counted
+    stream = fopen("/dev/full", "wb");
+    ASSERT_NE(nullptr, stream);
+    samples_start(&exporter, stream, 3, 2u * recordLength);
+    samples_game_init(&game, 3);
+    for (i = 0; i < 3; i++) {
+        samples_game_add(&game, 6u, (uint32_t)i, i, 1 + i, positions,
+                rankings, players);
+    }
+    samples_game_end(&game, &exporter, players);
+    samples_game_free(&game);
+    EXPECT_FALSE(samples_stop(&exporter));
+    EXPECT_EQ(0u, exporter.records);
+    fclose(stream);
+}